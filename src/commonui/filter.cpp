@@ -47,6 +47,16 @@ bool valid_regex(std::wstring const& r)
 	return compile_regex(r, true) != nullptr;
 }
 
+bool search_regex(std::shared_ptr<void> const& r, std::wstring const& subject)
+{
+	return r && regex_ns::regex_search(subject, *std::static_pointer_cast<regex_ns::wregex>(r));
+}
+
+bool regex_ignores_case(std::shared_ptr<void> const& r)
+{
+	return r && (std::static_pointer_cast<regex_ns::wregex>(r)->flags() & regex_ns::regex_constants::icase);
+}
+
 
 std::array<std::wstring, 4> const matchTypeXmlNames =
 	{ L"All", L"Any", L"None", L"Not all" };
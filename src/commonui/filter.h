@@ -113,4 +113,8 @@ void FZCUI_PUBLIC_SYMBOL save_filters(pugi::xml_node& element, filter_data const
 bool FZCUI_PUBLIC_SYMBOL valid_regex(std::wstring const& r);
 std::shared_ptr<void> compile_regex(std::wstring const& r, bool matchCase);
 
+// For regular expressions returned by compile_regex
+bool FZCUI_PUBLIC_SYMBOL search_regex(std::shared_ptr<void> const& r, std::wstring const& subject);
+bool FZCUI_PUBLIC_SYMBOL regex_ignores_case(std::shared_ptr<void> const& r);
+
 #endif
@@ -0,0 +1,597 @@
+#include "filter_matcher.h"
+#include "../include/directorylisting.h"
+
+#include <libfilezilla/string.hpp>
+
+#ifndef FZ_WINDOWS
+#include <sys/stat.h>
+#endif
+
+#include <string_view>
+#include <type_traits>
+
+namespace {
+struct regex_text final
+{
+	std::wstring text; // Longest text all matches contain
+	bool plain{}; // Nothing but text and anchors
+	bool begin{};
+	bool end{};
+};
+
+bool is_special(wchar_t c)
+{
+	return std::wstring_view(L"\\^$.|?*+()[]{}").find(c) != std::wstring_view::npos;
+}
+
+// Returns position after the closing bracket, npos if there is none
+size_t skip_class(std::wstring const& r, size_t i)
+{
+	++i;
+	if (i < r.size() && r[i] == '^') {
+		++i;
+	}
+	while (i < r.size()) {
+		if (r[i] == '\\') {
+			i += 2;
+		}
+		else if (r[i] == ']') {
+			return i + 1;
+		}
+		else {
+			++i;
+		}
+	}
+	return std::wstring::npos;
+}
+
+size_t skip_group(std::wstring const& r, size_t i)
+{
+	int depth = 1;
+	++i;
+	while (i < r.size()) {
+		if (r[i] == '\\') {
+			i += 2;
+		}
+		else if (r[i] == '[') {
+			i = skip_class(r, i);
+			if (i == std::wstring::npos) {
+				return i;
+			}
+		}
+		else if (r[i] == '(') {
+			++depth;
+			++i;
+		}
+		else if (r[i] == ')') {
+			++i;
+			if (!--depth) {
+				return i;
+			}
+		}
+		else {
+			++i;
+		}
+	}
+	return std::wstring::npos;
+}
+
+// Conservative analysis of ECMAScript syntax. Anything not understood
+// results in no text being required.
+regex_text analyze_regex(std::wstring const& r)
+{
+	regex_text ret;
+
+	bool plain = true;
+	std::wstring run;
+	auto const end_run = [&]() {
+		if (run.size() > ret.text.size()) {
+			ret.text = run;
+		}
+		run.clear();
+	};
+
+	size_t i = 0;
+	if (!r.empty() && r[0] == '^') {
+		ret.begin = true;
+		++i;
+	}
+	while (i < r.size()) {
+		wchar_t c = r[i];
+		bool literal{};
+		if (c == '|') {
+			// Alternatives, no text is required
+			return {};
+		}
+		else if (c == '\\') {
+			if (i + 1 >= r.size()) {
+				return {};
+			}
+			c = r[i + 1];
+			if ((c >= '0' && c <= '9') || std::wstring_view(L"xucpPk").find(c) != std::wstring_view::npos) {
+				// Escapes taking arguments
+				return {};
+			}
+			literal = is_special(c) || c == '/' || c == '-';
+			i += 2;
+		}
+		else if (c == '$' && i + 1 == r.size()) {
+			ret.end = true;
+			++i;
+			break;
+		}
+		else if (c == '[') {
+			i = skip_class(r, i);
+		}
+		else if (c == '(') {
+			i = skip_group(r, i);
+		}
+		else if (c == '.' || c == '^' || c == '$') {
+			++i;
+		}
+		else if (is_special(c)) {
+			// Quantifier without atom or stray bracket
+			return {};
+		}
+		else {
+			literal = true;
+			++i;
+		}
+		if (i == std::wstring::npos) {
+			return {};
+		}
+
+		bool quantified{};
+		bool optional{};
+		if (i < r.size()) {
+			if (r[i] == '*' || r[i] == '?') {
+				quantified = true;
+				optional = true;
+				++i;
+			}
+			else if (r[i] == '+') {
+				quantified = true;
+				++i;
+			}
+			else if (r[i] == '{') {
+				size_t j = i + 1;
+				bool nonzero{};
+				while (j < r.size() && r[j] >= '0' && r[j] <= '9') {
+					nonzero |= r[j] != '0';
+					++j;
+				}
+				if (j == i + 1) {
+					return {};
+				}
+				while (j < r.size() && (r[j] == ',' || (r[j] >= '0' && r[j] <= '9'))) {
+					++j;
+				}
+				if (j >= r.size() || r[j] != '}') {
+					return {};
+				}
+				quantified = true;
+				optional = !nonzero;
+				i = j + 1;
+			}
+			if (quantified && i < r.size() && r[i] == '?') {
+				// Lazy
+				++i;
+			}
+		}
+
+		if (!literal || quantified) {
+			plain = false;
+		}
+		if (literal && !optional) {
+			run += c;
+		}
+		if (!literal || quantified) {
+			end_run();
+		}
+	}
+	end_run();
+
+	ret.plain = plain;
+	return ret;
+}
+
+bool is_ascii(std::wstring const& s)
+{
+	for (auto const& c : s) {
+		if (static_cast<std::make_unsigned_t<wchar_t>>(c) >= 0x80) {
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+class filter_matcher::subject final
+{
+public:
+	explicit subject(std::wstring const& s)
+		: s_(s)
+	{}
+
+	std::wstring const& get() const { return s_; }
+
+	std::wstring const& lower() const
+	{
+		if (!lowered_) {
+			lower_ = fz::str_tolower(s_);
+			lowered_ = true;
+		}
+		return lower_;
+	}
+
+	// nullptr if not all ASCII
+	std::wstring const* ascii_lower() const
+	{
+		if (ascii_ < 0) {
+			ascii_ = is_ascii(s_) ? 1 : 0;
+			if (ascii_) {
+				ascii_lower_ = fz::str_tolower_ascii(s_);
+			}
+		}
+		return ascii_ ? &ascii_lower_ : nullptr;
+	}
+
+private:
+	std::wstring const& s_;
+
+	mutable std::wstring lower_;
+	mutable std::wstring ascii_lower_;
+	mutable bool lowered_{};
+	mutable int ascii_{-1};
+};
+
+struct filter_matcher::entry final
+{
+	subject name;
+	bool dir{};
+	int64_t size{};
+	int attributes{};
+	fz::datetime const& date;
+};
+
+filter_matcher::filter_matcher(std::vector<CFilter> const& filters)
+{
+	for (auto const& f : filters) {
+		filter compiled;
+		compiled.matchType = f.matchType;
+		compiled.filterFiles = f.filterFiles;
+		compiled.filterDirs = f.filterDirs;
+
+		for (auto const& c : f.filters) {
+			condition cc;
+			cc.type = c.type;
+			cc.op = c.condition;
+
+			switch (c.type) {
+			case filter_name:
+			case filter_path:
+				if (c.condition != 4) {
+					if (f.matchCase) {
+						cc.value = c.strValue;
+					}
+					else {
+						cc.value = c.lowerValue;
+						cc.lower = true;
+					}
+				}
+				else if (c.pRegEx) {
+					auto const analyzed = analyze_regex(c.strValue);
+					if (regex_ignores_case(c.pRegEx)) {
+						// The regex decides for names not in ASCII
+						if (is_ascii(analyzed.text)) {
+							cc.literal = fz::str_tolower_ascii(analyzed.text);
+						}
+						cc.lower = true;
+						cc.regex = c.pRegEx;
+					}
+					else if (analyzed.plain) {
+						cc.value = analyzed.text;
+						if (analyzed.begin && analyzed.end) {
+							cc.op = 1;
+						}
+						else if (analyzed.begin) {
+							cc.op = 2;
+						}
+						else if (analyzed.end) {
+							cc.op = 3;
+						}
+						else {
+							cc.op = 0;
+						}
+					}
+					else {
+						cc.literal = analyzed.text;
+						cc.regex = c.pRegEx;
+					}
+				}
+				if (c.type == filter_path) {
+					cc.path_index = path_conditions_++;
+				}
+				break;
+			case filter_size:
+				cc.number = c.value;
+				break;
+			case filter_attributes:
+#ifdef FZ_WINDOWS
+				switch (c.condition) {
+				case 0:
+					cc.flag = FILE_ATTRIBUTE_ARCHIVE;
+					break;
+				case 1:
+					cc.flag = FILE_ATTRIBUTE_COMPRESSED;
+					break;
+				case 2:
+					cc.flag = FILE_ATTRIBUTE_ENCRYPTED;
+					break;
+				case 3:
+					cc.flag = FILE_ATTRIBUTE_HIDDEN;
+					break;
+				case 4:
+					cc.flag = FILE_ATTRIBUTE_READONLY;
+					break;
+				case 5:
+					cc.flag = FILE_ATTRIBUTE_SYSTEM;
+					break;
+				}
+#endif
+				cc.number = c.value;
+				break;
+			case filter_permissions:
+#ifndef FZ_WINDOWS
+				switch (c.condition) {
+				case 0:
+					cc.flag = S_IRUSR;
+					break;
+				case 1:
+					cc.flag = S_IWUSR;
+					break;
+				case 2:
+					cc.flag = S_IXUSR;
+					break;
+				case 3:
+					cc.flag = S_IRGRP;
+					break;
+				case 4:
+					cc.flag = S_IWGRP;
+					break;
+				case 5:
+					cc.flag = S_IXGRP;
+					break;
+				case 6:
+					cc.flag = S_IROTH;
+					break;
+				case 7:
+					cc.flag = S_IWOTH;
+					break;
+				case 8:
+					cc.flag = S_IXOTH;
+					break;
+				}
+#endif
+				cc.number = c.value;
+				break;
+			case filter_date:
+				cc.date = c.date;
+				break;
+			}
+
+			compiled.conditions.emplace_back(std::move(cc));
+		}
+
+		filters_.emplace_back(std::move(compiled));
+	}
+}
+
+bool filter_matcher::condition::match(subject const& s) const
+{
+	if (op == 4) {
+		if (!regex) {
+			return false;
+		}
+		if (!literal.empty()) {
+			if (lower) {
+				auto const* l = s.ascii_lower();
+				if (l && l->find(literal) == std::wstring::npos) {
+					return false;
+				}
+			}
+			else if (s.get().find(literal) == std::wstring::npos) {
+				return false;
+			}
+		}
+		return search_regex(regex, s.get());
+	}
+
+	std::wstring const& v = lower ? s.lower() : s.get();
+	switch (op) {
+	case 0:
+		return v.find(value) != std::wstring::npos;
+	case 1:
+		return v == value;
+	case 2:
+		return fz::starts_with(v, value);
+	case 3:
+		return fz::ends_with(v, value);
+	case 5:
+		return v.find(value) == std::wstring::npos;
+	}
+
+	return false;
+}
+
+bool filter_matcher::filter::filtered(entry const& e, std::vector<uint8_t> const& path_matches) const
+{
+	if (e.dir ? !filterDirs : !filterFiles) {
+		return false;
+	}
+
+	// Same logic as in filter_manager::FilenameFilteredByFilter
+	for (auto const& c : conditions) {
+		bool match = false;
+
+		switch (c.type) {
+		case filter_name:
+			match = c.match(e.name);
+			break;
+		case filter_path:
+			match = path_matches[c.path_index] != 0;
+			break;
+		case filter_size:
+			if (e.size == -1) {
+				continue;
+			}
+			switch (c.op) {
+			case 0:
+				match = e.size > c.number;
+				break;
+			case 1:
+				match = e.size == c.number;
+				break;
+			case 2:
+				match = e.size != c.number;
+				break;
+			case 3:
+				match = e.size < c.number;
+				break;
+			}
+			break;
+		case filter_attributes:
+#ifndef FZ_WINDOWS
+			continue;
+#else
+			if (!e.attributes) {
+				continue;
+			}
+			match = ((c.flag & e.attributes) ? 1 : 0) == c.number;
+			break;
+#endif
+		case filter_permissions:
+#ifdef FZ_WINDOWS
+			continue;
+#else
+			if (e.attributes == -1) {
+				continue;
+			}
+			match = ((c.flag & e.attributes) ? 1 : 0) == c.number;
+			break;
+#endif
+		case filter_date:
+			if (!e.date.empty()) {
+				int const cmp = e.date.compare(c.date);
+				switch (c.op) {
+				case 0:
+					match = cmp < 0;
+					break;
+				case 1:
+					match = cmp == 0;
+					break;
+				case 2:
+					match = cmp != 0;
+					break;
+				case 3:
+					match = cmp > 0;
+					break;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+		if (match) {
+			if (matchType == CFilter::any) {
+				return true;
+			}
+			else if (matchType == CFilter::none) {
+				return false;
+			}
+		}
+		else {
+			if (matchType == CFilter::all) {
+				return false;
+			}
+			else if (matchType == CFilter::not_all) {
+				return true;
+			}
+		}
+	}
+
+	if (matchType == CFilter::not_all) {
+		return false;
+	}
+
+	if (matchType != CFilter::any || conditions.empty()) {
+		return true;
+	}
+
+	return false;
+}
+
+std::vector<uint8_t> filter_matcher::match_path(std::wstring const& path) const
+{
+	std::vector<uint8_t> ret(path_conditions_);
+	if (path_conditions_) {
+		subject const s(path);
+		for (auto const& f : filters_) {
+			for (auto const& c : f.conditions) {
+				if (c.type == filter_path) {
+					ret[c.path_index] = c.match(s) ? 1 : 0;
+				}
+			}
+		}
+	}
+	return ret;
+}
+
+bool filter_matcher::filtered(entry const& e, std::vector<uint8_t> const& path_matches) const
+{
+	for (auto const& f : filters_) {
+		if (f.filtered(e, path_matches)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool filter_matcher::filtered(std::wstring const& name, std::wstring const& path, bool dir, int64_t size, int attributes, fz::datetime const& date) const
+{
+	if (filters_.empty()) {
+		return false;
+	}
+
+	return filtered(entry{subject(name), dir, size, attributes, date}, match_path(path));
+}
+
+std::vector<bool> filter_matcher::filtered(CDirectoryListing const& listing, std::wstring const& path) const
+{
+	std::vector<bool> ret(listing.size());
+	if (filters_.empty()) {
+		return ret;
+	}
+
+	auto const path_matches = match_path(path);
+	for (size_t i = 0; i < listing.size(); ++i) {
+		CDirentry const& d = listing[i];
+		ret[i] = filtered(entry{subject(d.name), d.is_dir(), d.size, 0, d.time}, path_matches);
+	}
+	return ret;
+}
+
+std::vector<bool> filter_matcher::filtered(std::vector<local_recursive_operation::listing::entry> const& entries, std::wstring const& path, bool dirs) const
+{
+	std::vector<bool> ret(entries.size());
+	if (filters_.empty()) {
+		return ret;
+	}
+
+	auto const path_matches = match_path(path);
+	for (size_t i = 0; i < entries.size(); ++i) {
+		auto const& d = entries[i];
+		ret[i] = filtered(entry{subject(d.name), dirs, d.size, d.attributes, d.time}, path_matches);
+	}
+	return ret;
+}
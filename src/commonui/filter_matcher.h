@@ -0,0 +1,79 @@
+#ifndef FILEZILLA_COMMONUI_FILTER_MATCHER_HEADER
+#define FILEZILLA_COMMONUI_FILTER_MATCHER_HEADER
+
+#include "filter.h"
+#include "local_recursive_operation.h"
+
+class CDirectoryListing;
+
+// Filters prepared for matching the entries of whole directories.
+//
+// Gives the same results as filter_manager::FilenameFiltered, but does the
+// work depending only on the filters once: values are lower-cased up front
+// and regular expressions get analyzed for text every match has to contain.
+// Regular expressions that are nothing but such text are replaced by string
+// comparisons, the others only run on names containing the text.
+//
+// Names get lower-cased at most once per entry for all filters. When
+// evaluating a directory, conditions on the path are evaluated only once.
+class FZCUI_PUBLIC_SYMBOL filter_matcher final
+{
+public:
+	filter_matcher() = default;
+	explicit filter_matcher(std::vector<CFilter> const& filters);
+
+	explicit operator bool() const { return !filters_.empty(); }
+
+	// Note: Under non-windows, attributes are permissions
+	bool filtered(std::wstring const& name, std::wstring const& path, bool dir, int64_t size, int attributes, fz::datetime const& date) const;
+
+	// Evaluates all entries in a single pass. Entry i is filtered if bit i
+	// of the returned bitmap is set.
+	std::vector<bool> filtered(CDirectoryListing const& listing, std::wstring const& path) const;
+	std::vector<bool> filtered(std::vector<local_recursive_operation::listing::entry> const& entries, std::wstring const& path, bool dirs) const;
+
+private:
+	class subject;
+	struct entry;
+
+	struct condition final
+	{
+		bool match(subject const& s) const;
+
+		t_filterType type{filter_name};
+		int op{}; // As in CFilterCondition
+
+		// Name and path matches
+		std::wstring value; // Lower-case if lower is set
+		std::shared_ptr<void> regex;
+		std::wstring literal; // Contained in all matches of regex
+		bool lower{};
+
+		size_t path_index{};
+
+		int64_t number{}; // Size, or attribute state
+		int flag{}; // Attribute or permission bit
+		fz::datetime date;
+	};
+
+	struct filter final
+	{
+		bool filtered(entry const& e, std::vector<uint8_t> const& path_matches) const;
+
+		std::vector<condition> conditions;
+		CFilter::t_matchType matchType{CFilter::all};
+		bool filterFiles{true};
+		bool filterDirs{true};
+	};
+
+	std::vector<uint8_t> match_path(std::wstring const& path) const;
+	bool filtered(entry const& e, std::vector<uint8_t> const& path_matches) const;
+
+	std::vector<filter> filters_;
+
+	// Conditions on the path are numbered, their results get passed
+	// along with the entry
+	size_t path_conditions_{};
+};
+
+#endif
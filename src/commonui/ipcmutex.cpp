@@ -121,7 +121,8 @@ int CInterProcessMutex::TryLock()
 	}
 
 	int res = ::WaitForSingleObject(hMutex, 1);
-	if (res == WAIT_OBJECT_0) {
+	if (res == WAIT_OBJECT_0 || res == WAIT_ABANDONED) {
+		// Also acquired if abandoned by a process that exited without releasing it
 		m_locked = true;
 		return 1;
 	}
@@ -31,7 +31,8 @@ enum t_ipcMutexType
 	MUTEX_GLOBALBOOKMARKS = 9,
 	MUTEX_SEARCHCONDITIONS = 10,
 	MUTEX_MAC_SANDBOX_USERDIRS = 11, // Only used if configured with --enable-mac-sandbox
-	MUTEX_TOKENSTORE = 12
+	MUTEX_TOKENSTORE = 12,
+	MUTEX_QUEUE_OWNER = 13 // Held for the lifetime of the instance keeping the stored queue up to date
 };
 
 // this sets the path where the lock file is located in non-windows systems
@@ -1,12 +1,58 @@
 #include "local_recursive_operation.h"
+#include "filter_matcher.h"
 
 #include <libfilezilla/local_filesys.hpp>
 
+#include <algorithm>
+#include <thread>
+
+namespace {
+// Enumerating is mostly waiting for the filesystem. A few directories in
+// flight are enough to keep fast storage busy without thrashing slow disks.
+size_t constexpr default_max_workers = 8;
+
+// Number of entries after which a partial listing is handed off
+size_t constexpr chunk_size = 5000;
+}
+
+class local_recursive_operation::dir_node final
+{
+public:
+	struct chunk final
+	{
+		listing d;
+		std::vector<dir_node_ptr> subdirs;
+	};
+
+	// Set if this directory or one of its parents turned out to be visited already
+	bool skipped() const
+	{
+		for (auto node = this; node; node = node->parent.get()) {
+			if (node->skip) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	CLocalPath localPath;
+	CServerPath remotePath;
+	bool recurse{true};
+
+	dir_node_ptr parent;
+	bool skip{};
+
+	// Enumerated, but not yet delivered
+	std::deque<chunk> chunks;
+	bool done{};
+};
+
 local_recursive_operation::local_recursive_operation()
 {}
 
-local_recursive_operation::local_recursive_operation(fz::thread_pool& pool)
+local_recursive_operation::local_recursive_operation(fz::thread_pool& pool, size_t max_workers)
 : pool_(&pool)
+, max_workers_(max_workers ? max_workers : std::clamp(static_cast<size_t>(std::thread::hardware_concurrency()), size_t(1), default_max_workers))
 {
 }
 
@@ -65,13 +111,34 @@ bool local_recursive_operation::do_start_recursive_operation(OperationMode mode,
 	m_filters = filters;
 	m_ignoreLinks = ignore_links;
 
+	work_.clear();
+	ordered_.clear();
+	root_seeded_ = false;
+	busy_ = 0;
+	idle_ = 0;
+
 	if (pool_) {
-		thread_ = pool_->spawn([this] { thread_entry(); });
-		if (!thread_) {
+		work_.resize(max_workers_);
+		running_ = max_workers_;
+		for (size_t i = 0; i < max_workers_; ++i) {
+			auto thread = pool_->spawn([this, i] { worker_entry(i); });
+			if (!thread) {
+				// Make do with the workers we have
+				running_ -= max_workers_ - i;
+				work_.resize(i);
+				break;
+			}
+			threads_.emplace_back(std::move(thread));
+		}
+		if (threads_.empty()) {
 			m_operationMode = recursive_none;
 			return false;
 		}
 	}
+	else {
+		work_.resize(1);
+		running_ = 1;
+	}
 
 	return true;
 }
@@ -90,136 +157,303 @@ void local_recursive_operation::StopRecursiveOperation()
 		m_processedFiles = 0;
 		m_processedDirectories = 0;
 
+		// Wake up idle workers so that they notice
+		cond_.signal(l);
 	}
 
-	thread_.join();
+	join();
 	m_listedDirectories.clear();
 }
 
-void local_recursive_operation::EnqueueEnumeratedListing(fz::scoped_lock& l, listing&& d, bool recurse)
+void local_recursive_operation::join()
 {
-	if (recursion_roots_.empty()) {
-		return;
+	for (auto & thread : threads_) {
+		thread.join();
 	}
+	threads_.clear();
+}
 
-	auto& root = recursion_roots_.front();
+void local_recursive_operation::thread_entry()
+{
+	worker_entry(0);
+}
 
-	if (recurse) {
-		// Queue for recursion
-		for (auto const& entry : d.dirs) {
-			local_recursion_root::new_dir dir;
-			CLocalPath localSub = d.localPath;
-			localSub.AddSegment(entry.name);
+void local_recursive_operation::worker_entry(size_t index)
+{
+	{
+		fz::scoped_lock l(mutex_);
 
-			CServerPath remoteSub = d.remotePath;
-			if (!remoteSub.empty()) {
-				if (m_operationMode == recursive_transfer) {
-					// Non-flatten case
-					remoteSub.AddSegment(entry.name);
+		filter_matcher const filter(m_filters.first);
+
+		while (!recursion_roots_.empty()) {
+			auto node = take_work(index);
+			if (!node) {
+				if (busy_) {
+					// Others may still find subdirectories
+					++idle_;
+					cond_.wait(l);
+					--idle_;
+					continue;
+				}
+
+				// Nothing left to enumerate in the current root
+				if (root_seeded_) {
+					recursion_roots_.pop_front();
+					root_seeded_ = false;
+				}
+				if (recursion_roots_.empty() || !seed_root(index)) {
+					continue;
+				}
+				node = take_work(index);
+				if (!node) {
+					continue;
 				}
 			}
-			root.add_dir_to_visit(localSub, remoteSub);
+
+			// Pass on the wakeup if there is more to do
+			if (idle_) {
+				for (auto const& work : work_) {
+					if (!work.empty()) {
+						cond_.signal(l);
+						break;
+					}
+				}
+			}
+
+			++busy_;
+			enumerate(l, index, node, filter);
+			--busy_;
 		}
+
+		// Let the other workers notice that there is nothing left
+		cond_.signal(l);
+
+		if (--running_) {
+			return;
+		}
+
+		// Last one out
+		work_.clear();
+		ordered_.clear();
+		listing d;
+		m_listedDirectories.emplace_back(std::move(d));
 	}
 
-	m_listedDirectories.emplace_back(std::move(d));
+	on_listed_directory();
+}
 
-	// Hand off to GUI thread
-	if (m_listedDirectories.size() == 1) {
-		l.unlock();
-		on_listed_directory();
-		l.lock();
+local_recursive_operation::dir_node_ptr local_recursive_operation::take_work(size_t index)
+{
+	// Depth-first on own queue for locality, stealing breadth-first from others
+	auto & own = work_[index];
+	while (!own.empty()) {
+		auto node = std::move(own.back());
+		own.pop_back();
+		if (!node->skipped()) {
+			return node;
+		}
 	}
+
+	for (size_t i = 1; i < work_.size(); ++i) {
+		auto & other = work_[(index + i) % work_.size()];
+		while (!other.empty()) {
+			auto node = std::move(other.front());
+			other.pop_front();
+			if (!node->skipped()) {
+				return node;
+			}
+		}
+	}
+
+	return {};
 }
 
-void local_recursive_operation::thread_entry()
+bool local_recursive_operation::seed_root(size_t index)
 {
-	{
-		fz::scoped_lock l(mutex_);
+	auto & root = recursion_roots_.front();
+	root_seeded_ = true;
+
+	bool seeded{};
+	while (!root.m_dirsToVisit.empty()) {
+		auto const& dir = root.m_dirsToVisit.front();
+		if (root.m_visitedDirs.insert(dir.localPath).second) {
+			auto node = std::make_shared<dir_node>();
+			node->localPath = dir.localPath;
+			node->remotePath = dir.remotePath;
+			node->recurse = dir.recurse;
+			work_[index].push_front(node);
+			ordered_.push_back(std::move(node));
+			seeded = true;
+		}
+		root.m_dirsToVisit.pop_front();
+	}
 
-		auto filters = m_filters.first;
+	return seeded;
+}
 
-		while (!recursion_roots_.empty()) {
-			listing d;
-			bool recurse{true};
+namespace {
+void remove_filtered(std::vector<local_recursive_operation::listing::entry> & entries, filter_matcher const& filter, std::wstring const& path, bool dirs)
+{
+	if (!filter) {
+		return;
+	}
 
-			{
-				auto& root = recursion_roots_.front();
-				if (root.m_dirsToVisit.empty()) {
-					recursion_roots_.pop_front();
+	auto const filtered = filter.filtered(entries, path, dirs);
+	size_t kept{};
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (!filtered[i]) {
+			if (kept != i) {
+				entries[kept] = std::move(entries[i]);
+			}
+			++kept;
+		}
+	}
+	entries.resize(kept);
+}
+}
+
+void local_recursive_operation::enumerate(fz::scoped_lock& l, size_t index, dir_node_ptr const& node, filter_matcher const& filter)
+{
+	listing d;
+	d.localPath = node->localPath;
+	d.remotePath = node->remotePath;
+
+	// Do the slow part without holding mutex
+	l.unlock();
+
+	// Entries get filtered a chunk at a time
+	std::wstring const path = d.localPath.GetPath();
+	auto const apply_filter = [&]() {
+		remove_filtered(d.files, filter, path, false);
+		remove_filtered(d.dirs, filter, path, true);
+	};
+
+	bool sentPartial = false;
+	fz::local_filesys fs;
+	fz::native_string localPath = fz::to_native(path);
+
+	if (fs.begin_find_files(localPath)) {
+		listing::entry entry;
+		bool isLink{};
+		fz::native_string name;
+		fz::local_filesys::type t{};
+		while (fs.get_next_file(name, isLink, t, &entry.size, &entry.time, &entry.attributes)) {
+			if (isLink && m_ignoreLinks) {
+				continue;
+			}
+			entry.name = fz::to_wstring(name);
+
+			if (t == fz::local_filesys::dir) {
+				d.dirs.emplace_back(std::move(entry));
+			}
+			else {
+				d.files.emplace_back(std::move(entry));
+			}
+
+			// If having queued 5k items, hand off to main thread.
+			if (d.files.size() + d.dirs.size() >= chunk_size) {
+				apply_filter();
+				if (d.files.empty() && d.dirs.empty()) {
 					continue;
 				}
 
-				auto const& dir = root.m_dirsToVisit.front();
-				d.localPath = dir.localPath;
-				d.remotePath = dir.remotePath;
-				recurse = dir.recurse;
+				sentPartial = true;
 
-				root.m_dirsToVisit.pop_front();
-			}
+				listing next;
+				next.localPath = d.localPath;
+				next.remotePath = d.remotePath;
 
-			// Do the slow part without holding mutex
-			l.unlock();
-
-			bool sentPartial = false;
-			fz::local_filesys fs;
-			fz::native_string localPath = fz::to_native(d.localPath.GetPath());
-
-			if (fs.begin_find_files(localPath)) {
-				listing::entry entry;
-				bool isLink{};
-				fz::native_string name;
-				fz::local_filesys::type t{};
-				while (fs.get_next_file(name, isLink, t, &entry.size, &entry.time, &entry.attributes)) {
-					if (isLink && m_ignoreLinks) {
-						continue;
-					}
-					entry.name = fz::to_wstring(name);
-
-					if (!filter_manager::FilenameFiltered(filters, entry.name, d.localPath.GetPath(), t == fz::local_filesys::dir, entry.size, entry.attributes, entry.time)) {
-						if (t == fz::local_filesys::dir) {
-							d.dirs.emplace_back(std::move(entry));
-						}
-						else {
-							d.files.emplace_back(std::move(entry));
-						}
-
-						// If having queued 5k items, hand off to main thread.
-						if (d.files.size() + d.dirs.size() >= 5000) {
-							sentPartial = true;
-
-							listing next;
-							next.localPath = d.localPath;
-							next.remotePath = d.remotePath;
-
-							l.lock();
-							// Check for cancellation
-							if (recursion_roots_.empty()) {
-								l.unlock();
-								break;
-							}
-							EnqueueEnumeratedListing(l, std::move(d), recurse);
-							l.unlock();
-							d = next;
-						}
-					}
+				l.lock();
+				// Check for cancellation
+				if (recursion_roots_.empty()) {
+					return;
 				}
+				add_chunk(l, index, node, std::move(d), true, false);
+				l.unlock();
+				d = next;
 			}
+		}
+	}
+	apply_filter();
 
-			l.lock();
-			// Check for cancellation
-			if (recursion_roots_.empty()) {
-				break;
+	l.lock();
+	// Check for cancellation
+	if (recursion_roots_.empty()) {
+		return;
+	}
+	bool const has_listing = !sentPartial || !d.files.empty() || !d.dirs.empty();
+	add_chunk(l, index, node, std::move(d), has_listing, true);
+}
+
+void local_recursive_operation::add_chunk(fz::scoped_lock& l, size_t index, dir_node_ptr const& node, listing&& d, bool has_listing, bool done)
+{
+	node->done = done;
+	if (has_listing) {
+		dir_node::chunk c;
+		if (node->recurse && !node->skipped()) {
+			// Queue for recursion
+			for (auto const& entry : d.dirs) {
+				auto sub = std::make_shared<dir_node>();
+				sub->parent = node;
+				sub->localPath = d.localPath;
+				sub->localPath.AddSegment(entry.name);
+
+				sub->remotePath = d.remotePath;
+				if (!sub->remotePath.empty()) {
+					if (m_operationMode == recursive_transfer) {
+						// Non-flatten case
+						sub->remotePath.AddSegment(entry.name);
+					}
+				}
+				work_[index].push_back(sub);
+				c.subdirs.emplace_back(std::move(sub));
 			}
-			if (!sentPartial || !d.files.empty() || !d.dirs.empty()) {
-				EnqueueEnumeratedListing(l, std::move(d), recurse);
+			if (!c.subdirs.empty() && idle_) {
+				cond_.signal(l);
 			}
 		}
-
-		listing d;
-		m_listedDirectories.emplace_back(std::move(d));
+		c.d = std::move(d);
+		node->chunks.emplace_back(std::move(c));
 	}
 
-	on_listed_directory();
+	deliver(l);
 }
 
+void local_recursive_operation::deliver(fz::scoped_lock& l)
+{
+	bool notify{};
+	while (!ordered_.empty() && !recursion_roots_.empty()) {
+		auto node = ordered_.front();
+		while (!node->chunks.empty()) {
+			auto & c = node->chunks.front();
+
+			// Same check as if enumerating one directory after another, so
+			// that it is independent of the order the workers finish in.
+			auto & root = recursion_roots_.front();
+			for (auto & sub : c.subdirs) {
+				if (root.m_visitedDirs.insert(sub->localPath).second) {
+					ordered_.push_back(std::move(sub));
+				}
+				else {
+					sub->skip = true;
+				}
+			}
+
+			m_listedDirectories.emplace_back(std::move(c.d));
+			notify |= m_listedDirectories.size() == 1;
+			node->chunks.pop_front();
+		}
+		if (!node->done) {
+			break;
+		}
+		node->parent.reset();
+		ordered_.pop_front();
+	}
+
+	// Hand off to GUI thread
+	if (notify) {
+		l.unlock();
+		on_listed_directory();
+		l.lock();
+	}
+}
@@ -12,8 +12,12 @@
 #include <libfilezilla/time.hpp>
 
 #include <deque>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
+
+class filter_matcher;
 
 class FZCUI_PUBLIC_SYMBOL local_recursion_root final
 {
@@ -62,8 +66,9 @@ public:
 
 	// when default constructed, thread_entry must be called to process the files
 	local_recursive_operation();
-	// spawns async task when start_recursive_operation called to process the files
-	local_recursive_operation(fz::thread_pool& pool);
+	// spawns async tasks when start_recursive_operation called to process the files,
+	// enumerating up to max_workers directories in parallel
+	local_recursive_operation(fz::thread_pool& pool, size_t max_workers = 0);
 	virtual ~local_recursive_operation();
 
 	void AddRecursionRoot(local_recursion_root&& root);
@@ -71,7 +76,7 @@ public:
 
 	virtual void StopRecursiveOperation() override;
 
-	// thread entry point for processing files
+	// thread entry point for processing files, enumerates one directory at a time
 	void thread_entry();
 
 protected:
@@ -82,17 +87,46 @@ protected:
 	virtual void on_listed_directory() = 0;
 
 protected:
-	void EnqueueEnumeratedListing(fz::scoped_lock& l, listing&& d, bool recurse);
+	// Waits for all workers to exit
+	void join();
 
 	std::deque<local_recursion_root> recursion_roots_;
 
 	fz::mutex mutex_;
 	fz::thread_pool* pool_{};
 
+	// Listings are always delivered in the same order as when enumerating
+	// one directory after another, no matter how many workers there are.
 	std::deque<listing> m_listedDirectories;
 	bool m_ignoreLinks{};
 
-	fz::async_task thread_;
+private:
+	class dir_node;
+	using dir_node_ptr = std::shared_ptr<dir_node>;
+
+	void worker_entry(size_t index);
+	dir_node_ptr take_work(size_t index);
+	bool seed_root(size_t index);
+	void enumerate(fz::scoped_lock& l, size_t index, dir_node_ptr const& node, filter_matcher const& filter);
+	void add_chunk(fz::scoped_lock& l, size_t index, dir_node_ptr const& node, listing&& d, bool has_listing, bool done);
+	void deliver(fz::scoped_lock& l);
+
+	size_t const max_workers_{1};
+
+	// Each worker has its own queue of directories to enumerate and steals
+	// from the others once empty.
+	std::vector<std::deque<dir_node_ptr>> work_;
+
+	// Directories in delivery order, enumerated or not
+	std::deque<dir_node_ptr> ordered_;
+
+	bool root_seeded_{};
+	size_t busy_{};
+	size_t idle_{};
+	size_t running_{};
+	fz::condition cond_;
+
+	std::vector<fz::async_task> threads_;
 };
 
 #endif
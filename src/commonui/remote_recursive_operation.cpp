@@ -73,6 +73,7 @@ void remote_recursive_operation::start_recursive_operation(OperationMode mode, A
 void remote_recursive_operation::do_start_recursive_operation(OperationMode, ActiveFilters const& filters)
 {
 	m_filters = filters;
+	filter_ = filter_matcher(filters.second);
 	NextOperation();
 }
 
@@ -85,7 +86,7 @@ bool remote_recursive_operation::NextOperation()
 	while (!recursion_roots_.empty()) {
 		auto & root = recursion_roots_.front();
 		while (!root.m_dirsToVisit.empty()) {
-			const recursion_root::new_dir& dirToVisit = root.m_dirsToVisit.front();
+			recursion_root::new_dir& dirToVisit = root.m_dirsToVisit.front();
 
 			if (m_operationMode == recursive_delete && !dirToVisit.doVisit && dirToVisit.recurse) {
 				process_command(std::make_unique<CRemoveDirCommand>(dirToVisit.parent, dirToVisit.subdir));
@@ -93,7 +94,23 @@ bool remote_recursive_operation::NextOperation()
 				continue;
 			}
 
+			if (dirToVisit.listing_id) {
+				auto const it = parallel_listings_.find(dirToVisit.listing_id);
+				if (it != parallel_listings_.end()) {
+					if (it->second.reply_ == FZ_REPLY_WOULDBLOCK) {
+						// Wait for the additional connection to finish listing it
+						StartParallelListings(root);
+					}
+					else {
+						DeliverParallelListing();
+					}
+					return true;
+				}
+				dirToVisit.listing_id = 0;
+			}
+
 			process_command(std::make_unique<CListCommand>(dirToVisit.parent, dirToVisit.subdir, dirToVisit.link ? LIST_FLAG_LINK : 0));
+			StartParallelListings(root);
 			return true;
 		}
 
@@ -106,6 +123,115 @@ bool remote_recursive_operation::NextOperation()
 	return false;
 }
 
+void remote_recursive_operation::StartParallelListings(recursion_root & root)
+{
+	size_t const connections = parallel_listing_connections();
+	if (!connections || root.m_dirsToVisit.empty()) {
+		return;
+	}
+
+	// Directories get listed in the order they are going to be processed. Limit how
+	// many finished listings may pile up while waiting for their turn.
+	size_t const max_listings = connections * 4;
+
+	// The first directory is handled by NextOperation
+	for (auto it = root.m_dirsToVisit.begin() + 1; it != root.m_dirsToVisit.end(); ++it) {
+		if (parallel_pending_ >= connections || parallel_listings_.size() >= max_listings) {
+			break;
+		}
+		if (it->listing_id || !it->doVisit || it->second_try) {
+			continue;
+		}
+
+		if (!++next_listing_id_) {
+			++next_listing_id_;
+		}
+		it->listing_id = next_listing_id_;
+		parallel_listings_[it->listing_id];
+		++parallel_pending_;
+		process_parallel_listing(it->listing_id, std::make_unique<CListCommand>(it->parent, it->subdir, it->link ? LIST_FLAG_LINK : 0));
+	}
+}
+
+void remote_recursive_operation::ParallelListingFinished(unsigned int id, int reply, std::shared_ptr<CDirectoryListing> const& listing)
+{
+	auto const it = parallel_listings_.find(id);
+	if (it == parallel_listings_.end() || it->second.reply_ != FZ_REPLY_WOULDBLOCK) {
+		return;
+	}
+	--parallel_pending_;
+
+	if (reply == FZ_REPLY_OK && !listing) {
+		reply = FZ_REPLY_ERROR;
+	}
+	else if (reply == FZ_REPLY_WOULDBLOCK) {
+		reply = FZ_REPLY_INTERNALERROR;
+	}
+	else if ((reply & FZ_REPLY_CANCELED) == FZ_REPLY_CANCELED) {
+		// Cancelling the operation is up to the primary connection, have it retry the directory instead.
+		reply = FZ_REPLY_ERROR;
+	}
+	it->second.reply_ = reply;
+	it->second.listing_ = listing;
+
+	if (m_operationMode == recursive_none || recursion_roots_.empty()) {
+		return;
+	}
+
+	auto & root = recursion_roots_.front();
+	if (!root.m_dirsToVisit.empty() && root.m_dirsToVisit.front().listing_id == id) {
+		DeliverParallelListing();
+	}
+	else {
+		StartParallelListings(root);
+	}
+}
+
+void remote_recursive_operation::DeliverParallelListing()
+{
+	if (delivering_) {
+		// Processing the previous listing ended up here through NextOperation, keep the stack flat.
+		deliver_again_ = true;
+		return;
+	}
+
+	delivering_ = true;
+	do {
+		deliver_again_ = false;
+
+		if (m_operationMode == recursive_none || recursion_roots_.empty()) {
+			break;
+		}
+		auto & root = recursion_roots_.front();
+		if (root.m_dirsToVisit.empty() || !root.m_dirsToVisit.front().listing_id) {
+			break;
+		}
+		auto const it = parallel_listings_.find(root.m_dirsToVisit.front().listing_id);
+		if (it == parallel_listings_.end() || it->second.reply_ == FZ_REPLY_WOULDBLOCK) {
+			break;
+		}
+
+		parallel_listing const result = std::move(it->second);
+		parallel_listings_.erase(it);
+
+		// From here on it is treated like a listing from the primary connection,
+		// a retry after failure goes through the latter.
+		root.m_dirsToVisit.front().listing_id = 0;
+		handle_parallel_listing(result.reply_, result.listing_);
+	} while (deliver_again_);
+	delivering_ = false;
+}
+
+void remote_recursive_operation::handle_parallel_listing(int reply, std::shared_ptr<CDirectoryListing> const& listing)
+{
+	if (reply == FZ_REPLY_OK) {
+		ProcessDirectoryListing(listing.get());
+	}
+	else {
+		ListingFailed(reply);
+	}
+}
+
 bool remote_recursive_operation::BelowRecursionRoot(CServerPath const& path, recursion_root::new_dir &dir)
 {
 	if (!dir.start_dir.empty()) {
@@ -142,6 +268,11 @@ void remote_recursive_operation::process_entries(recursion_root& root, CDirector
 	std::vector<std::wstring> filesToDelete;
 	bool const restricted = static_cast<bool>(dir.restricted);
 
+	std::vector<bool> filtered;
+	if (!restricted) {
+		filtered = filter_.filtered(*pDirectoryListing, remotePath);
+	}
+
 	for (size_t i = pDirectoryListing->size(); i > 0; --i) {
 		const CDirentry& entry = (*pDirectoryListing)[i - 1];
 
@@ -150,7 +281,7 @@ void remote_recursive_operation::process_entries(recursion_root& root, CDirector
 				continue;
 			}
 		}
-		else if (filter_manager::FilenameFiltered(m_filters.second, entry.name, remotePath, entry.is_dir(), entry.size, 0, entry.time)) {
+		else if (filtered[i - 1]) {
 			continue;
 		}
 
@@ -289,6 +420,9 @@ void remote_recursive_operation::StopRecursiveOperation()
 	}
 	recursion_roots_.clear();
 	chmodData_.reset();
+
+	parallel_listings_.clear();
+	parallel_pending_ = 0;
 }
 
 void remote_recursive_operation::ListingFailed(int error)
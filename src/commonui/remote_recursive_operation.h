@@ -7,10 +7,12 @@
 #include "../include/directorylisting.h"
 
 #include "filter.h"
+#include "filter_matcher.h"
 #include "recursive_operation.h"
 #include "visibility.h"
 
 #include <deque>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -53,6 +55,10 @@ private:
 		bool doVisit{true};
 		bool recurse{true};
 		bool second_try{};
+
+		// Non-zero while the directory is listed ahead of time on
+		// an additional connection, see process_parallel_listing
+		unsigned int listing_id{};
 	};
 
 	CServerPath m_remoteStartDir;
@@ -100,6 +106,18 @@ protected:
 	// called after looping through directory (non-recursively) to allow status updates et al.
 	virtual void handle_dir_listing_end() = 0;
 
+	// Number of additional connections directories can be listed on ahead of time. 0 if there are none.
+	virtual size_t parallel_listing_connections() const { return 0; }
+
+	// List directory on one of the additional connections. The outcome, including failures,
+	// has to be reported through ParallelListingFinished.
+	virtual void process_parallel_listing(unsigned int, std::unique_ptr<CListCommand>&&) {}
+
+	// Called for listings from the additional connections once it is their turn, in the same order the
+	// primary connection would have listed the directories. Needs to pass the result on to
+	// ProcessDirectoryListing, ListingFailed or LinkIsNotDir.
+	virtual void handle_parallel_listing(int reply, std::shared_ptr<CDirectoryListing> const& listing);
+
 	// Call this when engine indicates that link was tried to be listed as directory but is not one
 	void LinkIsNotDir(Site const& site);
 
@@ -109,6 +127,9 @@ protected:
 	// Processes the directory listing in case of a recursive operation
 	void ProcessDirectoryListing(CDirectoryListing const* pDirectoryListing);
 
+	// Call this when a listing started through process_parallel_listing has finished
+	void ParallelListingFinished(unsigned int id, int reply, std::shared_ptr<CDirectoryListing> const& listing);
+
 protected:
 	void process_entries(recursion_root& root, const CDirectoryListing* pDirectoryListing
 		, recursion_root::new_dir const& dir, std::wstring const& remotePath);
@@ -116,10 +137,30 @@ protected:
 	bool NextOperation();
 	bool BelowRecursionRoot(CServerPath const& path, recursion_root::new_dir &dir);
 
+	void StartParallelListings(recursion_root & root);
+	void DeliverParallelListing();
+
 	std::deque<recursion_root> recursion_roots_;
 
+	// Results of the listings on the additional connections, keyed by
+	// new_dir::listing_id. Held back until the directory is at the front
+	// of m_dirsToVisit.
+	struct parallel_listing final
+	{
+		std::shared_ptr<CDirectoryListing> listing_;
+		int reply_{FZ_REPLY_WOULDBLOCK};
+	};
+	std::map<unsigned int, parallel_listing> parallel_listings_;
+	size_t parallel_pending_{};
+	unsigned int next_listing_id_{};
+	bool delivering_{};
+	bool deliver_again_{};
+
 	// Needed for recursive_chmod
 	std::unique_ptr<ChmodData> chmodData_;
+
+	// The remote filters of m_filters
+	filter_matcher filter_;
 };
 
 #endif
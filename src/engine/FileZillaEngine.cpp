@@ -21,6 +21,11 @@ int CFileZillaEngine::Execute(const CCommand &command)
 	return impl_->Execute(command);
 }
 
+int CFileZillaEngine::Queue(CCommand const& command)
+{
+	return impl_->Queue(command);
+}
+
 std::unique_ptr<CNotification> CFileZillaEngine::GetNextNotification()
 {
 	return impl_->GetNextNotification();
@@ -13,6 +13,11 @@ void activity_logger::record(_direction direction, uint64_t amount)
 	}
 }
 
+void activity_logger::record_saved(uint64_t amount)
+{
+	saved_ += amount;
+}
+
 std::pair<uint64_t, uint64_t> activity_logger::extract_amounts()
 {
 	fz::scoped_lock l(mtx_);
@@ -0,0 +1,85 @@
+#include "filezilla.h"
+#include "checksum.h"
+
+#include <libfilezilla/encode.hpp>
+
+namespace {
+struct crc32_table final
+{
+	crc32_table()
+	{
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+			}
+			values[i] = c;
+		}
+	}
+
+	uint32_t values[256];
+};
+}
+
+transfer_checksum::transfer_checksum(checksum_algorithm alg)
+	: alg_(alg)
+{
+	switch (alg) {
+	case checksum_algorithm::md5:
+		acc_ = std::make_unique<fz::hash_accumulator>(fz::hash_algorithm::md5);
+		break;
+	case checksum_algorithm::sha1:
+		acc_ = std::make_unique<fz::hash_accumulator>(fz::hash_algorithm::sha1);
+		break;
+	case checksum_algorithm::sha256:
+		acc_ = std::make_unique<fz::hash_accumulator>(fz::hash_algorithm::sha256);
+		break;
+	case checksum_algorithm::sha512:
+		acc_ = std::make_unique<fz::hash_accumulator>(fz::hash_algorithm::sha512);
+		break;
+	default:
+		break;
+	}
+}
+
+void transfer_checksum::update(unsigned char const* data, size_t len)
+{
+	if (acc_) {
+		acc_->update(data, len);
+	}
+	else {
+		static crc32_table const table;
+		uint32_t crc = crc_;
+		for (size_t i = 0; i < len; ++i) {
+			crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		crc_ = crc;
+	}
+}
+
+std::string transfer_checksum::digest()
+{
+	if (acc_) {
+		return fz::hex_encode<std::string>(acc_->digest());
+	}
+
+	return fz::sprintf("%08x", crc_ ^ 0xffffffffu);
+}
+
+size_t transfer_checksum::digest_length(checksum_algorithm alg)
+{
+	switch (alg) {
+	case checksum_algorithm::crc32:
+		return 8;
+	case checksum_algorithm::md5:
+		return 32;
+	case checksum_algorithm::sha1:
+		return 40;
+	case checksum_algorithm::sha256:
+		return 64;
+	case checksum_algorithm::sha512:
+		return 128;
+	}
+
+	return 0;
+}
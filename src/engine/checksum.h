@@ -0,0 +1,42 @@
+#ifndef FILEZILLA_ENGINE_CHECKSUM_HEADER
+#define FILEZILLA_ENGINE_CHECKSUM_HEADER
+
+#include <libfilezilla/hash.hpp>
+
+#include <memory>
+#include <string>
+
+enum class checksum_algorithm
+{
+	crc32,
+	md5,
+	sha1,
+	sha256,
+	sha512
+};
+
+// Incrementally computes the checksum of transferred data, so that it can be
+// compared against the checksum reported by the server without reading the
+// local file a second time.
+class transfer_checksum final
+{
+public:
+	explicit transfer_checksum(checksum_algorithm alg);
+
+	void update(unsigned char const* data, size_t len);
+
+	// Lowercase hex-encoded digest. Finishes the computation.
+	std::string digest();
+
+	checksum_algorithm algorithm() const { return alg_; }
+
+	// Length of the hex-encoded digest
+	static size_t digest_length(checksum_algorithm alg);
+
+private:
+	checksum_algorithm const alg_;
+	std::unique_ptr<fz::hash_accumulator> acc_;
+	uint32_t crc_{0xffffffffu};
+};
+
+#endif
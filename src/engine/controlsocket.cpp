@@ -90,6 +90,12 @@ void CControlSocket::LogTransferResultMessage(int nErrorCode, CFileTransferOpDat
 		else if ((nErrorCode & FZ_REPLY_CANCELED) == FZ_REPLY_CANCELED) {
 			msg = _("File transfer aborted by user after transferring %s in %s");
 		}
+		else if ((nErrorCode & FZ_REPLY_CHECKSUMMISMATCH) == FZ_REPLY_CHECKSUMMISMATCH) {
+			msg = _("File transfer failed checksum verification after transferring %s in %s");
+		}
+		else if ((nErrorCode & FZ_REPLY_CHECKSUMUNVERIFIED) == FZ_REPLY_CHECKSUMUNVERIFIED) {
+			msg = _("File transferred, but its checksum could not be verified, transferred %s in %s");
+		}
 		else if ((nErrorCode & FZ_REPLY_CRITICALERROR) == FZ_REPLY_CRITICALERROR) {
 			msg = _("Critical file transfer error after transferring %s in %s");
 		}
@@ -204,7 +210,7 @@ int CControlSocket::ResetOperation(int nErrorCode)
 						log(logmsg::debug_warning, L"currentServer_ is empty");
 					}
 					else {
-						UpdateCache(data, data.remotePath_, data.remoteFile_, (nErrorCode == FZ_REPLY_OK) ? data.localFileSize_ : -1);
+						UpdateCache(data, data.remotePath_, data.remoteFile_, (nErrorCode == FZ_REPLY_OK || nErrorCode == FZ_REPLY_CHECKSUMUNVERIFIED) ? data.localFileSize_ : -1);
 					}
 				}
 				LogTransferResultMessage(nErrorCode, &data);
@@ -247,6 +253,10 @@ void CControlSocket::UpdateCache(COpData const &, CServerPath const& serverPath,
 int CControlSocket::DoClose(int nErrorCode)
 {
 	log(logmsg::debug_debug, L"CControlSocket::DoClose(%d)", nErrorCode);
+
+	auto const stats = engine_.GetDirectoryCache().GetStatistics();
+	log(logmsg::debug_info, L"Directory cache: %u hits, %u misses, %u evictions, %u listings using %d KiB", stats.hits, stats.misses, stats.evictions, stats.listings, stats.memory / 1024);
+
 	currentPath_.clear();
 	return ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED | nErrorCode);
 }
@@ -371,6 +381,18 @@ int CControlSocket::CheckOverwriteFile()
 	}
 
 	auto & data = static_cast<CFileTransferOpData &>(*operations_.back());
+
+	if (auto const* segment = data.segment()) {
+		// Whoever split the download into segments has already dealt with the
+		// local file, its segments always continue where they left off.
+		if (data.remoteFileSize_ >= 0 && static_cast<uint64_t>(data.remoteFileSize_) != segment->file_size()) {
+			log(logmsg::error, _("The size of the remote file has changed, cannot continue segmented download."));
+			return FZ_REPLY_CRITICALERROR;
+		}
+		data.resume_ = true;
+		return FZ_REPLY_OK;
+	}
+
 	data.localFileSize_ = data.download() ? data.writer_factory_.size() : data.reader_factory_.size();
 	data.localFileTime_ = data.download() ? data.writer_factory_.mtime() : data.reader_factory_.mtime();
 
@@ -468,6 +490,14 @@ CFileTransferOpData::CFileTransferOpData(wchar_t const* name, CFileTransferComma
 	localFileTime_ = download() ? writer_factory_.mtime() : reader_factory_.mtime();
 }
 
+segment_writer_factory const* CFileTransferOpData::segment() const
+{
+	if (!download() || !writer_factory_) {
+		return nullptr;
+	}
+	return dynamic_cast<segment_writer_factory const*>(&*writer_factory_);
+}
+
 std::wstring CControlSocket::ConvToLocal(char const* buffer, size_t len)
 {
 	std::wstring ret;
@@ -1160,6 +1190,19 @@ void CControlSocket::SendDirectoryListingNotification(CServerPath const& path, b
 	engine_.AddNotification(std::make_unique<CDirectoryListingNotification>(path, operations_.size() == 1 && operations_.back()->opId == Command::list, failed));
 }
 
+void CControlSocket::SendPartialDirectoryListingNotification(CDirectoryListing && listing)
+{
+	if (!currentServer_) {
+		return;
+	}
+
+	if (operations_.size() != 1 || operations_.back()->opId != Command::list) {
+		return;
+	}
+
+	engine_.AddNotification(std::make_unique<CPartialDirectoryListingNotification>(std::move(listing)));
+}
+
 void CControlSocket::CallSetAsyncRequestReply(CAsyncRequestNotification *pNotification)
 {
 	if (operations_.empty() || operations_.back()->async_request_state_ == async_request_state::none) {
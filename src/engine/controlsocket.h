@@ -4,6 +4,7 @@
 #include "../include/activity_logger.h"
 #include "../include/directorylisting.h"
 #include "../include/server.h"
+#include "../include/segment_writer.h"
 #include "../include/serverpath.h"
 
 #include "logging_private.h"
@@ -136,6 +137,9 @@ public:
 
 	bool download() const { return flags_ & transfer_flags::download; }
 
+	// Set if only a byte range of the remote file gets downloaded, see segment_writer_factory
+	segment_writer_factory const* segment() const;
+
 	bool tryAbsolutePath_{};
 	bool resume_{};
 
@@ -286,6 +290,10 @@ protected:
 	virtual bool SetAsyncRequestReply(CAsyncRequestNotification *pNotification) = 0;
 	void SendDirectoryListingNotification(CServerPath const& path, bool failed);
 
+	// Only sent for primary listings, other listings are of no interest
+	// until they are complete.
+	void SendPartialDirectoryListingNotification(CDirectoryListing && listing);
+
 	fz::duration GetInferredTimezoneOffset() const;
 
 	virtual int DoClose(int nErrorCode = FZ_REPLY_DISCONNECTED | FZ_REPLY_ERROR);
@@ -0,0 +1,188 @@
+#include "deflate_layer.h"
+
+#include <algorithm>
+
+#include <errno.h>
+
+namespace {
+size_t constexpr chunk_size = 64 * 1024;
+}
+
+deflate_layer::deflate_layer(fz::event_handler* handler, fz::socket_interface& next_layer, int level, bool sending)
+	: fz::socket_layer(handler, next_layer, true)
+	, level_(level)
+{
+	next_layer.set_event_handler(handler);
+	if (sending) {
+		init_deflate();
+	}
+}
+
+deflate_layer::~deflate_layer()
+{
+	next_layer_.set_event_handler(nullptr);
+
+	if (inflate_initialized_) {
+		inflateEnd(&inflate_);
+	}
+	if (deflate_initialized_) {
+		deflateEnd(&deflate_);
+	}
+}
+
+int deflate_layer::read(void* buffer, unsigned int size, int& error)
+{
+	if (!inflate_initialized_) {
+		if (inflateInit(&inflate_) != Z_OK) {
+			error = ENOMEM;
+			return -1;
+		}
+		inflate_initialized_ = true;
+	}
+
+	inflate_.next_out = static_cast<Bytef*>(buffer);
+	inflate_.avail_out = size;
+
+	while (true) {
+		if (!inflate_finished_) {
+			// zlib may still hold output from earlier input, always give it a chance
+			inflate_.next_in = read_buffer_.get();
+			inflate_.avail_in = static_cast<uInt>(read_buffer_.size());
+			int const res = inflate(&inflate_, Z_NO_FLUSH);
+			read_buffer_.consume(read_buffer_.size() - inflate_.avail_in);
+
+			if (res == Z_STREAM_END) {
+				inflate_finished_ = true;
+			}
+			else if (res != Z_OK && res != Z_BUF_ERROR) {
+				error = EPROTO;
+				return -1;
+			}
+
+			size_t const produced = size - inflate_.avail_out;
+			if (produced) {
+				payload_ += produced;
+				return static_cast<int>(produced);
+			}
+		}
+
+		if (inflate_finished_) {
+			// Nothing may follow the end of the compressed stream
+			if (!read_buffer_.empty()) {
+				error = EPROTO;
+				return -1;
+			}
+		}
+		else if (eof_) {
+			// Connection closed before the end of the compressed stream, data is truncated
+			error = EPROTO;
+			return -1;
+		}
+
+		int const read = next_layer_.read(read_buffer_.get(chunk_size), static_cast<unsigned int>(chunk_size), error);
+		if (read < 0) {
+			return read;
+		}
+		if (!read) {
+			eof_ = true;
+			if (inflate_finished_) {
+				return 0;
+			}
+		}
+		else {
+			wire_ += static_cast<size_t>(read);
+			read_buffer_.add(static_cast<size_t>(read));
+		}
+	}
+}
+
+int deflate_layer::write(void const* buffer, unsigned int size, int& error)
+{
+	if (deflate_finished_) {
+		error = EPIPE;
+		return -1;
+	}
+
+	if (!init_deflate()) {
+		error = ENOMEM;
+		return -1;
+	}
+
+	// Only accept new data once everything compressed so far has been passed on,
+	// otherwise the amount of buffered data would be unbounded.
+	int res = flush();
+	if (res) {
+		error = res;
+		return -1;
+	}
+
+	deflate_.next_in = const_cast<Bytef*>(static_cast<Bytef const*>(buffer));
+	deflate_.avail_in = size;
+	do {
+		deflate_.next_out = write_buffer_.get(chunk_size);
+		deflate_.avail_out = static_cast<uInt>(chunk_size);
+		if (deflate(&deflate_, Z_NO_FLUSH) == Z_STREAM_ERROR) {
+			error = EINVAL;
+			return -1;
+		}
+		write_buffer_.add(chunk_size - deflate_.avail_out);
+	} while (deflate_.avail_in || !deflate_.avail_out);
+
+	payload_ += size;
+
+	res = flush();
+	if (res && res != EAGAIN) {
+		error = res;
+		return -1;
+	}
+
+	return static_cast<int>(size);
+}
+
+int deflate_layer::shutdown()
+{
+	if (deflate_initialized_ && !deflate_finished_) {
+		int res;
+		do {
+			deflate_.next_out = write_buffer_.get(chunk_size);
+			deflate_.avail_out = static_cast<uInt>(chunk_size);
+			res = deflate(&deflate_, Z_FINISH);
+			if (res == Z_STREAM_ERROR) {
+				return EINVAL;
+			}
+			write_buffer_.add(chunk_size - deflate_.avail_out);
+		} while (res != Z_STREAM_END);
+		deflate_finished_ = true;
+	}
+
+	int const res = flush();
+	if (res) {
+		return res;
+	}
+
+	return next_layer_.shutdown();
+}
+
+bool deflate_layer::init_deflate()
+{
+	if (!deflate_initialized_) {
+		deflate_initialized_ = deflateInit(&deflate_, level_) == Z_OK;
+	}
+	return deflate_initialized_;
+}
+
+int deflate_layer::flush()
+{
+	while (!write_buffer_.empty()) {
+		int error{};
+		unsigned int const size = static_cast<unsigned int>(std::min(write_buffer_.size(), chunk_size));
+		int const written = next_layer_.write(write_buffer_.get(), size, error);
+		if (written <= 0) {
+			return written < 0 ? error : EAGAIN;
+		}
+		wire_ += static_cast<size_t>(written);
+		write_buffer_.consume(static_cast<size_t>(written));
+	}
+
+	return 0;
+}
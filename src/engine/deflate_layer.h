@@ -0,0 +1,55 @@
+#ifndef FILEZILLA_ENGINE_DEFLATE_LAYER_HEADER
+#define FILEZILLA_ENGINE_DEFLATE_LAYER_HEADER
+
+#include <libfilezilla/buffer.hpp>
+#include <libfilezilla/socket.hpp>
+
+#include <zlib.h>
+
+// Transparently compresses written and decompresses read data using a zlib
+// stream as used by the FTP MODE Z transfer mode.
+//
+// Since compressing the data is pointless after encryption, this layer needs
+// to be put above the TLS layer.
+//
+// If sending, shutdown terminates the compressed stream even if no data has
+// been written, so that empty files are transferred as a valid stream.
+class deflate_layer final : public fz::socket_layer
+{
+public:
+	deflate_layer(fz::event_handler* handler, fz::socket_interface& next_layer, int level, bool sending);
+	virtual ~deflate_layer();
+
+	virtual int read(void* buffer, unsigned int size, int& error) override;
+	virtual int write(void const* buffer, unsigned int size, int& error) override;
+
+	virtual int shutdown() override;
+
+	// Amount of uncompressed data passed through the layer
+	uint64_t payload_bytes() const { return payload_; }
+
+	// Amount of compressed data exchanged with the next layer
+	uint64_t wire_bytes() const { return wire_; }
+
+private:
+	bool init_deflate();
+	int flush();
+
+	z_stream inflate_{};
+	z_stream deflate_{};
+	bool inflate_initialized_{};
+	bool deflate_initialized_{};
+	bool inflate_finished_{};
+	bool deflate_finished_{};
+	bool eof_{};
+
+	uint64_t payload_{};
+	uint64_t wire_{};
+
+	int const level_;
+
+	fz::buffer read_buffer_;
+	fz::buffer write_buffer_;
+};
+
+#endif
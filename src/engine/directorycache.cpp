@@ -3,68 +3,91 @@
 
 #include <assert.h>
 
+namespace {
+// Limit on the number of listings regardless of memory consumption
+size_t constexpr max_listings = 50000;
+
+// Number of most recently used listings per server kept unpacked
+size_t constexpr unpacked_listings = 20;
+
+size_t server_hash(CServer const& server)
+{
+	// Only covers some of the fields compared by CServer::SameContent
+	size_t h = std::hash<std::wstring>()(server.GetHost());
+	h ^= std::hash<std::wstring>()(server.GetUser()) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	h ^= static_cast<size_t>(server.GetPort()) << 16;
+	h ^= static_cast<size_t>(server.GetProtocol());
+	return h;
+}
+}
+
+size_t CDirectoryCache::path_hash::operator()(CServerPath const& path) const
+{
+	return std::hash<std::wstring>()(path.GetPath()) ^ static_cast<size_t>(path.GetType());
+}
+
 CDirectoryCache::CDirectoryCache()
 {
 }
 
 CDirectoryCache::~CDirectoryCache()
 {
-	for (auto & serverEntry : m_serverList) {
-		for (auto & cacheEntry : serverEntry.cacheList) {
-#ifndef NDEBUG
-			m_totalFileCount -= cacheEntry.listing.size();
-#endif
-			tLruList::iterator* lruIt = (tLruList::iterator*)cacheEntry.lruIt;
-			if (lruIt) {
-				m_leastRecentlyUsedList.erase(*lruIt);
-				delete lruIt;
+	if (storage_) {
+		for (auto const& sit : GetServerEntries()) {
+			fz::scoped_lock lock(sit->mutex_);
+			for (auto & entry : sit->lruList) {
+				Persist(*sit, entry);
 			}
 		}
 	}
-#ifndef NDEBUG
-	assert(m_totalFileCount == 0);
-#endif
 }
 
 void CDirectoryCache::Store(CDirectoryListing const& listing, CServer const& server)
 {
-	fz::scoped_lock lock(mutex_);
-
-	tServerIter sit = CreateServerEntry(server);
-	assert(sit != m_serverList.end());
-
-	m_totalFileCount += listing.size();
-
-	tCacheIter cit;
-	bool unused;
-	if (Lookup(cit, sit, listing.path, true, unused)) {
-		auto & entry = const_cast<CCacheEntry&>(*cit);
-		entry.modificationTime = fz::monotonic_clock::now();
-
-		m_totalFileCount -= cit->listing.size();
-		entry.listing = listing;
-
-		return;
+	{
+		tServerIter sit = CreateServerEntry(server);
+		fz::scoped_lock lock(sit->mutex_);
+
+		auto it = sit->index.find(listing.path);
+		if (it != sit->index.end()) {
+			tCacheIter cit = it->second;
+			cit->listing = listing;
+			cit->packed.clear();
+			cit->modificationTime = fz::monotonic_clock::now();
+			cit->dirty = true;
+			UpdateLru(*sit, cit);
+			UpdateMemory(*sit, *cit);
+			Persist(*sit, *cit);
+		}
+		else {
+			sit->stored.erase(listing.path);
+			sit->lruList.emplace_back(listing);
+			tCacheIter cit = std::prev(sit->lruList.end());
+			cit->dirty = true;
+			sit->index.emplace(listing.path, cit);
+			++m_totalListings;
+
+			UpdateLru(*sit, cit);
+			UpdateMemory(*sit, *cit);
+			Persist(*sit, *cit);
+		}
 	}
 
-	cit = sit->cacheList.emplace_hint(cit, listing);
-
-	UpdateLru(sit, cit);
-
 	Prune();
 }
 
 bool CDirectoryCache::Lookup(CDirectoryListing &listing, CServer const& server, const CServerPath &path, bool allowUnsureEntries, bool& is_outdated)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
+		++misses_;
 		return false;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
-	if (Lookup(iter, sit, path, allowUnsureEntries, is_outdated)) {
+	if (Lookup(iter, *sit, path, allowUnsureEntries, is_outdated)) {
 		listing = iter->listing;
 		return true;
 	}
@@ -72,41 +95,42 @@ bool CDirectoryCache::Lookup(CDirectoryListing &listing, CServer const& server,
 	return false;
 }
 
-bool CDirectoryCache::Lookup(tCacheIter &cacheIter, tServerIter &sit, CServerPath const& path, bool allowUnsureEntries, bool& is_outdated)
+bool CDirectoryCache::Lookup(tCacheIter &cacheIter, CServerEntry &sit, CServerPath const& path, bool allowUnsureEntries, bool& is_outdated)
 {
-	CCacheEntry dummy;
-	dummy.listing.path = path;
-	cacheIter = sit->cacheList.lower_bound(dummy);
-
-	if (cacheIter != sit->cacheList.end()) {
-		CCacheEntry const& entry = *cacheIter;
-
-		if (entry.listing.path == path) {
-			UpdateLru(sit, cacheIter);
+	auto it = sit.index.find(path);
+	if (it == sit.index.end()) {
+		it = LoadStored(sit, path);
+		if (it == sit.index.end()) {
+			++misses_;
+			return false;
+		}
+	}
 
-			if (!allowUnsureEntries && entry.listing.get_unsure_flags()) {
-				return false;
-			}
+	cacheIter = it->second;
+	UpdateLru(sit, cacheIter);
 
-			is_outdated = (fz::monotonic_clock::now() - entry.listing.m_firstListTime) > ttl_;
-			return true;
-		}
+	if (!allowUnsureEntries && cacheIter->listing.get_unsure_flags()) {
+		++misses_;
+		return false;
 	}
 
-	return false;
+	is_outdated = (fz::monotonic_clock::now() - cacheIter->listing.m_firstListTime) > fz::duration::from_milliseconds(ttl_);
+	++hits_;
+	return true;
 }
 
 bool CDirectoryCache::DoesExist(CServer const& server, CServerPath const& path, int &hasUnsureEntries, bool &is_outdated)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
+		++misses_;
 		return false;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
-	if (Lookup(iter, sit, path, true, is_outdated)) {
+	if (Lookup(iter, *sit, path, true, is_outdated)) {
 		hasUnsureEntries = iter->listing.get_unsure_flags();
 		return true;
 	}
@@ -119,16 +143,17 @@ std::tuple<LookupResults, CDirentry> CDirectoryCache::LookupFile(CServer const&
 	LookupResults results{};
 	CDirentry entry;
 
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
+		++misses_;
 		return {results, entry};
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
 	bool outdated{};
-	if (!Lookup(iter, sit, path, true, outdated)) {
+	if (!Lookup(iter, *sit, path, true, outdated)) {
 		return {results, entry};
 	}
 
@@ -141,8 +166,7 @@ std::tuple<LookupResults, CDirentry> CDirectoryCache::LookupFile(CServer const&
 
 	results |= LookupResults::direxists;
 
-	CCacheEntry const& cacheEntry = *iter;
-	CDirectoryListing const& listing = cacheEntry.listing;
+	CDirectoryListing const& listing = iter->listing;
 
 	size_t i = listing.FindFile_CmpCase(filename);
 	if (i != std::string::npos) {
@@ -164,16 +188,17 @@ std::vector<std::tuple<LookupResults, CDirentry>> CDirectoryCache::LookupFiles(C
 {
 	std::vector<std::tuple<LookupResults, CDirentry>> ret;
 
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
+		++misses_;
 		return ret;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
 	bool outdated{};
-	if (!Lookup(iter, sit, path, true, outdated)) {
+	if (!Lookup(iter, *sit, path, true, outdated)) {
 		return ret;
 	}
 
@@ -188,8 +213,7 @@ std::vector<std::tuple<LookupResults, CDirentry>> CDirectoryCache::LookupFiles(C
 
 	results |= LookupResults::direxists;
 
-	CCacheEntry const& cacheEntry = *iter;
-	CDirectoryListing const& listing = cacheEntry.listing;
+	CDirectoryListing const& listing = iter->listing;
 
 	ret.reserve(filenames.size());
 
@@ -216,24 +240,24 @@ std::vector<std::tuple<LookupResults, CDirentry>> CDirectoryCache::LookupFiles(C
 
 bool CDirectoryCache::LookupFile(CDirentry &entry, CServer const& server, CServerPath const& path, std::wstring const& filename, bool &dirDidExist, bool &matchedCase)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
+		++misses_;
 		dirDidExist = false;
 		return false;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
 	bool unused;
-	if (!Lookup(iter, sit, path, true, unused)) {
+	if (!Lookup(iter, *sit, path, true, unused)) {
 		dirDidExist = false;
 		return false;
 	}
 	dirDidExist = true;
 
-	const CCacheEntry &cacheEntry = *iter;
-	const CDirectoryListing &listing = cacheEntry.listing;
+	const CDirectoryListing &listing = iter->listing;
 
 	size_t i = listing.FindFile_CmpCase(filename);
 	if (i != std::string::npos) {
@@ -253,19 +277,24 @@ bool CDirectoryCache::LookupFile(CDirentry &entry, CServer const& server, CServe
 
 bool CDirectoryCache::InvalidateFile(CServer const& server, CServerPath const& path, std::wstring const& filename)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return false;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	bool const cmpCase = server.GetCaseSensitivity() == CaseSensitivity::yes;
 	bool dir{};
 
+	LoadStoredNoCase(*sit, path);
+
 	auto const now = fz::monotonic_clock::now();
-	for (tCacheIter iter = sit->cacheList.begin(); iter != sit->cacheList.end(); ++iter) {
-		auto & entry = const_cast<CCacheEntry&>(*iter);
+
+	// Iterate the index, UpdateLru reorders the list
+	for (auto const& indexEntry : sit->index) {
+		tCacheIter const iter = indexEntry.second;
+		auto & entry = *iter;
 
 		if (cmpCase) {
 			if (path != entry.listing.path) {
@@ -278,7 +307,7 @@ bool CDirectoryCache::InvalidateFile(CServer const& server, CServerPath const& p
 			}
 		}
 
-		UpdateLru(sit, iter);
+		UpdateLru(*sit, iter);
 
 		for (unsigned int i = 0; i < entry.listing.size(); i++) {
 			bool same;
@@ -297,18 +326,22 @@ bool CDirectoryCache::InvalidateFile(CServer const& server, CServerPath const& p
 		}
 		entry.listing.m_flags |= CDirectoryListing::unsure_unknown;
 		entry.modificationTime = now;
+		MarkDirty(*sit, entry);
 	}
 
 	if (dir) {
 		CServerPath child = path;
 		if (child.ChangePath(filename)) {
-			for (tCacheIter iter = sit->cacheList.begin(); iter != sit->cacheList.end(); ++iter) {
-				auto & entry = const_cast<CCacheEntry&>(*iter);
+			for (auto & entry : sit->lruList) {
 				if (path.IsParentOf(entry.listing.path, !cmpCase, true)) {
 					entry.listing.m_flags |= CDirectoryListing::unsure_unknown;
 					entry.modificationTime = now;
+					MarkDirty(*sit, entry);
 				}
 			}
+
+			// Not worth loading, the affected listings need to be refreshed anyhow.
+			RemoveStored(*sit, path);
 		}
 	}
 
@@ -317,22 +350,25 @@ bool CDirectoryCache::InvalidateFile(CServer const& server, CServerPath const& p
 
 bool CDirectoryCache::UpdateFile(CServer const& server, CServerPath const& path, std::wstring const& filename, bool mayCreate, Filetype type, int64_t size, std::wstring const& ownerGroup)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return false;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	bool updated = false;
 
-	for (tCacheIter iter = sit->cacheList.begin(); iter != sit->cacheList.end(); ++iter) {
-		auto & entry = const_cast<CCacheEntry&>(*iter);
+	LoadStoredNoCase(*sit, path);
+
+	for (auto const& indexEntry : sit->index) {
+		tCacheIter const iter = indexEntry.second;
+		auto & entry = *iter;
 		if (!path.equal_nocase(entry.listing.path)) {
 			continue;
 		}
 
-		UpdateLru(sit, iter);
+		UpdateLru(*sit, iter);
 
 		bool matchCase = false;
 		size_t i;
@@ -384,12 +420,13 @@ bool CDirectoryCache::UpdateFile(CServer const& server, CServerPath const& path,
 			}
 			entry.listing.Append(std::move(direntry));
 
-			++m_totalFileCount;
+			UpdateMemory(*sit, entry);
 		}
 		else {
 			entry.listing.m_flags |= CDirectoryListing::unsure_unknown;
 		}
 		entry.modificationTime = fz::monotonic_clock::now();
+		MarkDirty(*sit, entry);
 
 		updated = true;
 	}
@@ -399,20 +436,23 @@ bool CDirectoryCache::UpdateFile(CServer const& server, CServerPath const& path,
 
 bool CDirectoryCache::RemoveFile(CServer const& server, CServerPath const& path, std::wstring const& filename)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return false;
 	}
 
-	for (tCacheIter iter = sit->cacheList.begin(); iter != sit->cacheList.end(); ++iter) {
-		auto & entry = const_cast<CCacheEntry&>(*iter);
+	fz::scoped_lock lock(sit->mutex_);
+
+	LoadStoredNoCase(*sit, path);
+
+	for (auto const& indexEntry : sit->index) {
+		tCacheIter const iter = indexEntry.second;
+		auto & entry = *iter;
 		if (!path.equal_nocase(entry.listing.path)) {
 			continue;
 		}
 
-		UpdateLru(sit, iter);
+		UpdateLru(*sit, iter);
 
 		bool matchCase = false;
 		for (size_t i = 0; i < entry.listing.size(); ++i) {
@@ -431,7 +471,7 @@ bool CDirectoryCache::RemoveFile(CServer const& server, CServerPath const& path,
 			assert(i != entry.listing.size());
 
 			entry.listing.RemoveEntry(i); // This does set m_hasUnsureEntries
-			--m_totalFileCount;
+			UpdateMemory(*sit, entry);
 		}
 		else {
 			for (size_t i = 0; i < entry.listing.size(); ++i) {
@@ -442,6 +482,7 @@ bool CDirectoryCache::RemoveFile(CServer const& server, CServerPath const& path,
 			entry.listing.m_flags |= CDirectoryListing::unsure_invalid;
 		}
 		entry.modificationTime = fz::monotonic_clock::now();
+		MarkDirty(*sit, entry);
 	}
 
 	return true;
@@ -449,40 +490,50 @@ bool CDirectoryCache::RemoveFile(CServer const& server, CServerPath const& path,
 
 void CDirectoryCache::InvalidateServer(CServer const& server)
 {
-	fz::scoped_lock lock(mutex_);
-
-	for (auto iter = m_serverList.begin(); iter != m_serverList.end(); ++iter) {
-		if (!iter->server.SameContent(server)) {
-			continue;
-		}
+	tServerIter sit;
+	{
+		fz::scoped_lock lock(m_serverMutex);
 
-		for (tCacheIter cit = iter->cacheList.begin(); cit != iter->cacheList.end(); ++cit) {
-			tLruList::iterator* lruIt = (tLruList::iterator*)cit->lruIt;
-			if (lruIt) {
-				m_leastRecentlyUsedList.erase(*lruIt);
-				delete lruIt;
+		auto range = m_serverList.equal_range(server_hash(server));
+		for (auto iter = range.first; iter != range.second; ++iter) {
+			if (iter->second->server.SameContent(server)) {
+				sit = iter->second;
+				m_serverList.erase(iter);
+				break;
 			}
-
-			m_totalFileCount -= cit->listing.size();
 		}
+	}
+
+	if (storage_) {
+		storage_->RemoveServer(server);
+	}
 
-		m_serverList.erase(iter);
-		break;
+	if (!sit) {
+		return;
 	}
+
+	// Others may still hold a reference to the shard, but it is no longer reachable.
+	fz::scoped_lock lock(sit->mutex_);
+	m_totalMemory -= sit->memory;
+	m_totalListings -= sit->lruList.size();
+	sit->memory = 0;
+	sit->index.clear();
+	sit->lruList.clear();
+	sit->stored.clear();
 }
 
 bool CDirectoryCache::GetChangeTime(fz::monotonic_clock& time, CServer const& server, CServerPath const& path)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return false;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
 	bool unused;
-	if (Lookup(iter, sit, path, true, unused)) {
+	if (Lookup(iter, *sit, path, true, unused)) {
 		time = iter->modificationTime;
 		return true;
 	}
@@ -492,55 +543,87 @@ bool CDirectoryCache::GetChangeTime(fz::monotonic_clock& time, CServer const& se
 
 void CDirectoryCache::RemoveDir(CServer const& server, CServerPath const& path, std::wstring const& filename, CServerPath const&)
 {
-	fz::scoped_lock lock(mutex_);
-
 	// TODO: This is not 100% foolproof and may not work properly
 	// Perhaps just throw away the complete cache?
 
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	CServerPath absolutePath = path;
 	if (!absolutePath.AddSegment(filename)) {
 		absolutePath.clear();
 	}
 
-	for (tCacheIter iter = sit->cacheList.begin(); iter != sit->cacheList.end(); ) {
-		auto & entry = const_cast<CCacheEntry&>(*iter);
-		// Delete exact matches and subdirs
-		if (!absolutePath.empty() && (entry.listing.path == absolutePath || absolutePath.IsParentOf(entry.listing.path, true))) {
-			m_totalFileCount -= entry.listing.size();
-			tLruList::iterator* lruIt = (tLruList::iterator*)iter->lruIt;
-			if (lruIt) {
-				m_leastRecentlyUsedList.erase(*lruIt);
-				delete lruIt;
+	if (!absolutePath.empty()) {
+		for (auto iter = sit->lruList.begin(); iter != sit->lruList.end(); ) {
+			// Delete exact matches and subdirs
+			if (iter->listing.path == absolutePath || absolutePath.IsParentOf(iter->listing.path, true)) {
+				if (storage_) {
+					storage_->Remove(sit->server, iter->listing.path);
+				}
+				RemoveEntry(*sit, iter++);
+			}
+			else {
+				++iter;
 			}
-			sit->cacheList.erase(iter++);
+		}
+
+		RemoveStored(*sit, absolutePath);
+	}
+
+	RemoveFile(server, path, filename);
+}
+
+void CDirectoryCache::InvalidateDir(CServer const& server, CServerPath const& path)
+{
+	tServerIter sit = GetServerEntry(server);
+	if (!sit) {
+		return;
+	}
+
+	fz::scoped_lock lock(sit->mutex_);
+
+	for (auto iter = sit->lruList.begin(); iter != sit->lruList.end(); ) {
+		if (iter->listing.path == path) {
+			RemoveEntry(*sit, iter++);
 		}
 		else {
 			++iter;
 		}
 	}
 
-	RemoveFile(server, path, filename);
+	for (auto it = sit->stored.begin(); it != sit->stored.end(); ) {
+		if (*it == path) {
+			it = sit->stored.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	if (storage_) {
+		storage_->Remove(sit->server, path);
+	}
 }
 
 void CDirectoryCache::Rename(CServer const& server, CServerPath const& pathFrom, std::wstring const& fileFrom, CServerPath const& pathTo, std::wstring const& fileTo)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
 	bool is_outdated = false;
-	bool found = Lookup(iter, sit, pathFrom, true, is_outdated);
+	bool found = Lookup(iter, *sit, pathFrom, true, is_outdated);
 	if (found) {
-		auto & listing = const_cast<CDirectoryListing&>(iter->listing);
+		auto & listing = iter->listing;
 		if (pathFrom == pathTo) {
 			RemoveFile(server, pathFrom, fileTo);
 			size_t i;
@@ -560,6 +643,7 @@ void CDirectoryCache::Rename(CServer const& server, CServerPath const& pathFrom,
 					listing.get(i).flags |= CDirentry::flag_unsure;
 					listing.m_flags |= CDirectoryListing::unsure_unknown;
 					listing.ClearFindMap();
+					MarkDirty(*sit, *iter);
 				}
 			}
 			return;
@@ -591,18 +675,18 @@ void CDirectoryCache::Rename(CServer const& server, CServerPath const& pathFrom,
 
 void CDirectoryCache::UpdateOwnerGroup(CServer const& server, CServerPath const& path, std::wstring const& filename, std::wstring& ownerGroup)
 {
-	fz::scoped_lock lock(mutex_);
-
 	tServerIter sit = GetServerEntry(server);
-	if (sit == m_serverList.end()) {
+	if (!sit) {
 		return;
 	}
 
+	fz::scoped_lock lock(sit->mutex_);
+
 	tCacheIter iter;
 	bool is_outdated = false;
-	bool found = Lookup(iter, sit, path, true, is_outdated);
+	bool found = Lookup(iter, *sit, path, true, is_outdated);
 	if (found) {
-		auto & listing = const_cast<CDirectoryListing&>(iter->listing);
+		auto & listing = iter->listing;
 		size_t i;
 		for (i = 0; i < listing.size(); ++i) {
 			if (listing[i].name == filename) {
@@ -613,6 +697,7 @@ void CDirectoryCache::UpdateOwnerGroup(CServer const& server, CServerPath const&
 			if (!listing[i].is_dir()) {
 				listing.get(i).ownerGroup.get() = ownerGroup;
 				listing.ClearFindMap();
+				MarkDirty(*sit, *iter);
 			}
 			return;
 		}
@@ -623,75 +708,345 @@ void CDirectoryCache::UpdateOwnerGroup(CServer const& server, CServerPath const&
 }
 
 
+CDirectoryCache::tServerIter CDirectoryCache::FindServerEntry(size_t hash, CServer const& server)
+{
+	auto range = m_serverList.equal_range(hash);
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		if (iter->second->server.SameContent(server)) {
+			return iter->second;
+		}
+	}
+
+	return tServerIter();
+}
+
 CDirectoryCache::tServerIter CDirectoryCache::CreateServerEntry(CServer const& server)
 {
-	for (tServerIter iter = m_serverList.begin(); iter != m_serverList.end(); ++iter) {
-		if (iter->server.SameContent(server)) {
-			return iter;
+	size_t const hash = server_hash(server);
+	{
+		fz::scoped_lock lock(m_serverMutex);
+		tServerIter sit = FindServerEntry(hash, server);
+		if (sit) {
+			return sit;
+		}
+	}
+
+	// Read the stored paths without holding the lock, engines connected
+	// to other servers must not wait for the disk.
+	auto sit = std::make_shared<CServerEntry>(server);
+	if (storage_) {
+		for (auto & path : storage_->GetPaths(server)) {
+			sit->stored.emplace(std::move(path));
 		}
 	}
-	m_serverList.emplace_back(server);
 
-	return --m_serverList.end();
+	fz::scoped_lock lock(m_serverMutex);
+	tServerIter existing = FindServerEntry(hash, server);
+	if (existing) {
+		// Created by someone else in the meantime
+		return existing;
+	}
+
+	return m_serverList.emplace(hash, sit)->second;
 }
 
 CDirectoryCache::tServerIter CDirectoryCache::GetServerEntry(CServer const& server)
 {
-	tServerIter iter;
-	for (iter = m_serverList.begin(); iter != m_serverList.end(); ++iter) {
-		if (iter->server.SameContent(server)) {
-			break;
-		}
+	if (storage_) {
+		// There may be stored listings for the server
+		return CreateServerEntry(server);
 	}
 
-	return iter;
+	fz::scoped_lock lock(m_serverMutex);
+	return FindServerEntry(server_hash(server), server);
 }
 
-void CDirectoryCache::UpdateLru(tServerIter const& sit, tCacheIter const& cit)
+std::vector<CDirectoryCache::tServerIter> CDirectoryCache::GetServerEntries()
 {
-	tLruList::iterator* lruIt = (tLruList::iterator*)cit->lruIt;
-	if (lruIt) {
-		m_leastRecentlyUsedList.splice(m_leastRecentlyUsedList.end(), m_leastRecentlyUsedList, *lruIt);
-		**lruIt = std::make_pair(sit, cit);
+	std::vector<tServerIter> ret;
+
+	fz::scoped_lock lock(m_serverMutex);
+	ret.reserve(m_serverList.size());
+	for (auto const& entry : m_serverList) {
+		ret.push_back(entry.second);
 	}
-	else {
-		auto & entry = const_cast<CCacheEntry&>(*cit);
-		entry.lruIt = (void*)new tLruList::iterator(m_leastRecentlyUsedList.emplace(m_leastRecentlyUsedList.end(), sit, cit));
+
+	return ret;
+}
+
+void CDirectoryCache::UpdateLru(CServerEntry & sit, tCacheIter const& cit)
+{
+	// Everything accessing the entries of a cached listing passes through here
+	if (cit->packed) {
+		cit->Unpack();
+		UpdateMemory(sit, *cit);
 	}
+
+	cit->lastAccess = fz::monotonic_clock::now();
+	sit.lruList.splice(sit.lruList.end(), sit.lruList, cit);
+
+	PackColdEntry(sit);
 }
 
-void CDirectoryCache::Prune()
+void CDirectoryCache::PackColdEntry(CServerEntry & sit)
 {
-	while ((m_leastRecentlyUsedList.size() > 50000) ||
-		(m_totalFileCount > 1000000 && m_leastRecentlyUsedList.size() > 1000) ||
-		(m_totalFileCount > 5000000 && m_leastRecentlyUsedList.size() > 100))
-	{
-		tFullEntryPosition pos = m_leastRecentlyUsedList.front();
-		tLruList::iterator* lruIt = (tLruList::iterator*)pos.second->lruIt;
-		delete lruIt;
+	// Entries only ever move one position towards the front of the
+	// LRU list at a time, so each one passes this position as it
+	// becomes cold.
+	if (sit.lruList.size() <= unpacked_listings) {
+		return;
+	}
+
+	auto it = sit.lruList.end();
+	std::advance(it, -static_cast<std::ptrdiff_t>(unpacked_listings + 1));
 
-		m_totalFileCount -= pos.second->listing.size();
+	if (!it->packed) {
+		it->Pack();
+		UpdateMemory(sit, *it);
+	}
+}
+
+void CDirectoryCache::UpdateMemory(CServerEntry & sit, CCacheEntry & entry)
+{
+	int64_t const memory = entry.EstimateMemory();
+	int64_t const diff = memory - entry.memory;
+	entry.memory = memory;
+	sit.memory += diff;
+	m_totalMemory += diff;
+}
+
+void CDirectoryCache::RemoveEntry(CServerEntry & sit, tCacheIter const& cit)
+{
+	sit.memory -= cit->memory;
+	m_totalMemory -= cit->memory;
+	--m_totalListings;
 
-		pos.first->cacheList.erase(pos.second);
-		if (pos.first->cacheList.empty()) {
-			m_serverList.erase(pos.first);
+	sit.index.erase(cit->listing.path);
+	sit.lruList.erase(cit);
+}
+
+void CDirectoryCache::Prune()
+{
+	while (m_totalMemory > memoryLimit_ || m_totalListings > max_listings) {
+		// Without a global LRU list, find the server whose least recently
+		// used listing is the oldest.
+		tServerIter oldest;
+		fz::monotonic_clock oldestTime;
+		for (auto const& sit : GetServerEntries()) {
+			fz::scoped_lock lock(sit->mutex_);
+			if (sit->lruList.empty()) {
+				continue;
+			}
+			auto const& t = sit->lruList.front().lastAccess;
+			if (!oldest || t < oldestTime) {
+				oldest = sit;
+				oldestTime = t;
+			}
 		}
 
-		m_leastRecentlyUsedList.pop_front();
+		if (!oldest) {
+			break;
+		}
+
+		fz::scoped_lock lock(oldest->mutex_);
+		if (!oldest->lruList.empty()) {
+			auto cit = oldest->lruList.begin();
+			if (storage_) {
+				// Keep it available from the persistent storage
+				if (Persist(*oldest, *cit)) {
+					oldest->stored.insert(cit->listing.path);
+				}
+			}
+			RemoveEntry(*oldest, cit);
+			++evictions_;
+		}
 	}
 }
 
 void CDirectoryCache::SetTtl(fz::duration const& ttl)
 {
-	fz::scoped_lock lock(mutex_);
-
 	if (ttl < fz::duration::from_seconds(30)) {
-		ttl_ = fz::duration::from_seconds(30);
+		ttl_ = fz::duration::from_seconds(30).get_milliseconds();
 	}
 	else if (ttl > fz::duration::from_days(1)) {
-		ttl_ = fz::duration::from_days(1);
+		ttl_ = fz::duration::from_days(1).get_milliseconds();
 	}
 	else {
-		ttl_ = ttl;
+		ttl_ = ttl.get_milliseconds();
 	}
 }
+
+void CDirectoryCache::SetMemoryLimit(int64_t bytes)
+{
+	memoryLimit_ = std::max(bytes, int64_t(1024 * 1024));
+	Prune();
+}
+
+bool CDirectoryCache::SetStorage(std::wstring const& file, fz::thread_pool & pool)
+{
+	// Older listings are so likely to be out of date that they are not worth keeping
+	auto storage = std::make_unique<CDirectoryCacheStorage>();
+	if (!storage->Open(file, fz::duration::from_days(30), pool)) {
+		return false;
+	}
+
+	storage_ = std::move(storage);
+	return true;
+}
+
+std::unordered_map<CServerPath, CDirectoryCache::tCacheIter, CDirectoryCache::path_hash>::iterator CDirectoryCache::LoadStored(CServerEntry & sit, CServerPath const& path)
+{
+	auto stored = sit.stored.find(path);
+	if (stored == sit.stored.end()) {
+		return sit.index.end();
+	}
+	sit.stored.erase(stored);
+
+	CDirectoryListing listing;
+	if (!storage_ || !storage_->Load(sit.server, path, listing)) {
+		return sit.index.end();
+	}
+
+	sit.lruList.emplace_back(listing);
+	tCacheIter cit = std::prev(sit.lruList.end());
+	++m_totalListings;
+	UpdateMemory(sit, *cit);
+
+	// Pruning happens once the next listing gets stored
+	return sit.index.emplace(path, cit).first;
+}
+
+void CDirectoryCache::LoadStoredNoCase(CServerEntry & sit, CServerPath const& path)
+{
+	std::vector<CServerPath> matches;
+	for (auto const& stored : sit.stored) {
+		if (path.equal_nocase(stored)) {
+			matches.push_back(stored);
+		}
+	}
+	for (auto const& match : matches) {
+		auto it = LoadStored(sit, match);
+		if (it != sit.index.end()) {
+			UpdateLru(sit, it->second);
+		}
+	}
+}
+
+void CDirectoryCache::RemoveStored(CServerEntry & sit, CServerPath const& path)
+{
+	for (auto it = sit.stored.begin(); it != sit.stored.end(); ) {
+		if (*it == path || path.IsParentOf(*it, true)) {
+			if (storage_) {
+				storage_->Remove(sit.server, *it);
+			}
+			it = sit.stored.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void CDirectoryCache::MarkDirty(CServerEntry & sit, CCacheEntry & entry)
+{
+	// Written back once evicted or on shutdown, until then there must
+	// not be an outdated copy in the storage.
+	if (!entry.dirty && storage_) {
+		storage_->Remove(sit.server, entry.listing.path);
+	}
+	entry.dirty = true;
+}
+
+bool CDirectoryCache::Persist(CServerEntry & sit, CCacheEntry & entry)
+{
+	if (!storage_) {
+		return false;
+	}
+	if (!entry.dirty) {
+		return true;
+	}
+
+	// Don't let an older copy outlive a failed listing
+	if (entry.listing.partial() || entry.listing.failed()) {
+		storage_->Remove(sit.server, entry.listing.path);
+		entry.dirty = false;
+		return false;
+	}
+
+	bool saved;
+	if (entry.packed) {
+		CDirectoryListing listing = entry.listing;
+		entry.packed->Unpack(listing);
+		saved = storage_->Save(sit.server, listing);
+	}
+	else {
+		saved = storage_->Save(sit.server, entry.listing);
+	}
+
+	if (saved) {
+		entry.dirty = false;
+	}
+	else {
+		storage_->Remove(sit.server, entry.listing.path);
+	}
+
+	return saved;
+}
+
+CDirectoryCache::Statistics CDirectoryCache::GetStatistics() const
+{
+	Statistics ret;
+	ret.hits = hits_;
+	ret.misses = misses_;
+	ret.evictions = evictions_;
+	ret.memory = m_totalMemory;
+	ret.listings = m_totalListings;
+	return ret;
+}
+
+namespace {
+size_t constexpr unpacked_entry_overhead = sizeof(CDirentry) + sizeof(fz::shared_value<CDirentry>) + 32;
+}
+
+int64_t CDirectoryCache::CCacheEntry::EstimateMemory() const
+{
+	int64_t ret = sizeof(CCacheEntry) + 64;
+	if (packed) {
+		ret += packed->memory_usage();
+	}
+	else {
+		size_t const count = listing.size();
+		ret += count * unpacked_entry_overhead;
+		for (size_t i = 0; i < count; ++i) {
+			ret += listing[i].name.capacity() * sizeof(wchar_t);
+		}
+	}
+	return ret;
+}
+
+void CDirectoryCache::CCacheEntry::Pack()
+{
+	if (packed || !listing.size()) {
+		return;
+	}
+
+	if (!packed.get().Pack(listing)) {
+		packed.clear();
+		return;
+	}
+
+	// Only keep the metadata
+	int const flags = listing.m_flags;
+	listing.Assign(std::vector<fz::shared_value<CDirentry>>());
+	listing.m_flags = flags;
+}
+
+void CDirectoryCache::CCacheEntry::Unpack()
+{
+	if (!packed) {
+		return;
+	}
+
+	packed->Unpack(listing);
+	packed.clear();
+}
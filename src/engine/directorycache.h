@@ -15,11 +15,16 @@ version.
 */
 
 #include "../include/directorylisting.h"
+#include "directorycache_storage.h"
+#include "packed_listing.h"
 
 #include <libfilezilla/mutex.hpp>
 
+#include <atomic>
 #include <list>
-#include <set>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 enum class LookupFlags
 {
@@ -97,11 +102,33 @@ public:
 	bool RemoveFile(CServer const& server, CServerPath const& path, std::wstring const& filename);
 	void InvalidateServer(CServer const& server);
 	void RemoveDir(CServer const& server, CServerPath const& path, std::wstring const& filename, CServerPath const& target);
+
+	// Drops the listing of the directory, its subdirectories are kept
+	void InvalidateDir(CServer const& server, CServerPath const& path);
 	void Rename(CServer const& server, CServerPath const& pathFrom, std::wstring const& fileFrom, CServerPath const& pathTo, std::wstring const& fileTo);
 	void UpdateOwnerGroup(CServer const& server, CServerPath const& path, std::wstring const& filename, std::wstring& ownerGroup);
 
 	void SetTtl(fz::duration const& ttl);
 
+	// Least recently used listings get evicted once the estimated memory
+	// consumption of all cached listings exceeds this limit.
+	void SetMemoryLimit(int64_t bytes);
+
+	// Keeps listings in the given file across sessions. Stored listings
+	// are only read once looked up, changes are written by a worker
+	// spawned from the pool.
+	bool SetStorage(std::wstring const& file, fz::thread_pool & pool);
+
+	struct Statistics final
+	{
+		uint64_t hits{};
+		uint64_t misses{};
+		uint64_t evictions{};
+		int64_t memory{};
+		size_t listings{};
+	};
+	Statistics GetStatistics() const;
+
 protected:
 
 	class CCacheEntry final
@@ -116,56 +143,117 @@ protected:
 			, modificationTime(fz::monotonic_clock::now())
 		{}
 
+		// If packed is set, listing only holds path and flags, the entries
+		// need to be restored through Unpack before use.
 		CDirectoryListing listing;
+		fz::shared_optional<CPackedDirectoryListing> packed;
+
 		fz::monotonic_clock modificationTime;
+		fz::monotonic_clock lastAccess;
+
+		// Estimated memory consumption as accounted in the totals
+		int64_t memory{};
+
+		// Modified since last written to the persistent storage
+		bool dirty{};
 
 		CCacheEntry& operator=(CCacheEntry const& a) = default;
 		CCacheEntry& operator=(CCacheEntry && a) noexcept = default;
 
-		void* lruIt{}; // void* to break cyclic declaration dependency
+		size_t size() const { return packed ? packed->size() : listing.size(); }
+
+		void Pack();
+		void Unpack();
 
-		bool operator<(CCacheEntry const& op) const noexcept {
-			return listing.path < op.listing.path;
-		}
+		int64_t EstimateMemory() const;
+	};
+
+	struct path_hash final
+	{
+		size_t operator()(CServerPath const& path) const;
 	};
 
+	typedef std::list<CCacheEntry>::iterator tCacheIter;
+
+	// The cache is sharded by server, each with its own lock, so that
+	// engines connected to different servers do not contend.
+	//
+	// Lock order: m_serverMutex must never be acquired while waiting
+	// for a shard lock, and never more than one shard is locked at
+	// the same time, except recursively by the same thread.
 	class CServerEntry final
 	{
 	public:
-		CServerEntry() {}
 		explicit CServerEntry(CServer const& s)
 			: server(s)
 		{}
 
-		CServer server;
-		std::set<CCacheEntry> cacheList;
+		CServer const server;
+
+		fz::mutex mutex_;
+
+		// Ordered by last use, most recently used at the end
+		std::list<CCacheEntry> lruList;
+		std::unordered_map<CServerPath, tCacheIter, path_hash> index;
+
+		// Listings in the persistent storage that have not been loaded yet
+		std::unordered_set<CServerPath, path_hash> stored;
+
+		int64_t memory{};
 	};
 
-	typedef std::list<CServerEntry>::iterator tServerIter;
+	typedef std::shared_ptr<CServerEntry> tServerIter;
 
 	tServerIter CreateServerEntry(const CServer& server);
 	tServerIter GetServerEntry(const CServer& server);
 
-	typedef std::set<CCacheEntry>::iterator tCacheIter;
-	typedef std::set<CCacheEntry>::const_iterator tCacheConstIter;
+	// Must be called with m_serverMutex held
+	tServerIter FindServerEntry(size_t hash, CServer const& server);
+	std::vector<tServerIter> GetServerEntries();
+
+	bool Lookup(tCacheIter &cacheIter, CServerEntry &sit, CServerPath const& path, bool allowUnsureEntries, bool& is_outdated);
 
-	bool Lookup(tCacheIter &cacheIter, tServerIter &sit, CServerPath const& path, bool allowUnsureEntries, bool& is_outdated);
+	// Loads a listing from the persistent storage, returns sit.index.end() if there is none.
+	std::unordered_map<CServerPath, tCacheIter, path_hash>::iterator LoadStored(CServerEntry & sit, CServerPath const& path);
 
-	fz::mutex mutex_;
+	// Loads all stored listings whose path matches ignoring case, before
+	// they get modified.
+	void LoadStoredNoCase(CServerEntry & sit, CServerPath const& path);
 
-	std::list<CServerEntry> m_serverList;
+	// Drops stored listings of the given directory and its subdirectories
+	void RemoveStored(CServerEntry & sit, CServerPath const& path);
 
-	void UpdateLru(tServerIter const& sit, tCacheIter const& cit);
+	void MarkDirty(CServerEntry & sit, CCacheEntry & entry);
 
+	// Writes modified listings to the persistent storage, returns
+	// whether the listing is available from it afterwards.
+	bool Persist(CServerEntry & sit, CCacheEntry & entry);
+
+	void UpdateLru(CServerEntry & sit, tCacheIter const& cit);
+
+	// Only the most recently used listings of each server are kept unpacked
+	void PackColdEntry(CServerEntry & sit);
+
+	void UpdateMemory(CServerEntry & sit, CCacheEntry & entry);
+	void RemoveEntry(CServerEntry & sit, tCacheIter const& cit);
+
+	// Must be called without holding any shard lock
 	void Prune();
 
-	typedef std::pair<tServerIter, tCacheIter> tFullEntryPosition;
-	typedef std::list<tFullEntryPosition> tLruList;
-	tLruList m_leastRecentlyUsedList;
+	fz::mutex m_serverMutex;
+	std::unordered_multimap<size_t, tServerIter> m_serverList;
+
+	std::atomic<int64_t> m_totalMemory{};
+	std::atomic<size_t> m_totalListings{};
+	std::atomic<int64_t> memoryLimit_{256 * 1024 * 1024};
+
+	std::atomic<uint64_t> hits_{};
+	std::atomic<uint64_t> misses_{};
+	std::atomic<uint64_t> evictions_{};
 
-	int64_t m_totalFileCount{};
+	std::atomic<int64_t> ttl_{600 * 1000}; // In milliseconds
 
-	fz::duration ttl_{fz::duration::from_seconds(600)};
+	std::unique_ptr<CDirectoryCacheStorage> storage_;
 };
 
 #endif
@@ -0,0 +1,405 @@
+#include "filezilla.h"
+#include "directorycache_storage.h"
+#include "packed_listing.h"
+
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/hash.hpp>
+
+#include <sqlite3.h>
+
+#include <set>
+
+namespace {
+// Bump whenever the schema or the blob format changes, old caches are simply discarded.
+int constexpr schema_version = 1;
+
+std::string server_key(CServer const& server)
+{
+	// Covers everything compared by CServer::SameContent. Stored as a digest,
+	// the cache file is not meant to reveal which servers have been visited.
+	std::string key = fz::sprintf("%d\n%s\n%u\n%s\n%d\n%d\n%s\n",
+		static_cast<int>(server.GetProtocol()), fz::to_utf8(server.GetHost()), server.GetPort(), fz::to_utf8(server.GetUser()),
+		server.GetTimezoneOffset(), static_cast<int>(server.GetEncodingType()), fz::to_utf8(server.GetCustomEncoding()));
+	for (auto const& command : server.GetPostLoginCommands()) {
+		key += fz::to_utf8(command);
+		key += '\n';
+	}
+	for (auto const& trait : ExtraServerParameterTraits(server.GetProtocol())) {
+		if (trait.flags_ & ParameterTraits::content_transparent) {
+			continue;
+		}
+		key += trait.name_;
+		key += '=';
+		key += fz::to_utf8(server.GetExtraParameter(trait.name_));
+		key += '\n';
+	}
+
+	return fz::hex_encode<std::string>(fz::sha256(key));
+}
+
+int64_t to_milliseconds(fz::datetime const& t)
+{
+	return static_cast<int64_t>(t.get_time_t()) * 1000 + t.get_milliseconds();
+}
+
+bool bind_text(sqlite3_stmt* statement, int index, std::string const& value)
+{
+	return sqlite3_bind_text(statement, index, value.c_str(), value.size(), SQLITE_TRANSIENT) == SQLITE_OK;
+}
+
+bool restore(CServerPath const& path, int64_t listTime, int flags, unsigned char const* blob, size_t len, CDirectoryListing & listing)
+{
+	CPackedDirectoryListing packed;
+	if (!blob || !len || !packed.Deserialize(blob, len)) {
+		return false;
+	}
+
+	listing.path = path;
+	listing.m_flags = flags;
+	packed.Unpack(listing);
+
+	// Restore the age of the listing on the monotonic clock
+	fz::datetime const t = fz::datetime(static_cast<time_t>(listTime / 1000), fz::datetime::milliseconds) + fz::duration::from_milliseconds(listTime % 1000);
+	fz::duration age = fz::datetime::now() - t;
+	if (age < fz::duration()) {
+		age = fz::duration();
+	}
+	listing.m_firstListTime = fz::monotonic_clock::now();
+	listing.m_firstListTime -= age;
+
+	return true;
+}
+
+// Waits for locks held by other instances instead of failing right away
+int constexpr busy_timeout = 5000;
+}
+
+CDirectoryCacheStorage::~CDirectoryCacheStorage()
+{
+	{
+		fz::scoped_lock lock(mutex_);
+		quit_ = true;
+		cond_.signal(lock);
+	}
+	// Worker writes what is still pending before exiting
+	thread_.join();
+
+	Close();
+}
+
+bool CDirectoryCacheStorage::Open(std::wstring const& file, fz::duration const& maxAge, fz::thread_pool & pool)
+{
+	if (thread_) {
+		return false;
+	}
+
+	std::string const name = fz::to_utf8(file);
+	if (sqlite3_open(name.c_str(), &writeDb_) != SQLITE_OK) {
+		Close();
+		return false;
+	}
+	sqlite3_busy_timeout(writeDb_, busy_timeout);
+
+	// Losing the cache in a crash is harmless, don't wait for the disk.
+	bool ret = sqlite3_exec(writeDb_, "PRAGMA synchronous = OFF", 0, 0, 0) == SQLITE_OK;
+	ret = ret && sqlite3_exec(writeDb_, "PRAGMA journal_mode = WAL", 0, 0, 0) == SQLITE_OK;
+
+	int version{};
+	sqlite3_stmt* versionQuery{};
+	if (ret && sqlite3_prepare_v2(writeDb_, "PRAGMA user_version", -1, &versionQuery, 0) == SQLITE_OK) {
+		if (sqlite3_step(versionQuery) == SQLITE_ROW) {
+			version = sqlite3_column_int(versionQuery, 0);
+		}
+		else {
+			ret = false;
+		}
+		sqlite3_finalize(versionQuery);
+	}
+	else {
+		ret = false;
+	}
+	if (ret && version != schema_version) {
+		ret = sqlite3_exec(writeDb_, "DROP TABLE IF EXISTS listings", 0, 0, 0) == SQLITE_OK;
+	}
+
+	ret = ret && sqlite3_exec(writeDb_,
+		"CREATE TABLE IF NOT EXISTS listings ("
+		"server TEXT NOT NULL, "
+		"path TEXT NOT NULL, "
+		"list_time INTEGER NOT NULL, "
+		"flags INTEGER NOT NULL, "
+		"entries BLOB, "
+		"PRIMARY KEY (server, path))", 0, 0, 0) == SQLITE_OK;
+
+	if (ret && version != schema_version) {
+		ret = sqlite3_exec(writeDb_, fz::sprintf("PRAGMA user_version = %d", schema_version).c_str(), 0, 0, 0) == SQLITE_OK;
+	}
+
+	if (ret) {
+		std::string const query = fz::sprintf("DELETE FROM listings WHERE list_time < %d", to_milliseconds(fz::datetime::now() - maxAge));
+		ret = sqlite3_exec(writeDb_, query.c_str(), 0, 0, 0) == SQLITE_OK;
+	}
+
+	ret = ret && sqlite3_prepare_v2(writeDb_, "INSERT OR REPLACE INTO listings (server, path, list_time, flags, entries) VALUES (?1, ?2, ?3, ?4, ?5)", -1, &insertListingQuery_, 0) == SQLITE_OK;
+	ret = ret && sqlite3_prepare_v2(writeDb_, "DELETE FROM listings WHERE server=?1 AND path=?2", -1, &deleteListingQuery_, 0) == SQLITE_OK;
+	ret = ret && sqlite3_prepare_v2(writeDb_, "DELETE FROM listings WHERE server=?1", -1, &deleteServerQuery_, 0) == SQLITE_OK;
+
+	ret = ret && sqlite3_open_v2(name.c_str(), &readDb_, SQLITE_OPEN_READONLY, 0) == SQLITE_OK;
+	if (ret) {
+		sqlite3_busy_timeout(readDb_, busy_timeout);
+	}
+	ret = ret && sqlite3_prepare_v2(readDb_, "SELECT path FROM listings WHERE server=?1", -1, &selectPathsQuery_, 0) == SQLITE_OK;
+	ret = ret && sqlite3_prepare_v2(readDb_, "SELECT list_time, flags, entries FROM listings WHERE server=?1 AND path=?2", -1, &selectListingQuery_, 0) == SQLITE_OK;
+
+	if (ret) {
+		thread_ = pool.spawn([this]() { entry(); });
+		ret = static_cast<bool>(thread_);
+	}
+
+	if (!ret) {
+		Close();
+	}
+
+	return ret;
+}
+
+void CDirectoryCacheStorage::Close()
+{
+	sqlite3_finalize(selectPathsQuery_);
+	sqlite3_finalize(selectListingQuery_);
+	sqlite3_finalize(insertListingQuery_);
+	sqlite3_finalize(deleteListingQuery_);
+	sqlite3_finalize(deleteServerQuery_);
+	selectPathsQuery_ = 0;
+	selectListingQuery_ = 0;
+	insertListingQuery_ = 0;
+	deleteListingQuery_ = 0;
+	deleteServerQuery_ = 0;
+
+	sqlite3_close(readDb_);
+	readDb_ = 0;
+	sqlite3_close(writeDb_);
+	writeDb_ = 0;
+}
+
+bool CDirectoryCacheStorage::Step(sqlite3_stmt* statement)
+{
+	// Contention with other instances is handled by the busy timeout
+	int const res = sqlite3_step(statement);
+	sqlite3_reset(statement);
+
+	return res == SQLITE_DONE;
+}
+
+void CDirectoryCacheStorage::Queue(change && c)
+{
+	fz::scoped_lock lock(mutex_);
+	if (!thread_) {
+		return;
+	}
+
+	pending_.emplace_back(std::move(c));
+	if (pending_.size() == 1) {
+		cond_.signal(lock);
+	}
+}
+
+void CDirectoryCacheStorage::entry()
+{
+	fz::scoped_lock lock(mutex_);
+	while (true) {
+		while (!quit_ && pending_.empty()) {
+			cond_.wait(lock);
+		}
+		if (pending_.empty()) {
+			break;
+		}
+
+		writing_.swap(pending_);
+
+		lock.unlock();
+		Write(writing_);
+		lock.lock();
+
+		writing_.clear();
+	}
+}
+
+void CDirectoryCacheStorage::Write(std::vector<change> const& changes)
+{
+	bool const transaction = sqlite3_exec(writeDb_, "BEGIN", 0, 0, 0) == SQLITE_OK;
+
+	for (auto const& c : changes) {
+		switch (c.type_) {
+		case change::save:
+			bind_text(insertListingQuery_, 1, c.server_);
+			bind_text(insertListingQuery_, 2, c.path_);
+			sqlite3_bind_int64(insertListingQuery_, 3, c.listTime_);
+			sqlite3_bind_int(insertListingQuery_, 4, c.flags_);
+			sqlite3_bind_blob(insertListingQuery_, 5, c.blob_.c_str(), c.blob_.size(), SQLITE_STATIC);
+			Step(insertListingQuery_);
+			break;
+		case change::remove:
+			bind_text(deleteListingQuery_, 1, c.server_);
+			bind_text(deleteListingQuery_, 2, c.path_);
+			Step(deleteListingQuery_);
+			break;
+		case change::remove_server:
+			bind_text(deleteServerQuery_, 1, c.server_);
+			Step(deleteServerQuery_);
+			break;
+		}
+	}
+
+	if (transaction) {
+		sqlite3_exec(writeDb_, "COMMIT", 0, 0, 0);
+	}
+}
+
+CDirectoryCacheStorage::change const* CDirectoryCacheStorage::FindQueued(std::string const& server, std::string const& path) const
+{
+	for (auto const* changes : { &pending_, &writing_ }) {
+		for (auto it = changes->crbegin(); it != changes->crend(); ++it) {
+			if (it->server_ == server && (it->type_ == change::remove_server || it->path_ == path)) {
+				return &*it;
+			}
+		}
+	}
+	return nullptr;
+}
+
+std::vector<CServerPath> CDirectoryCacheStorage::GetPaths(CServer const& server)
+{
+	std::vector<CServerPath> ret;
+
+	std::string const key = server_key(server);
+
+	// Take the queued changes first. Reapplying those that get committed
+	// in the meantime gives the same result.
+	std::vector<change> queued;
+	{
+		fz::scoped_lock lock(mutex_);
+		if (!thread_) {
+			return ret;
+		}
+		for (auto const* changes : { &writing_, &pending_ }) {
+			for (auto const& c : *changes) {
+				if (c.server_ == key) {
+					queued.push_back(change{c.type_, c.server_, c.path_});
+				}
+			}
+		}
+	}
+
+	std::set<std::string> paths;
+	{
+		fz::scoped_lock lock(readMutex_);
+
+		bind_text(selectPathsQuery_, 1, key);
+		while (sqlite3_step(selectPathsQuery_) == SQLITE_ROW) {
+			char const* text = reinterpret_cast<char const*>(sqlite3_column_text(selectPathsQuery_, 0));
+			if (text) {
+				paths.emplace(text);
+			}
+		}
+		sqlite3_reset(selectPathsQuery_);
+	}
+
+	for (auto const& c : queued) {
+		switch (c.type_) {
+		case change::save:
+			paths.insert(c.path_);
+			break;
+		case change::remove:
+			paths.erase(c.path_);
+			break;
+		case change::remove_server:
+			paths.clear();
+			break;
+		}
+	}
+
+	ret.reserve(paths.size());
+	for (auto const& text : paths) {
+		CServerPath path;
+		if (path.SetSafePath(fz::to_wstring_from_utf8(text))) {
+			ret.emplace_back(std::move(path));
+		}
+	}
+
+	return ret;
+}
+
+bool CDirectoryCacheStorage::Load(CServer const& server, CServerPath const& path, CDirectoryListing & listing)
+{
+	std::string const key = server_key(server);
+	std::string const safePath = fz::to_utf8(path.GetSafePath());
+
+	{
+		fz::scoped_lock lock(mutex_);
+		if (!thread_) {
+			return false;
+		}
+		change const* c = FindQueued(key, safePath);
+		if (c) {
+			if (c->type_ != change::save) {
+				return false;
+			}
+			return restore(path, c->listTime_, c->flags_, reinterpret_cast<unsigned char const*>(c->blob_.data()), c->blob_.size(), listing);
+		}
+	}
+
+	fz::scoped_lock lock(readMutex_);
+
+	bind_text(selectListingQuery_, 1, key);
+	bind_text(selectListingQuery_, 2, safePath);
+
+	bool ret = false;
+	if (sqlite3_step(selectListingQuery_) == SQLITE_ROW) {
+		int64_t const listTime = sqlite3_column_int64(selectListingQuery_, 0);
+		int const flags = sqlite3_column_int(selectListingQuery_, 1);
+		auto const* blob = static_cast<unsigned char const*>(sqlite3_column_blob(selectListingQuery_, 2));
+		int const len = sqlite3_column_bytes(selectListingQuery_, 2);
+		ret = len > 0 && restore(path, listTime, flags, blob, static_cast<size_t>(len), listing);
+	}
+
+	sqlite3_reset(selectListingQuery_);
+
+	return ret;
+}
+
+bool CDirectoryCacheStorage::Save(CServer const& server, CDirectoryListing const& listing)
+{
+	CPackedDirectoryListing packed;
+	if (!packed.Pack(listing)) {
+		return false;
+	}
+
+	change c;
+	c.type_ = change::save;
+	c.server_ = server_key(server);
+	c.path_ = fz::to_utf8(listing.path.GetSafePath());
+	c.listTime_ = to_milliseconds(fz::datetime::now() - (fz::monotonic_clock::now() - listing.m_firstListTime));
+	c.flags_ = listing.m_flags;
+	packed.Serialize(c.blob_);
+
+	Queue(std::move(c));
+	return true;
+}
+
+void CDirectoryCacheStorage::Remove(CServer const& server, CServerPath const& path)
+{
+	change c;
+	c.type_ = change::remove;
+	c.server_ = server_key(server);
+	c.path_ = fz::to_utf8(path.GetSafePath());
+	Queue(std::move(c));
+}
+
+void CDirectoryCacheStorage::RemoveServer(CServer const& server)
+{
+	change c;
+	c.type_ = change::remove_server;
+	c.server_ = server_key(server);
+	Queue(std::move(c));
+}
@@ -0,0 +1,101 @@
+#ifndef FILEZILLA_ENGINE_DIRECTORYCACHE_STORAGE_HEADER
+#define FILEZILLA_ENGINE_DIRECTORYCACHE_STORAGE_HEADER
+
+#include "../include/directorylisting.h"
+#include "../include/server.h"
+
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/*
+On-disk store backing the directory cache across sessions.
+
+Listings are kept in an SQLite database, keyed by a digest of the server and
+the path of the listing. The entries are stored in the flat representation
+of CPackedDirectoryListing, together with the listing flags and the time
+the listing was retrieved so that the usual TTL and unsure handling apply
+to restored listings as well.
+*/
+class CDirectoryCacheStorage final
+{
+public:
+	CDirectoryCacheStorage() = default;
+	~CDirectoryCacheStorage();
+
+	CDirectoryCacheStorage(CDirectoryCacheStorage const&) = delete;
+	CDirectoryCacheStorage& operator=(CDirectoryCacheStorage const&) = delete;
+
+	// Listings older than maxAge get purged from the store. Changes are
+	// written by a worker spawned from the pool.
+	bool Open(std::wstring const& file, fz::duration const& maxAge, fz::thread_pool & pool);
+
+	// Paths of all listings stored for the given server
+	std::vector<CServerPath> GetPaths(CServer const& server);
+
+	bool Load(CServer const& server, CServerPath const& path, CDirectoryListing & listing);
+
+	// These only queue the change for the worker, they never wait for the
+	// disk. Queued changes are taken into account by GetPaths and Load.
+	bool Save(CServer const& server, CDirectoryListing const& listing);
+	void Remove(CServer const& server, CServerPath const& path);
+	void RemoveServer(CServer const& server);
+
+private:
+	struct change final
+	{
+		enum type {
+			save,
+			remove,
+			remove_server
+		};
+
+		type type_{};
+		std::string server_;
+		std::string path_;
+		int64_t listTime_{};
+		int flags_{};
+		std::string blob_;
+	};
+
+	void Close();
+
+	void Queue(change && c);
+	void entry();
+	void Write(std::vector<change> const& changes);
+
+	// Most recent queued change affecting the listing, nullptr if there is
+	// none. Must be called with mutex_ held.
+	change const* FindQueued(std::string const& server, std::string const& path) const;
+
+	bool Step(sqlite3_stmt* statement);
+
+	// Guards the queued changes. Changes being written by the worker are
+	// kept in writing_ until they have been committed.
+	fz::mutex mutex_{false};
+	fz::condition cond_;
+	std::vector<change> pending_;
+	std::vector<change> writing_;
+	bool quit_{};
+
+	fz::async_task thread_;
+
+	// Separate connections for reading and writing. With the database
+	// in WAL mode, reads do not wait for the worker's writes.
+	fz::mutex readMutex_{false};
+	sqlite3* readDb_{};
+	sqlite3_stmt* selectPathsQuery_{};
+	sqlite3_stmt* selectListingQuery_{};
+
+	// Only used by the worker once opened
+	sqlite3* writeDb_{};
+	sqlite3_stmt* insertListingQuery_{};
+	sqlite3_stmt* deleteListingQuery_{};
+	sqlite3_stmt* deleteServerQuery_{};
+};
+
+#endif
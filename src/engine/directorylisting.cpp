@@ -230,7 +230,7 @@ bool CheckInclusion(const CDirectoryListing& listing1, const CDirectoryListing&
 	std::vector<std::wstring>::const_iterator iter1, iter2;
 	iter1 = names1.cbegin();
 	iter2 = names2.cbegin();
-	while (iter2 != names2.cbegin()) {
+	while (iter2 != names2.cend()) {
 		if (iter1 == names1.cend()) {
 			return false;
 		}
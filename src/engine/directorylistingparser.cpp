@@ -318,19 +318,29 @@ class CLine final
 public:
 	CLine(std::wstring && line, size_t trailing_whitespace = std::string::npos)
 		: trailing_whitespace_(trailing_whitespace)
-		, line_(line)
+		, line_(std::move(line))
 	{
 		m_Tokens.reserve(10);
 		m_LineEndTokens.reserve(10);
-		while (m_parsePos < line_.size() && (line_[m_parsePos] == ' ' || line_[m_parsePos] == '\t')) {
-			++m_parsePos;
-		}
+		SkipLeadingWhitespace();
 	}
 
 	~CLine()
 	{
 	}
 
+	// Re-initializes the line with new contents, keeping the
+	// already allocated token storage.
+	void Assign(std::wstring && line)
+	{
+		m_Tokens.clear();
+		m_LineEndTokens.clear();
+		m_parsePos = 0;
+		trailing_whitespace_ = std::string::npos;
+		line_ = std::move(line);
+		SkipLeadingWhitespace();
+	}
+
 	CToken GetToken(unsigned int n)
 	{
 		if (m_Tokens.size() > n) {
@@ -440,11 +450,18 @@ public:
 	}
 
 protected:
+	void SkipLeadingWhitespace()
+	{
+		while (m_parsePos < line_.size() && (line_[m_parsePos] == ' ' || line_[m_parsePos] == '\t')) {
+			++m_parsePos;
+		}
+	}
+
 	std::vector<CToken> m_Tokens;
 	std::vector<CToken> m_LineEndTokens;
 	size_t m_parsePos{};
 	size_t trailing_whitespace_;
-	std::wstring const line_;
+	std::wstring line_;
 };
 
 CDirectoryListingParser::CDirectoryListingParser(CControlSocket* pControlSocket, const CServer& server, listingEncoding::type encoding)
@@ -694,6 +711,7 @@ CDirectoryListingParser::~CDirectoryListingParser()
 	}
 
 	delete m_prevLine;
+	delete m_spareLine;
 }
 
 bool CDirectoryListingParser::ParseData(bool partial)
@@ -703,42 +721,55 @@ bool CDirectoryListingParser::ParseData(bool partial)
 	bool error = false;
 	CLine *pLine = GetLine(partial, error);
 	while (pLine) {
-		bool res = ParseLine(*pLine, m_server.GetType(), false);
-		if (!res) {
-			if (m_prevLine) {
-				CLine* pConcatenatedLine = m_prevLine->Concat(pLine);
-				res = ParseLine(*pConcatenatedLine, m_server.GetType(), true);
-				delete pConcatenatedLine;
-				delete m_prevLine;
-
-				if (res) {
-					delete pLine;
-					m_prevLine = nullptr;
-				}
-				else {
-					m_prevLine = pLine;
-				}
+		ProcessLine(pLine);
+		pLine = GetLine(partial, error);
+	};
+
+	return !error;
+}
+
+void CDirectoryListingParser::ProcessLine(CLine* pLine)
+{
+	bool res = ParseLine(*pLine, m_server.GetType(), false);
+	if (!res) {
+		if (m_prevLine) {
+			CLine* pConcatenatedLine = m_prevLine->Concat(pLine);
+			res = ParseLine(*pConcatenatedLine, m_server.GetType(), true);
+			delete pConcatenatedLine;
+			ReleaseLine(m_prevLine);
+
+			if (res) {
+				ReleaseLine(pLine);
+				m_prevLine = nullptr;
 			}
 			else {
 				m_prevLine = pLine;
 			}
 		}
 		else {
-			delete m_prevLine;
+			m_prevLine = pLine;
+		}
+	}
+	else {
+		if (m_prevLine) {
+			ReleaseLine(m_prevLine);
 			m_prevLine = nullptr;
-			delete pLine;
 		}
-		pLine = GetLine(partial, error);
-	};
-
-	return !error;
+		ReleaseLine(pLine);
+	}
 }
 
 CDirectoryListing CDirectoryListingParser::Parse(const CServerPath &path)
 {
 	CDirectoryListing listing;
 	listing.path = path;
-	listing.m_firstListTime = fz::monotonic_clock::now();
+	if (firstListTime_) {
+		// Same as in the partial listings already sent
+		listing.m_firstListTime = firstListTime_;
+	}
+	else {
+		listing.m_firstListTime = fz::monotonic_clock::now();
+	}
 
 	if (!ParseData(false)) {
 		listing.m_flags |= CDirectoryListing::listing_failed;
@@ -2127,7 +2158,11 @@ bool CDirectoryListingParser::AddData(char *pData, int len)
 		return true;
 	}
 
-	return ParseData(true);
+	bool const ret = ParseData(true);
+	if (ret) {
+		EmitPartialListing();
+	}
+	return ret;
 }
 
 bool CDirectoryListingParser::AddLine(std::wstring && line, std::wstring && name, fz::datetime const& time)
@@ -2142,141 +2177,236 @@ bool CDirectoryListingParser::AddLine(std::wstring && line, std::wstring && name
 	CLine l(std::move(line));
 	ParseLine(l, m_server.GetType(), true, &override);
 
+	EmitPartialListing();
+
 	return true;
 }
 
+void CDirectoryListingParser::AddReplyLine(std::wstring_view line, std::wstring_view code)
+{
+	if (code.size() >= 3 && line.size() >= 4 && line.substr(0, 3) == code.substr(0, 3) && line[3] == '-') {
+		line = line.substr(4);
+	}
+
+	if (line.empty()) {
+		return;
+	}
+
+	CLine* pLine;
+	if (m_spareLine) {
+		pLine = m_spareLine;
+		m_spareLine = nullptr;
+		pLine->Assign(std::wstring(line));
+	}
+	else {
+		pLine = new CLine(std::wstring(line));
+	}
+	ProcessLine(pLine);
+
+	EmitPartialListing();
+}
+
+void CDirectoryListingParser::SetPartialListingHandler(CServerPath const& path, size_t batch_size, std::function<void(CDirectoryListing &&)> && handler)
+{
+	partialHandler_ = std::move(handler);
+	partialPath_ = path;
+	partialBatch_ = std::max(batch_size, size_t(1));
+	nextPartial_ = partialBatch_;
+	firstListTime_ = fz::monotonic_clock::now();
+}
+
+void CDirectoryListingParser::EmitPartialListing()
+{
+	if (!partialHandler_ || entries_.size() < nextPartial_) {
+		return;
+	}
+
+	nextPartial_ = std::max(entries_.size() + partialBatch_, entries_.size() * 2);
+
+	CDirectoryListing listing;
+	listing.path = partialPath_;
+	listing.m_firstListTime = firstListTime_;
+	listing.m_flags |= CDirectoryListing::listing_partial;
+
+	// Only copies the references, the entries themselves are shared
+	listing.Assign(std::vector<fz::shared_value<CDirentry>>(entries_));
+
+	partialHandler_(std::move(listing));
+}
+
+namespace {
+bool is_line_break(char c)
+{
+	return c == '\n' || c == '\r' || !c;
+}
+
+bool is_blank(char c)
+{
+	return is_line_break(c) || c == ' ' || c == '\t';
+}
+
+// Returns the first CR, LF or NUL in [p, end), or end if there is none.
+// Scans a machine word at a time, only the word containing a match is looked
+// at byte-by-byte.
+char const* find_line_break(char const* p, char const* const end)
+{
+	uint64_t constexpr ones = 0x0101010101010101ull;
+	uint64_t constexpr highs = 0x8080808080808080ull;
+	uint64_t constexpr lf = ones * '\n';
+	uint64_t constexpr cr = ones * '\r';
+
+	while (end - p >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		uint64_t const v_lf = v ^ lf;
+		uint64_t const v_cr = v ^ cr;
+		uint64_t const match = ((v - ones) & ~v) | ((v_lf - ones) & ~v_lf) | ((v_cr - ones) & ~v_cr);
+		if (match & highs) {
+			break;
+		}
+		p += 8;
+	}
+
+	while (p != end && !is_line_break(*p)) {
+		++p;
+	}
+	return p;
+}
+
+size_t constexpr max_line_length = 10000;
+}
+
 CLine *CDirectoryListingParser::GetLine(bool breakAtEnd, bool &error)
 {
 	while (!m_DataList.empty()) {
 		// Trim empty lines and spaces
-		auto iter = m_DataList.begin();
-		int len = iter->len;
-		while (iter->p[m_currentOffset] == '\r' || iter->p[m_currentOffset] == '\n'
-			|| iter->p[m_currentOffset] == ' ' || iter->p[m_currentOffset] == '\t'
-			|| !iter->p[m_currentOffset])
-		{
+		t_list & front = m_DataList.front();
+		while (m_currentOffset < front.len && is_blank(front.p[m_currentOffset])) {
 			++m_currentOffset;
-			if (m_currentOffset >= len) {
-				delete [] iter->p;
-				++iter;
-				m_currentOffset = 0;
-				if (iter == m_DataList.end()) {
-					m_DataList.clear();
-					return nullptr;
-				}
-				len = iter->len;
-			}
 		}
-		m_DataList.erase(m_DataList.begin(), iter);
-		iter = m_DataList.begin();
+		if (m_currentOffset >= front.len) {
+			delete [] front.p;
+			m_DataList.pop_front();
+			m_currentOffset = 0;
+			continue;
+		}
 
-		// Remember start offset and find next linebreak
-		int startpos = m_currentOffset;
-		int reslen = 0;
+		char const* const start = front.p + m_currentOffset;
+		char const* const front_end = front.p + front.len;
+		char const* lineEnd = find_line_break(start, front_end);
+		if (lineEnd != front_end) {
+			// Common case: Line is contained in a single chunk, no need to copy it.
+			size_t const len = static_cast<size_t>(lineEnd - start);
+			if (len > max_line_length) {
+				if (m_pControlSocket) {
+					m_pControlSocket->log(logmsg::error, _("Received a line exceeding 10000 characters, aborting."));
+				}
+				error = true;
+				return nullptr;
+			}
+			m_currentOffset = static_cast<int>(lineEnd - front.p);
 
-		int currentOffset = m_currentOffset;
-		while (iter->p[currentOffset] != '\n' && iter->p[currentOffset] != '\r' && iter->p[currentOffset]) {
-			++reslen;
+			CLine* line = MakeLine(start, len);
+			if (line) {
+				return line;
+			}
+			continue;
+		}
 
-			++currentOffset;
-			if (currentOffset >= len) {
-				++iter;
-				if (iter == m_DataList.end()) {
-					if (reslen > 10000) {
-						if (m_pControlSocket) {
-							m_pControlSocket->log(logmsg::error, _("Received a line exceeding 10000 characters, aborting."));
-						}
-						error = true;
-						return nullptr;
-					}
-					if (breakAtEnd) {
-						return nullptr;
-					}
-					break;
-				}
-				len = iter->len;
-				currentOffset = 0;
+		// Line spans multiple chunks, find the chunk containing its end
+		size_t reslen = static_cast<size_t>(front_end - start);
+		auto iter = m_DataList.begin() + 1;
+		for (; iter != m_DataList.end(); ++iter) {
+			lineEnd = find_line_break(iter->p, iter->p + iter->len);
+			reslen += static_cast<size_t>(lineEnd - iter->p);
+			if (reslen > max_line_length || lineEnd != iter->p + iter->len) {
+				break;
 			}
 		}
 
-		if (reslen > 10000) {
+		if (reslen > max_line_length) {
 			if (m_pControlSocket) {
 				m_pControlSocket->log(logmsg::error, _("Received a line exceeding 10000 characters, aborting."));
 			}
 			error = true;
 			return nullptr;
 		}
-		m_currentOffset = currentOffset;
-
-		// Reslen is now the length of the line, including any terminating whitespace
-		int const buflen = reslen;
-		char *res = new char[buflen + 1];
-		res[buflen] = 0;
-
-		int respos = 0;
-
-		// Copy line data
-		auto i = m_DataList.begin();
-		while (i != iter && reslen) {
-			int copylen = i->len - startpos;
-			if (copylen > reslen) {
-				copylen = reslen;
-			}
-			memcpy(&res[respos], &i->p[startpos], copylen);
-			reslen -= copylen;
-			respos += i->len - startpos;
-			startpos = 0;
 
-			delete [] i->p;
-			++i;
-		};
+		if (iter == m_DataList.end() && breakAtEnd) {
+			// Wait for more data
+			return nullptr;
+		}
 
-		// Copy last chunk
-		if (iter != m_DataList.end() && reslen) {
-			int copylen = m_currentOffset-startpos;
-			if (copylen > reslen) {
-				copylen = reslen;
-			}
-			memcpy(&res[respos], &iter->p[startpos], copylen);
-			if (reslen >= iter->len) {
-				delete [] iter->p;
-				m_DataList.erase(m_DataList.begin(), ++iter);
-			}
-			else {
-				m_DataList.erase(m_DataList.begin(), iter);
-			}
+		// Assemble the line, releasing all fully consumed chunks
+		lineBuffer_.clear();
+		lineBuffer_.append(start, front_end);
+		delete [] front.p;
+		auto it = m_DataList.begin() + 1;
+		for (; it != iter; ++it) {
+			lineBuffer_.append(it->p, it->len);
+			delete [] it->p;
+		}
+		if (iter != m_DataList.end()) {
+			lineBuffer_.append(iter->p, static_cast<size_t>(lineEnd - iter->p));
+			m_currentOffset = static_cast<int>(lineEnd - iter->p);
 		}
 		else {
-			m_DataList.erase(m_DataList.begin(), iter);
+			m_currentOffset = 0;
 		}
+		m_DataList.erase(m_DataList.begin(), iter);
 
-		std::wstring buffer;
-		if (m_pControlSocket) {
-			buffer = m_pControlSocket->ConvToLocal(res, buflen);
-			m_pControlSocket->log_raw(logmsg::listing, buffer);
+		CLine* line = MakeLine(lineBuffer_.c_str(), lineBuffer_.size());
+		if (line) {
+			return line;
 		}
-		else {
-			buffer = fz::to_wstring_from_utf8(res);
+	}
+
+	return nullptr;
+}
+
+CLine *CDirectoryListingParser::MakeLine(char const* p, size_t len)
+{
+	std::wstring buffer;
+	if (m_pControlSocket) {
+		buffer = m_pControlSocket->ConvToLocal(p, len);
+		m_pControlSocket->log_raw(logmsg::listing, buffer);
+	}
+	else {
+		buffer = fz::to_wstring_from_utf8(p, len);
+		if (buffer.empty()) {
+			buffer = fz::to_wstring(std::string_view(p, len));
 			if (buffer.empty()) {
-				buffer = fz::to_wstring(res);
-				if (buffer.empty()) {
-					buffer = std::wstring(res, res + strlen(res));
-				}
+				buffer = std::wstring(p, p + len);
 			}
 		}
-		delete [] res;
+	}
 
-		// Strip BOM
-		if (buffer[0] == 0xfeff) {
-			buffer = buffer.substr(1);
-		}
+	// Strip BOM
+	if (!buffer.empty() && buffer[0] == 0xfeff) {
+		buffer.erase(0, 1);
+	}
 
-		if (!buffer.empty()) {
-			return new CLine(std::move(buffer));
-		}
+	if (buffer.empty()) {
+		return nullptr;
 	}
 
-	return nullptr;
+	if (m_spareLine) {
+		CLine* line = m_spareLine;
+		m_spareLine = nullptr;
+		line->Assign(std::move(buffer));
+		return line;
+	}
+	return new CLine(std::move(buffer));
+}
+
+void CDirectoryListingParser::ReleaseLine(CLine* line)
+{
+	if (!m_spareLine) {
+		m_spareLine = line;
+	}
+	else {
+		delete line;
+	}
 }
 
 bool CDirectoryListingParser::ParseAsWfFtp(CLine &line, CDirentry &entry)
@@ -2987,6 +3117,7 @@ void CDirectoryListingParser::Reset()
 	m_fileListOnly = true;
 	m_maybeMultilineVms = false;
 	truncated_ = false;
+	nextPartial_ = partialBatch_;
 }
 
 bool CDirectoryListingParser::ParseAsZVM(CLine &line, CDirentry &entry)
@@ -36,6 +36,9 @@
 #include "../include/server.h"
 
 #include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 class CLine;
@@ -67,17 +70,40 @@ public:
 	bool AddData(char *pData, int len);
 	bool AddLine(std::wstring && line, std::wstring && name, fz::datetime const& time);
 
+	// Adds a line of a listing received on the control connection, e.g. in
+	// reply to STAT. Unlike AddLine, the line does not get logged. Some
+	// servers prefix each line with the reply code and a dash, pass the code
+	// of the multi-line reply to have that prefix removed.
+	void AddReplyLine(std::wstring_view line, std::wstring_view code = {});
+
 	void Reset();
 
 	void SetTimezoneOffset(fz::duration const& span) { m_timezoneOffset = span; }
 
 	void SetServer(const CServer& server) { m_server = server; };
 
+	// Streaming mode: Whenever enough new entries have been parsed, the
+	// handler gets passed a listing of all entries parsed so far, flagged
+	// with CDirectoryListing::listing_partial.
+	// To keep the total cost linear, the interval grows with the number of
+	// entries, but it is never smaller than batch_size.
+	void SetPartialListingHandler(CServerPath const& path, size_t batch_size, std::function<void(CDirectoryListing &&)> && handler);
+
 protected:
 	CLine *GetLine(bool breakAtEnd, bool& error);
+	CLine *MakeLine(char const* p, size_t len);
+
+	// Keeps one line object around for reuse by MakeLine
+	void ReleaseLine(CLine* line);
 
 	bool ParseData(bool partial);
 
+	// Parses the line, possibly together with the previous one. Takes
+	// ownership of the line.
+	void ProcessLine(CLine* line);
+
+	void EmitPartialListing();
+
 	bool ParseLine(CLine &line, ServerType const serverType, bool concatenated, CDirentry const* override = nullptr);
 
 	bool ParseAsUnix(CLine &line, CDirentry &entry, bool expect_date);
@@ -138,6 +164,10 @@ protected:
 	int64_t m_totalData{};
 
 	CLine *m_prevLine{};
+	CLine *m_spareLine{};
+
+	// Scratch buffer for lines spanning multiple chunks
+	std::string lineBuffer_;
 
 	CServer m_server;
 
@@ -152,6 +182,12 @@ protected:
 
 	size_t limit_{size_t(-1)};
 	bool truncated_{};
+
+	std::function<void(CDirectoryListing &&)> partialHandler_;
+	CServerPath partialPath_;
+	size_t partialBatch_{};
+	size_t nextPartial_{};
+	fz::monotonic_clock firstListTime_;
 };
 
 #endif
@@ -14,6 +14,10 @@
 #include <libfilezilla/thread_pool.hpp>
 #include <libfilezilla/tls_system_trust_store.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 namespace {
 class option_change_handler final : public fz::event_handler
 {
@@ -93,17 +97,41 @@ public:
 		, tlsSystemTrustStore_(pool_)
 	{
 		directory_cache_.SetTtl(fz::duration::from_seconds(options.get_int(OPTION_CACHE_TTL)));
+		directory_cache_.SetMemoryLimit(static_cast<int64_t>(options.get_int(OPTION_CACHE_MEMORY_LIMIT)) * 1024 * 1024);
+		if (options.get_bool(OPTION_CACHE_PERSISTENT)) {
+			std::wstring const file = options.get_string(OPTION_CACHE_FILE);
+			if (!file.empty()) {
+				directory_cache_.SetStorage(file, pool_);
+			}
+		}
 		rate_limit_mgr_.add(&rate_limiter_);
+
+		// The primary loop also takes engines
+		size_t loops = static_cast<size_t>(options.get_int(OPTION_EVENT_LOOPS));
+		if (!loops) {
+			loops = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (size_t i = 1; i < loops; ++i) {
+			engine_loops_.emplace_back(std::make_unique<fz::event_loop>(pool_));
+		}
 	}
 
 	~Impl()
 	{
 	}
 
+	fz::event_loop& next_engine_loop()
+	{
+		size_t const i = next_engine_loop_++ % (engine_loops_.size() + 1);
+		return i ? *engine_loops_[i - 1] : loop_;
+	}
+
 
 	COptionsBase& options_;
 	fz::thread_pool pool_;
 	fz::event_loop loop_{pool_};
+	std::vector<std::unique_ptr<fz::event_loop>> engine_loops_;
+	std::atomic<size_t> next_engine_loop_{};
 	fz::rate_limit_manager rate_limit_mgr_;
 	fz::rate_limiter rate_limiter_;
 	option_change_handler option_change_handler_{options_, loop_, rate_limit_mgr_, rate_limiter_};
@@ -135,6 +163,16 @@ fz::event_loop& CFileZillaEngineContext::GetEventLoop()
 	return impl_->loop_;
 }
 
+fz::event_loop& CFileZillaEngineContext::GetEngineEventLoop()
+{
+	return impl_->next_engine_loop();
+}
+
+size_t CFileZillaEngineContext::GetEventLoopCount() const
+{
+	return impl_->engine_loops_.size() + 1;
+}
+
 fz::rate_limiter& CFileZillaEngineContext::GetRateLimiter()
 {
 	return impl_->rate_limiter_;
@@ -79,7 +79,18 @@ unsigned int register_engine_options()
 		{ "TCP Keepalive Interval", 15, option_flags::numeric_clamp, 1, 10000 },
 		{ "Cache TTL", 600, option_flags::numeric_clamp, 30, 60*60*24 },
 		{ "Minimum TLS Version", 2, option_flags::numeric_clamp, 0, 3 },
-		{ "Directory listing item limit", 10000000, option_flags::numeric_clamp, 1000000, 2000000000 }
+		{ "Directory listing item limit", 10000000, option_flags::numeric_clamp, 1000000, 2000000000 },
+		{ "Partial listing batch size", 5000, option_flags::numeric_clamp, 0, 10000000 },
+		{ "Cache memory limit", 256, option_flags::numeric_clamp, 16, 1024*1024 },
+		{ "Persistent directory cache", false, option_flags::normal },
+		{ "Directory cache file", L"", option_flags::internal },
+		{ "Verify FTP checksums", false, option_flags::normal },
+		{ "MODE Z compression level", 6, option_flags::numeric_clamp, 1, 9 },
+		{ "SFTP minimum transfer window", 1024, option_flags::numeric_clamp, 32, 1024*1024 },
+		{ "SFTP maximum transfer window", 32*1024, option_flags::numeric_clamp, 32, 1024*1024 },
+		{ "Event loops", 0, option_flags::numeric_clamp, 0, 64 },
+		{ "FTP DELE pipelining window", 16, option_flags::numeric_clamp, 2, 100 },
+		{ "FTP transfers with absolute paths", false, option_flags::normal }
 	});
 	return value;
 }
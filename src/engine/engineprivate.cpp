@@ -33,10 +33,14 @@ unsigned int get_next_engine_id()
 	static std::atomic<int> next_{};
 	return ++next_;
 }
+
+// Enough to have the next transfer ready, queueing more would only delay
+// reactions of the caller to failures.
+size_t const max_queued_commands = 4;
 }
 
 CFileZillaEnginePrivate::CFileZillaEnginePrivate(CFileZillaEngineContext& context, CFileZillaEngine& parent, std::function<void(CFileZillaEngine*)> const& notification_cb)
-	: event_handler(context.GetEventLoop())
+	: event_handler(context.GetEngineEventLoop())
 	, transfer_status_(*this)
 	, opLockManager_(context.GetOpLockManager())
 	, activity_logger_(context.GetActivityLogger())
@@ -117,6 +121,7 @@ void CFileZillaEnginePrivate::shutdown()
 
 	controlSocket_.reset();
 	currentCommand_.reset();
+	queuedCommands_.clear();
 
 	{
 		fz::scoped_lock lock(notification_mutex_);
@@ -276,6 +281,15 @@ int CFileZillaEnginePrivate::ResetOperation(int nErrorCode)
 		AddNotification(std::make_unique<COperationNotification>(nErrorCode, currentCommand_->GetId()));
 
 		currentCommand_.reset();
+
+		if (cancelQueued_) {
+			CancelQueuedCommands();
+		}
+		else if (!queuedCommands_.empty()) {
+			currentCommand_ = std::move(queuedCommands_.front());
+			queuedCommands_.pop_front();
+			send_event<CCommandEvent>();
+		}
 	}
 
 	if (nErrorCode != FZ_REPLY_OK) {
@@ -712,6 +726,7 @@ void CFileZillaEnginePrivate::DoCancel()
 
 		logger_->log(logmsg::error, _("Connection attempt interrupted by user"));
 		AddNotification(std::make_unique<COperationNotification>(FZ_REPLY_DISCONNECTED | FZ_REPLY_CANCELED, Command::connect));
+		CancelQueuedCommands();
 
 		ClearQueuedLogs(true);
 	}
@@ -758,6 +773,49 @@ int CFileZillaEnginePrivate::Execute(CCommand const& command)
 	return FZ_REPLY_WOULDBLOCK;
 }
 
+int CFileZillaEnginePrivate::Queue(CCommand const& command)
+{
+	if (!command.valid()) {
+		logger_->log(logmsg::debug_warning, L"Command not valid");
+		return FZ_REPLY_SYNTAXERROR;
+	}
+
+	fz::scoped_lock lock(mutex_);
+
+	if (!currentCommand_) {
+		int res = CheckCommandPreconditions(command, false);
+		if (res != FZ_REPLY_OK) {
+			return res;
+		}
+
+		currentCommand_.reset(command.Clone());
+		send_event<CCommandEvent>();
+
+		return FZ_REPLY_WOULDBLOCK;
+	}
+
+	// Whether the preconditions are met is only known once it is the
+	// command's turn.
+	if (command.GetId() == Command::connect || command.GetId() == Command::disconnect ||
+		queuedCommands_.size() >= max_queued_commands || cancelQueued_)
+	{
+		return FZ_REPLY_BUSY;
+	}
+
+	queuedCommands_.emplace_back(command.Clone());
+
+	return FZ_REPLY_WOULDBLOCK;
+}
+
+void CFileZillaEnginePrivate::CancelQueuedCommands()
+{
+	for (auto const& command : queuedCommands_) {
+		AddNotification(std::make_unique<COperationNotification>(FZ_REPLY_CANCELED, command->GetId()));
+	}
+	queuedCommands_.clear();
+	cancelQueued_ = false;
+}
+
 std::unique_ptr<CNotification> CFileZillaEnginePrivate::GetNextNotification()
 {
 	fz::scoped_lock lock(notification_mutex_);
@@ -830,6 +888,12 @@ int CFileZillaEnginePrivate::Cancel()
 		return FZ_REPLY_OK;
 	}
 
+	// The notifications for the queued commands have to follow the one
+	// for the current command.
+	if (!queuedCommands_.empty()) {
+		cancelQueued_ = true;
+	}
+
 	send_event<CFileZillaEngineEvent>(engineCancel);
 	return FZ_REPLY_WOULDBLOCK;
 }
@@ -895,6 +959,16 @@ void CTransferStatusManager::SetMadeProgress()
 	made_progress_ = true;
 }
 
+void CTransferStatusManager::SetWindow(int64_t window)
+{
+	fz::scoped_lock lock(mutex_);
+	if (!status_) {
+		return;
+	}
+
+	status_.window = window;
+}
+
 void CTransferStatusManager::Update(int64_t transferredBytes)
 {
 	std::unique_ptr<CNotification> notification;
@@ -40,6 +40,7 @@ public:
 	void Reset();
 	void SetStartTime();
 	void SetMadeProgress();
+	void SetWindow(int64_t window);
 	void Update(int64_t transferredBytes);
 
 	CTransferStatus Get(bool &changed);
@@ -62,6 +63,7 @@ public:
 	virtual ~CFileZillaEnginePrivate();
 
 	int Execute(CCommand const& command);
+	int Queue(CCommand const& command);
 	int Cancel();
 	int ResetOperation(int nErrorCode);
 
@@ -122,6 +124,9 @@ protected:
 
 	int CheckCommandPreconditions(CCommand const& command, bool checkBusy);
 
+	// Notifies about the queued commands being canceled and drops them
+	void CancelQueuedCommands();
+
 	void OnSetAsyncRequestReplyEvent(std::unique_ptr<CAsyncRequestNotification> const& reply);
 
 	// Command handlers, only called by CFileZillaEngine::Command
@@ -165,6 +170,10 @@ protected:
 
 	std::unique_ptr<CCommand> currentCommand_;
 
+	// Commands to execute after the current one, see CFileZillaEngine::Queue
+	std::deque<std::unique_ptr<CCommand>> queuedCommands_;
+	bool cancelQueued_{};
+
 	// Protect access to these with notification_mutex_
 	std::deque<CNotification*> m_NotificationList;
 	bool m_maySendNotificationEvent{true};
@@ -2,6 +2,7 @@
 
 #include "delete.h"
 #include "../directorycache.h"
+#include "../servercapabilities.h"
 
 enum rmdStates
 {
@@ -18,21 +19,34 @@ int CFtpDeleteOpData::Send()
 		return FZ_REPLY_CONTINUE;
 	}
 	else if (opState == del_del) {
-		std::wstring const& file = files_.back();
-		if (file.empty()) {
-			log(logmsg::debug_info, L"Empty filename");
-			return FZ_REPLY_INTERNALERROR;
+		// With pipelining, keep sending until the window is full. Replies
+		// arrive in the order the commands were sent.
+		size_t const window = controlSocket_.GetPipelineWindow();
+		while (!files_.empty() && sent_.size() < window) {
+			std::wstring const& file = files_.back();
+			if (file.empty()) {
+				log(logmsg::debug_info, L"Empty filename");
+				return FZ_REPLY_INTERNALERROR;
+			}
+
+			std::wstring filename = path_.FormatFilename(file, omitPath_);
+			if (filename.empty()) {
+				log(logmsg::error, _("Filename cannot be constructed for directory %s and filename %s"), path_.GetPath(), file);
+				return FZ_REPLY_ERROR;
+			}
+
+			engine_.GetDirectoryCache().InvalidateFile(currentServer_, path_, file);
+
+			int res = controlSocket_.SendCommand(L"DELE " + filename, false, sent_.empty());
+			if (res != FZ_REPLY_WOULDBLOCK) {
+				return res;
+			}
+
+			sent_.emplace_back(std::move(files_.back()), window > 1);
+			files_.pop_back();
 		}
 
-		std::wstring filename = path_.FormatFilename(file, omitPath_);
-		if (filename.empty()) {
-			log(logmsg::error, _("Filename cannot be constructed for directory %s and filename %s"), path_.GetPath(), file);
-			return FZ_REPLY_ERROR;
-		}
-
-		engine_.GetDirectoryCache().InvalidateFile(currentServer_, path_, file);
-
-		return controlSocket_.SendCommand(L"DELE " + filename);
+		return FZ_REPLY_WOULDBLOCK;
 	}
 
 	log(logmsg::debug_warning, L"Unkown op state %d", opState);
@@ -42,13 +56,40 @@ int CFtpDeleteOpData::Send()
 int CFtpDeleteOpData::ParseResponse()
 {
 	int code = controlSocket_.GetReplyCode();
+	if (code == 1) {
+		// Not the final reply
+		return FZ_REPLY_WOULDBLOCK;
+	}
+
+	if (sent_.empty()) {
+		log(logmsg::debug_warning, L"Reply without outstanding DELE command");
+		InvalidateListing();
+		return FZ_REPLY_INTERNALERROR;
+	}
+
+	auto const [file, pipelined] = std::move(sent_.front());
+	sent_.pop_front();
+
 	if (code != 2 && code != 3) {
-		deleteFailed_ = true;
+		// Syntax and sequence errors are what servers mixing up pipelined
+		// commands reply with. Stop pipelining and retry the file on its own.
+		std::wstring const reply = controlSocket_.m_Response.substr(0, 3);
+		if (pipelined && (reply == L"500" || reply == L"501" || reply == L"503")) {
+			if (CServerCapabilities::GetCapability(currentServer_, pipelining_support) != no) {
+				log(logmsg::status, _("Server does not handle pipelined commands, sending commands one at a time."));
+				CServerCapabilities::SetCapability(currentServer_, pipelining_support, no);
+			}
+			InvalidateListing();
+			files_.push_back(file);
+		}
+		else {
+			deleteFailed_ = true;
+		}
 	}
 	else {
-		std::wstring const& file = files_.back();
-
-		engine_.GetDirectoryCache().RemoveFile(currentServer_, path_, file);
+		if (!listingInvalidated_) {
+			engine_.GetDirectoryCache().RemoveFile(currentServer_, path_, file);
+		}
 
 		auto now = fz::monotonic_clock::now();
 		if (time_ && (now - time_).get_seconds() >= 1) {
@@ -61,11 +102,12 @@ int CFtpDeleteOpData::ParseResponse()
 		}
 	}
 
-	files_.pop_back();
-
 	if (!files_.empty()) {
 		return FZ_REPLY_CONTINUE;
 	}
+	if (!sent_.empty()) {
+		return FZ_REPLY_WOULDBLOCK;
+	}
 
 	return deleteFailed_ ? FZ_REPLY_ERROR : FZ_REPLY_OK;
 }
@@ -89,8 +131,23 @@ int CFtpDeleteOpData::SubcommandResult(int prevResult, COpData const&)
 
 int CFtpDeleteOpData::Reset(int result)
 {
+	if ((result & FZ_REPLY_TIMEOUT) == FZ_REPLY_TIMEOUT && sent_.size() > 1) {
+		// Some servers silently drop commands arriving before they replied
+		// to the previous one. Don't pipeline again when retrying.
+		CServerCapabilities::SetCapability(currentServer_, pipelining_support, no);
+		InvalidateListing();
+	}
+
 	if (needSendListing_ && !(result & FZ_REPLY_DISCONNECTED)) {
 		controlSocket_.SendDirectoryListingNotification(path_, false);
 	}
 	return result;
 }
+
+void CFtpDeleteOpData::InvalidateListing()
+{
+	if (!listingInvalidated_) {
+		engine_.GetDirectoryCache().InvalidateDir(currentServer_, path_);
+		listingInvalidated_ = true;
+	}
+}
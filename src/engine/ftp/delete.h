@@ -5,6 +5,8 @@
 
 #include "../../include/serverpath.h"
 
+#include <deque>
+
 class CFtpDeleteOpData final : public COpData, public CFtpOpData
 {
 public:
@@ -19,9 +21,13 @@ public:
 	virtual int Reset(int result) override;
 
 	CServerPath path_;
-	std::vector<std::wstring> files_;
+	std::vector<std::wstring> files_; // Files not yet sent, last one first
 	bool omitPath_{};
 
+	// Files whose DELE command awaits its reply, oldest first. The flag is set
+	// if the command got sent with pipelining enabled.
+	std::deque<std::pair<std::wstring, bool>> sent_;
+
 	// Set to fz::monotonic_clock::now initially and after
 	// sending an updated listing to the UI.
 	fz::monotonic_clock time_;
@@ -30,6 +36,14 @@ public:
 
 	// Set to true if deletion of at least one file failed
 	bool deleteFailed_{};
+
+	// Set once the replies no longer could be matched to the files reliably.
+	// The cached listing of the directory is dropped then instead of
+	// updating it file by file.
+	bool listingInvalidated_{};
+
+private:
+	void InvalidateListing();
 };
 
 #endif
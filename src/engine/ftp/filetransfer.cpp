@@ -7,6 +7,7 @@
 #include "../servercapabilities.h"
 #include "../../include/engine_options.h"
 
+#include <libfilezilla/encode.hpp>
 #include <libfilezilla/file.hpp>
 #include <libfilezilla/local_filesys.hpp>
 
@@ -15,10 +16,48 @@
 CFtpFileTransferOpData::CFtpFileTransferOpData(CFtpControlSocket& controlSocket, CFileTransferCommand const& cmd)
 	: CFileTransferOpData(L"CFtpFileTransferOpData", cmd)
 	, CFtpOpData(controlSocket)
+	, commandsAtStart_(controlSocket.commandCount_)
 {
 	binary = !(cmd.GetFlags() & ftp_transfer_flags::ascii);
 }
 
+int CFtpFileTransferOpData::Reset(int result)
+{
+	uint64_t const commands = controlSocket_.commandCount_ - commandsAtStart_;
+	++controlSocket_.transferCount_;
+	controlSocket_.transferCommandCount_ += commands;
+	log(logmsg::debug_info, L"Sent %u commands for this file, %u commands for %u files on this connection", commands, controlSocket_.transferCommandCount_, controlSocket_.transferCount_);
+
+	return result;
+}
+
+bool CFtpFileTransferOpData::CanSkipChangeDir() const
+{
+	if (!options_.get_bool(OPTION_FTP_TRANSFER_ABSOLUTE_PATHS)) {
+		return false;
+	}
+
+	if (currentPath_ == remotePath_) {
+		return false;
+	}
+
+	// With TVFS, absolute paths work with all commands
+	if (CServerCapabilities::GetCapability(currentServer_, tvfs_support) != yes) {
+		return false;
+	}
+	if (remotePath_.GetType() != UNIX && remotePath_.GetType() != DEFAULT) {
+		return false;
+	}
+
+	// Changing the directory is still needed to list it. Otherwise the
+	// cached listing gives size and time of the file without any command.
+	CDirentry entry;
+	bool dirDidExist{};
+	bool matchedCase{};
+	engine_.GetDirectoryCache().LookupFile(entry, currentServer_, remotePath_, remoteFile_, dirDidExist, matchedCase);
+	return dirDidExist;
+}
+
 int CFtpFileTransferOpData::Send()
 {
 	std::wstring cmd;
@@ -41,6 +80,12 @@ int CFtpFileTransferOpData::Send()
 			remotePath_.SetType(currentServer_.GetType());
 		}
 
+		if (CanSkipChangeDir()) {
+			log(logmsg::debug_verbose, L"Using absolute path instead of changing directory");
+			tryAbsolutePath_ = true;
+			return LookupRemoteFile();
+		}
+
 		controlSocket_.ChangeDir(remotePath_);
 		return FZ_REPLY_CONTINUE;
 	case filetransfer_size:
@@ -80,7 +125,16 @@ int CFtpFileTransferOpData::Send()
 					localFileSize_ = 0;
 				}
 
-				engine_.transfer_status_.Init(remoteFileSize_, resumeOffset, false);
+				if (auto const* s = segment()) {
+					if (static_cast<uint64_t>(resumeOffset) >= s->end()) {
+						log(logmsg::debug_info, L"Segment has already been downloaded completely.");
+						return FZ_REPLY_OK;
+					}
+					engine_.transfer_status_.Init(static_cast<int64_t>(s->end()), resumeOffset, false);
+				}
+				else {
+					engine_.transfer_status_.Init(remoteFileSize_, resumeOffset, false);
+				}
 			}
 			else {
 				if (resume_) {
@@ -107,14 +161,21 @@ int CFtpFileTransferOpData::Send()
 				engine_.transfer_status_.Init(reader_factory_.size(), resumeOffset, false);
 			}
 
+			SetupChecksum();
+
 			controlSocket_.m_pTransferSocket = std::make_unique<CTransferSocket>(engine_, controlSocket_, download() ? TransferMode::download : TransferMode::upload);
 			controlSocket_.m_pTransferSocket->m_binaryMode = binary;
+			controlSocket_.m_pTransferSocket->set_checksum(checksum_.get());
 			if (download()) {
 				auto writer = controlSocket_.OpenWriter(writer_factory_, resumeOffset, true);
 				if (!writer) {
 					return FZ_REPLY_CRITICALERROR;
 				}
-				if (options_.get_int(OPTION_PREALLOCATE_SPACE)) {
+				if (auto const* s = segment()) {
+					// The file has been preallocated as a whole before splitting it up
+					controlSocket_.m_pTransferSocket->set_download_limit(s->end() - static_cast<uint64_t>(resumeOffset));
+				}
+				else if (options_.get_int(OPTION_PREALLOCATE_SPACE)) {
 					if (remoteFileSize_ >= 0 && remoteFileSize_ > resumeOffset) {
 						if (writer->preallocate(static_cast<uint64_t>(remoteFileSize_ - resumeOffset)) != fz::aio_result::ok) {
 							return FZ_REPLY_ERROR;
@@ -161,6 +222,12 @@ int CFtpFileTransferOpData::Send()
 
 		break;
 	}
+	case filetransfer_opts_hash:
+		cmd = L"OPTS HASH " + hashAlgorithm_;
+		break;
+	case filetransfer_hash:
+		cmd = hashCommand_ + L" " + remotePath_.FormatFilename(remoteFile_, !tryAbsolutePath_);
+		break;
 	default:
 		log(logmsg::debug_warning, L"Unhandled opState: %d", opState);
 		return FZ_REPLY_ERROR;
@@ -290,7 +357,25 @@ int CFtpFileTransferOpData::ParseResponse()
 
 		break;
 	case filetransfer_mfmt:
-		return FZ_REPLY_OK;
+		return FinalResult();
+	case filetransfer_opts_hash:
+		if (code != 2) {
+			log(logmsg::error, _("Server refused to select the %s checksum algorithm, checksum not verified."), hashAlgorithm_);
+			checksumUnverified_ = true;
+			return TransferFinished();
+		}
+		{
+			// Remember the selection
+			std::wstring algorithms;
+			CServerCapabilities::GetCapability(currentServer_, hash_command, &algorithms);
+			fz::replace_substrings(algorithms, L"*", L"");
+			fz::replace_substrings(algorithms, hashAlgorithm_, hashAlgorithm_ + L"*");
+			CServerCapabilities::SetCapability(currentServer_, hash_command, yes, algorithms);
+		}
+		opState = filetransfer_hash;
+		break;
+	case filetransfer_hash:
+		return VerifyChecksum();
 	default:
 		log(logmsg::debug_warning, L"Unknown op state");
 		return FZ_REPLY_INTERNALERROR;
@@ -303,58 +388,7 @@ int CFtpFileTransferOpData::SubcommandResult(int prevResult, COpData const&)
 {
 	if (opState == filetransfer_waitcwd) {
 		if (prevResult == FZ_REPLY_OK) {
-			CDirentry entry;
-			bool dirDidExist;
-			bool matchedCase;
-			bool found = engine_.GetDirectoryCache().LookupFile(entry, currentServer_, tryAbsolutePath_ ? remotePath_ : currentPath_, remoteFile_, dirDidExist, matchedCase);
-			if (!found) {
-				if (!dirDidExist) {
-					opState = filetransfer_waitlist;
-				}
-				else if (download() && options_.get_int(OPTION_PRESERVE_TIMESTAMPS) && CServerCapabilities::GetCapability(currentServer_, mdtm_command) == yes) {
-					opState = filetransfer_mdtm;
-				}
-				else {
-					opState = filetransfer_resumetest;
-				}
-			}
-			else {
-				if (entry.is_unsure()) {
-					opState = filetransfer_waitlist;
-				}
-				else {
-					if (matchedCase) {
-						remoteFileSize_ = entry.size;
-						if (entry.has_date()) {
-							remoteFileTime_ = entry.time;
-						}
-
-						if (download() &&
-							!entry.has_time() &&
-							options_.get_int(OPTION_PRESERVE_TIMESTAMPS) &&
-							CServerCapabilities::GetCapability(currentServer_, mdtm_command) == yes)
-						{
-							opState = filetransfer_mdtm;
-						}
-						else {
-							opState = filetransfer_resumetest;
-						}
-					}
-					else {
-						opState = filetransfer_size;
-					}
-				}
-			}
-			if (opState == filetransfer_waitlist) {
-				controlSocket_.List(CServerPath(), L"", LIST_FLAG_REFRESH);
-				return FZ_REPLY_CONTINUE;
-			}
-			else if (opState == filetransfer_resumetest) {
-				int res = controlSocket_.CheckOverwriteFile();
-				if (res != FZ_REPLY_OK) {
-					return res;
-				}
-			}
+			return LookupRemoteFile();
 		}
 		else {
 			tryAbsolutePath_ = true;
@@ -416,21 +450,12 @@ int CFtpFileTransferOpData::SubcommandResult(int prevResult, COpData const&)
 		}
 	}
 	else if (opState == filetransfer_waittransfer) {
-		if (prevResult == FZ_REPLY_OK && options_.get_int(OPTION_PRESERVE_TIMESTAMPS)) {
-			if (!download() &&
-				CServerCapabilities::GetCapability(currentServer_, mfmt_command) == yes)
-			{
-				localFileTime_ = reader_factory_.mtime();
-				if (!localFileTime_.empty()) {
-					opState = filetransfer_mfmt;
-					return FZ_REPLY_CONTINUE;
-				}
-			}
-			else if (download() && !remoteFileTime_.empty()) {
-				if (!writer_factory_->set_mtime(remoteFileTime_)) {
-					log(logmsg::debug_warning, L"Could not set modification time");
-				}
+		if (prevResult == FZ_REPLY_OK) {
+			if (checksum_) {
+				opState = hashAlgorithm_.empty() ? filetransfer_hash : filetransfer_opts_hash;
+				return FZ_REPLY_CONTINUE;
 			}
+			return TransferFinished();
 		}
 		return prevResult;
 	}
@@ -462,3 +487,215 @@ int CFtpFileTransferOpData::SubcommandResult(int prevResult, COpData const&)
 
 	return FZ_REPLY_CONTINUE;
 }
+
+int CFtpFileTransferOpData::LookupRemoteFile()
+{
+	CDirentry entry;
+	bool dirDidExist;
+	bool matchedCase;
+	bool found = engine_.GetDirectoryCache().LookupFile(entry, currentServer_, tryAbsolutePath_ ? remotePath_ : currentPath_, remoteFile_, dirDidExist, matchedCase);
+	if (!found) {
+		if (!dirDidExist) {
+			opState = filetransfer_waitlist;
+		}
+		else if (download() && options_.get_int(OPTION_PRESERVE_TIMESTAMPS) && CServerCapabilities::GetCapability(currentServer_, mdtm_command) == yes) {
+			opState = filetransfer_mdtm;
+		}
+		else {
+			opState = filetransfer_resumetest;
+		}
+	}
+	else {
+		if (entry.is_unsure()) {
+			opState = filetransfer_waitlist;
+		}
+		else {
+			if (matchedCase) {
+				remoteFileSize_ = entry.size;
+				if (entry.has_date()) {
+					remoteFileTime_ = entry.time;
+				}
+
+				if (download() &&
+					!entry.has_time() &&
+					options_.get_int(OPTION_PRESERVE_TIMESTAMPS) &&
+					CServerCapabilities::GetCapability(currentServer_, mdtm_command) == yes)
+				{
+					opState = filetransfer_mdtm;
+				}
+				else {
+					opState = filetransfer_resumetest;
+				}
+			}
+			else {
+				opState = filetransfer_size;
+			}
+		}
+	}
+	if (opState == filetransfer_waitlist) {
+		controlSocket_.List(tryAbsolutePath_ ? remotePath_ : CServerPath(), L"", LIST_FLAG_REFRESH);
+		return FZ_REPLY_CONTINUE;
+	}
+	else if (opState == filetransfer_resumetest) {
+		int res = controlSocket_.CheckOverwriteFile();
+		if (res != FZ_REPLY_OK) {
+			return res;
+		}
+	}
+
+	return FZ_REPLY_CONTINUE;
+}
+
+void CFtpFileTransferOpData::SetupChecksum()
+{
+	checksum_.reset();
+	hashCommand_.clear();
+	hashAlgorithm_.clear();
+	checksumUnverified_ = false;
+
+	if (!options_.get_bool(OPTION_FTP_VERIFY_CHECKSUM)) {
+		return;
+	}
+
+	// The server computes the checksum over the whole file as stored on its side
+	if (!binary) {
+		log(logmsg::debug_info, L"Not verifying checksum of ASCII mode transfer");
+		return;
+	}
+	if (segment()) {
+		log(logmsg::debug_info, L"Not verifying checksum of a segment of the file");
+		return;
+	}
+	if (resumeOffset) {
+		log(logmsg::debug_info, L"Not verifying checksum of resumed transfer");
+		return;
+	}
+
+	struct algorithm
+	{
+		checksum_algorithm alg;
+		wchar_t const* hash_name;
+		capabilityNames x_command;
+		wchar_t const* x_name;
+	};
+
+	// In order of preference
+	static algorithm const algorithms[] = {
+		{ checksum_algorithm::sha256, L"SHA-256", xsha256_command, L"XSHA256" },
+		{ checksum_algorithm::sha512, L"SHA-512", xsha512_command, L"XSHA512" },
+		{ checksum_algorithm::sha1, L"SHA-1", xsha1_command, L"XSHA1" },
+		{ checksum_algorithm::md5, L"MD5", xmd5_command, L"XMD5" },
+		{ checksum_algorithm::crc32, L"CRC32", xcrc_command, L"XCRC" }
+	};
+
+	std::wstring supported;
+	if (CServerCapabilities::GetCapability(currentServer_, hash_command, &supported) == yes) {
+		auto const tokens = fz::strtok(supported, L";");
+		for (auto const& a : algorithms) {
+			for (auto token : tokens) {
+				fz::trim(token);
+				bool const selected = !token.empty() && token.back() == '*';
+				if (selected) {
+					token.pop_back();
+				}
+				if (token == a.hash_name) {
+					checksum_ = std::make_unique<transfer_checksum>(a.alg);
+					hashCommand_ = L"HASH";
+					if (!selected) {
+						hashAlgorithm_ = a.hash_name;
+					}
+					return;
+				}
+			}
+		}
+	}
+
+	for (auto const& a : algorithms) {
+		if (CServerCapabilities::GetCapability(currentServer_, a.x_command) == yes) {
+			checksum_ = std::make_unique<transfer_checksum>(a.alg);
+			hashCommand_ = a.x_name;
+			return;
+		}
+	}
+
+	log(logmsg::error, _("Server does not support any checksum commands, checksum will not be verified."));
+	checksumUnverified_ = true;
+}
+
+int CFtpFileTransferOpData::VerifyChecksum()
+{
+	if (controlSocket_.GetReplyCode() != 2) {
+		log(logmsg::error, _("Server could not compute checksum, checksum not verified."));
+		checksumUnverified_ = true;
+		return TransferFinished();
+	}
+
+	std::string const local = checksum_->digest();
+
+	// Both the HASH reply ("213 SHA-256 0-1234 <hash> <file>") and the replies
+	// to the various X commands carry the hash as separate token.
+	std::wstring remote;
+	size_t const length = transfer_checksum::digest_length(checksum_->algorithm());
+	for (auto token : fz::strtok(controlSocket_.m_Response.substr(4), L" ")) {
+		if (token.size() > length) {
+			continue;
+		}
+		if (token.size() < length && checksum_->algorithm() != checksum_algorithm::crc32) {
+			continue;
+		}
+		bool hex = true;
+		for (auto const& c : token) {
+			if (fz::hex_char_to_int(c) < 0) {
+				hex = false;
+				break;
+			}
+		}
+		if (hex) {
+			// Some servers strip leading zeroes from the CRC
+			remote = std::wstring(length - token.size(), '0') + fz::str_tolower_ascii(token);
+			break;
+		}
+	}
+
+	if (remote.empty()) {
+		log(logmsg::error, _("Could not find checksum in server reply, checksum not verified."));
+		checksumUnverified_ = true;
+		return TransferFinished();
+	}
+
+	if (fz::to_utf8(remote) != local) {
+		log(logmsg::error, _("Checksum mismatch, local checksum is %s, server reports %s."), local, remote);
+		return FZ_REPLY_CHECKSUMMISMATCH;
+	}
+
+	log(logmsg::status, _("Checksum verified"));
+	return TransferFinished();
+}
+
+int CFtpFileTransferOpData::TransferFinished()
+{
+	if (options_.get_int(OPTION_PRESERVE_TIMESTAMPS)) {
+		if (!download() &&
+			CServerCapabilities::GetCapability(currentServer_, mfmt_command) == yes)
+		{
+			localFileTime_ = reader_factory_.mtime();
+			if (!localFileTime_.empty()) {
+				opState = filetransfer_mfmt;
+				return FZ_REPLY_CONTINUE;
+			}
+		}
+		else if (download() && !remoteFileTime_.empty() && !segment()) {
+			if (!writer_factory_->set_mtime(remoteFileTime_)) {
+				log(logmsg::debug_warning, L"Could not set modification time");
+			}
+		}
+	}
+
+	return FinalResult();
+}
+
+int CFtpFileTransferOpData::FinalResult() const
+{
+	// The file itself got transferred, but the user asked for verification
+	return checksumUnverified_ ? FZ_REPLY_CHECKSUMUNVERIFIED : FZ_REPLY_OK;
+}
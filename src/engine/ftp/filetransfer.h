@@ -2,6 +2,7 @@
 #define FILEZILLA_ENGINE_FTP_FILETRANSFER_HEADER
 
 #include "ftpcontrolsocket.h"
+#include "../checksum.h"
 
 enum filetransferStates
 {
@@ -14,7 +15,9 @@ enum filetransferStates
 	filetransfer_transfer,
 	filetransfer_waittransfer,
 	filetransfer_waitresumetest,
-	filetransfer_mfmt
+	filetransfer_mfmt,
+	filetransfer_opts_hash,
+	filetransfer_hash
 };
 
 class CFtpFileTransferOpData final : public CFileTransferOpData, public CFtpTransferOpData, public CFtpOpData
@@ -25,10 +28,37 @@ public:
 	virtual int Send() override;
 	virtual int ParseResponse() override;
 	virtual int SubcommandResult(int prevResult, COpData const&) override;
+	virtual int Reset(int result) override;
 
 	int TestResumeCapability();
 
+	// Decides from the cached listing of the directory which commands are
+	// needed to find out about the remote file.
+	int LookupRemoteFile();
+
+	// On servers supporting TVFS, transfers into directories with a cached
+	// listing use absolute paths instead of changing the directory.
+	bool CanSkipChangeDir() const;
+
+	// Picks the checksum algorithm and command if verification is enabled and possible
+	void SetupChecksum();
+	int VerifyChecksum();
+
+	// Post-transfer steps such as preserving timestamps
+	int TransferFinished();
+	int FinalResult() const;
+
 	bool fileDidExist_{true};
+
+	// Value of the control socket's command counter when the transfer started
+	uint64_t const commandsAtStart_{};
+
+	std::unique_ptr<transfer_checksum> checksum_;
+	std::wstring hashCommand_;
+	std::wstring hashAlgorithm_; // Algorithm to select through OPTS HASH, if any
+
+	// Verification was requested but the server cannot provide a checksum
+	bool checksumUnverified_{};
 };
 
 #endif
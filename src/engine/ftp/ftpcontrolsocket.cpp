@@ -157,6 +157,11 @@ void CFtpControlSocket::ParseLine(std::wstring line)
 				m_Response.clear();
 				m_MultilineResponseLines.clear();
 			}
+			else if (!m_repliesToSkip && !operations_.empty() && operations_.back()->opId == Command::list &&
+				static_cast<CFtpListOpData&>(*operations_.back()).ParseStatLine(line))
+			{
+				// Directory listing sent in reply to STAT, goes straight to the parser
+			}
 			else {
 				if (m_MultilineResponseLines.size() < 10000) {
 					m_MultilineResponseLines.push_back(line);
@@ -185,6 +190,8 @@ void CFtpControlSocket::ParseLine(std::wstring line)
 void CFtpControlSocket::OnConnect()
 {
 	m_lastTypeBinary = -1;
+	m_lastModeZ = 0;
+	m_modeZLevel = 0;
 	m_sentRestartOffset = false;
 
 	SetAlive();
@@ -295,6 +302,17 @@ int CFtpControlSocket::GetReplyCode() const
 	}
 }
 
+size_t CFtpControlSocket::GetPipelineWindow() const
+{
+	if (currentServer_.GetExtraParameter("pipelining") != L"1") {
+		return 1;
+	}
+	if (CServerCapabilities::GetCapability(currentServer_, pipelining_support) == no) {
+		return 1;
+	}
+	return static_cast<size_t>(engine_.GetOptions().get_int(OPTION_FTP_PIPELINE_WINDOW));
+}
+
 int CFtpControlSocket::SendCommand(std::wstring const& str, bool maskArgs, bool measureRTT)
 {
 	size_t pos;
@@ -315,6 +333,7 @@ int CFtpControlSocket::SendCommand(std::wstring const& str, bool maskArgs, bool
 	bool res = CRealControlSocket::Send(buffer.c_str(), buffer.size());
 	if (res) {
 		++m_pendingReplies;
+		++commandCount_;
 	}
 
 	if (measureRTT) {
@@ -88,6 +88,11 @@ protected:
 
 	int GetReplyCode() const;
 
+	// Number of commands an operation may send before waiting for the first
+	// reply. 1 unless the site has pipelining enabled and the server has not
+	// mishandled it before.
+	size_t GetPipelineWindow() const;
+
 	int GetExternalIPAddress(std::string& address);
 
 	void StartKeepaliveTimer();
@@ -107,6 +112,12 @@ protected:
 
 	int m_pendingReplies{1};
 
+	// Number of commands sent, and the part of it sent for file transfers,
+	// to tell how many round trips each file takes
+	uint64_t commandCount_{};
+	uint64_t transferCommandCount_{};
+	uint64_t transferCount_{};
+
 	std::unique_ptr<CExternalIPResolver> m_pIPResolver;
 
 	std::unique_ptr<fz::tls_layer> tls_layer_;
@@ -114,6 +125,11 @@ protected:
 
 	int m_lastTypeBinary{-1};
 
+	// 1 if MODE Z is active, 0 for MODE S, -1 if unknown
+	int m_lastModeZ{};
+	// Compression level last set through OPTS MODE Z, 0 if never set
+	int m_modeZLevel{};
+
 	// Used by keepalive code so that we're not using keep alive
 	// till the end of time. Stop after a couple of minutes.
 	fz::monotonic_clock m_lastCommandCompletionTime;
@@ -85,9 +85,6 @@ int CFtpListOpData::Send()
 			return FZ_REPLY_WOULDBLOCK;
 		}
 
-		controlSocket_.m_pTransferSocket.reset();
-		controlSocket_.m_pTransferSocket = std::make_unique<CTransferSocket>(engine_, controlSocket_, TransferMode::list);
-
 		// Assume that a server supporting UTF-8 does not send EBCDIC listings.
 		listingEncoding::type encoding = listingEncoding::unknown;
 		if (CServerCapabilities::GetCapability(currentServer_, utf8_command) == yes) {
@@ -97,6 +94,20 @@ int CFtpListOpData::Send()
 		listing_parser_ = std::make_unique<CDirectoryListingParser>(&controlSocket_, currentServer_, encoding);
 
 		listing_parser_->SetTimezoneOffset(controlSocket_.GetInferredTimezoneOffset());
+
+		if (!statTried_ && CanListWithStat()) {
+			// Saves setting up a data connection. Unless known to work,
+			// the listing gets verified against a regular one.
+			statTried_ = true;
+			if (CServerCapabilities::GetCapability(currentServer_, stat_listing) == yes) {
+				EnablePartialListings();
+			}
+			opState = list_stat;
+			return controlSocket_.SendCommand(L"STAT .");
+		}
+
+		controlSocket_.m_pTransferSocket.reset();
+		controlSocket_.m_pTransferSocket = std::make_unique<CTransferSocket>(engine_, controlSocket_, TransferMode::list);
 		controlSocket_.m_pTransferSocket->m_pDirectoryListingParser = listing_parser_.get();
 
 		engine_.transfer_status_.Init(-1, 0, true);
@@ -126,6 +137,12 @@ int CFtpListOpData::Send()
 				controlSocket_.Transfer(L"LIST", this);
 			}
 		}
+
+		// With the LIST -a check, the listing might get retrieved a second time,
+		// so only stream the listing if it is final.
+		if (!viewHiddenCheck_) {
+			EnablePartialListings();
+		}
 		return FZ_REPLY_CONTINUE;
 	}
 	if (opState == list_mdtm) {
@@ -141,6 +158,10 @@ int CFtpListOpData::Send()
 
 int CFtpListOpData::ParseResponse()
 {
+	if (opState == list_stat) {
+		return ParseStatResponse();
+	}
+
 	if (opState != list_mdtm) {
 		log(logmsg::debug_warning, "CFtpListOpData::ParseResponse should never be called if opState != list_mdtm");
 		return FZ_REPLY_INTERNALERROR;
@@ -256,6 +277,22 @@ int CFtpListOpData::SubcommandResult(int prevResult, COpData const&)
 				}
 			}
 
+			if (statCheck_) {
+				statCheck_ = false;
+
+				// Two empty listings do not tell whether STAT lists directories at all
+				if (listing.size() || directoryListing_.size()) {
+					if (CheckInclusion(listing, directoryListing_) && CheckInclusion(directoryListing_, listing)) {
+						log(logmsg::debug_info, L"Server sends directory listings in reply to STAT");
+						CServerCapabilities::SetCapability(currentServer_, stat_listing, yes);
+					}
+					else {
+						log(logmsg::debug_info, L"Reply to STAT does not match directory listing, not using STAT for listings");
+						CServerCapabilities::SetCapability(currentServer_, stat_listing, no);
+					}
+				}
+			}
+
 			controlSocket_.SetAlive();
 
 			int res = CheckTimezoneDetection(listing);
@@ -354,6 +391,88 @@ int CFtpListOpData::SubcommandResult(int prevResult, COpData const&)
 	}
 }
 
+bool CFtpListOpData::CanListWithStat() const
+{
+	if (CServerCapabilities::GetCapability(currentServer_, stat_listing) == no) {
+		return false;
+	}
+
+	// STAT returns LIST-style listings, MLSD listings are more precise
+	if (CServerCapabilities::GetCapability(currentServer_, mlsd_command) == yes) {
+		return false;
+	}
+
+	// Hidden files cannot be requested
+	if (options_.get_int(OPTION_VIEW_HIDDEN_FILES)) {
+		return false;
+	}
+
+	return true;
+}
+
+bool CFtpListOpData::ParseStatLine(std::wstring const& line)
+{
+	if (opState != list_stat || !listing_parser_) {
+		return false;
+	}
+
+	listing_parser_->AddReplyLine(line, controlSocket_.m_MultilineResponseCode);
+
+	return true;
+}
+
+int CFtpListOpData::ParseStatResponse()
+{
+	std::wstring const& response = controlSocket_.m_Response;
+	if (response[0] == '1') {
+		return FZ_REPLY_WOULDBLOCK;
+	}
+
+	std::wstring const code = response.substr(0, 3);
+	if (code == L"211" || code == L"212" || code == L"213") {
+		CDirectoryListing listing = listing_parser_->Parse(currentPath_);
+
+		if (CServerCapabilities::GetCapability(currentServer_, stat_listing) != yes) {
+			directoryListing_ = std::move(listing);
+			statCheck_ = true;
+			opState = list_waitlock;
+			return FZ_REPLY_CONTINUE;
+		}
+
+		int res = CheckTimezoneDetection(listing);
+		if (res != FZ_REPLY_OK) {
+			return res;
+		}
+
+		engine_.GetDirectoryCache().Store(listing, currentServer_);
+
+		controlSocket_.SendDirectoryListingNotification(currentPath_, false);
+
+		return FZ_REPLY_OK;
+	}
+
+	if (code == L"500" || code == L"501" || code == L"502" || code == L"504" ||
+		CServerCapabilities::GetCapability(currentServer_, stat_listing) != yes)
+	{
+		log(logmsg::debug_info, L"STAT cannot be used for directory listings");
+		CServerCapabilities::SetCapability(currentServer_, stat_listing, no);
+	}
+
+	// Fall back to a listing over a data connection
+	opState = list_waitlock;
+	return FZ_REPLY_CONTINUE;
+}
+
+void CFtpListOpData::EnablePartialListings()
+{
+	auto const batch = options_.get_int(OPTION_LISTING_PARTIAL_BATCH);
+	if (batch > 0) {
+		listing_parser_->SetPartialListingHandler(currentPath_, static_cast<size_t>(batch), [this](CDirectoryListing && listing) {
+			controlSocket_.SendPartialDirectoryListingNotification(std::move(listing));
+		});
+	}
+}
+
 int CFtpListOpData::CheckTimezoneDetection(CDirectoryListing& listing)
 {
 	if (CServerCapabilities::GetCapability(currentServer_, inferred_timezone_offset) == unknown) {
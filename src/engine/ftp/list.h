@@ -12,7 +12,8 @@ enum listStates
 	list_waitcwd,
 	list_waitlock,
 	list_waittransfer,
-	list_mdtm
+	list_mdtm,
+	list_stat
 };
 
 class CFtpListOpData final : public COpData, public CFtpOpData, public CFtpTransferOpData
@@ -24,8 +25,16 @@ public:
 	virtual int ParseResponse() override;
 	virtual int SubcommandResult(int prevResult, COpData const& previousOperation) override;
 
+	// Called for the lines of multi-line replies. Returns true if the line is
+	// part of a listing sent in reply to STAT.
+	bool ParseStatLine(std::wstring const& line);
+
 private:
 	int CheckTimezoneDetection(CDirectoryListing& listing);
+	void EnablePartialListings();
+
+	bool CanListWithStat() const;
+	int ParseStatResponse();
 
 	CServerPath path_;
 	std::wstring subDir_;
@@ -44,6 +53,12 @@ private:
 	bool viewHiddenCheck_{};
 	bool viewHidden_{}; // Uses LIST -a command
 
+	bool statTried_{};
+
+	// Set while verifying a listing received in reply to STAT, kept in
+	// directoryListing_, against the one from the data connection
+	bool statCheck_{};
+
 	// Listing index for list_mdtm
 	size_t mdtm_index_{};
 
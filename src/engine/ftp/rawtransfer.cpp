@@ -24,12 +24,16 @@ int CFtpRawTransferOpData::Send()
 		if ((pOldData->binary && controlSocket_.m_lastTypeBinary == 1) ||
 			(!pOldData->binary && controlSocket_.m_lastTypeBinary == 0))
 		{
-			opState = rawtransfer_port_pasv;
+			opState = rawtransfer_mode;
 		}
 		else {
 			opState = rawtransfer_type;
 		}
 
+		compress_ = currentServer_.GetExtraParameter("mode_z") == L"1" &&
+			CServerCapabilities::GetCapability(currentServer_, mode_z_support) == yes;
+		controlSocket_.m_pTransferSocket->set_compression(compress_ ? options_.get_int(OPTION_FTP_MODE_Z_LEVEL) : 0);
+
 		if (controlSocket_.proxy_layer_) {
 			// Only passive supported
 			// Theoretically could use reverse proxy ability in SOCKS5, but
@@ -65,6 +69,16 @@ int CFtpRawTransferOpData::Send()
 		}
 		measureRTT = true;
 		break;
+	case rawtransfer_mode:
+		if (controlSocket_.m_lastModeZ == (compress_ ? 1 : 0)) {
+			opState = rawtransfer_port_pasv;
+			return FZ_REPLY_CONTINUE;
+		}
+		cmd = compress_ ? L"MODE Z" : L"MODE S";
+		break;
+	case rawtransfer_opts_mode:
+		cmd = fz::sprintf(L"OPTS MODE Z LEVEL %d", options_.get_int(OPTION_FTP_MODE_Z_LEVEL));
+		break;
 	case rawtransfer_port_pasv:
 		if (bPasv) {
 			cmd = GetPassiveCommand();
@@ -152,10 +166,36 @@ int CFtpRawTransferOpData::ParseResponse()
 			error = true;
 		}
 		else {
-			opState = rawtransfer_port_pasv;
+			opState = rawtransfer_mode;
 			controlSocket_.m_lastTypeBinary = pOldData->binary ? 1 : 0;
 		}
 		break;
+	case rawtransfer_mode:
+		if (code == 2) {
+			controlSocket_.m_lastModeZ = compress_ ? 1 : 0;
+			if (compress_ && controlSocket_.m_modeZLevel != options_.get_int(OPTION_FTP_MODE_Z_LEVEL)) {
+				opState = rawtransfer_opts_mode;
+			}
+			else {
+				opState = rawtransfer_port_pasv;
+			}
+		}
+		else if (compress_) {
+			// Mode unchanged, go back to uncompressed transfers if needed
+			log(logmsg::status, _("Server does not support MODE Z, transferring data uncompressed."));
+			CServerCapabilities::SetCapability(currentServer_, mode_z_support, no);
+			compress_ = false;
+			controlSocket_.m_pTransferSocket->set_compression(0);
+		}
+		else {
+			error = true;
+		}
+		break;
+	case rawtransfer_opts_mode:
+		// Not all servers allow setting the level, the server then just uses its default
+		controlSocket_.m_modeZLevel = options_.get_int(OPTION_FTP_MODE_Z_LEVEL);
+		opState = rawtransfer_port_pasv;
+		break;
 	case rawtransfer_port_pasv:
 		if (code != 2 && code != 3) {
 			if (!options_.get_int(OPTION_ALLOW_TRANSFERMODEFALLBACK)) {
@@ -264,6 +304,13 @@ int CFtpRawTransferOpData::ParseResponse()
 		}
 		break;
 	case rawtransfer_waittransfer:
+		if (code == 4 && pOldData->transferEndReason == TransferEndReason::successful &&
+			controlSocket_.m_pTransferSocket->download_limit_reached())
+		{
+			// We closed the data connection ourselves after receiving the requested range
+			log(logmsg::debug_info, L"Ignoring failure reply, the requested range has been received completely.");
+			return FZ_REPLY_OK;
+		}
 		if (code != 2 && code != 3) {
 			if (pOldData->transferEndReason == TransferEndReason::successful) {
 				pOldData->transferEndReason = TransferEndReason::transfer_command_failure;
@@ -7,6 +7,8 @@ enum rawtransferStates
 {
 	rawtransfer_init = 0,
 	rawtransfer_type,
+	rawtransfer_mode,
+	rawtransfer_opts_mode,
 	rawtransfer_port_pasv,
 	rawtransfer_rest,
 	rawtransfer_transfer,
@@ -40,6 +42,9 @@ public:
 	bool bTriedPasv{};
 	bool bTriedActive{};
 
+	// Use MODE Z for this transfer
+	bool compress_{};
+
 private:
 	std::wstring host_;
 	unsigned short port_{};
@@ -1,5 +1,7 @@
 #include "../filezilla.h"
 #include "../activity_logger_layer.h"
+#include "../checksum.h"
+#include "../deflate_layer.h"
 #include "../directorylistingparser.h"
 #include "../engineprivate.h"
 #include "../proxy.h"
@@ -14,6 +16,8 @@
 #include <libfilezilla/rate_limited_layer.hpp>
 #include <libfilezilla/util.hpp>
 
+#include <atomic>
+
 using namespace std::literals;
 
 #if HAVE_ASCII_TRANSFORM
@@ -65,6 +69,15 @@ void CTransferSocket::ResetSocket()
 #if HAVE_ASCII_TRANSFORM
 	ascii_layer_.reset();
 #endif
+	if (deflate_layer_) {
+		uint64_t const payload = deflate_layer_->payload_bytes();
+		uint64_t const wire = deflate_layer_->wire_bytes();
+		controlSocket_.log(logmsg::debug_info, L"MODE Z transferred %u bytes of data as %u bytes", payload, wire);
+		if (payload > wire) {
+			engine_.activity_logger_.record_saved(payload - wire);
+		}
+		deflate_layer_.reset();
+	}
 	tls_layer_.reset();
 	proxy_layer_.reset();
 	ratelimit_layer_.reset();
@@ -315,8 +328,17 @@ bool CTransferSocket::OnReceive()
 				return false;
 			}
 
+			if (download_limit_reached()) {
+				// Still waiting for the writer to take the end of the range
+				FinalizeWrite();
+				return false;
+			}
+
 			int error{};
 			size_t to_read = buffer_->capacity() - buffer_->size();
+			if (to_read > download_limit_) {
+				to_read = static_cast<size_t>(download_limit_);
+			}
 			int numread = active_layer_->read(buffer_->get(to_read), static_cast<unsigned int>(to_read), error);
 
 			if (numread < 0) {
@@ -337,6 +359,16 @@ bool CTransferSocket::OnReceive()
 				}
 				else {
 					buffer_->add(static_cast<size_t>(numread));
+					if (checksum_) {
+						checksum_->update(buffer_->get() + buffer_->size() - numread, static_cast<size_t>(numread));
+					}
+					if (download_limit_ != fz::aio_base::nosize) {
+						download_limit_ -= static_cast<uint64_t>(numread);
+						if (!download_limit_) {
+							FinalizeWrite();
+							return false;
+						}
+					}
 					return true;
 				}
 			}
@@ -551,6 +583,12 @@ bool CTransferSocket::InitLayers(bool active)
 		}
 	}
 
+	if (compression_level_) {
+		// Compress before encrypting, encrypted data does not compress
+		deflate_layer_ = std::make_unique<deflate_layer>(nullptr, *active_layer_, compression_level_, m_transferMode == TransferMode::upload);
+		active_layer_ = deflate_layer_.get();
+	}
+
 #if HAVE_ASCII_TRANSFORM
 	if (use_ascii_) {
 		ascii_layer_ = std::make_unique<fz::ascii_layer>(event_loop_, nullptr, *active_layer_);
@@ -591,7 +629,7 @@ void CTransferSocket::TransferEnd(TransferEndReason reason)
 	}
 	m_transferEndReason = reason;
 
-	if (reason != TransferEndReason::successful) {
+	if (reason != TransferEndReason::successful || download_limit_reached()) {
 		ResetSocket();
 	}
 	else {
@@ -633,7 +671,8 @@ std::unique_ptr<fz::listen_socket> CTransferSocket::CreateSocketServer()
 	// connection attempts. This may cause problems if transferring lots of
 	// files with a narrow port range.
 
-	static int start = 0;
+	// Shared by all engines, which may run on different event loops
+	static std::atomic<int> start{0};
 
 	int low = engine_.GetOptions().get_int(OPTION_LIMITPORTS_LOW);
 	int high = engine_.GetOptions().get_int(OPTION_LIMITPORTS_HIGH);
@@ -641,22 +680,24 @@ std::unique_ptr<fz::listen_socket> CTransferSocket::CreateSocketServer()
 		low = high;
 	}
 
-	if (start < low || start > high) {
-		start = static_cast<decltype(start)>(fz::random_number(low, high));
+	int port = start;
+	if (port < low || port > high) {
+		port = static_cast<int>(fz::random_number(low, high));
 	}
 
 	std::unique_ptr<fz::listen_socket> server;
 
 	int count = high - low + 1;
 	while (count--) {
-		server = CreateSocketServer(start++);
+		server = CreateSocketServer(port++);
 		if (server) {
 			break;
 		}
-		if (start > high) {
-			start = low;
+		if (port > high) {
+			port = low;
 		}
 	}
+	start = port;
 
 	return server;
 }
@@ -699,6 +740,10 @@ bool CTransferSocket::CheckGetNextReadBuffer()
 			return false;
 		}
 
+		if (checksum_) {
+			checksum_->update(buffer_->get(), buffer_->size());
+		}
+
 		if (buffer_->empty()) {
 			int r = active_layer_->shutdown();
 			if (r) {
@@ -6,6 +6,8 @@
 class CFileZillaEnginePrivate;
 class CFtpControlSocket;
 class CDirectoryListingParser;
+class deflate_layer;
+class transfer_checksum;
 
 enum class TransferMode
 {
@@ -39,6 +41,9 @@ public:
 
 	bool m_binaryMode{true};
 
+	// Compression level to use for MODE Z, 0 if the data is not compressed
+	void set_compression(int level) { compression_level_ = level; }
+
 	TransferEndReason GetTransferEndreason() const { return m_transferEndReason; }
 
 	void set_reader(std::unique_ptr<fz::reader_base> && reader, bool ascii);
@@ -46,6 +51,17 @@ public:
 
 	void ContinueWithoutSesssionResumption();
 
+	// Fed with all data passing between the file and the socket. Owned by
+	// the file transfer operation, which outlives the transfer socket.
+	void set_checksum(transfer_checksum * checksum) { checksum_ = checksum; }
+
+	// Stop downloading after the given amount of data, used to download a
+	// byte range of a file. Once the range is complete the data connection
+	// is closed without waiting for the server, which in turn usually
+	// reports the transfer as aborted.
+	void set_download_limit(uint64_t limit) { download_limit_ = limit; }
+	bool download_limit_reached() const { return download_limit_ == 0; }
+
 protected:
 	bool CheckGetNextWriteBuffer();
 	bool CheckGetNextReadBuffer();
@@ -94,6 +110,8 @@ protected:
 	std::unique_ptr<fz::rate_limited_layer> ratelimit_layer_;
 	std::unique_ptr<CProxySocket> proxy_layer_;
 	std::unique_ptr<fz::tls_layer> tls_layer_;
+	std::unique_ptr<deflate_layer> deflate_layer_;
+	int compression_level_{};
 #if HAVE_ASCII_TRANSFORM
 	std::unique_ptr<fz::ascii_layer> ascii_layer_;
 	bool use_ascii_{};
@@ -110,6 +128,10 @@ protected:
 	std::unique_ptr<fz::writer_base> writer_;
 	fz::buffer_lease buffer_;
 	size_t resumetest_{};
+
+	transfer_checksum * checksum_{};
+
+	uint64_t download_limit_{fz::aio_base::nosize};
 };
 
 #endif
@@ -7,6 +7,43 @@
 #include <assert.h>
 #include <string.h>
 
+#include <string_view>
+
+namespace {
+// Parses "bytes first-last/complete", complete is -1 if given as *
+bool parse_content_range(std::string_view v, int64_t & first, int64_t & last, int64_t & complete)
+{
+	if (v.substr(0, 6) != "bytes ") {
+		return false;
+	}
+	v.remove_prefix(6);
+
+	size_t const dash = v.find('-');
+	size_t const slash = v.find('/');
+	if (dash == std::string_view::npos || slash == std::string_view::npos || dash > slash) {
+		return false;
+	}
+
+	first = fz::to_integral<int64_t>(v.substr(0, dash), -1);
+	last = fz::to_integral<int64_t>(v.substr(dash + 1, slash - dash - 1), -1);
+	if (first < 0 || last < first) {
+		return false;
+	}
+
+	if (v.substr(slash + 1) == "*") {
+		complete = -1;
+	}
+	else {
+		complete = fz::to_integral<int64_t>(v.substr(slash + 1), -1);
+		if (complete <= last) {
+			return false;
+		}
+	}
+
+	return true;
+}
+}
+
 enum filetransferStates
 {
 	filetransfer_init = 0,
@@ -71,7 +108,14 @@ int CHttpFileTransferOpData::Send()
 		}
 		return FZ_REPLY_CONTINUE;
 	case filetransfer_transfer:
-		if (resume_ && localFileSize_ != 0 && localFileSize_ != fz::aio_base::nosize) {
+		if (auto const* segment = this->segment()) {
+			if (localFileSize_ >= segment->end()) {
+				log(logmsg::debug_info, L"Segment has already been downloaded completely.");
+				return FZ_REPLY_OK;
+			}
+			rr_.request_.headers_["Range"] = fz::sprintf("bytes=%d-%d", localFileSize_, segment->end() - 1);
+		}
+		else if (resume_ && localFileSize_ != 0 && localFileSize_ != fz::aio_base::nosize) {
 			rr_.request_.headers_["Range"] = fz::sprintf("bytes=%d-", localFileSize_);
 		}
 
@@ -91,7 +135,12 @@ fz::http::continuation CHttpFileTransferOpData::OnHeader(std::shared_ptr<HttpReq
 {
 	log(logmsg::debug_verbose, L"CHttpFileTransferOpData::OnHeader");
 
-	if (rr_.response_.code_ == 416 && resume_) {
+	if (segment() && rr_.response_.code_ >= 200 && rr_.response_.code_ < 300 && rr_.response_.code_ != 206) {
+		log(logmsg::error, _("Server does not support range requests, cannot download segment."));
+		return fz::http::continuation::error;
+	}
+
+	if (rr_.response_.code_ == 416 && resume_ && !segment()) {
 		resume_ = false;
 		opState = filetransfer_transfer;
 		return fz::http::continuation::error;
@@ -147,6 +196,10 @@ fz::http::continuation CHttpFileTransferOpData::OnHeader(std::shared_ptr<HttpReq
 		resume_ = false;
 	}
 
+	if (rr_.response_.code_ == 206 && !CheckContentRange()) {
+		return fz::http::continuation::error;
+	}
+
 	if (writer_factory_) {
 		auto writer = controlSocket_.OpenWriter(writer_factory_, resume_ ? localFileSize_ : 0, true);
 		if (!writer) {
@@ -162,6 +215,10 @@ fz::http::continuation CHttpFileTransferOpData::OnHeader(std::shared_ptr<HttpReq
 		}
 	}
 
+	if (auto const* segment = this->segment()) {
+		totalSize = static_cast<int64_t>(segment->end());
+	}
+
 	if (engine_.transfer_status_.empty()) {
 		engine_.transfer_status_.Init(totalSize, resume_ ? localFileSize_ : 0, false);
 		engine_.transfer_status_.SetStartTime();
@@ -170,6 +227,49 @@ fz::http::continuation CHttpFileTransferOpData::OnHeader(std::shared_ptr<HttpReq
 	return fz::http::continuation::next;
 }
 
+bool CHttpFileTransferOpData::CheckContentRange()
+{
+	auto const* segment = this->segment();
+	if (!segment && !resume_) {
+		log(logmsg::error, _("Server sent a partial file, but the whole file was requested."));
+		return false;
+	}
+
+	std::string const header = rr_.response_.get_header("Content-Range");
+	int64_t first, last, complete;
+	if (!parse_content_range(header, first, last, complete)) {
+		log(logmsg::error, _("Server sent an invalid or unsupported Content-Range: %s"), header);
+		return false;
+	}
+
+	// The writer has been opened at localFileSize_, anything else would
+	// end up at the wrong position in the file.
+	bool match = static_cast<uint64_t>(first) == localFileSize_;
+	if (segment) {
+		match = match && last == static_cast<int64_t>(segment->end()) - 1 &&
+			(complete == -1 || complete == static_cast<int64_t>(segment->file_size()));
+
+		// Only with a known length the body cannot run past the end of
+		// the segment into the data of the next one.
+		int64_t const length = fz::to_integral<int64_t>(rr_.response_.get_header("Content-Length"), -1);
+		if (match && length != last - first + 1) {
+			log(logmsg::error, _("Server did not send the length of the requested range, cannot download segment."));
+			return false;
+		}
+	}
+	else {
+		match = match && (complete == -1 || last == complete - 1) &&
+			(remoteFileSize_ == -1 || complete == -1 || complete == remoteFileSize_);
+	}
+
+	if (!match) {
+		log(logmsg::error, _("Server sent a different range than requested: %s"), header);
+		return false;
+	}
+
+	return true;
+}
+
 int CHttpFileTransferOpData::SubcommandResult(int prevResult, COpData const&)
 {
 	if (opState == filetransfer_transfer) {
@@ -20,6 +20,9 @@ public:
 private:
 	fz::http::continuation OnHeader(std::shared_ptr<HttpRequestResponse> const&);
 
+	// Checks that a 206 reply carries exactly the requested range
+	bool CheckContentRange();
+
 	HttpRequestResponse rr_;
 
 	int redirectCount_{};
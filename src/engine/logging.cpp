@@ -4,30 +4,436 @@
 
 #include "../include/engine_options.h"
 
+#include <libfilezilla/thread_pool.hpp>
 #include <libfilezilla/util.hpp>
 
+#include <vector>
+
 #include <errno.h>
 
 #ifndef FZ_WINDOWS
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #endif
 
 bool CLogging::m_logfile_initialized = false;
-#ifdef FZ_WINDOWS
-HANDLE CLogging::m_log_fd = INVALID_HANDLE_VALUE;
-#else
-int CLogging::m_log_fd = -1;
-#endif
+std::unique_ptr<log_file_writer> CLogging::writer_;
 std::string CLogging::m_prefixes[sizeof(logmsg::type) * 8];
 unsigned int CLogging::m_pid;
-int CLogging::m_max_size;
-fz::native_string CLogging::m_file;
 
 int CLogging::m_refcount = 0;
 fz::mutex CLogging::mutex_(false);
 
+namespace {
+#ifdef FZ_WINDOWS
+using error_type = DWORD;
+#else
+using error_type = int;
+#endif
+
+// If the writer cannot keep up, lines get dropped beyond this
+// amount of pending data. Logging must never hold up transfers.
+size_t constexpr max_pending_size = 4 * 1024 * 1024;
+
+#ifndef FZ_WINDOWS
+int constexpr max_iov = 64;
+#endif
+}
+
+// Writes the log file on a worker thread, shared by all engines.
+//
+// Engines only format and queue the lines, the worker collects all
+// pending lines and writes them with a single call. Rotating the file
+// once it exceeds the size limit also happens on the worker.
+//
+// As the worker cannot log to an engine, failures are recorded and
+// picked up by the next engine logging a message.
+class log_file_writer final
+{
+public:
+	enum class failure {
+		none,
+		open,
+		write,
+		mutex
+	};
+
+	log_file_writer(fz::native_string const& file, int64_t max_size);
+	~log_file_writer();
+
+	log_file_writer(log_file_writer const&) = delete;
+	log_file_writer& operator=(log_file_writer const&) = delete;
+
+	// Opens the file and starts the worker. Returns 0 on success, otherwise an error code.
+	error_type open(fz::thread_pool & pool);
+
+	// Queues the line. If too much data is pending, the line gets dropped. Once lines
+	// are accepted again, the notice returned by make_notice(dropped) is written first.
+	template<typename Notice>
+	void add(std::string && line, Notice const& make_notice)
+	{
+		fz::scoped_lock l(mutex_);
+		if (failed_) {
+			return;
+		}
+
+		if (pending_size_ + line.size() > max_pending_size) {
+			++dropped_;
+			return;
+		}
+
+		bool const signal = pending_.empty();
+		if (dropped_) {
+			pending_.emplace_back(make_notice(dropped_));
+			pending_size_ += pending_.back().size();
+			dropped_ = 0;
+		}
+
+		pending_size_ += line.size();
+		pending_.emplace_back(std::move(line));
+		if (signal) {
+			cond_.signal(l);
+		}
+	}
+
+	// Returns each failure only once
+	failure get_failure(error_type & error);
+
+private:
+	void entry();
+	void write(std::vector<std::string> const& lines);
+	bool rotate();
+	void fail(failure f, error_type error);
+
+	fz::native_string const file_;
+	int64_t const max_size_;
+
+#ifdef FZ_WINDOWS
+	HANDLE fd_{INVALID_HANDLE_VALUE};
+#else
+	int fd_{-1};
+#endif
+
+	fz::mutex mutex_{false};
+	fz::condition cond_;
+	std::vector<std::string> pending_;
+	size_t pending_size_{};
+	size_t dropped_{};
+	bool quit_{};
+	bool failed_{};
+	failure failure_{};
+	error_type error_{};
+
+	fz::async_task thread_;
+};
+
+log_file_writer::log_file_writer(fz::native_string const& file, int64_t max_size)
+	: file_(file)
+	, max_size_(max_size)
+{
+}
+
+log_file_writer::~log_file_writer()
+{
+	{
+		fz::scoped_lock l(mutex_);
+		quit_ = true;
+		cond_.signal(l);
+	}
+	// Worker writes what is still pending before exiting
+	thread_.join();
+
+#ifdef FZ_WINDOWS
+	if (fd_ != INVALID_HANDLE_VALUE) {
+		CloseHandle(fd_);
+	}
+#else
+	if (fd_ != -1) {
+		close(fd_);
+	}
+#endif
+}
+
+error_type log_file_writer::open(fz::thread_pool & pool)
+{
+#ifdef FZ_WINDOWS
+	fd_ = CreateFile(file_.c_str(), FILE_APPEND_DATA, FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fd_ == INVALID_HANDLE_VALUE) {
+		return GetLastError();
+	}
+#else
+	fd_ = ::open(file_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (fd_ == -1) {
+		return errno;
+	}
+#endif
+
+	thread_ = pool.spawn([this]() { entry(); });
+	if (!thread_) {
+#ifdef FZ_WINDOWS
+		return ERROR_NOT_ENOUGH_MEMORY;
+#else
+		return ENOMEM;
+#endif
+	}
+
+	return 0;
+}
+
+log_file_writer::failure log_file_writer::get_failure(error_type & error)
+{
+	fz::scoped_lock l(mutex_);
+	failure const ret = failure_;
+	error = error_;
+	failure_ = failure::none;
+	return ret;
+}
+
+void log_file_writer::fail(failure f, error_type error)
+{
+	fz::scoped_lock l(mutex_);
+	failed_ = true;
+	failure_ = f;
+	error_ = error;
+	pending_.clear();
+	pending_size_ = 0;
+}
+
+void log_file_writer::entry()
+{
+	std::vector<std::string> lines;
+
+	fz::scoped_lock l(mutex_);
+	while (true) {
+		while (!quit_ && pending_.empty()) {
+			cond_.wait(l);
+		}
+		if (pending_.empty()) {
+			break;
+		}
+
+		lines.swap(pending_);
+		pending_size_ = 0;
+
+		l.unlock();
+		if (rotate()) {
+			write(lines);
+		}
+		lines.clear();
+		l.lock();
+	}
+}
+
+#ifdef FZ_WINDOWS
+bool log_file_writer::rotate()
+{
+	if (fd_ == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	if (!max_size_) {
+		return true;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(fd_, &size) && size.QuadPart <= max_size_) {
+		return true;
+	}
+
+	CloseHandle(fd_);
+	fd_ = INVALID_HANDLE_VALUE;
+
+	// fd_ might no longer be the original file.
+	// Recheck on a new handle. Proteced with a mutex against other processes
+	HANDLE hMutex = ::CreateMutexW(nullptr, true, L"FileZilla 3 Logrotate Mutex");
+	if (!hMutex) {
+		fail(failure::mutex, GetLastError());
+		return false;
+	}
+
+	HANDLE hFile = CreateFileW(file_.c_str(), FILE_APPEND_DATA, FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		DWORD err = GetLastError();
+
+		// Oh dear..
+		ReleaseMutex(hMutex);
+		CloseHandle(hMutex);
+
+		fail(failure::open, err);
+		return false;
+	}
+
+	DWORD err{};
+	if (GetFileSizeEx(hFile, &size) && size.QuadPart > max_size_) {
+		CloseHandle(hFile);
+
+		// MoveFileEx can fail if trying to access a deleted file for which another process still has
+		// a handle. Move it far away first.
+		// Todo: Handle the case in which logdir and tmpdir are on different volumes.
+		// (Why is everthing so needlessly complex on MSW?)
+
+		wchar_t tempDir[MAX_PATH + 1];
+		DWORD res = GetTempPath(MAX_PATH, tempDir);
+		if (res && res <= MAX_PATH) {
+			tempDir[MAX_PATH] = 0;
+
+			wchar_t tempFile[MAX_PATH + 1];
+			res = GetTempFileNameW(tempDir, L"fz3", 0, tempFile);
+			if (res) {
+				tempFile[MAX_PATH] = 0;
+				MoveFileExW((file_ + L".1").c_str(), tempFile, MOVEFILE_REPLACE_EXISTING);
+				DeleteFileW(tempFile);
+			}
+		}
+		MoveFileExW(file_.c_str(), (file_ + L".1").c_str(), MOVEFILE_REPLACE_EXISTING);
+		fd_ = CreateFileW(file_.c_str(), FILE_APPEND_DATA, FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fd_ == INVALID_HANDLE_VALUE) {
+			// If this function would return bool, I'd return FILE_NOT_FOUND here.
+			err = GetLastError();
+		}
+	}
+	else {
+		fd_ = hFile;
+	}
+
+	ReleaseMutex(hMutex);
+	CloseHandle(hMutex);
+
+	if (err) {
+		fail(failure::open, err);
+		return false;
+	}
+
+	return true;
+}
+
+void log_file_writer::write(std::vector<std::string> const& lines)
+{
+	std::string out;
+	for (auto const& line : lines) {
+		out += line;
+	}
+
+	DWORD len = static_cast<DWORD>(out.size());
+	DWORD written;
+	BOOL res = WriteFile(fd_, out.c_str(), len, &written, nullptr);
+	if (!res || written != len) {
+		DWORD err = GetLastError();
+		CloseHandle(fd_);
+		fd_ = INVALID_HANDLE_VALUE;
+		fail(failure::write, err);
+	}
+}
+#else
+bool log_file_writer::rotate()
+{
+	if (fd_ == -1) {
+		return false;
+	}
+
+	if (!max_size_) {
+		return true;
+	}
+
+	struct stat buf;
+	int rc = fstat(fd_, &buf);
+	while (!rc && buf.st_size > max_size_) {
+		struct flock lock = {};
+		lock.l_type = F_WRLCK;
+		lock.l_whence = SEEK_SET;
+		lock.l_start = 0;
+		lock.l_len = 1;
+
+		// Retry through signals
+		while ((rc = fcntl(fd_, F_SETLKW, &lock)) == -1 && errno == EINTR);
+
+		// Ignore any other failures
+		int fd = ::open(file_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+		if (fd == -1) {
+			int err = errno;
+
+			close(fd_);
+			fd_ = -1;
+
+			fail(failure::open, err);
+			return false;
+		}
+		struct stat buf2;
+		rc = fstat(fd, &buf2);
+
+		// Different files
+		if (!rc && buf.st_ino != buf2.st_ino) {
+			close(fd_); // Releases the lock
+			fd_ = fd;
+			buf = buf2;
+			continue;
+		}
+
+		// The file is indeed the log file and we are holding a lock on it.
+
+		// Rename it
+		rc = rename(file_.c_str(), (file_ + ".1").c_str());
+		close(fd_);
+		close(fd);
+
+		// Get the new file
+		fd_ = ::open(file_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+		if (fd_ == -1) {
+			fail(failure::open, errno);
+			return false;
+		}
+
+		if (!rc) {
+			// Rename didn't fail
+			rc = fstat(fd_, &buf);
+		}
+	}
+
+	return true;
+}
+
+void log_file_writer::write(std::vector<std::string> const& lines)
+{
+	size_t line{};
+	size_t offset{};
+	while (line < lines.size()) {
+		iovec iov[max_iov];
+		int count{};
+		for (size_t i = line; i < lines.size() && count < max_iov; ++i, ++count) {
+			size_t const skip = (i == line) ? offset : 0;
+			iov[count].iov_base = const_cast<char*>(lines[i].data() + skip);
+			iov[count].iov_len = lines[i].size() - skip;
+		}
+
+		ssize_t written = writev(fd_, iov, count);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			int err = written ? errno : EIO;
+			close(fd_);
+			fd_ = -1;
+			fail(failure::write, err);
+			return;
+		}
+
+		// Skip past what got written, writes to regular files are rarely short
+		size_t left = static_cast<size_t>(written);
+		while (left) {
+			size_t const remaining = lines[line].size() - offset;
+			if (left < remaining) {
+				offset += left;
+				break;
+			}
+			left -= remaining;
+			offset = 0;
+			++line;
+		}
+	}
+}
+#endif
 
 class CLoggingOptionsChanged final : public fz::event_handler
 {
@@ -75,17 +481,8 @@ CLogging::~CLogging()
 	--m_refcount;
 
 	if (!m_refcount) {
-#ifdef FZ_WINDOWS
-		if (m_log_fd != INVALID_HANDLE_VALUE) {
-			CloseHandle(m_log_fd);
-			m_log_fd = INVALID_HANDLE_VALUE;
-		}
-#else
-		if (m_log_fd != -1) {
-			close(m_log_fd);
-			m_log_fd = -1;
-		}
-#endif
+		// Flushes all pending lines
+		writer_.reset();
 		m_logfile_initialized = false;
 	}
 }
@@ -98,24 +495,29 @@ bool CLogging::InitLogFile(fz::scoped_lock& l)
 
 	m_logfile_initialized = true;
 
-	m_file = fz::to_native(engine_.GetOptions().get_string(OPTION_LOGGING_FILE));
-	if (m_file.empty()) {
+	fz::native_string const file = fz::to_native(engine_.GetOptions().get_string(OPTION_LOGGING_FILE));
+	if (file.empty()) {
 		return false;
 	}
 
-#ifdef FZ_WINDOWS
-	m_log_fd = CreateFile(m_file.c_str(), FILE_APPEND_DATA, FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-	if (m_log_fd == INVALID_HANDLE_VALUE) {
-		DWORD err = GetLastError();
-#else
-	m_log_fd = open(m_file.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
-	if (m_log_fd == -1) {
-		int err = errno;
-#endif
+	int64_t max_size = engine_.GetOptions().get_int(OPTION_LOGGING_FILE_SIZELIMIT);
+	if (max_size < 0) {
+		max_size = 0;
+	}
+	else if (max_size > 2000) {
+		max_size = 2000;
+	}
+	max_size *= 1024 * 1024;
+
+	auto writer = std::make_unique<log_file_writer>(file, max_size);
+	auto const err = writer->open(engine_.GetThreadPool());
+	if (err) {
+		writer.reset();
 		l.unlock(); //Avoid recursion
 		log(logmsg::error, _("Could not open log file: %s"), GetSystemErrorDescription(err));
 		return false;
 	}
+	writer_ = std::move(writer);
 
 	m_prefixes[fz::bitscan_reverse(logmsg::status)] = fz::to_utf8(_("Status:"));
 	m_prefixes[fz::bitscan_reverse(logmsg::error)] = fz::to_utf8(_("Error:"));
@@ -133,15 +535,6 @@ bool CLogging::InitLogFile(fz::scoped_lock& l)
 	m_pid = static_cast<unsigned int>(getpid());
 #endif
 
-	m_max_size = engine_.GetOptions().get_int(OPTION_LOGGING_FILE_SIZELIMIT);
-	if (m_max_size < 0) {
-		m_max_size = 0;
-	}
-	else if (m_max_size > 2000) {
-		m_max_size = 2000;
-	}
-	m_max_size *= 1024 * 1024;
-
 	return true;
 }
 
@@ -154,17 +547,11 @@ void CLogging::LogToFile(logmsg::type nMessageType, std::wstring const& msg, fz:
 			return;
 		}
 	}
-#ifdef FZ_WINDOWS
-	if (m_log_fd == INVALID_HANDLE_VALUE) {
+	if (!writer_) {
 		return;
 	}
-#else
-	if (m_log_fd == -1) {
-		return;
-	}
-#endif
 
-	std::string const out = fz::sprintf("%s %u %u %s %s"
+	std::string out = fz::sprintf("%s %u %u %s %s"
 #ifdef FZ_WINDOWS
 		"\r\n",
 #else
@@ -172,160 +559,33 @@ void CLogging::LogToFile(logmsg::type nMessageType, std::wstring const& msg, fz:
 #endif
 		now.format("%Y-%m-%d %H:%M:%S", fz::datetime::local), m_pid, engine_.GetEngineId(), m_prefixes[fz::bitscan_reverse(nMessageType)], fz::to_utf8(msg));
 
+	writer_->add(std::move(out), [&](size_t dropped) {
+		return fz::sprintf("%s %u %u %s %s"
 #ifdef FZ_WINDOWS
-	if (m_max_size) {
-		LARGE_INTEGER size;
-		if (!GetFileSizeEx(m_log_fd, &size) || size.QuadPart > m_max_size) {
-			CloseHandle(m_log_fd);
-			m_log_fd = INVALID_HANDLE_VALUE;
-
-			// m_log_fd might no longer be the original file.
-			// Recheck on a new handle. Proteced with a mutex against other processes
-			HANDLE hMutex = ::CreateMutexW(nullptr, true, L"FileZilla 3 Logrotate Mutex");
-			if (!hMutex) {
-				DWORD err = GetLastError();
-				l.unlock();
-				log(logmsg::error, _("Could not create logging mutex: %s"), GetSystemErrorDescription(err));
-				return;
-			}
-
-			HANDLE hFile = CreateFileW(m_file.c_str(), FILE_APPEND_DATA, FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-			if (hFile == INVALID_HANDLE_VALUE) {
-				DWORD err = GetLastError();
-
-				// Oh dear..
-				ReleaseMutex(hMutex);
-				CloseHandle(hMutex);
-
-				l.unlock(); // Avoid recursion
-				log(logmsg::error, _("Could not open log file: %s"), GetSystemErrorDescription(err));
-				return;
-			}
-
-			DWORD err{};
-			if (GetFileSizeEx(hFile, &size) && size.QuadPart > m_max_size) {
-				CloseHandle(hFile);
-
-				// MoveFileEx can fail if trying to access a deleted file for which another process still has
-				// a handle. Move it far away first.
-				// Todo: Handle the case in which logdir and tmpdir are on different volumes.
-				// (Why is everthing so needlessly complex on MSW?)
-
-				wchar_t tempDir[MAX_PATH + 1];
-				DWORD res = GetTempPath(MAX_PATH, tempDir);
-				if (res && res <= MAX_PATH) {
-					tempDir[MAX_PATH] = 0;
-
-					wchar_t tempFile[MAX_PATH + 1];
-					res = GetTempFileNameW(tempDir, L"fz3", 0, tempFile);
-					if (res) {
-						tempFile[MAX_PATH] = 0;
-						MoveFileExW((m_file + L".1").c_str(), tempFile, MOVEFILE_REPLACE_EXISTING);
-						DeleteFileW(tempFile);
-					}
-				}
-				MoveFileExW(m_file.c_str(), (m_file + L".1").c_str(), MOVEFILE_REPLACE_EXISTING);
-				m_log_fd = CreateFileW(m_file.c_str(), FILE_APPEND_DATA, FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-				if (m_log_fd == INVALID_HANDLE_VALUE) {
-					// If this function would return bool, I'd return FILE_NOT_FOUND here.
-					err = GetLastError();
-				}
-			}
-			else {
-				m_log_fd = hFile;
-			}
-
-			if (hMutex) {
-				ReleaseMutex(hMutex);
-				CloseHandle(hMutex);
-			}
-
-			if (err) {
-				l.unlock(); // Avoid recursion
-				log(logmsg::error, _("Could not open log file: %s"), GetSystemErrorDescription(err));
-				return;
-			}
-		}
-	}
-	DWORD len = static_cast<DWORD>(out.size());
-	DWORD written;
-	BOOL res = WriteFile(m_log_fd, out.c_str(), len, &written, nullptr);
-	if (!res || written != len) {
-		DWORD err = GetLastError();
-		CloseHandle(m_log_fd);
-		m_log_fd = INVALID_HANDLE_VALUE;
-		l.unlock(); // Avoid recursion
-		log(logmsg::error, _("Could not write to log file: %s"), GetSystemErrorDescription(err));
-	}
+			"\r\n",
 #else
-	if (m_max_size) {
-		struct stat buf;
-		int rc = fstat(m_log_fd, &buf);
-		while (!rc && buf.st_size > m_max_size) {
-			struct flock lock = {};
-			lock.l_type = F_WRLCK;
-			lock.l_whence = SEEK_SET;
-			lock.l_start = 0;
-			lock.l_len = 1;
-
-			// Retry through signals
-			while ((rc = fcntl(m_log_fd, F_SETLKW, &lock)) == -1 && errno == EINTR);
-
-			// Ignore any other failures
-			int fd = open(m_file.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
-			if (fd == -1) {
-				int err = errno;
-
-				close(m_log_fd);
-				m_log_fd = -1;
-
-				l.unlock(); // Avoid recursion
-				log(logmsg::error, _("Could not open log file: %s"), GetSystemErrorDescription(err));
-				return;
-			}
-			struct stat buf2;
-			rc = fstat(fd, &buf2);
-
-			// Different files
-			if (!rc && buf.st_ino != buf2.st_ino) {
-				close(m_log_fd); // Releases the lock
-				m_log_fd = fd;
-				buf = buf2;
-				continue;
-			}
-
-			// The file is indeed the log file and we are holding a lock on it.
-
-			// Rename it
-			rc = rename(m_file.c_str(), (m_file + ".1").c_str());
-			close(m_log_fd);
-			close(fd);
-
-			// Get the new file
-			m_log_fd = open(m_file.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
-			if (m_log_fd == -1) {
-				int err = errno;
-				l.unlock(); // Avoid recursion
-				log(logmsg::error, _("Could not open log file: %s"), GetSystemErrorDescription(err));
-				return;
-			}
-
-			if (!rc) {
-				// Rename didn't fail
-				rc = fstat(m_log_fd, &buf);
-			}
-		}
-	}
-	size_t written = write(m_log_fd, out.c_str(), out.size());
-	if (written != out.size()) {
-		int err = errno;
-		close(m_log_fd);
-		m_log_fd = -1;
+			"\n",
+#endif
+			now.format("%Y-%m-%d %H:%M:%S", fz::datetime::local), m_pid, engine_.GetEngineId(), m_prefixes[fz::bitscan_reverse(logmsg::error)],
+			fz::to_utf8(fz::sprintf(fztranslate("%d message could not be written to the log file in time and got dropped.", "%d messages could not be written to the log file in time and got dropped.", dropped), dropped)));
+	});
 
+	error_type err{};
+	auto const failure = writer_->get_failure(err);
+	if (failure != log_file_writer::failure::none) {
 		l.unlock(); // Avoid recursion
-		log(logmsg::error, _("Could not write to log file: %s"), GetSystemErrorDescription(err));
+		switch (failure) {
+		case log_file_writer::failure::open:
+			log(logmsg::error, _("Could not open log file: %s"), GetSystemErrorDescription(err));
+			break;
+		case log_file_writer::failure::mutex:
+			log(logmsg::error, _("Could not create logging mutex: %s"), GetSystemErrorDescription(err));
+			break;
+		default:
+			log(logmsg::error, _("Could not write to log file: %s"), GetSystemErrorDescription(err));
+			break;
+		}
 	}
-#endif
 }
 
 void CLogging::UpdateLogLevel(COptionsBase & options)
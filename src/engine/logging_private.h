@@ -7,6 +7,7 @@
 #include <utility>
 
 class CLoggingOptionsChanged;
+class log_file_writer;
 
 class CLogging : public fz::logger_interface
 {
@@ -32,15 +33,9 @@ private:
 	void LogToFile(logmsg::type nMessageType, std::wstring const& msg, fz::datetime const& now);
 
 	static bool m_logfile_initialized;
-#ifdef FZ_WINDOWS
-	static HANDLE m_log_fd;
-#else
-	static int m_log_fd;
-#endif
+	static std::unique_ptr<log_file_writer> writer_;
 	static std::string m_prefixes[sizeof(logmsg::type) * 8];
 	static unsigned int m_pid;
-	static int m_max_size;
-	static fz::native_string m_file;
 
 	static int m_refcount;
 
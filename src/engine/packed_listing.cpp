@@ -0,0 +1,238 @@
+#include "filezilla.h"
+#include "packed_listing.h"
+
+#include <limits>
+
+#include <string.h>
+
+namespace {
+uint8_t constexpr no_time = 0xff;
+uint32_t constexpr no_target = std::numeric_limits<uint32_t>::max();
+
+uint32_t constexpr serialization_version = 1;
+
+void write_u32(std::string & out, uint32_t v)
+{
+	out.append(reinterpret_cast<char const*>(&v), sizeof(v));
+}
+
+bool read_u32(unsigned char const*& p, unsigned char const* end, uint32_t & v)
+{
+	if (static_cast<size_t>(end - p) < sizeof(v)) {
+		return false;
+	}
+	memcpy(&v, p, sizeof(v));
+	p += sizeof(v);
+	return true;
+}
+
+void write_string(std::string & out, std::wstring const& s)
+{
+	std::string const utf8 = fz::to_utf8(s);
+	write_u32(out, static_cast<uint32_t>(utf8.size()));
+	out += utf8;
+}
+
+bool read_string(unsigned char const*& p, unsigned char const* end, fz::shared_value<std::wstring> & s)
+{
+	uint32_t len;
+	if (!read_u32(p, end, len) || static_cast<size_t>(end - p) < len) {
+		return false;
+	}
+	s = fz::shared_value<std::wstring>(fz::to_wstring_from_utf8(reinterpret_cast<char const*>(p), len));
+	p += len;
+	return true;
+}
+}
+
+bool CPackedDirectoryListing::AddString(std::wstring const& s, uint32_t & offset, uint32_t & length)
+{
+	std::string const utf8 = fz::to_utf8(s);
+	if (utf8.empty() && !s.empty()) {
+		return false;
+	}
+	if (strings_.size() + utf8.size() >= std::numeric_limits<uint32_t>::max()) {
+		return false;
+	}
+
+	offset = static_cast<uint32_t>(strings_.size());
+	length = static_cast<uint32_t>(utf8.size());
+	strings_ += utf8;
+
+	return true;
+}
+
+uint32_t CPackedDirectoryListing::Intern(std::vector<fz::shared_value<std::wstring>> & table, fz::shared_value<std::wstring> const& v)
+{
+	// The parser already interns these values, so there are only few
+	// distinct instances and comparing the pointers is sufficient
+	// most of the time.
+	for (size_t i = 0; i < table.size(); ++i) {
+		if (&*table[i] == &*v || *table[i] == *v) {
+			return static_cast<uint32_t>(i);
+		}
+	}
+	table.push_back(v);
+	return static_cast<uint32_t>(table.size() - 1);
+}
+
+bool CPackedDirectoryListing::Pack(CDirectoryListing const& listing)
+{
+	strings_.clear();
+	entries_.clear();
+	permissions_.clear();
+	ownerGroups_.clear();
+
+	size_t const count = listing.size();
+	entries_.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		CDirentry const& in = listing[i];
+
+		entry out{};
+		out.size = in.size;
+		out.flags = static_cast<uint8_t>(in.flags);
+		if (!AddString(in.name, out.name_offset, out.name_length)) {
+			return false;
+		}
+		if (in.target) {
+			if (!AddString(*in.target, out.target_offset, out.target_length)) {
+				return false;
+			}
+		}
+		else {
+			out.target_offset = no_target;
+		}
+
+		if (in.time.empty()) {
+			out.accuracy = no_time;
+		}
+		else {
+			out.time = static_cast<int64_t>(in.time.get_time_t());
+			out.milliseconds = static_cast<uint16_t>(in.time.get_milliseconds());
+			out.accuracy = static_cast<uint8_t>(in.time.get_accuracy());
+		}
+
+		out.permissions = Intern(permissions_, in.permissions);
+		out.ownerGroup = Intern(ownerGroups_, in.ownerGroup);
+
+		entries_.push_back(out);
+	}
+
+	strings_.shrink_to_fit();
+	return true;
+}
+
+void CPackedDirectoryListing::Unpack(CDirectoryListing & listing) const
+{
+	std::vector<fz::shared_value<CDirentry>> entries;
+	entries.reserve(entries_.size());
+
+	for (auto const& in : entries_) {
+		fz::shared_value<CDirentry> ref;
+		CDirentry & out = ref.get();
+
+		out.name = fz::to_wstring_from_utf8(strings_.data() + in.name_offset, in.name_length);
+		out.size = in.size;
+		out.flags = in.flags;
+		if (in.target_offset != no_target) {
+			out.target = fz::sparse_optional<std::wstring>(fz::to_wstring_from_utf8(strings_.data() + in.target_offset, in.target_length));
+		}
+		if (in.accuracy != no_time) {
+			out.time = fz::datetime(static_cast<time_t>(in.time), static_cast<fz::datetime::accuracy>(in.accuracy));
+			if (in.milliseconds) {
+				out.time += fz::duration::from_milliseconds(in.milliseconds);
+			}
+		}
+		out.permissions = permissions_[in.permissions];
+		out.ownerGroup = ownerGroups_[in.ownerGroup];
+
+		entries.emplace_back(std::move(ref));
+	}
+
+	int const flags = listing.m_flags;
+	listing.Assign(std::move(entries));
+	listing.m_flags = flags;
+}
+
+size_t CPackedDirectoryListing::memory_usage() const
+{
+	return sizeof(*this) + strings_.capacity() + entries_.capacity() * sizeof(entry) +
+		(permissions_.capacity() + ownerGroups_.capacity()) * sizeof(fz::shared_value<std::wstring>);
+}
+
+void CPackedDirectoryListing::Serialize(std::string & out) const
+{
+	write_u32(out, serialization_version);
+	write_u32(out, static_cast<uint32_t>(sizeof(entry)));
+
+	write_u32(out, static_cast<uint32_t>(permissions_.size()));
+	for (auto const& v : permissions_) {
+		write_string(out, *v);
+	}
+	write_u32(out, static_cast<uint32_t>(ownerGroups_.size()));
+	for (auto const& v : ownerGroups_) {
+		write_string(out, *v);
+	}
+
+	write_u32(out, static_cast<uint32_t>(strings_.size()));
+	out += strings_;
+
+	write_u32(out, static_cast<uint32_t>(entries_.size()));
+	out.append(reinterpret_cast<char const*>(entries_.data()), entries_.size() * sizeof(entry));
+}
+
+bool CPackedDirectoryListing::Deserialize(unsigned char const* p, size_t len)
+{
+	strings_.clear();
+	entries_.clear();
+	permissions_.clear();
+	ownerGroups_.clear();
+
+	unsigned char const* const end = p + len;
+
+	uint32_t v;
+	if (!read_u32(p, end, v) || v != serialization_version) {
+		return false;
+	}
+	if (!read_u32(p, end, v) || v != sizeof(entry)) {
+		return false;
+	}
+
+	for (auto * table : { &permissions_, &ownerGroups_ }) {
+		if (!read_u32(p, end, v) || v > static_cast<size_t>(end - p) / sizeof(uint32_t)) {
+			return false;
+		}
+		table->resize(v);
+		for (auto & s : *table) {
+			if (!read_string(p, end, s)) {
+				return false;
+			}
+		}
+	}
+
+	if (!read_u32(p, end, v) || static_cast<size_t>(end - p) < v) {
+		return false;
+	}
+	strings_.assign(reinterpret_cast<char const*>(p), v);
+	p += v;
+
+	if (!read_u32(p, end, v) || static_cast<size_t>(end - p) != static_cast<size_t>(v) * sizeof(entry)) {
+		return false;
+	}
+	entries_.resize(v);
+	memcpy(entries_.data(), p, static_cast<size_t>(v) * sizeof(entry));
+
+	// Don't trust the offsets
+	for (auto const& e : entries_) {
+		if (static_cast<uint64_t>(e.name_offset) + e.name_length > strings_.size() ||
+			(e.target_offset != no_target && static_cast<uint64_t>(e.target_offset) + e.target_length > strings_.size()) ||
+			e.permissions >= permissions_.size() || e.ownerGroup >= ownerGroups_.size() ||
+			(e.accuracy != no_time && (e.accuracy > fz::datetime::milliseconds || e.milliseconds > 999)))
+		{
+			entries_.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,65 @@
+#ifndef FILEZILLA_ENGINE_PACKED_LISTING_HEADER
+#define FILEZILLA_ENGINE_PACKED_LISTING_HEADER
+
+#include "../include/directorylisting.h"
+
+#include <string>
+#include <vector>
+
+/*
+Compact representation of the entries of a directory listing, used by the
+directory cache for listings that haven't been accessed recently.
+
+Each CDirentry is a separately allocated object holding its own heap-allocated
+name. In the packed form, names and link targets are stored back to back in a
+single UTF-8 arena, permissions and owner/group strings are interned in
+per-listing tables and the remaining fields are kept in a fixed-size record.
+*/
+class CPackedDirectoryListing final
+{
+public:
+	CPackedDirectoryListing() = default;
+
+	// Fails if the listing contains names that cannot be represented losslessly.
+	bool Pack(CDirectoryListing const& listing);
+
+	// Restores the entries into the listing. Listing metadata such
+	// as path and flags is left alone.
+	void Unpack(CDirectoryListing & listing) const;
+
+	size_t size() const { return entries_.size(); }
+
+	// Approximate memory consumption in bytes
+	size_t memory_usage() const;
+
+	// Flat representation used by the persistent directory cache. Only
+	// meant to be read back by the same build on the same platform.
+	void Serialize(std::string & out) const;
+	bool Deserialize(unsigned char const* p, size_t len);
+
+private:
+	struct entry final
+	{
+		int64_t size;
+		int64_t time;
+		uint32_t name_offset;
+		uint32_t name_length;
+		uint32_t target_offset;
+		uint32_t target_length;
+		uint32_t permissions;
+		uint32_t ownerGroup;
+		uint16_t milliseconds;
+		uint8_t accuracy;
+		uint8_t flags;
+	};
+
+	bool AddString(std::wstring const& s, uint32_t & offset, uint32_t & length);
+	static uint32_t Intern(std::vector<fz::shared_value<std::wstring>> & table, fz::shared_value<std::wstring> const& v);
+
+	std::string strings_;
+	std::vector<entry> entries_;
+	std::vector<fz::shared_value<std::wstring>> permissions_;
+	std::vector<fz::shared_value<std::wstring>> ownerGroups_;
+};
+
+#endif
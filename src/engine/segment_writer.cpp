@@ -0,0 +1,55 @@
+#include "filezilla.h"
+
+#include "../include/segment_writer.h"
+
+#include <libfilezilla/file.hpp>
+
+#include <algorithm>
+
+segment_writer_factory::segment_writer_factory(std::wstring const& file, fz::thread_pool & pool, uint64_t file_size, uint64_t offset, uint64_t length, uint64_t done)
+	: fz::writer_factory(file)
+	, thread_pool_(pool)
+	, file_size_(file_size)
+	, offset_(offset)
+	, length_(length)
+	, done_(std::make_shared<std::atomic<uint64_t>>(std::min(done, length)))
+{
+}
+
+std::unique_ptr<fz::writer_factory> segment_writer_factory::clone() const
+{
+	return std::unique_ptr<fz::writer_factory>(new segment_writer_factory(*this));
+}
+
+uint64_t segment_writer_factory::size() const
+{
+	return offset_ + *done_;
+}
+
+std::unique_ptr<fz::writer_base> segment_writer_factory::open(fz::aio_buffer_pool & pool, uint64_t offset, fz::writer_base::progress_cb_t progress_cb, size_t max_buffers)
+{
+	if (offset < offset_ || offset > end()) {
+		return nullptr;
+	}
+
+	// The other segments are written into the same file, it must
+	// neither be created nor truncated here.
+	fz::file f;
+	if (!f.open(fz::to_native(name()), fz::file::writing, fz::file::existing)) {
+		return nullptr;
+	}
+	if (f.seek(static_cast<int64_t>(offset), fz::file::begin) != static_cast<int64_t>(offset)) {
+		return nullptr;
+	}
+
+	*done_ = offset - offset_;
+
+	auto cb = [done = done_, progress_cb = std::move(progress_cb)](fz::writer_base const* w, uint64_t written) {
+		*done += written;
+		if (progress_cb) {
+			progress_cb(w, written);
+		}
+	};
+
+	return std::make_unique<fz::file_writer>(std::wstring(name()), pool, std::move(f), thread_pool_, false, std::move(cb), max_buffers);
+}
@@ -566,6 +566,8 @@ bool CServer::ProtocolHasFeature(ServerProtocol const protocol, ProtocolFeature
 	case ProtocolFeature::TransferMode:
 	case ProtocolFeature::EnterCommand:
 	case ProtocolFeature::PostLoginCommands:
+	case ProtocolFeature::DataCompression:
+	case ProtocolFeature::CommandPipelining:
 		if (protocol == FTP || protocol == FTPS || protocol == FTPES || protocol == INSECURE_FTP) {
 			return true;
 		}
@@ -914,6 +916,19 @@ std::vector<ParameterTraits> const& ExtraServerParameterTraits(ServerProtocol pr
 			static std::vector<ParameterTraits> const ret = []() {
 				std::vector<ParameterTraits> ret;
 				ret.emplace_back(ParameterTraits{"otp_code", ParameterSection::credentials, ParameterTraits::optional | ParameterTraits::custom, std::wstring(), std::wstring()});
+				ret.emplace_back(ParameterTraits{"mode_z", ParameterSection::extra, ParameterTraits::optional | ParameterTraits::custom | ParameterTraits::content_transparent, std::wstring(), std::wstring()});
+				ret.emplace_back(ParameterTraits{"pipelining", ParameterSection::extra, ParameterTraits::optional | ParameterTraits::custom | ParameterTraits::content_transparent, std::wstring(), std::wstring()});
+				return ret;
+			}();
+			return ret;
+		}
+	case FTPES:
+	case INSECURE_FTP:
+		{
+			static std::vector<ParameterTraits> const ret = []() {
+				std::vector<ParameterTraits> ret;
+				ret.emplace_back(ParameterTraits{"mode_z", ParameterSection::extra, ParameterTraits::optional | ParameterTraits::custom | ParameterTraits::content_transparent, std::wstring(), std::wstring()});
+				ret.emplace_back(ParameterTraits{"pipelining", ParameterSection::extra, ParameterTraits::optional | ParameterTraits::custom | ParameterTraits::content_transparent, std::wstring(), std::wstring()});
 				return ret;
 			}();
 			return ret;
@@ -30,10 +30,18 @@ enum capabilityNames
 	mdtm_command,
 	size_command,
 	mode_z_support,
+	pipelining_support, // set to 'no' once the server mishandled pipelined commands
 	tvfs_support, // Trivial virtual file store (RFC 3659)
 	list_hidden_support, // LIST -a command
+	stat_listing, // STAT sends directory listings over the control connection
 	rest_stream, // supports REST+STOR in addition to APPE
 	epsv_command,
+	hash_command, // Supported algorithms from the FEAT reply as option, the selected one marked with an asterisk
+	xcrc_command,
+	xmd5_command,
+	xsha1_command,
+	xsha256_command,
+	xsha512_command,
 
 	// Server timezone offset. If using FTP, LIST details are unspecified and
 	// can return different times than the UTC based times using the MLST or
@@ -29,9 +29,24 @@ int CSftpChmodOpData::Send()
 	return FZ_REPLY_INTERNALERROR;
 }
 
+void CSftpChmodOpData::OnFileResult(size_t index, bool success)
+{
+	if (index) {
+		log(logmsg::debug_warning, L"Result for unknown file %d", index);
+		return;
+	}
+	gotFileResult_ = true;
+	succeeded_ = success;
+}
+
 int CSftpChmodOpData::ParseResponse()
 {
-	return controlSocket_.result_;
+	if (gotFileResult_) {
+		return succeeded_ ? FZ_REPLY_OK : FZ_REPLY_ERROR;
+	}
+
+	// Mode rejected before the file was even looked at
+	return controlSocket_.result_ == FZ_REPLY_OK ? FZ_REPLY_ERROR : controlSocket_.result_;
 }
 
 int CSftpChmodOpData::SubcommandResult(int prevResult, COpData const&)
@@ -16,9 +16,14 @@ public:
 	virtual int ParseResponse() override;
 	virtual int SubcommandResult(int, COpData const&) override;
 
+	// The command names a single file, index is always 0
+	void OnFileResult(size_t index, bool success);
+
 private:
 	CChmodCommand command_;
 	bool useAbsolute_{};
+	bool gotFileResult_{};
+	bool succeeded_{};
 };
 
 #endif
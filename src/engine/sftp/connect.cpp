@@ -72,6 +72,9 @@ int CSftpConnectOpData::Send()
 			if (options_.get_int(OPTION_SFTP_COMPRESSION)) {
 				args.push_back(fzT("-C"));
 			}
+			args.push_back(fzT("-transferwindow"));
+			args.push_back(fz::sprintf(fzT("%d"), options_.get_int(OPTION_SFTP_WINDOW_MIN)));
+			args.push_back(fz::sprintf(fzT("%d"), options_.get_int(OPTION_SFTP_WINDOW_MAX)));
 
 			controlSocket_.process_ = std::make_unique<fz::process>(engine_.GetThreadPool(), controlSocket_);
 #ifndef FZ_WINDOWS
@@ -3,51 +3,85 @@
 #include "delete.h"
 #include "../directorycache.h"
 
+namespace {
+// Number of files removed by a single command. fzsftp keeps several
+// requests for them in flight.
+size_t const max_batch = 256;
+}
+
 int CSftpDeleteOpData::Send()
 {
-	std::wstring const& file = files_.back();
-	if (file.empty()) {
-		log(logmsg::debug_info, L"Empty filename");
-		return FZ_REPLY_INTERNALERROR;
+	if (time_.empty()) {
+		time_ = fz::datetime::now();
 	}
 
-	std::wstring filename = path_.FormatFilename(file);
-	if (filename.empty()) {
-		log(logmsg::error, _("Filename cannot be constructed for directory %s and filename %s"), path_.GetPath(), file);
-		return FZ_REPLY_ERROR;
-	}
+	std::wstring cmd = L"rm";
+	batch_.clear();
+	results_ = 0;
+	while (!files_.empty() && batch_.size() < max_batch) {
+		std::wstring file = std::move(files_.back());
+		files_.pop_back();
+		if (file.empty()) {
+			log(logmsg::debug_info, L"Empty filename");
+			return FZ_REPLY_INTERNALERROR;
+		}
 
-	if (time_.empty()) {
-		time_ = fz::datetime::now();
+		std::wstring filename = path_.FormatFilename(file);
+		if (filename.empty()) {
+			log(logmsg::error, _("Filename cannot be constructed for directory %s and filename %s"), path_.GetPath(), file);
+			deleteFailed_ = true;
+			continue;
+		}
+
+		engine_.GetDirectoryCache().InvalidateFile(currentServer_, path_, file);
+
+		cmd += L" " + controlSocket_.QuoteFilename(filename);
+		batch_.emplace_back(std::move(file));
 	}
 
-	engine_.GetDirectoryCache().InvalidateFile(currentServer_, path_, file);
+	if (batch_.empty()) {
+		return deleteFailed_ ? FZ_REPLY_ERROR : FZ_REPLY_OK;
+	}
 
-	return controlSocket_.SendCommand(L"rm " + controlSocket_.QuoteFilename(filename));
+	return controlSocket_.SendCommand(cmd);
 }
 
-int CSftpDeleteOpData::ParseResponse()
+void CSftpDeleteOpData::OnFileResult(size_t index, bool success)
 {
-	if (controlSocket_.result_ != FZ_REPLY_OK) {
+	if (index >= batch_.size()) {
+		log(logmsg::debug_warning, L"Result for unknown file %d", index);
+		return;
+	}
+	++results_;
+
+	if (!success) {
 		deleteFailed_ = true;
+		return;
 	}
-	else {
-		std::wstring const& file = files_.back();
 
-		engine_.GetDirectoryCache().RemoveFile(currentServer_, path_, file);
+	engine_.GetDirectoryCache().RemoveFile(currentServer_, path_, batch_[index]);
 
-		auto const now = fz::datetime::now();
-		if (!time_.empty() && (now - time_).get_seconds() >= 1) {
-			controlSocket_.SendDirectoryListingNotification(path_, false);
-			time_ = now;
-			needSendListing_ = false;
-		}
-		else {
-			needSendListing_ = true;
-		}
+	auto const now = fz::datetime::now();
+	if (!time_.empty() && (now - time_).get_seconds() >= 1) {
+		controlSocket_.SendDirectoryListingNotification(path_, false);
+		time_ = now;
+		needSendListing_ = false;
+	}
+	else {
+		needSendListing_ = true;
 	}
+}
 
-	files_.pop_back();
+int CSftpDeleteOpData::ParseResponse()
+{
+	if (results_ < batch_.size()) {
+		log(logmsg::debug_warning, L"Got results for only %d of %d files", results_, batch_.size());
+		deleteFailed_ = true;
+	}
+	else if (controlSocket_.result_ != FZ_REPLY_OK) {
+		deleteFailed_ = true;
+	}
+	batch_.clear();
 
 	if (!files_.empty()) {
 		return FZ_REPLY_CONTINUE;
@@ -16,9 +16,16 @@ public:
 	virtual int SubcommandResult(int prevResult, COpData const&) override;
 	virtual int Reset(int result) override;
 
+	// Result for the file at the given index of the current batch
+	void OnFileResult(size_t index, bool success);
+
 	CServerPath path_;
 	std::vector<std::wstring> files_;
 
+	// Files removed by the current command, in the order they got sent
+	std::vector<std::wstring> batch_;
+	size_t results_{};
+
 	// Set to fz::datetime::Now initially and after
 	// sending an updated listing to the UI.
 	fz::datetime time_;
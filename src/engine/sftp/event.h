@@ -5,7 +5,7 @@
 
 #include <string>
 
-#define FZSFTP_PROTOCOL_VERSION 11
+#define FZSFTP_PROTOCOL_VERSION 15
 
 enum class sftpEvent {
 	Unknown = -1,
@@ -39,6 +39,8 @@ enum class sftpEvent {
 	io_open,
 	io_nextbuf,
 	io_finalize,
+	TransferWindow,
+	FileResult,
 
 	count
 };
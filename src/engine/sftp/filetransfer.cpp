@@ -23,6 +23,7 @@ enum filetransferStates
 CSftpFileTransferOpData::~CSftpFileTransferOpData()
 {
 	remove_handler();
+	buffers_.clear();
 	reader_.reset();
 }
 
@@ -60,7 +61,8 @@ int CSftpFileTransferOpData::Send()
 			logstr = L"re";
 		}
 		if (download()) {
-			engine_.transfer_status_.Init(remoteFileSize_, resume_ ? localFileSize_ : 0, false);
+			auto const* segment = this->segment();
+			engine_.transfer_status_.Init(segment ? static_cast<int64_t>(segment->end()) : remoteFileSize_, resume_ ? localFileSize_ : 0, false);
 			cmd += "get ";
 			logstr += L"get ";
 			
@@ -75,6 +77,12 @@ int CSftpFileTransferOpData::Send()
 			std::wstring localFile = controlSocket_.QuoteFilename(localName_);
 			cmd += fz::to_utf8(localFile);
 			logstr += localFile;
+
+			if (segment) {
+				// Offset at which to stop reading
+				cmd += fz::sprintf(" %u", segment->end());
+				logstr += fz::sprintf(L" %u", segment->end());
+			}
 		}
 		else {
 			engine_.transfer_status_.Init(localFileSize_, resume_ ? remoteFileSize_ : 0, false);
@@ -131,7 +139,7 @@ int CSftpFileTransferOpData::ParseResponse()
 		writer_.reset();
 		if (controlSocket_.result_ == FZ_REPLY_OK && options_.get_int(OPTION_PRESERVE_TIMESTAMPS)) {
 			if (download()) {
-				if (!remoteFileTime_.empty()) {
+				if (!remoteFileTime_.empty() && !segment()) {
 					if (!writer_factory_->set_mtime(remoteFileTime_)) {
 						log(logmsg::debug_warning, L"Could not set modification time");
 					}
@@ -351,60 +359,111 @@ void CSftpFileTransferOpData::OnOpenRequested(uint64_t offset)
 	controlSocket_.AddToSendBuffer(fz::sprintf("-%d %u %u\n", std::get<0>(info), std::get<2>(info), offset));
 #endif
 	base_address_ = std::get<1>(info);
+
+	PushBuffers();
 }
 
 
 void CSftpFileTransferOpData::OnNextBufferRequested(uint64_t processed)
 {
-	if (reader_) {
-		fz::aio_result r;
-		std::tie(r, buffer_) = reader_->get_buffer(*this);
-		if (r == fz::aio_result::wait) {
-			return;
-		}
+	// fzsftp is done with the oldest buffer in flight
+	if (buffers_.empty()) {
+		log(logmsg::debug_warning, L"fzsftp requested next buffer without any buffer in flight");
+		return;
+	}
+	fz::buffer_lease buffer = std::move(buffers_.front());
+	buffers_.pop_front();
+
+	if (writer_ && !pushed_last_) {
+		buffer->resize(processed);
+		auto const r = writer_->add_buffer(std::move(buffer), *this);
 		if (r == fz::aio_result::error) {
-			controlSocket_.AddToSendBuffer("--1\n");
+			PushBufferLine("-");
 			return;
 		}
-		if (buffer_->size()) {
-			controlSocket_.AddToSendBuffer(fz::sprintf("-%d %d\n", buffer_->get() - base_address_, buffer_->size()));
-		}
-		else {
-			controlSocket_.AddToSendBuffer(fz::sprintf("-0\n"));
-		}
+		writer_waiting_ = r == fz::aio_result::wait;
 	}
-	else if (writer_) {
-		buffer_->resize(processed);
-		auto r = writer_->add_buffer(std::move(buffer_), *this);
-		if (r == fz::aio_result::ok) {
-			buffer_ = controlSocket_.buffer_pool_->get_buffer(*this);
-			if (!buffer_) {
-				r = fz::aio_result::wait;
+
+	PushBuffers();
+}
+
+void CSftpFileTransferOpData::PushBuffers()
+{
+	// Keep several buffers in flight, so that fzsftp finds the next buffer
+	// already waiting once it is done with the current one instead of
+	// having to wait for a full round trip. Leave the other half of the
+	// pool to the reader or writer.
+	size_t const max = std::max(size_t(1), controlSocket_.max_buffer_count() / 2);
+
+	while (!pushed_last_ && !finalizing_ && buffers_.size() < max) {
+		fz::buffer_lease buffer;
+		if (reader_) {
+			fz::aio_result r;
+			std::tie(r, buffer) = reader_->get_buffer(*this);
+			if (r == fz::aio_result::wait) {
+				return;
 			}
+			if (r == fz::aio_result::error) {
+				PushBufferLine("-");
+				return;
+			}
+			if (buffer->empty()) {
+				PushBufferLine("0 0");
+				return;
+			}
+			PushBufferLine(fz::sprintf("%d %d", buffer->get() - base_address_, buffer->size()));
 		}
-		if (r == fz::aio_result::wait) {
-			return;
+		else if (writer_) {
+			if (writer_waiting_) {
+				return;
+			}
+			buffer = controlSocket_.buffer_pool_->get_buffer(*this);
+			if (!buffer) {
+				return;
+			}
+			PushBufferLine(fz::sprintf("%d %d", buffer->get() - base_address_, buffer->capacity()));
 		}
-		if (r == fz::aio_result::error) {
-			controlSocket_.AddToSendBuffer("--1\n");
+		else {
 			return;
 		}
-		controlSocket_.AddToSendBuffer(fz::sprintf("-%d %d\n", buffer_->get() - base_address_, buffer_->capacity()));
+		buffers_.emplace_back(std::move(buffer));
 	}
-	else {
-		controlSocket_.AddToSendBuffer("--1\n");
-		return;
+}
+
+void CSftpFileTransferOpData::PushBufferLine(std::string const& line)
+{
+	if (line == "-" || line == "0 0") {
+		pushed_last_ = true;
 	}
+	controlSocket_.AddToSendBuffer(fz::sprintf("-@%u %s\n", controlSocket_.io_transfer_id_, line));
 }
 
 void CSftpFileTransferOpData::OnFinalizeRequested(uint64_t lastWrite)
 {
-	finalizing_ = true;
-	buffer_->resize(lastWrite);
-	auto r = writer_->add_buffer(std::move(buffer_), *this);
-	if (r == fz::aio_result::ok) {
-		r = writer_->finalize(*this);
+	if (!finalizing_) {
+		finalizing_ = true;
+
+		// The oldest buffer in flight is the one fzsftp has been writing to,
+		// the others are unused.
+		fz::buffer_lease buffer;
+		if (!buffers_.empty()) {
+			buffer = std::move(buffers_.front());
+			buffers_.clear();
+		}
+		if (buffer) {
+			buffer->resize(lastWrite);
+			auto r = writer_->add_buffer(std::move(buffer), *this);
+			if (r == fz::aio_result::error) {
+				controlSocket_.AddToSendBuffer(fz::sprintf("-0\n"));
+				return;
+			}
+			if (r == fz::aio_result::wait) {
+				return;
+			}
+		}
 	}
+
+	auto r = writer_->finalize(*this);
 	if (r == fz::aio_result::wait) {
 		return;
 	}
@@ -442,15 +501,12 @@ void CSftpFileTransferOpData::operator()(fz::event_base const& ev)
 
 void CSftpFileTransferOpData::OnBufferAvailability(fz::aio_waitable const* w)
 {
-	if (w == reader_.get()) {
-		OnNextBufferRequested(0);
-	}
-	else if (w == writer_.get()) {
+	if (w == writer_.get()) {
+		writer_waiting_ = false;
 		if (finalizing_) {
 			OnFinalizeRequested(0);
-		}
-		else {
-			OnNextBufferRequested(0);
+			return;
 		}
 	}
+	PushBuffers();
 }
@@ -3,6 +3,8 @@
 
 #include "sftpcontrolsocket.h"
 
+#include <deque>
+
 class CSftpFileTransferOpData final : public CFileTransferOpData, public CSftpOpData, public fz::event_handler
 {
 public:
@@ -27,12 +29,22 @@ private:
 	virtual void operator()(fz::event_base const& ev) override;
 	void OnBufferAvailability(fz::aio_waitable const* w);
 
+	// Hands buffers to fzsftp until the pipeline is full
+	void PushBuffers();
+	void PushBufferLine(std::string const& line);
+
 	std::unique_ptr<fz::reader_base> reader_;
 	std::unique_ptr<fz::writer_base> writer_;
 	bool finalizing_{};
 
+	// No more buffers get handed to fzsftp after end of file or an error.
+	bool pushed_last_{};
+	bool writer_waiting_{};
+
 	uint8_t const* base_address_{};
-	fz::buffer_lease buffer_;
+
+	// Buffers handed to fzsftp, in the order it processes them
+	std::deque<fz::buffer_lease> buffers_;
 };
 
 #endif
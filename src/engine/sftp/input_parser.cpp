@@ -36,6 +36,8 @@ size_t SftpInputParser::lines(sftpEvent eventType) const
 	case sftpEvent::Info:
 	case sftpEvent::Status:
 	case sftpEvent::Transfer:
+	case sftpEvent::TransferWindow:
+	case sftpEvent::FileResult:
 	case sftpEvent::AskPassword:
 	case sftpEvent::RequestPreamble:
 	case sftpEvent::RequestInstruction:
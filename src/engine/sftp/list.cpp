@@ -1,6 +1,7 @@
 #include "../filezilla.h"
 
 #include "../directorycache.h"
+#include "../../include/engine_options.h"
 #include "list.h"
 
 #include <assert.h>
@@ -61,6 +62,13 @@ int CSftpListOpData::Send()
 	}
 	else if (opState == list_list) {
 		listing_parser_ = std::make_unique<CDirectoryListingParser>(&controlSocket_, currentServer_, listingEncoding::unknown);
+
+		auto const batch = options_.get_int(OPTION_LISTING_PARTIAL_BATCH);
+		if (batch > 0) {
+			listing_parser_->SetPartialListingHandler(currentPath_, static_cast<size_t>(batch), [this](CDirectoryListing && listing) {
+				controlSocket_.SendPartialDirectoryListingNotification(std::move(listing));
+			});
+		}
 		return controlSocket_.SendCommand(L"ls");
 	}
 
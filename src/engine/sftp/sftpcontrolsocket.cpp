@@ -111,6 +111,30 @@ void CSftpControlSocket::OnSftpEvent(sftp_message const& message)
 	case sftpEvent::Send:
 		RecordActivity(activity_logger::send, fz::to_integral<uint64_t>(message.text[0]));
 		break;
+	case sftpEvent::TransferWindow:
+		engine_.transfer_status_.SetWindow(fz::to_integral<int64_t>(message.text[0], -1));
+		break;
+	case sftpEvent::FileResult:
+		{
+			auto const pos = message.text[0].find(' ');
+			if (pos == std::wstring::npos) {
+				log(logmsg::debug_warning, L"Malformed file result: %s", message.text[0]);
+				break;
+			}
+			auto const index = fz::to_integral<size_t>(std::wstring_view(message.text[0]).substr(0, pos), size_t(-1));
+			bool const success = message.text[0].substr(pos + 1) == L"1";
+
+			if (operations_.empty()) {
+				log(logmsg::debug_warning, L"File result outside of an operation, ignoring.");
+			}
+			else if (operations_.back()->opId == Command::del) {
+				static_cast<CSftpDeleteOpData&>(*operations_.back()).OnFileResult(index, success);
+			}
+			else if (operations_.back()->opId == Command::chmod) {
+				static_cast<CSftpChmodOpData&>(*operations_.back()).OnFileResult(index, success);
+			}
+		}
+		break;
 	case sftpEvent::Transfer:
 		{
 			auto value = fz::to_integral<int64_t>(message.text[0]);
@@ -264,6 +288,7 @@ void CSftpControlSocket::OnSftpEvent(sftp_message const& message)
 		}
 		break;
 	case sftpEvent::io_open:
+		++io_transfer_id_;
 		if (!operations_.empty() && operations_.back()->opId == Command::transfer) {
 			auto & data = static_cast<CSftpFileTransferOpData&>(*operations_.back());
 			data.OnOpenRequested(fz::to_integral<uint64_t>(message.text[0]));
@@ -66,6 +66,9 @@ protected:
 
 	fz::buffer send_buffer_;
 
+	// Incremented whenever fzsftp opens a file, tags the buffers handed to it
+	unsigned int io_transfer_id_{};
+
 	friend class CProtocolOpData<CSftpControlSocket>;
 	friend class CSftpChangeDirOpData;
 	friend class CSftpChmodOpData;
@@ -15,6 +15,16 @@
 namespace {
 wchar_t const prefix[] = { ' ', 'K', 'M', 'G', 'T', 'P', 'E' };
 
+// Sizes get formatted from all event loops, hence the thread-safe initialization
+wchar_t GetByteUnit()
+{
+	static wchar_t const unit = []() {
+		std::wstring t = _("B <Unit symbol for bytes. Only translate first letter>"); // @translator: Only translate first letter.
+		return t[0];
+	}();
+	return unit;
+}
+
 std::wstring ToString(int64_t n, wchar_t const* const sepBegin = nullptr, wchar_t const* const sepEnd = nullptr)
 {
 	std::wstring ret;
@@ -162,11 +172,7 @@ std::wstring CSizeFormatBase::Format(COptionsBase* pOptions, int64_t size, bool
 	}
 	result += ' ';
 
-	static wchar_t byte_unit = 0;
-	if (!byte_unit) {
-		std::wstring t = _("B <Unit symbol for bytes. Only translate first letter>"); // @translator: Only translate first letter.
-		byte_unit = t[0];
-	}
+	wchar_t const byte_unit = GetByteUnit();
 
 	if (!p) {
 		return result + byte_unit;
@@ -229,11 +235,7 @@ std::wstring CSizeFormatBase::GetUnit(COptionsBase* pOptions, _unit unit, CSizeF
 		ret += 'i';
 	}
 
-	static wchar_t byte_unit = 0;
-	if (!byte_unit) {
-		std::wstring t = _("B <Unit symbol for bytes. Only translate first letter>"); // @translator: Only translate first letter.
-		byte_unit = t[0];
-	}
+	wchar_t const byte_unit = GetByteUnit();
 
 	ret += byte_unit;
 
@@ -27,7 +27,14 @@ public:
 	// commands and reply codes.
 	int Execute(CCommand const& command);
 
-	// Cancels the current command
+	// Like Execute, but while busy, the command gets queued and executed
+	// right after the current one without waiting for the caller.
+	// Only a few commands can be queued, if the queue is full, FZ_REPLY_BUSY
+	// is returned. Connect and disconnect commands cannot be queued.
+	// Each command still gets its own COperationNotification, in order.
+	int Queue(CCommand const& command);
+
+	// Cancels the current command and all queued ones
 	int Cancel();
 
 	bool IsBusy() const;
@@ -25,10 +25,15 @@ public:
 
 	std::pair<uint64_t, uint64_t> extract_amounts();
 
+	// Data not sent over the wire thanks to compression
+	void record_saved(uint64_t amount);
+	uint64_t saved() const { return saved_; }
+
 	void set_notifier(std::function<void()> && notification_cb);
 
 private:
 	std::atomic_uint64_t amounts_[2]{};
+	std::atomic_uint64_t saved_{};
 
 	fz::mutex mtx_;
 	std::function<void()> notification_cb_;
@@ -66,6 +66,8 @@ enum class Command
 
 #define FZ_REPLY_CONTINUE 0x8000 // Used internally
 #define FZ_REPLY_ERROR_NOTFOUND (0x10000 | FZ_REPLY_ERROR) // Used internally
+#define FZ_REPLY_CHECKSUMMISMATCH (0x20000 | FZ_REPLY_CRITICALERROR) // Transferred data does not match checksum reported by the server
+#define FZ_REPLY_CHECKSUMUNVERIFIED (0x40000 | FZ_REPLY_CRITICALERROR) // Transfer completed, but the requested checksum verification was not possible
 
 // --------------- //
 // Actual commands //
@@ -127,7 +127,10 @@ public:
 		listing_failed = 0x100,
 		listing_has_dirs = 0x200,
 		listing_has_perms = 0x400,
-		listing_has_usergroup = 0x800
+		listing_has_usergroup = 0x800,
+
+		// Set on listings still being received, see CPartialDirectoryListingNotification
+		listing_partial = 0x1000
 	};
 
 	int get_unsure_flags() const { return m_flags & unsure_mask; }
@@ -135,6 +138,7 @@ public:
 	bool has_dirs() const { return (m_flags & listing_has_dirs) != 0; }
 	bool has_perms() const { return (m_flags & listing_has_perms) != 0; }
 	bool has_usergroup() const { return (m_flags & listing_has_usergroup) != 0; }
+	bool partial() const { return (m_flags & listing_partial) != 0; }
 
 	void Assign(std::vector<fz::shared_value<CDirentry>> && entries);
 
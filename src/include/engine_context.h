@@ -37,7 +37,15 @@ public:
 
 	COptionsBase& GetOptions() { return options_; }
 	fz::thread_pool& GetThreadPool();
+
+	// The primary event loop, for everything besides the engines
 	fz::event_loop& GetEventLoop();
+
+	// Engines are spread round-robin over a pool of event loops, see OPTION_EVENT_LOOPS.
+	// Returns the loop the next engine is to be assigned to.
+	fz::event_loop& GetEngineEventLoop();
+	size_t GetEventLoopCount() const;
+
 	fz::rate_limiter& GetRateLimiter();
 	CDirectoryCache& GetDirectoryCache();
 	CPathCache& GetPathCache();
@@ -82,6 +82,17 @@ enum engineOptions : unsigned int
 	OPTION_MIN_TLS_VER,
 
 	OPTION_DIRECTORY_LISTING_ITEM_LIMIT,
+	OPTION_LISTING_PARTIAL_BATCH, // Minimum number of entries between partial listing notifications, 0 to disable
+	OPTION_CACHE_MEMORY_LIMIT, // In MiB
+	OPTION_CACHE_PERSISTENT, // Keep directory listings across sessions
+	OPTION_CACHE_FILE, // Set by the interface, location of the persistent directory cache
+	OPTION_FTP_VERIFY_CHECKSUM, // Compare checksum reported by server after FTP transfers
+	OPTION_FTP_MODE_Z_LEVEL, // Compression level for MODE Z, only used on sites which have compression enabled
+	OPTION_SFTP_WINDOW_MIN, // In KiB, lower limit of data in outstanding SFTP read or write requests
+	OPTION_SFTP_WINDOW_MAX, // In KiB, upper limit of data in outstanding SFTP read or write requests
+	OPTION_EVENT_LOOPS, // Number of event loops engines are distributed over, 0 for one per CPU core. Read once at startup.
+	OPTION_FTP_PIPELINE_WINDOW, // Maximum number of outstanding DELE commands, only used on sites which have pipelining enabled
+	OPTION_FTP_TRANSFER_ABSOLUTE_PATHS, // Skip changing directories for transfers if the server supports TVFS, off by default
 
 	OPTIONS_ENGINE_NUM
 };
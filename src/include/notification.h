@@ -19,6 +19,7 @@
 // CFileZillaEngine::SetAsyncRequestReply to continue the current operation.
 
 #include "commands.h"
+#include "directorylisting.h"
 #include "local_path.h"
 #include "logging.h"
 #include "server.h"
@@ -37,7 +38,8 @@ enum NotificationId : unsigned int
 	nId_local_dir_created, // local directory has been created
 	nId_serverchange,      // With some protocols, actual server identity isn't known until after logon
 	nId_persistent_state,  // See PersistentStateNotification
-	nId_ftp_tls_resumption
+	nId_ftp_tls_resumption,
+	nId_listing_partial    // directory listing still being received, see CPartialDirectoryListingNotification
 };
 
 // Async request IDs
@@ -120,7 +122,6 @@ public:
 //
 // Primary notifications are those resulting from a CListCommand, other ones
 // can happen spontaneously through other actions.
-class CDirectoryListing;
 class FZC_PUBLIC_SYMBOL CDirectoryListingNotification final : public CNotificationHelper<nId_listing>
 {
 public:
@@ -135,6 +136,26 @@ protected:
 	CServerPath m_path;
 };
 
+// Sent while receiving large primary directory listings if
+// OPTION_LISTING_PARTIAL_BATCH is non-zero. Unlike CDirectoryListingNotification
+// it directly carries the entries parsed so far, as partial listings never
+// enter the directory cache.
+// Consecutive partial listings of the same directory share the same
+// m_firstListTime, each one being a prefix of the next. Once the listing
+// is complete, a regular CDirectoryListingNotification follows.
+class FZC_PUBLIC_SYMBOL CPartialDirectoryListingNotification final : public CNotificationHelper<nId_listing_partial>
+{
+public:
+	explicit CPartialDirectoryListingNotification(CDirectoryListing && listing)
+		: listing_(std::move(listing))
+	{}
+
+	CDirectoryListing const& GetListing() const { return listing_; }
+
+protected:
+	CDirectoryListing const listing_;
+};
+
 class FZC_PUBLIC_SYMBOL CAsyncRequestNotification : public CNotificationHelper<nId_asyncrequest>
 {
 public:
@@ -255,6 +276,9 @@ public:
 	// SFTP uploads: Set to true if currentOffset >= startOffset + 65536.
 	bool madeProgress{};
 
+	// SFTP: Amount of data in outstanding requests, adapts to the connection. -1 if unknown.
+	int64_t window{-1};
+
 	bool list{};
 };
 
@@ -0,0 +1,53 @@
+#ifndef FILEZILLA_ENGINE_SEGMENT_WRITER_HEADER
+#define FILEZILLA_ENGINE_SEGMENT_WRITER_HEADER
+
+#include "visibility.h"
+
+#include <libfilezilla/writer.hpp>
+
+#include <atomic>
+#include <memory>
+
+// Writes a byte range of a local file shared by the concurrent transfers of
+// a segmented download.
+//
+// Unlike fz::file_writer_factory, the file is neither created nor truncated,
+// it has to exist already with its final size. All offsets are absolute
+// positions in the file: size() returns the position up to which the range
+// has been written, so that the regular resume logic of the protocols picks
+// up the segment where it left off.
+//
+// Transfers using this factory download the range only. They never ask
+// whether to overwrite the file and leave its modification time alone.
+class FZC_PUBLIC_SYMBOL segment_writer_factory final : public fz::writer_factory
+{
+public:
+	segment_writer_factory(std::wstring const& file, fz::thread_pool & pool, uint64_t file_size, uint64_t offset, uint64_t length, uint64_t done = 0);
+
+	virtual std::unique_ptr<fz::writer_factory> clone() const override;
+
+	virtual std::unique_ptr<fz::writer_base> open(fz::aio_buffer_pool & pool, uint64_t offset, fz::writer_base::progress_cb_t progress_cb = nullptr, size_t max_buffers = 0) override;
+
+	virtual uint64_t size() const override;
+
+	// Size of the remote file the range belongs to
+	uint64_t file_size() const { return file_size_; }
+
+	uint64_t offset() const { return offset_; }
+	uint64_t end() const { return offset_ + length_; }
+
+	// Amount of data of the range written to disk so far. Shared by all
+	// copies of the factory, so it can be queried while the transfer runs.
+	uint64_t done() const { return *done_; }
+
+private:
+	segment_writer_factory(segment_writer_factory const&) = default;
+
+	fz::thread_pool & thread_pool_;
+	uint64_t const file_size_;
+	uint64_t const offset_;
+	uint64_t const length_;
+	std::shared_ptr<std::atomic<uint64_t>> done_;
+};
+
+#endif
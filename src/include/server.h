@@ -111,7 +111,9 @@ enum class ProtocolFeature
 	ProExclusive,
 	ListVersions,
 	DownloadVersion,
-	DeleteVersion
+	DeleteVersion,
+	DataCompression,
+	CommandPipelining
 };
 
 enum class CaseSensitivity
@@ -233,6 +233,9 @@ USE AT OWN RISK"), _T("Important Information"));
 	CheckExistsFzstorj();
 #endif
 
+	// Needs to be known before the engine context gets created
+	options_->set(OPTION_CACHE_FILE, options_->get_string(OPTION_DEFAULT_SETTINGSDIR) + L"listingcache.sqlite3");
+
 #ifdef WITH_LIBDBUS
 	CSessionManager::Init();
 #endif
@@ -29,9 +29,12 @@
 #include <libfilezilla/local_filesys.hpp>
 #include <libfilezilla/process.hpp>
 #include <libfilezilla/recursive_remove.hpp>
+#include <libfilezilla/thread_pool.hpp>
 
 #include <wx/menu.h>
 
+#include <atomic>
+
 using namespace std::literals;
 
 class CLocalListViewDropTarget final : public CFileDropTarget<wxListCtrlEx>
@@ -313,14 +316,149 @@ CLocalListView::~CLocalListView()
 	wxString str = wxString::Format(_T("%d %d"), m_sortDirection, m_sortColumn);
 	options_.set(OPTION_LOCALFILELIST_SORTORDER, str.ToStdWstring());
 
+	StopLoading();
+	for (auto & loader : stopped_loaders_) {
+		loader->task_.join();
+	}
+
 #ifdef __WXMSW__
 	volumeEnumeratorThread_.reset();
 #endif
 }
 
-bool CLocalListView::DisplayDir(CLocalPath const& dirname)
+namespace {
+// The first entries of a directory are handed to the main thread quickly,
+// after that ever larger chunks as each one needs the list to get sorted.
+size_t const first_chunk_size = 500;
+size_t const max_chunk_size = 64 * 1024;
+auto const chunk_interval = fz::duration::from_milliseconds(250);
+
+size_t const dir_cache_size = 5;
+size_t const dir_cache_max_entries = 500000;
+
+#ifdef __WXMSW__
+// False for the drives and the shares of a computer
+bool is_regular_dir(CLocalPath const& dir)
+{
+	std::wstring const& path = dir.GetPath();
+	if (path == L"\\") {
+		return false;
+	}
+	if (path.substr(0, 2) == L"\\\\") {
+		// UNC path without shares
+		auto pos = path.find('\\', 2);
+		return pos != std::wstring::npos && pos + 1 < path.size();
+	}
+	return true;
+}
+#endif
+}
+
+struct CLocalListView::dir_loader final
+{
+	dir_loader(CLocalPath const& dir, bool progressive)
+		: dir_(dir)
+		, progressive_(progressive)
+	{}
+
+	// Runs on the worker thread
+	void run(CLocalListView & view);
+
+	CLocalPath const dir_;
+	bool const progressive_;
+
+	// Only accessed from the main thread
+	std::wstring focus_;
+	bool ensureVisible_{};
+	std::vector<CLocalFileData> entries_;
+	std::vector<std::wstring> refreshedFiles_;
+
+	std::atomic<bool> stop_{};
+
+	fz::mutex mutex_{false};
+	std::vector<CLocalFileData> listed_;
+	fz::result result_{};
+	bool encodingError_{};
+	bool done_{};
+	bool notified_{};
+
+	fz::async_task task_;
+};
+
+void CLocalListView::dir_loader::run(CLocalListView & view)
+{
+	std::vector<CLocalFileData> entries;
+	bool encodingError{};
+
+	auto const hand_off = [&](fz::result const* result) {
+		fz::scoped_lock l(mutex_);
+		if (listed_.empty()) {
+			listed_ = std::move(entries);
+		}
+		else {
+			listed_.insert(listed_.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+		}
+		entries.clear();
+		encodingError_ |= encodingError;
+		if (result) {
+			result_ = *result;
+			done_ = true;
+		}
+		if (!notified_) {
+			notified_ = true;
+			view.CallAfter(&CLocalListView::OnDirLoaded);
+		}
+	};
+
+	fz::local_filesys local_filesys;
+	auto const result = local_filesys.begin_find_files(fz::to_native(dir_.GetPath()), false);
+	if (result) {
+		size_t chunk_size = first_chunk_size;
+		auto last = fz::monotonic_clock::now();
+
+		CLocalFileData data;
+		bool wasLink{};
+		fz::local_filesys::type t{};
+		fz::native_string name;
+		while (!stop_ && local_filesys.get_next_file(name, wasLink, t, &data.size, &data.time, &data.attributes)) {
+			data.name = fz::to_wstring(name);
+			data.dir = t == fz::local_filesys::dir;
+			if (name.empty() || data.name.empty()) {
+				encodingError = true;
+				continue;
+			}
+
+			entries.push_back(data);
+			if (progressive_) {
+				auto const now = fz::monotonic_clock::now();
+				if (entries.size() >= chunk_size || now - last >= chunk_interval) {
+					hand_off(nullptr);
+					chunk_size = std::min(chunk_size * 2, max_chunk_size);
+					last = now;
+				}
+			}
+		}
+	}
+
+	hand_off(&result);
+}
+
+void CLocalListView::DisplayDir(CLocalPath const& dirname)
 {
 	CancelLabelEdit();
+	StopLoading();
+
+#ifdef __WXMSW__
+	bool const regular = is_regular_dir(dirname);
+#else
+	bool const regular = true;
+#endif
+
+	if (regular && m_dir == dirname) {
+		// Keep the current contents until the directory has been listed again
+		StartLoading(false, std::wstring(), false);
+		return;
+	}
 
 	std::wstring focused;
 	int focusedItem = -1;
@@ -370,94 +508,262 @@ bool CLocalListView::DisplayDir(CLocalPath const& dirname)
 		m_indexMapping.push_back(0);
 	}
 
+	if (regular) {
+		auto const cached = std::find_if(dir_cache_.cbegin(), dir_cache_.cend(), [&](auto const& c) { return c.first == m_dir; });
+		if (cached != dir_cache_.cend()) {
+			m_fileData.insert(m_fileData.end(), cached->second.cbegin(), cached->second.cend());
+			SetInfoText(wxString());
+		}
+		else {
+			SetInfoText(_("Reading directory listing..."));
+		}
+		UpdateIndexMapping();
+
+		// The focused item of a new directory may only be listed later on
+		StartLoading(cached == dir_cache_.cend(), focused, ensureVisible);
+	}
 #ifdef __WXMSW__
-	if (m_dir.GetPath() == _T("\\")) {
+	else if (m_dir.GetPath() == _T("\\")) {
 		DisplayDrives();
 	}
-	else if (m_dir.GetPath().substr(0, 2) == _T("\\\\")) {
-		auto pos = m_dir.GetPath().find('\\', 2);
-		if (pos != std::wstring::npos && pos + 1 < m_dir.GetPath().size()) {
-			goto regular_dir;
-		}
-
-		// UNC path without shares
+	else {
 		DisplayShares(m_dir.GetPath());
 	}
-	else
 #endif
+
+	DisplayEntries(oldItemCount, selectedNames, focused, focusedItem, ensureVisible);
+}
+
+void CLocalListView::StartLoading(bool progressive, std::wstring const& focus, bool ensureVisible)
+{
+	loader_ = std::make_unique<dir_loader>(m_dir, progressive);
+	loader_->focus_ = focus;
+	loader_->ensureVisible_ = ensureVisible;
+
+	auto & loader = *loader_;
+	loader.task_ = m_state.pool_.spawn([this, &loader] { loader.run(*this); });
+	if (!loader.task_) {
+		loader.run(*this);
+	}
+}
+
+void CLocalListView::StopLoading()
+{
+	if (loader_) {
+		// On slow file systems the worker may take a while to notice,
+		// it gets joined once done.
+		loader_->stop_ = true;
+		stopped_loaders_.emplace_back(std::move(loader_));
+	}
+	JoinFinishedLoaders();
+}
+
+void CLocalListView::JoinFinishedLoaders()
+{
+	for (size_t i = 0; i < stopped_loaders_.size(); ) {
+		auto & loader = *stopped_loaders_[i];
+		bool done;
+		{
+			fz::scoped_lock l(loader.mutex_);
+			done = loader.done_;
+		}
+		if (done) {
+			loader.task_.join();
+			stopped_loaders_[i] = std::move(stopped_loaders_.back());
+			stopped_loaders_.pop_back();
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+void CLocalListView::OnDirLoaded()
+{
+	JoinFinishedLoaders();
+	if (!loader_) {
+		return;
+	}
+
+	std::vector<CLocalFileData> listed;
+	fz::result result{};
+	bool encodingError;
+	bool done;
 	{
-#ifdef __WXMSW__
-regular_dir:
-#endif
-		CStateFilterManager const& filter = m_state.GetStateFilterManager();
-		fz::local_filesys local_filesys;
+		fz::scoped_lock l(loader_->mutex_);
+		listed.swap(loader_->listed_);
+		result = loader_->result_;
+		encodingError = loader_->encodingError_;
+		loader_->encodingError_ = false;
+		done = loader_->done_;
+		loader_->notified_ = false;
+	}
 
-		auto result = local_filesys.begin_find_files(fz::to_native(m_dir.GetPath()), false);
-		if (!result) {
+	if (encodingError) {
+		wxGetApp().DisplayEncodingWarning();
+	}
 
-			if (result.error_ == fz::result::noperm) {
-				SetInfoText(_("You do not have permission to list this directory"));
-			}
-			else {
-				SetInfoText(_("Could not list directory contents"));
+	if (!done) {
+		if (loader_->progressive_) {
+			if (!listed.empty()) {
+				SetInfoText(wxString());
 			}
+			AddEntries(*loader_, std::move(listed));
+		}
+		else {
+			loader_->entries_.insert(loader_->entries_.end(), std::make_move_iterator(listed.begin()), std::make_move_iterator(listed.end()));
+		}
+		return;
+	}
 
-			SetItemCount(1);
-			if (m_pFilelistStatusBar) {
-				m_pFilelistStatusBar->SetDirectoryContents(0, 0, 0, 0, 0);
-			}
+	// Finished, comparisons and changes to single files are possible again
+	auto loader = std::move(loader_);
+	loader->task_.join();
 
-			return false;
+	if (!result) {
+		dir_cache_.remove_if([&](auto const& c) { return c.first == m_dir; });
+
+		if (result.error_ == fz::result::noperm) {
+			SetInfoText(_("You do not have permission to list this directory"));
+		}
+		else {
+			SetInfoText(_("Could not list directory contents"));
 		}
 
-		SetInfoText(wxString());
+		ReplaceEntries(std::vector<CLocalFileData>());
+		return;
+	}
 
-		int64_t totalSize{};
-		int unknown_sizes = 0;
-		int totalFileCount = 0;
-		int totalDirCount = 0;
-		int hidden = 0;
+	SetInfoText(wxString());
 
-		int num = m_fileData.size();
-		CLocalFileData data;
-		bool wasLink{};
-		fz::local_filesys::type t{};
-		fz::native_string name;
-		while (local_filesys.get_next_file(name, wasLink, t, &data.size, &data.time, &data.attributes)) {
-			data.name = fz::to_wstring(name);
-			data.dir = t == fz::local_filesys::dir;
-			if (name.empty() || data.name.empty()) {
-				wxGetApp().DisplayEncodingWarning();
-				continue;
-			}
+	if (loader->progressive_) {
+		AddEntries(*loader, std::move(listed));
+	}
+	else {
+		loader->entries_.insert(loader->entries_.end(), std::make_move_iterator(listed.begin()), std::make_move_iterator(listed.end()));
+		ReplaceEntries(std::move(loader->entries_));
+	}
 
-			m_fileData.push_back(data);
-			if (!filter.FilenameFiltered(data.name, m_dir.GetPath(), data.dir, data.size, true, data.attributes, data.time)) {
-				if (data.dir) {
-					++totalDirCount;
-				}
-				else {
-					if (data.size != -1) {
-						totalSize += data.size;
-					}
-					else {
-						++unknown_sizes;
-					}
-					++totalFileCount;
-				}
-				m_indexMapping.push_back(num);
+	CacheEntries();
+
+	for (auto const& file : loader->refreshedFiles_) {
+		RefreshFile(file);
+	}
+}
+
+void CLocalListView::AddEntries(dir_loader & loader, std::vector<CLocalFileData> && entries)
+{
+	// The last call refreshes a comparison even if nothing got added
+	if (entries.empty() && loader_) {
+		return;
+	}
+
+	std::wstring focused;
+	int focusedItem = -1;
+	std::vector<std::wstring> const selectedNames = RememberSelectedItems(focused, focusedItem);
+
+	// Until the user moves the focus, try focusing the item that was
+	// supposed to get focused when entering the directory
+	bool ensureVisible{};
+	if (!loader.focus_.empty()) {
+		if (focusedItem <= 0) {
+			focused = loader.focus_;
+			ensureVisible = loader.ensureVisible_;
+		}
+		else {
+			loader.focus_.clear();
+		}
+	}
+
+	if (m_pFilelistStatusBar) {
+		m_pFilelistStatusBar->UnselectAll();
+	}
+
+	int const oldItemCount = m_indexMapping.size();
+
+	m_fileData.insert(m_fileData.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+	UpdateIndexMapping();
+
+	DisplayEntries(oldItemCount, selectedNames, focused, focusedItem, ensureVisible);
+
+	if (!loader.focus_.empty()) {
+		int const item = GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_FOCUSED);
+		CLocalFileData const* data = GetData(item);
+		if (data && data->name == loader.focus_) {
+			loader.focus_.clear();
+		}
+	}
+}
+
+void CLocalListView::ReplaceEntries(std::vector<CLocalFileData> && entries)
+{
+	std::wstring focused;
+	int focusedItem = -1;
+	std::vector<std::wstring> const selectedNames = RememberSelectedItems(focused, focusedItem);
+
+	if (m_pFilelistStatusBar) {
+		m_pFilelistStatusBar->UnselectAll();
+	}
+
+	int const oldItemCount = m_indexMapping.size();
+
+	m_fileData.resize(m_hasParent ? 1 : 0);
+	m_fileData.insert(m_fileData.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+	UpdateIndexMapping();
+
+	DisplayEntries(oldItemCount, selectedNames, focused, focusedItem, false);
+}
+
+void CLocalListView::UpdateIndexMapping()
+{
+	filter_matcher const filter = m_state.GetStateFilterManager().GetFilterMatcher(true);
+	std::wstring const& path = m_dir.GetPath();
+
+	int64_t totalSize{};
+	int unknown_sizes = 0;
+	int totalFileCount = 0;
+	int totalDirCount = 0;
+	int hidden = 0;
+
+	unsigned int const min = m_hasParent ? 1 : 0;
+
+	m_indexMapping.clear();
+	if (m_hasParent) {
+		m_indexMapping.push_back(0);
+	}
+	for (unsigned int i = min; i < m_fileData.size(); ++i) {
+		const CLocalFileData& data = m_fileData[i];
+		if (data.comparison_flags == fill) {
+			continue;
+		}
+		if (filter && filter.filtered(data.name, path, data.dir, data.size, data.attributes, data.time)) {
+			++hidden;
+			continue;
+		}
+
+		if (data.dir) {
+			++totalDirCount;
+		}
+		else {
+			if (data.size != -1) {
+				totalSize += data.size;
 			}
 			else {
-				++hidden;
+				++unknown_sizes;
 			}
-			++num;
+			++totalFileCount;
 		}
 
-		if (m_pFilelistStatusBar) {
-			m_pFilelistStatusBar->SetDirectoryContents(totalFileCount, totalDirCount, totalSize, unknown_sizes, hidden);
-		}
+		m_indexMapping.push_back(i);
 	}
 
+	if (m_pFilelistStatusBar) {
+		m_pFilelistStatusBar->SetDirectoryContents(totalFileCount, totalDirCount, totalSize, unknown_sizes, hidden);
+	}
+}
+
+void CLocalListView::DisplayEntries(int oldItemCount, std::vector<std::wstring> const& selectedNames, std::wstring const& focused, int focusedItem, bool ensureVisible)
+{
 	if (m_dropTarget != -1) {
 		CLocalFileData* data = GetData(m_dropTarget);
 		if (!data || !data->dir) {
@@ -481,8 +787,36 @@ regular_dir:
 	ReselectItems(selectedNames, focused, focusedItem, ensureVisible);
 
 	RefreshListOnly();
+}
 
-	return true;
+void CLocalListView::CacheEntries()
+{
+	dir_cache_.remove_if([&](auto const& c) { return c.first == m_dir; });
+
+	size_t const min = m_hasParent ? 1 : 0;
+	if (m_fileData.size() - min > dir_cache_max_entries) {
+		return;
+	}
+
+	std::vector<CLocalFileData> entries;
+	entries.reserve(m_fileData.size() - min);
+	for (size_t i = min; i < m_fileData.size(); ++i) {
+		if (m_fileData[i].comparison_flags != fill) {
+			entries.push_back(m_fileData[i]);
+			entries.back().comparison_flags = normal;
+		}
+	}
+	dir_cache_.emplace_front(m_dir, std::move(entries));
+
+	size_t count{};
+	size_t total{};
+	for (auto it = dir_cache_.begin(); it != dir_cache_.end(); ++it) {
+		total += it->second.size();
+		if (++count > dir_cache_size || total > dir_cache_max_entries) {
+			dir_cache_.erase(it, dir_cache_.end());
+			break;
+		}
+	}
 }
 
 // See comment to OnGetItemText
@@ -1204,47 +1538,9 @@ void CLocalListView::ApplyCurrentFilter()
 		m_pFilelistStatusBar->UnselectAll();
 	}
 
-	int64_t totalSize{};
-	int unknown_sizes = 0;
-	int totalFileCount = 0;
-	int totalDirCount = 0;
-	int hidden = 0;
-
-	m_indexMapping.clear();
-	if (m_hasParent) {
-		m_indexMapping.push_back(0);
-	}
-	for (unsigned int i = min; i < m_fileData.size(); ++i) {
-		const CLocalFileData& data = m_fileData[i];
-		if (data.comparison_flags == fill) {
-			continue;
-		}
-		if (filter.FilenameFiltered(data.name, m_dir.GetPath(), data.dir, data.size, true, data.attributes, data.time)) {
-			++hidden;
-			continue;
-		}
-
-		if (data.dir) {
-			++totalDirCount;
-		}
-		else {
-			if (data.size != -1) {
-				totalSize += data.size;
-			}
-			else {
-				++unknown_sizes;
-			}
-			++totalFileCount;
-		}
-
-		m_indexMapping.push_back(i);
-	}
+	UpdateIndexMapping();
 	SetItemCount(m_indexMapping.size());
 
-	if (m_pFilelistStatusBar) {
-		m_pFilelistStatusBar->SetDirectoryContents(totalFileCount, totalDirCount, totalSize, unknown_sizes, hidden);
-	}
-
 	SortList(-1, -1, false);
 
 	if (IsComparing()) {
@@ -1521,6 +1817,12 @@ void CLocalListView::OnBeginDrag(wxListEvent&)
 
 void CLocalListView::RefreshFile(std::wstring const& file)
 {
+	if (loader_) {
+		// The file may or may not still get listed
+		loader_->refreshedFiles_.push_back(file);
+		return;
+	}
+
 	CLocalFileData data;
 
 	bool wasLink;
@@ -1763,7 +2065,7 @@ void CLocalListView::FinishComparison()
 
 bool CLocalListView::CanStartComparison()
 {
-	return true;
+	return !loader_ || !loader_->progressive_;
 }
 
 wxString CLocalListView::GetItemText(int item, unsigned int column)
@@ -4,6 +4,8 @@
 #include "filelistctrl.h"
 #include "state.h"
 
+#include <list>
+
 class CInfoText;
 class CQueueView;
 class CLocalListViewDropTarget;
@@ -38,9 +40,33 @@ public:
 
 protected:
 	void OnStateChange(t_statechange_notifications notification, std::wstring const& data, const void*) override;
-	bool DisplayDir(CLocalPath const& dirname);
+	void DisplayDir(CLocalPath const& dirname);
 	void ApplyCurrentFilter();
 
+	// Directories are listed on a worker thread. A newly visited directory
+	// gets displayed progressively, a directory that is displayed already
+	// keeps its contents until it has been listed completely.
+	struct dir_loader;
+	void StartLoading(bool progressive, std::wstring const& focus, bool ensureVisible);
+	void StopLoading();
+	void OnDirLoaded();
+	void JoinFinishedLoaders();
+
+	void AddEntries(dir_loader & loader, std::vector<CLocalFileData> && entries);
+	void ReplaceEntries(std::vector<CLocalFileData> && entries);
+
+	// Rebuilds the index mapping from the file data and updates the status bar
+	void UpdateIndexMapping();
+	void DisplayEntries(int oldItemCount, std::vector<std::wstring> const& selectedNames, std::wstring const& focused, int focusedItem, bool ensureVisible);
+
+	std::unique_ptr<dir_loader> loader_;
+	std::vector<std::unique_ptr<dir_loader>> stopped_loaders_;
+
+	// Listings of the last few directories, most recent first. They get
+	// displayed right away when returning to a directory.
+	void CacheEntries();
+	std::list<std::pair<CLocalPath, std::vector<CLocalFileData>>> dir_cache_;
+
 	// Declared const due to design error in wxWidgets.
 	// Won't be fixed since a fix would break backwards compatibility
 	// Both functions use a const_cast<CLocalListView *>(this) and modify
@@ -1084,6 +1084,14 @@ void CMainFrame::OnEngineEvent(CFileZillaEngine* engine)
 				}
 			}
 			break;
+		case nId_listing_partial:
+			{
+				auto const& listingNotification = static_cast<CPartialDirectoryListingNotification const&>(*pNotification.get());
+				if (pState->m_pCommandQueue) {
+					pState->m_pCommandQueue->ProcessPartialDirectoryListing(listingNotification);
+				}
+			}
+			break;
 		case nId_asyncrequest:
 			{
 				auto pAsyncRequest = unique_static_cast<CAsyncRequestNotification>(std::move(pNotification));
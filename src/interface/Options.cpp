@@ -115,7 +115,10 @@ static unsigned int register_interface_options()
 		{ "Drag and Drop disabled", false, option_flags::normal },
 		{ "Disable update footer", false, option_flags::normal },
 		{ "Tab data", L"", option_flags::normal | option_flags::sensitive_data, option_type::xml },
-		{ "Highest shown overlay id", 0, option_flags::normal }
+		{ "Highest shown overlay id", 0, option_flags::normal },
+		{ "Segmented downloads", 0, option_flags::numeric_clamp, 0, 10 },
+		{ "Segmented download minimum size", 64, option_flags::numeric_clamp, 1, 1024 * 1024 },
+		{ "Parallel recursive listings", 0, option_flags::numeric_clamp, 0, 10 }
 	});
 	return value;
 }
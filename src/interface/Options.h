@@ -86,6 +86,9 @@ enum interfaceOptions : unsigned int
 	OPTION_DISABLE_UPDATE_FOOTER,
 	OPTION_TAB_DATA,
 	OPTION_SHOWN_OVERLAY,
+	OPTION_SEGMENTED_DOWNLOADS,
+	OPTION_SEGMENTED_DOWNLOAD_MINSIZE,
+	OPTION_PARALLEL_LISTINGS,
 
 	// Has to be last element
 	OPTIONS_NUM
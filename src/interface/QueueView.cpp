@@ -27,7 +27,11 @@
 #include "../commonui/auto_ascii_files.h"
 #include "../commonui/misc.h"
 
+#include "../include/segment_writer.h"
+
+#include <libfilezilla/file.hpp>
 #include <libfilezilla/glue/wxinvoker.hpp>
+#include <libfilezilla/local_filesys.hpp>
 
 #if WITH_LIBDBUS
 #include "../dbus/desktop_notification.h"
@@ -41,12 +45,55 @@
 #include <wx/sound.h>
 #include <wx/utils.h>
 
+#include <algorithm>
+#include <map>
+
 #ifdef __WXMSW__
 #include <powrprof.h>
 #endif
 
 using namespace std::literals;
 
+struct CQueueView::queue_loader final
+{
+	// Stored servers in order, with their storage ids
+	std::vector<std::pair<int64_t, Site>> servers_;
+	size_t server_{};
+
+	// Rows up to after_ of the current server have been read. Files
+	// stored after startup have ids above last_, they already are in
+	// the queue.
+	int64_t after_{};
+	int64_t last_{};
+	bool loaded_{}; // Whether any file of the current server got loaded
+
+	// Stored servers whose files got added to another server item, by
+	// the storage id of that item
+	std::map<int64_t, int64_t> merged_;
+
+	// Not deleted during loading, files of them might still get loaded
+	std::vector<int64_t> removed_;
+
+	bool error_{};
+};
+
+namespace {
+// Number of stored files loaded per event loop iteration
+int const queue_load_batch_size = 2000;
+
+// Transfers queued in an engine behind its current one. Enough for the
+// engine not to wait for the queue view between files, more would only
+// keep other engines from getting them.
+size_t const max_queued_transfers = 2;
+
+void ShowLoadQueueError(CQueueStorage & storage)
+{
+	wxString file = storage.GetDatabaseFilename();
+	wxString msg = wxString::Format(_("An error occurred loading the transfer queue from \"%s\".\nSome queue items might not have been restored."), file);
+	wxMessageBoxEx(msg, _("Error loading queue"), wxICON_ERROR);
+}
+}
+
 class CQueueViewDropTarget final : public CFileDropTarget<wxListCtrlEx>
 {
 public:
@@ -253,6 +300,7 @@ CQueueView::CQueueView(CQueue* parent, int index, CMainFrame* pMainFrame, CAsync
 #endif
 
 	m_resize_timer.SetOwner(this);
+	m_storage_timer.SetOwner(this);
 }
 
 CQueueView::~CQueueView()
@@ -261,6 +309,7 @@ CQueueView::~CQueueView()
 	DeleteEngines();
 
 	m_resize_timer.Stop();
+	m_storage_timer.Stop();
 }
 
 bool CQueueView::QueueFile(bool const queueOnly, bool const download,
@@ -532,6 +581,7 @@ void CQueueView::ProcessNotification(t_EngineData *pEngineData, std::unique_ptr<
 			PersistentStateNotification& notification = static_cast<PersistentStateNotification&>(*pNotification);
 			CFileItem & fileItem = *pEngineData->pItem;
 			fileItem.set_persistent_state(std::move(notification.persistent_state_));
+			StoreItemChange(fileItem);
 		}
 		break;
 	}
@@ -559,7 +609,9 @@ bool CQueueView::CanStartTransfer(CServerItem const & server_item, t_EngineData
 		}
 
 		if (browsingSite.server == site.server) {
-			++active_count;
+			// Including the connections listing directories for a
+			// recursive operation
+			active_count += 1 + static_cast<int>(pState->GetRemoteRecursiveOperation()->GetListerCount());
 			browsingStateOnSameServer = pState;
 			break;
 		}
@@ -702,24 +754,13 @@ bool CQueueView::TryStartNextTransfer()
 		}
 	}
 
+	if (SplitDownload(*bestMatch.serverItem, *bestMatch.fileItem)) {
+		CommitChanges();
+	}
+
 	// Now we have both inactive engine and file.
 	// Assign the file to the engine.
-
-	bestMatch.fileItem->SetActive(true);
-
-	pEngineData->pItem = bestMatch.fileItem;
-	bestMatch.fileItem->m_pEngineData = pEngineData;
-	pEngineData->active = true;
-	delete pEngineData->m_idleDisconnectTimer;
-	pEngineData->m_idleDisconnectTimer = 0;
-	bestMatch.serverItem->m_activeCount++;
-	m_activeCount++;
-	if (bestMatch.fileItem->Download()) {
-		m_activeCountDown++;
-	}
-	else {
-		m_activeCountUp++;
-	}
+	ActivateItem(*pEngineData, *bestMatch.serverItem, *bestMatch.fileItem);
 
 	Site const oldSite = pEngineData->lastSite;
 	pEngineData->lastSite = bestMatch.serverItem->GetSite();
@@ -744,12 +785,41 @@ bool CQueueView::TryStartNextTransfer()
 		}
 	}
 
-	if (bestMatch.fileItem->GetType() == QueueItemType::File) {
+	SendNextCommand(*pEngineData);
+
+	return true;
+}
+
+void CQueueView::ActivateItem(t_EngineData& engineData, CServerItem& serverItem, CFileItem& fileItem)
+{
+	fileItem.SetActive(true);
+
+	// Transfers starting and finishing get committed right away instead of
+	// waiting for m_storage_timer, they should not be lost if the program
+	// gets terminated.
+	StoreItemChange(fileItem);
+	CommitStorage();
+
+	engineData.pItem = &fileItem;
+	fileItem.m_pEngineData = &engineData;
+	engineData.active = true;
+	delete engineData.m_idleDisconnectTimer;
+	engineData.m_idleDisconnectTimer = 0;
+	serverItem.m_activeCount++;
+	m_activeCount++;
+	if (fileItem.Download()) {
+		m_activeCountDown++;
+	}
+	else {
+		m_activeCountUp++;
+	}
+
+	if (fileItem.GetType() == QueueItemType::File) {
 		// Create status line
 
 		m_itemCount++;
 		SetItemCount(m_itemCount);
-		int lineIndex = GetItemIndex(bestMatch.fileItem);
+		int lineIndex = GetItemIndex(&fileItem);
 		UpdateSelections_ItemAdded(lineIndex + 1);
 
 		wxRect rect = GetClientRect();
@@ -759,21 +829,17 @@ bool CQueueView::TryStartNextTransfer()
 #endif
 		rect.SetHeight(GetLineHeight());
 		m_allowBackgroundErase = false;
-		if (!pEngineData->pStatusLineCtrl) {
-			pEngineData->pStatusLineCtrl = new CStatusLineCtrl(this, options_, pEngineData, rect);
+		if (!engineData.pStatusLineCtrl) {
+			engineData.pStatusLineCtrl = new CStatusLineCtrl(this, options_, &engineData, rect);
 		}
 		else {
-			pEngineData->pStatusLineCtrl->ClearTransferStatus();
-			pEngineData->pStatusLineCtrl->SetSize(rect);
-			pEngineData->pStatusLineCtrl->Show();
+			engineData.pStatusLineCtrl->ClearTransferStatus();
+			engineData.pStatusLineCtrl->SetSize(rect);
+			engineData.pStatusLineCtrl->Show();
 		}
 		m_allowBackgroundErase = true;
-		m_statusLineList.push_back(pEngineData->pStatusLineCtrl);
+		m_statusLineList.push_back(engineData.pStatusLineCtrl);
 	}
-
-	SendNextCommand(*pEngineData);
-
-	return true;
 }
 
 void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification const& notification)
@@ -786,6 +852,18 @@ void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification
 	// Process reply from the engine
 	int replyCode = notification.replyCode_;
 
+	if (!pEngineData->queuedItems.empty() &&
+		((replyCode & FZ_REPLY_DISCONNECTED) ||
+		(replyCode & FZ_REPLY_TIMEOUT) == FZ_REPLY_TIMEOUT ||
+		(replyCode & FZ_REPLY_NOTCONNECTED) == FZ_REPLY_NOTCONNECTED ||
+		(replyCode & FZ_REPLY_CRITICALERROR) == FZ_REPLY_CRITICALERROR))
+	{
+		// The connection might be unusable, don't let the queued transfers
+		// run into the same problem. They get reset as their replies arrive.
+		// Errors about a single file do not affect the other ones.
+		pEngineData->pEngine->Cancel();
+	}
+
 	if ((replyCode & FZ_REPLY_CANCELED) == FZ_REPLY_CANCELED) {
 		ResetReason reason;
 		if (pEngineData->pItem) {
@@ -885,7 +963,9 @@ void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification
 		// user interaction at a minimum if connection is unstable.
 
 		if (pEngineData->pItem->GetType() == QueueItemType::File && ((CFileItem*)pEngineData->pItem)->made_progress() &&
-			(replyCode & FZ_REPLY_WRITEFAILED) != FZ_REPLY_WRITEFAILED)
+			(replyCode & FZ_REPLY_WRITEFAILED) != FZ_REPLY_WRITEFAILED &&
+			(replyCode & FZ_REPLY_CHECKSUMMISMATCH) != FZ_REPLY_CHECKSUMMISMATCH &&
+			(replyCode & FZ_REPLY_CHECKSUMUNVERIFIED) != FZ_REPLY_CHECKSUMUNVERIFIED)
 		{
 			// Don't increase error count if there has been progress
 			CFileItem* pItem = (CFileItem*)pEngineData->pItem;
@@ -902,6 +982,17 @@ void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification
 			else if (replyCode & FZ_REPLY_DISCONNECTED) {
 				pEngineData->pItem->SetStatusMessage(CFileItem::Status::disconnected);
 			}
+			else if ((replyCode & FZ_REPLY_CHECKSUMMISMATCH) == FZ_REPLY_CHECKSUMMISMATCH) {
+				pEngineData->pItem->SetStatusMessage(CFileItem::Status::checksum_mismatch);
+				ResetEngine(*pEngineData, ResetReason::failure);
+				return;
+			}
+			else if ((replyCode & FZ_REPLY_CHECKSUMUNVERIFIED) == FZ_REPLY_CHECKSUMUNVERIFIED) {
+				// Retrying would not help, keep it in the failed list for the user to decide
+				pEngineData->pItem->SetStatusMessage(CFileItem::Status::checksum_unverified);
+				ResetEngine(*pEngineData, ResetReason::failure);
+				return;
+			}
 			else if ((replyCode & FZ_REPLY_WRITEFAILED) == FZ_REPLY_WRITEFAILED) {
 				pEngineData->pItem->SetStatusMessage(CFileItem::Status::local_file_unwriteable);
 				ResetEngine(*pEngineData, ResetReason::failure);
@@ -967,6 +1058,13 @@ void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification
 		return;
 	}
 
+	if (!pEngineData->queuedItems.empty()) {
+		// The engine is still busy with the queued transfers, the item gets
+		// retried once it is its turn again.
+		ResetEngine(*pEngineData, ResetReason::retry);
+		return;
+	}
+
 	SendNextCommand(*pEngineData);
 }
 
@@ -1004,6 +1102,14 @@ void CQueueView::ResetEngine(t_EngineData& data, const ResetReason reason)
 			SaveSetItemCount(m_itemCount);
 
 			CFileItem* const pFileItem = (CFileItem*)data.pItem;
+			if (data.segmentWriter) {
+				pFileItem->SetSegmentDone(static_cast<int64_t>(static_cast<segment_writer_factory const&>(*data.segmentWriter).done()));
+				data.segmentWriter.reset();
+				StoreItemChange(*pFileItem);
+			}
+			if (reason == ResetReason::success && pFileItem->GetSegment() && pServerItem) {
+				CompleteSegment(*pServerItem, *pFileItem);
+			}
 			if (pFileItem->Download()) {
 				const std::vector<CState*> *pStates = CContextManager::Get()->GetAllStates();
 				for (auto *pState : *pStates) {
@@ -1035,7 +1141,9 @@ void CQueueView::ResetEngine(t_EngineData& data, const ResetReason reason)
 		wxASSERT(data.pItem->m_pEngineData == &data);
 		if (data.pItem->IsActive()) {
 			data.pItem->SetActive(false);
+			StoreItemChange(*data.pItem);
 		}
+		data.pItem->m_pEngineData = nullptr;
 		if (data.pItem->Download()) {
 			wxASSERT(m_activeCountDown > 0);
 			if (m_activeCountDown > 0) {
@@ -1098,6 +1206,7 @@ void CQueueView::ResetEngine(t_EngineData& data, const ResetReason reason)
 		else if (reason != ResetReason::retry) {
 			RemoveItem(data.pItem, true);
 		}
+		CommitStorage();
 		data.pItem = 0;
 	}
 	wxASSERT(m_activeCount > 0);
@@ -1123,6 +1232,11 @@ void CQueueView::ResetEngine(t_EngineData& data, const ResetReason reason)
 
 	data.state = t_EngineData::none;
 
+	if (!data.queuedItems.empty()) {
+		// The engine has already moved on to the next transfer
+		StartQueuedTransfer(data);
+	}
+
 	AdvanceQueue();
 
 	m_waitStatusLineUpdate = false;
@@ -1133,6 +1247,13 @@ bool CQueueView::RemoveItem(CQueueItem* item, bool destroy, bool updateItemCount
 {
 	// RemoveItem assumes that the item has already been removed from all engines
 
+	int64_t const storageId = item->GetStorageId();
+	int64_t const serverStorageId = item->GetTopLevelItem()->GetStorageId();
+	if (!destroy) {
+		// Stored anew if it gets queued again
+		item->SetStorageId(0);
+	}
+
 	if (item->GetType() == QueueItemType::File) {
 		// Update size information
 		const CFileItem* const pFileItem = static_cast<CFileItem const*>(item);
@@ -1154,6 +1275,13 @@ bool CQueueView::RemoveItem(CQueueItem* item, bool destroy, bool updateItemCount
 
 	bool didRemoveParent = CQueueViewBase::RemoveItem(item, destroy, updateItemCount, updateSelections, forward);
 
+	StoreRemoval(storageId, serverStorageId, didRemoveParent);
+
+	if (m_serverList.empty() && !m_queue_loader) {
+		// Nothing left to share the paths with
+		CQueuePathTable::Get().Clear();
+	}
+
 	UpdateStatusLinePositions();
 
 	return didRemoveParent;
@@ -1260,25 +1388,8 @@ void CQueueView::SendNextCommand(t_EngineData& engineData)
 			fileItem->SetStatusMessage(CFileItem::Status::transferring);
 			RefreshItem(engineData.pItem);
 
-			std::wstring extraFlags;
-			std::string persistentState;
-			auto extraData = fileItem->GetExtraData();
-			if (extraData) {
-				extraFlags = extraData->extraFlags_;
-				persistentState = extraData->persistentState_;
-			}
-
-			int res;
-			if (!fileItem->Download()) {
-				auto cmd = CFileTransferCommand(fz::file_reader_factory(fileItem->GetLocalPath().GetPath() + fileItem->GetLocalFile(), m_pMainFrame->GetEngineContext().GetThreadPool()),
-					fileItem->GetRemotePath(), fileItem->GetRemoteFile(), fileItem->flags(), extraFlags, persistentState);
-				res = engineData.pEngine->Execute(cmd);
-			}
-			else {
-				auto cmd = CFileTransferCommand(fz::file_writer_factory(fileItem->GetLocalPath().GetPath() + fileItem->GetLocalFile(), m_pMainFrame->GetEngineContext().GetThreadPool()),
-					fileItem->GetRemotePath(), fileItem->GetRemoteFile(), fileItem->flags(), extraFlags, persistentState);
-				res = engineData.pEngine->Execute(cmd);
-			}
+			wxASSERT(engineData.queuedItems.empty());
+			int res = SendTransferCommand(engineData, *fileItem, false);
 
 			wxASSERT((res & FZ_REPLY_BUSY) != FZ_REPLY_BUSY);
 			if (res == FZ_REPLY_WOULDBLOCK) {
@@ -1329,6 +1440,92 @@ void CQueueView::SendNextCommand(t_EngineData& engineData)
 	}
 }
 
+int CQueueView::SendTransferCommand(t_EngineData& engineData, CFileItem& fileItem, bool queue)
+{
+	std::wstring extraFlags;
+	std::string persistentState;
+	auto extraData = fileItem.GetExtraData();
+	if (extraData) {
+		extraFlags = extraData->extraFlags_;
+		persistentState = extraData->persistentState_;
+	}
+
+	auto const send = [&](CFileTransferCommand const& cmd) {
+		return queue ? engineData.pEngine->Queue(cmd) : engineData.pEngine->Execute(cmd);
+	};
+
+	if (!fileItem.Download()) {
+		return send(CFileTransferCommand(fz::file_reader_factory(fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile(), m_pMainFrame->GetEngineContext().GetThreadPool()),
+			fileItem.GetRemotePath(), fileItem.GetRemoteFile(), fileItem.flags(), extraFlags, persistentState));
+	}
+	else if (auto const* segment = fileItem.GetSegment()) {
+		// The writer is tracked per engine, segments cannot be queued
+		wxASSERT(!queue);
+		segment_writer_factory writer(SegmentedDownloadFile(fileItem), m_pMainFrame->GetEngineContext().GetThreadPool(),
+			segment->fileSize_, segment->offset_, segment->length_, segment->done_);
+		engineData.segmentWriter = writer.clone();
+		return send(CFileTransferCommand(writer, fileItem.GetRemotePath(), fileItem.GetRemoteFile(), fileItem.flags(), extraFlags, persistentState));
+	}
+	else {
+		return send(CFileTransferCommand(fz::file_writer_factory(fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile(), m_pMainFrame->GetEngineContext().GetThreadPool()),
+			fileItem.GetRemotePath(), fileItem.GetRemoteFile(), fileItem.flags(), extraFlags, persistentState));
+	}
+}
+
+void CQueueView::QueueFollowingTransfers(t_EngineData& engineData)
+{
+	if (!engineData.active || engineData.transient || engineData.state != t_EngineData::transfer ||
+		!engineData.pItem || engineData.pItem->pending_remove() || m_quit || !m_activeMode)
+	{
+		return;
+	}
+
+	CServerItem* serverItem = static_cast<CServerItem*>(engineData.pItem->GetTopLevelItem());
+	if (!serverItem) {
+		return;
+	}
+
+	// Same direction as the current one, the queued transfers only take its
+	// place in the limits for concurrent up- and downloads.
+	TransferDirection const direction = engineData.pItem->Download() ? TransferDirection::download : TransferDirection::upload;
+
+	while (engineData.queuedItems.size() < max_queued_transfers) {
+		CFileItem* fileItem = serverItem->GetIdleChild(m_activeMode == 1, direction);
+
+		// Folders and downloads to be split into segments are left to
+		// TryStartNextTransfer.
+		if (!fileItem || fileItem->GetType() != QueueItemType::File || fileItem->GetSegment() || GetSegmentCount(*serverItem, *fileItem) > 1) {
+			break;
+		}
+
+		if (SendTransferCommand(engineData, *fileItem, true) != FZ_REPLY_WOULDBLOCK) {
+			break;
+		}
+
+		// Keeps it from getting started by another engine
+		fileItem->m_pEngineData = &engineData;
+		engineData.queuedItems.push_back(fileItem);
+	}
+}
+
+void CQueueView::StartQueuedTransfer(t_EngineData& engineData)
+{
+	CFileItem* const fileItem = engineData.queuedItems.front();
+	engineData.queuedItems.pop_front();
+
+	ActivateItem(engineData, *static_cast<CServerItem*>(fileItem->GetTopLevelItem()), *fileItem);
+	engineData.state = t_EngineData::transfer;
+
+	fileItem->SetStatusMessage(CFileItem::Status::transferring);
+	RefreshItem(fileItem);
+
+	if (m_quit || !m_activeMode || fileItem->pending_remove()) {
+		// The engine has already started it. Once it replies, it gets reset
+		// like any other canceled transfer.
+		engineData.pEngine->Cancel();
+	}
+}
+
 bool CQueueView::SetActive(bool active)
 {
 	if (!active) {
@@ -1426,6 +1623,9 @@ bool CQueueView::Quit(bool force)
 
 	DeleteEngines();
 
+	// Files not loaded yet simply stay stored
+	m_queue_loader.reset();
+
 	if (m_quit == 1) {
 		SaveQueue();
 		m_quit = 2;
@@ -1456,6 +1656,11 @@ void CQueueView::CheckQueueState()
 	if (m_activeCount)
 		return;
 
+	if (m_activeMode && m_queue_loader && !m_quit) {
+		// Queue continues with the files still getting loaded
+		return;
+	}
+
 	if (m_activeMode) {
 		m_activeMode = 0;
 		/* Users don't seem to like this, so comment it out for now.
@@ -1486,6 +1691,7 @@ void CQueueView::CheckQueueState()
 bool CQueueView::IncreaseErrorCount(t_EngineData& engineData)
 {
 	++engineData.pItem->m_errorCount;
+	StoreItemChange(*engineData.pItem);
 	if (engineData.pItem->m_errorCount <= options_.get_int(OPTION_RECONNECTCOUNT)) {
 		return true;
 	}
@@ -1565,6 +1771,11 @@ void CQueueView::SaveQueue(bool silent)
 		return;
 	}
 
+	if (m_incremental_storage) {
+		CommitStorage(silent);
+		return;
+	}
+
 	// While not really needed anymore using sqlite3, we still take the mutex
 	// just as extra precaution. Better 'save' than sorry.
 	CInterProcessMutex mutex(MUTEX_QUEUE);
@@ -1582,6 +1793,61 @@ void CQueueView::LoadQueue()
 	// to the same file or one is reading while the other one writes.
 	CInterProcessMutex mutex(MUTEX_QUEUE);
 
+	// Kiosk mode 2 doesn't save queue
+	if (options_.get_int(OPTION_DEFAULT_KIOSKMODE) != 2) {
+		// The first instance takes over the stored queue and keeps it up to date.
+		// Other instances leave it alone and add their queue to it when closed.
+		m_queue_owner = std::make_unique<CInterProcessMutex>(MUTEX_QUEUE_OWNER, false);
+		int const owner = m_queue_owner->TryLock();
+		if (!owner) {
+			m_queue_owner.reset();
+			return;
+		}
+		else if (owner < 0 || !m_queue_storage.EnableIncremental()) {
+			// Load and clear the stored queue, save it again on exit.
+			m_queue_owner.reset();
+		}
+	}
+	if (m_queue_owner) {
+		// Only the servers are read right away, so that startup does not
+		// depend on the size of the queue.
+		auto loader = std::make_unique<queue_loader>();
+		if (!m_queue_storage.BeginTransaction()) {
+			loader->error_ = true;
+		}
+		else {
+			if (!m_queue_storage.RemoveOrphans()) {
+				loader->error_ = true;
+			}
+
+			Site site;
+			int64_t id = m_queue_storage.GetServer(site, true);
+			for (; id > 0; id = m_queue_storage.GetServer(site, false)) {
+				loader->servers_.emplace_back(id, site);
+			}
+			if (id < 0) {
+				loader->error_ = true;
+			}
+
+			loader->last_ = m_queue_storage.GetLastFileId();
+			if (loader->last_ < 0) {
+				loader->error_ = true;
+			}
+
+			// Stored queue is kept as it is
+			if (!m_queue_storage.EndTransaction()) {
+				loader->error_ = true;
+			}
+		}
+		m_incremental_storage = true;
+
+		m_queue_loader = std::move(loader);
+		if (LoadQueueBatch(queue_load_batch_size)) {
+			CallAfter(&CQueueView::ContinueLoadingQueue);
+		}
+		return;
+	}
+
 	bool error = false;
 
 	if (!m_queue_storage.BeginTransaction()) {
@@ -1644,9 +1910,235 @@ void CQueueView::LoadQueue()
 	m_insertionCount = 0;
 	CommitChanges();
 	if (error) {
-		wxString file = m_queue_storage.GetDatabaseFilename();
-		wxString msg = wxString::Format(_("An error occurred loading the transfer queue from \"%s\".\nSome queue items might not have been restored."), file);
-		wxMessageBoxEx(msg, _("Error loading queue"), wxICON_ERROR);
+		ShowLoadQueueError(m_queue_storage);
+	}
+}
+
+bool CQueueView::LoadQueueBatch(int count)
+{
+	auto & loader = *m_queue_loader;
+
+	bool need_refresh{};
+	while (loader.server_ < loader.servers_.size()) {
+		int64_t const id = loader.servers_[loader.server_].first;
+
+		std::vector<CFileItem*> files;
+		int const rows = m_queue_storage.GetFiles(files, id, loader.after_, loader.last_, count > 0 ? count : -1);
+		if (rows < 0) {
+			loader.error_ = true;
+		}
+
+		if (!files.empty()) {
+			CServerItem* pServerItem = CreateServerItem(loader.servers_[loader.server_].second);
+			if (!pServerItem->GetStorageId()) {
+				// Not there or removed since loading the previous batch
+				pServerItem->SetStorageId(id);
+				loader.merged_.erase(id);
+			}
+			else if (pServerItem->GetStorageId() != id) {
+				loader.merged_[id] = pServerItem->GetStorageId();
+			}
+
+			for (auto * fileItem : files) {
+				fileItem->SetParent(pServerItem);
+				fileItem->SetPriority(fileItem->GetPriority());
+				InsertItem(pServerItem, fileItem);
+			}
+			loader.loaded_ = true;
+
+			if (m_insertionStart >= 0 && m_insertionStart <= GetTopItem() + GetCountPerPage() + 1) {
+				need_refresh = true;
+			}
+			CommitChanges();
+		}
+
+		if (count > 0 && rows >= count) {
+			// There might be more
+			break;
+		}
+
+		if (!loader.loaded_ && rows >= 0) {
+			// Nothing but invalid rows
+			loader.removed_.push_back(id);
+		}
+		++loader.server_;
+		loader.after_ = 0;
+		loader.loaded_ = false;
+
+		if (count > 0 && rows > 0) {
+			count -= rows;
+		}
+	}
+
+	UpdateStatusLinePositions();
+	if (need_refresh) {
+		RefreshListOnly(false);
+	}
+
+	if (loader.server_ < loader.servers_.size()) {
+		return true;
+	}
+
+	// Servers stored more than once, e.g. by other instances, get merged
+	bool success = true;
+	for (auto const& server : loader.merged_) {
+		success &= m_queue_storage.MergeServer(server.first, server.second);
+	}
+	for (auto const id : loader.removed_) {
+		auto const it = std::find_if(m_serverList.cbegin(), m_serverList.cend(), [id](CServerItem const* item) { return item->GetStorageId() == id; });
+		if (it == m_serverList.cend()) {
+			success &= m_queue_storage.RemoveServer(id);
+		}
+	}
+	if (!loader.merged_.empty() || !loader.removed_.empty()) {
+		OnStorageChange(success);
+	}
+
+	bool const error = loader.error_ || !success;
+	m_queue_loader.reset();
+
+	if (error) {
+		ShowLoadQueueError(m_queue_storage);
+	}
+
+	return false;
+}
+
+void CQueueView::ContinueLoadingQueue()
+{
+	if (!m_queue_loader || m_quit) {
+		return;
+	}
+
+	bool const more = LoadQueueBatch(queue_load_batch_size);
+
+	if (m_activeMode) {
+		AdvanceQueue();
+	}
+
+	if (more) {
+		CallAfter(&CQueueView::ContinueLoadingQueue);
+	}
+}
+
+void CQueueView::FinishLoadingQueue()
+{
+	if (m_queue_loader) {
+		LoadQueueBatch(0);
+	}
+}
+
+void CQueueView::StoreItem(CQueueItem & item)
+{
+	if (!m_incremental_storage || item.GetStorageId()) {
+		// Not stored or loaded from storage
+		return;
+	}
+
+	if (item.GetType() == QueueItemType::File && static_cast<CFileItem&>(item).m_edit != CEditHandler::none) {
+		// Files opened for editing are never stored
+		return;
+	}
+
+	auto & serverItem = static_cast<CServerItem&>(*item.GetTopLevelItem());
+	bool ret = true;
+	if (!serverItem.GetStorageId()) {
+		ret = m_queue_storage.AddServer(serverItem);
+	}
+	OnStorageChange(ret && m_queue_storage.AddItem(item));
+}
+
+void CQueueView::StoreItemChange(CQueueItem const& item)
+{
+	if (!m_incremental_storage) {
+		return;
+	}
+
+	bool ret = true;
+	if (item.GetType() == QueueItemType::Server) {
+		auto const& serverItem = static_cast<CServerItem const&>(item);
+		auto const& children = serverItem.GetChildren();
+		for (auto it = children.begin() + serverItem.GetRemovedAtFront(); it != children.end(); ++it) {
+			ret &= m_queue_storage.UpdateItem(**it);
+		}
+	}
+	else {
+		ret = m_queue_storage.UpdateItem(item);
+	}
+	OnStorageChange(ret);
+}
+
+void CQueueView::StoreServer(CServerItem & item)
+{
+	if (!m_incremental_storage || !item.GetStorageId()) {
+		return;
+	}
+
+	// Files are loaded in the order they got stored. Storing them again
+	// keeps the server at its position relative to the other servers.
+	bool ret = true;
+	auto const& children = item.GetChildren();
+	for (auto it = children.begin() + item.GetRemovedAtFront(); it != children.end(); ++it) {
+		CQueueItem & child = **it;
+		if (child.GetStorageId()) {
+			ret &= m_queue_storage.RemoveItem(child.GetStorageId()) && m_queue_storage.AddItem(child);
+		}
+	}
+	OnStorageChange(ret);
+}
+
+void CQueueView::StoreRemoval(int64_t id, int64_t serverId, bool removeServer)
+{
+	if (!m_incremental_storage) {
+		return;
+	}
+
+	if (removeServer && m_queue_loader) {
+		// Files of the server not loaded yet get added to a new server item
+		if (id) {
+			OnStorageChange(m_queue_storage.RemoveItem(id));
+		}
+		if (serverId) {
+			m_queue_loader->removed_.push_back(serverId);
+		}
+	}
+	else if (removeServer) {
+		if (serverId) {
+			OnStorageChange(m_queue_storage.RemoveServer(serverId));
+		}
+	}
+	else if (id) {
+		OnStorageChange(m_queue_storage.RemoveItem(id));
+	}
+}
+
+void CQueueView::OnStorageChange(bool success)
+{
+	if (!success) {
+		m_storage_error = true;
+	}
+
+	if (!m_storage_timer.IsRunning()) {
+		m_storage_timer.Start(1000, true);
+	}
+}
+
+void CQueueView::CommitStorage(bool silent)
+{
+	m_storage_timer.Stop();
+
+	if (!m_queue_storage.Commit()) {
+		m_storage_error = true;
+		if (m_queue_storage.HasUncommittedChanges()) {
+			// Database is busy, try again later
+			m_storage_timer.Start(1000, true);
+		}
+	}
+
+	if (m_storage_error && !silent) {
+		m_storage_error = false;
+		wxString msg = wxString::Format(_("An error occurred saving the transfer queue to \"%s\".\nSome queue items might not have been saved."), m_queue_storage.GetDatabaseFilename());
+		wxMessageBoxEx(msg, _("Error saving queue"), wxICON_ERROR);
 	}
 }
 
@@ -1684,6 +2176,7 @@ void CQueueView::ImportQueue(pugi::xml_node element, bool updateSelections)
 				int overwrite_action = GetTextElementInt(file, "OverwriteAction", CFileExistsNotification::unknown);
 
 				std::wstring extraFlags = GetTextElement(file, "ExtraFlags");
+				auto const segment = CFileItem::segment::from_string(GetTextElement(file, "Segment"));
 
 				CServerPath remotePath;
 				if (!localFile.empty() && !remoteFile.empty() && remotePath.SetSafePath(safeRemotePath) &&
@@ -1711,6 +2204,9 @@ void CQueueView::ImportQueue(pugi::xml_node element, bool updateSelections)
 						previousLocalPath, previousRemotePath, size, extraFlags);
 					fileItem->SetPriorityRaw(QueuePriority(priority));
 					fileItem->m_errorCount = errorCount;
+					if (flags & transfer_flags::download) {
+						fileItem->SetSegment(segment);
+					}
 					InsertItem(pServerItem, fileItem);
 
 					if (overwrite_action > 0 && overwrite_action < CFileExistsNotification::ACTION_COUNT) {
@@ -1941,13 +2437,36 @@ void CQueueView::RemoveAll()
 		}
 	}
 
+	FinishLoadingQueue();
+
 	std::vector<CServerItem*> newServerList;
 	m_itemCount = 0;
 	for (auto iter = m_serverList.begin(); iter != m_serverList.end(); ++iter) {
+		std::vector<int64_t> storageIds;
+		if (m_incremental_storage) {
+			auto const& children = (*iter)->GetChildren();
+			for (auto it = children.begin() + (*iter)->GetRemovedAtFront(); it != children.end(); ++it) {
+				storageIds.push_back((*it)->GetStorageId());
+			}
+		}
+
 		if ((*iter)->TryRemoveAll()) {
+			StoreRemoval(0, (*iter)->GetStorageId(), true);
 			delete *iter;
 		}
 		else {
+			// Remaining children keep their order
+			auto const& children = (*iter)->GetChildren();
+			size_t remaining{};
+			for (auto const id : storageIds) {
+				if (remaining < children.size() && children[remaining]->GetStorageId() == id) {
+					++remaining;
+				}
+				else {
+					StoreRemoval(id, 0, false);
+				}
+			}
+
 			newServerList.push_back(*iter);
 			m_itemCount += 1 + (*iter)->GetChildrenCount(true);
 		}
@@ -2015,6 +2534,9 @@ void CQueueView::OnRemoveSelected(wxCommandEvent&)
 			continue;
 		}
 		else if (pItem->GetType() == QueueItemType::Server) {
+			// Includes the files of it not loaded yet
+			FinishLoadingQueue();
+
 			CServerItem* pServer = (CServerItem*)pItem;
 			StopItem(pServer, false);
 
@@ -2025,7 +2547,7 @@ void CQueueView::OnRemoveSelected(wxCommandEvent&)
 				 pItem->GetType() == QueueItemType::Folder)
 		{
 			CFileItem* pFile = (CFileItem*)pItem;
-			if (pFile->IsActive()) {
+			if (pFile->IsActive() || pFile->m_pEngineData) {
 				pFile->set_pending_remove(true);
 				StopItem(pFile);
 				continue;
@@ -2061,7 +2583,9 @@ void CQueueView::OnRemoveSelected(wxCommandEvent&)
 bool CQueueView::StopItem(CFileItem* item)
 {
 	if (!item->IsActive()) {
-		return true;
+		// A transfer queued in the engine gets canceled once it is its turn,
+		// see StartQueuedTransfer
+		return !item->m_pEngineData;
 	}
 
 	((CServerItem*)item->GetTopLevelItem())->QueueImmediateFile(item);
@@ -2097,7 +2621,7 @@ bool CQueueView::StopItem(CServerItem* pServerItem, bool updateSelections)
 			 pItem->GetType() == QueueItemType::Folder)
 		{
 			CFileItem* pFile = (CFileItem*)pItem;
-			if (pFile->IsActive()) {
+			if (pFile->IsActive() || pFile->m_pEngineData) {
 				pFile->set_pending_remove(true);
 				StopItem(pFile);
 				continue;
@@ -2122,8 +2646,10 @@ bool CQueueView::StopItem(CServerItem* pServerItem, bool updateSelections)
 
 void CQueueView::SetDefaultFileExistsAction(CFileExistsNotification::OverwriteAction action, const TransferDirection direction)
 {
-	for (auto iter = m_serverList.begin(); iter != m_serverList.end(); ++iter)
+	for (auto iter = m_serverList.begin(); iter != m_serverList.end(); ++iter) {
 		(*iter)->SetDefaultFileExistsAction(action, direction);
+		StoreItemChange(**iter);
+	}
 }
 
 void CQueueView::OnSetDefaultFileExistsAction(wxCommandEvent &)
@@ -2251,7 +2777,19 @@ void CQueueView::OnSetDefaultFileExistsAction(wxCommandEvent &)
 		default:
 			break;
 		}
+		StoreItemChange(*pItem);
+	}
+}
+
+int CQueueView::GetActiveEngineCount(CServer const& server) const
+{
+	int count = 0;
+	for (auto const* pEngineData : m_engineData) {
+		if (pEngineData->active && !pEngineData->transient && pEngineData->lastSite.server == server) {
+			++count;
+		}
 	}
+	return count;
 }
 
 t_EngineData* CQueueView::GetIdleEngine(Site const& site, bool allowTransient)
@@ -2418,6 +2956,11 @@ void CQueueView::UpdateItemSize(CFileItem* pItem, int64_t size)
 {
 	wxASSERT(pItem);
 
+	// The engine reports the size of the whole file, the item only covers its segment
+	if (pItem->GetSegment()) {
+		return;
+	}
+
 	int64_t const oldSize = pItem->GetSize();
 	if (size == oldSize) {
 		return;
@@ -2441,10 +2984,178 @@ void CQueueView::UpdateItemSize(CFileItem* pItem, int64_t size)
 	}
 
 	pItem->SetSize(size);
+	StoreItemChange(*pItem);
 
 	DisplayQueueSize();
 }
 
+int CQueueView::GetSegmentCount(CServerItem const& serverItem, CFileItem const& fileItem) const
+{
+	int maxSegments = options_.get_int(OPTION_SEGMENTED_DOWNLOADS);
+	if (maxSegments < 2) {
+		return 1;
+	}
+
+	if (fileItem.GetType() != QueueItemType::File || !fileItem.Download() || fileItem.GetSegment() ||
+		fileItem.m_edit != CEditHandler::none || (fileItem.flags() & ftp_transfer_flags::ascii))
+	{
+		return 1;
+	}
+
+	// Needs support for ranged downloads, which the other protocols lack
+	// in the engine.
+	CServer const& server = serverItem.GetSite().server;
+	switch (server.GetProtocol()) {
+	case FTP:
+	case FTPS:
+	case FTPES:
+	case INSECURE_FTP:
+	case SFTP:
+	case HTTP:
+	case HTTPS:
+		break;
+	default:
+		return 1;
+	}
+
+	maxSegments = std::min(maxSegments, options_.get_int(OPTION_NUMTRANSFERS));
+	if (server.MaximumMultipleConnections() > 0) {
+		maxSegments = std::min(maxSegments, server.MaximumMultipleConnections());
+	}
+
+	int64_t const size = fileItem.GetSize();
+	int64_t const minSize = static_cast<int64_t>(options_.get_int(OPTION_SEGMENTED_DOWNLOAD_MINSIZE)) * 1024 * 1024;
+	if (size <= 0 || minSize <= 0) {
+		return 1;
+	}
+	return static_cast<int>(std::max(static_cast<int64_t>(1), std::min(static_cast<int64_t>(maxSegments), size / minSize)));
+}
+
+bool CQueueView::SplitDownload(CServerItem& serverItem, CFileItem& fileItem)
+{
+	int const count = GetSegmentCount(serverItem, fileItem);
+	if (count < 2) {
+		return false;
+	}
+
+	int64_t const size = fileItem.GetSize();
+
+	// Only new files are split, anything else goes through the
+	// usual file exists handling.
+	std::wstring const localFile = fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile();
+	if (fz::local_filesys::get_file_type(fz::to_native(localFile)) != fz::local_filesys::unknown) {
+		return false;
+	}
+
+	// All segments write into the same temporary file, it needs to exist
+	// with its final size. It only gets its real name once every segment
+	// has succeeded, see CompleteSegment.
+	std::wstring const partFile = SegmentedDownloadFile(fileItem);
+	if (fz::local_filesys::get_file_type(fz::to_native(partFile)) != fz::local_filesys::unknown) {
+		return false;
+	}
+	wxFileName::Mkdir(fileItem.GetLocalPath().GetPath(), 0777, wxPATH_MKDIR_FULL);
+	{
+		fz::file f(fz::to_native(partFile), fz::file::writing, fz::file::empty);
+		if (!f || f.seek(size, fz::file::begin) != size || !f.truncate()) {
+			f.close();
+			wxRemoveFile(partFile);
+			return false;
+		}
+	}
+
+	std::wstring targetFile;
+	std::wstring extraFlags;
+	auto const& extraData = fileItem.GetExtraData();
+	if (extraData) {
+		targetFile = extraData->targetFile_;
+		extraFlags = extraData->extraFlags_;
+	}
+
+	int64_t const length = size / count;
+	UpdateItemSize(&fileItem, length);
+	fileItem.SetSegment({0, length, size, 0});
+	StoreItemChange(fileItem);
+
+	for (int i = 1; i < count; ++i) {
+		int64_t const offset = length * i;
+		int64_t const segmentLength = (i == count - 1) ? (size - offset) : length;
+
+		// Not queued so that the segments get started right away
+		CFileItem* segmentItem = new CFileItem(&serverItem, fileItem.flags() - queue_flags::mask,
+			fileItem.GetSourceFile(), targetFile, fileItem.GetLocalPath(), fileItem.GetRemotePath(),
+			segmentLength, extraFlags);
+		segmentItem->SetSegment({offset, segmentLength, size, 0});
+		segmentItem->SetPriorityRaw(fileItem.GetPriority());
+		segmentItem->m_defaultFileExistsAction = fileItem.m_defaultFileExistsAction;
+		InsertItem(&serverItem, segmentItem);
+	}
+
+	return true;
+}
+
+std::wstring CQueueView::SegmentedDownloadFile(CFileItem const& fileItem)
+{
+	return fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile() + L".fzpart";
+}
+
+void CQueueView::CompleteSegment(CServerItem& serverItem, CFileItem& fileItem)
+{
+	// Each successful segment passes its length on to the other segments of
+	// the same file, including failed ones which might get requeued later.
+	// That way the last one to finish knows whether all data has arrived.
+	// Removed segments never pass theirs on, so their file keeps its
+	// temporary name.
+	auto const segment = *fileItem.GetSegment();
+
+	bool last = true;
+	auto const passOn = [&](CServerItem* pServerItem, bool store) {
+		if (!pServerItem) {
+			return;
+		}
+		auto const& children = pServerItem->GetChildren();
+		for (auto it = children.begin() + pServerItem->GetRemovedAtFront(); it != children.end(); ++it) {
+			CQueueItem* child = *it;
+			if (child == &fileItem || child->GetType() != QueueItemType::File) {
+				continue;
+			}
+			auto & other = static_cast<CFileItem&>(*child);
+			auto const* otherSegment = other.GetSegment();
+			if (!otherSegment || otherSegment->fileSize_ != segment.fileSize_ ||
+				other.GetLocalPath() != fileItem.GetLocalPath() || other.GetLocalFile() != fileItem.GetLocalFile())
+			{
+				continue;
+			}
+			other.AddSegmentOthersDone(segment.length_);
+			if (store) {
+				StoreItemChange(other);
+			}
+			last = false;
+		}
+	};
+	passOn(&serverItem, true);
+
+	// Failed items are not part of the stored queue
+	passOn(m_pQueue->GetQueueView_Failed()->GetServerItem(serverItem.GetSite()), false);
+
+	if (!last) {
+		return;
+	}
+
+	std::wstring const partFile = SegmentedDownloadFile(fileItem);
+	std::wstring const localFile = fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile();
+	if (segment.othersDone_ + segment.length_ != segment.fileSize_) {
+		m_pMainFrame->GetStatusView()->AddToLog(logmsg::error, fz::sprintf(fztranslate("Not all segments of \"%s\" have been downloaded, keeping the partial data in \"%s\""), localFile, partFile), fz::datetime::now());
+		return;
+	}
+
+	if (fz::local_filesys::get_file_type(fz::to_native(localFile)) != fz::local_filesys::unknown ||
+		!fz::rename_file(fz::to_native(partFile), fz::to_native(localFile)))
+	{
+		m_pMainFrame->GetStatusView()->AddToLog(logmsg::error, fz::sprintf(fztranslate("Could not rename \"%s\" to \"%s\""), partFile, localFile), fz::datetime::now());
+	}
+}
+
 void CQueueView::AdvanceQueue(bool refresh)
 {
 	static bool insideAdvanceQueue = false;
@@ -2456,6 +3167,12 @@ void CQueueView::AdvanceQueue(bool refresh)
 	while (TryStartNextTransfer()) {
 	}
 
+	// Only after the idle engines got their transfers, so that they do not
+	// get starved by the queued ones
+	for (auto * pEngineData : m_engineData) {
+		QueueFollowingTransfers(*pEngineData);
+	}
+
 	// Set timer for connected, idle engines
 	for (unsigned int i = 0; i < m_engineData.size(); ++i) {
 		if (m_engineData[i]->active || m_engineData[i]->transient) {
@@ -2493,6 +3210,8 @@ void CQueueView::InsertItem(CServerItem* pServerItem, CQueueItem* pItem)
 {
 	CQueueViewBase::InsertItem(pServerItem, pItem);
 
+	StoreItem(*pItem);
+
 	if (pItem->GetType() == QueueItemType::File) {
 		CFileItem* pFileItem = (CFileItem*)pItem;
 
@@ -2531,6 +3250,11 @@ void CQueueView::OnTimer(wxTimerEvent& event)
 		return;
 	}
 
+	if (id == m_storage_timer.GetId()) {
+		CommitStorage();
+		return;
+	}
+
 	for (auto & pData : m_engineData) {
 		if (pData->m_idleDisconnectTimer && !pData->m_idleDisconnectTimer->IsRunning()) {
 			delete pData->m_idleDisconnectTimer;
@@ -2604,6 +3328,7 @@ void CQueueView::OnSetPriority(wxCommandEvent& event)
 		}
 
 		pItem->SetPriority(priority);
+		StoreItemChange(*pItem);
 	}
 
 	RefreshListOnly();
@@ -2964,6 +3689,7 @@ void CQueueView::RenameFileInTransfer(CFileZillaEngine *pEngine, std::wstring co
 	else {
 		pFile->SetTargetFile(newName);
 	}
+	StoreItemChange(*pFile);
 
 	RefreshItem(pFile);
 }
@@ -3107,10 +3833,20 @@ void CQueueView::OnColumnClicked(wxListEvent &event)
 	int const col = event.GetColumn();
 	bool const reverse = wxGetKeyState(WXK_SHIFT);
 
+	FinishLoadingQueue();
+
 	for (auto * serverItem : m_serverList) {
 		serverItem->Sort(col, reverse);
+		StoreServer(*serverItem);
 	}
 
 	RefreshListOnly();
 	UpdateStatusLinePositions();
 }
+
+void CQueueView::WriteToFile(pugi::xml_node element)
+{
+	// Files still in the database would be missing otherwise
+	FinishLoadingQueue();
+	CQueueViewBase::WriteToFile(element);
+}
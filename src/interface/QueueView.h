@@ -14,6 +14,7 @@
 
 #include <wx/progdlg.h>
 
+#include <deque>
 #include <list>
 #include <set>
 
@@ -36,6 +37,7 @@ enum type {
 };
 }
 
+class CInterProcessMutex;
 class CStatusLineCtrl;
 class CFileItem;
 struct t_EngineData final
@@ -80,6 +82,14 @@ struct t_EngineData final
 	Site lastSite;
 	CStatusLineCtrl* pStatusLineCtrl;
 	wxTimer* m_idleDisconnectTimer;
+
+	// Copy of the writer passed to the engine if transferring a segment,
+	// used to track the segment's progress.
+	std::unique_ptr<fz::writer_factory> segmentWriter;
+
+	// Files whose transfers are queued in the engine behind the one of
+	// pItem, in the order the engine executes them.
+	std::deque<CFileItem*> queuedItems;
 };
 
 class CMainFrame;
@@ -144,6 +154,9 @@ public:
 	void RemoveAll();
 
 	void LoadQueue();
+	void FinishLoadingQueue(); // Loads all stored files not loaded yet right away
+
+	virtual void WriteToFile(pugi::xml_node element) override;
 	void ImportQueue(pugi::xml_node element, bool updateSelections);
 
 	virtual void InsertItem(CServerItem* pServerItem, CQueueItem* pItem) override;
@@ -158,6 +171,9 @@ public:
 
 	std::shared_ptr<CActionAfterBlocker> GetActionAfterBlocker();
 
+	// Number of the queue's own engines busy with the given server
+	int GetActiveEngineCount(CServer const& server) const;
+
 protected:
 
 #ifdef __WXMSW__
@@ -169,6 +185,36 @@ protected:
 	void AdvanceQueue(bool refresh = true);
 	bool TryStartNextTransfer();
 
+	// Assigns the file to the engine and shows its status line
+	void ActivateItem(t_EngineData& engineData, CServerItem& serverItem, CFileItem& fileItem);
+
+	// Hands the transfer of the file to the engine. If queue is set, the
+	// engine executes it after the commands it is busy with.
+	int SendTransferCommand(t_EngineData& engineData, CFileItem& fileItem, bool queue);
+
+	// Keeps a few transfers queued in the engine behind the current one, so
+	// that it can start the next one without waiting for the queue view.
+	void QueueFollowingTransfers(t_EngineData& engineData);
+
+	// Called once the engine has moved on to the first of its queued
+	// transfers, makes it the current one.
+	void StartQueuedTransfer(t_EngineData& engineData);
+
+	// Number of segments a download would get split into
+	int GetSegmentCount(CServerItem const& serverItem, CFileItem const& fileItem) const;
+
+	// Splits a large download into several segments, each of which gets
+	// transferred concurrently as separate queue item.
+	bool SplitDownload(CServerItem& serverItem, CFileItem& fileItem);
+
+	// Name of the temporary file the segments of a download are written to
+	static std::wstring SegmentedDownloadFile(CFileItem const& fileItem);
+
+	// Called when a segment has been transferred successfully, no matter
+	// whether it got requeued from the failed list. Renames the temporary
+	// file once all segments of the file are done.
+	void CompleteSegment(CServerItem& serverItem, CFileItem& fileItem);
+
 	// Called from TryStartNextTransfer(), checks
 	// whether it is allowed to start another transfer on that server item
 	bool CanStartTransfer(const CServerItem& server_item, t_EngineData *&pEngineData);
@@ -279,6 +325,29 @@ protected:
 
 	CQueueStorage m_queue_storage;
 
+	// Set if this instance owns the stored queue. Instead of saving the
+	// whole queue on exit, changes are then stored as they happen and
+	// committed in batches by m_storage_timer. Only transfers starting
+	// and finishing get committed immediately.
+	std::unique_ptr<CInterProcessMutex> m_queue_owner;
+	bool m_incremental_storage{};
+	bool m_storage_error{};
+	wxTimer m_storage_timer;
+
+	void StoreItem(CQueueItem & item);
+	void StoreItemChange(CQueueItem const& item); // For server items, stores all its files
+	void StoreServer(CServerItem & item); // Rewrites the server with all its files
+	void StoreRemoval(int64_t id, int64_t serverId, bool removeServer);
+	void OnStorageChange(bool success);
+	void CommitStorage(bool silent = true);
+
+	// The owner of the stored queue only reads the servers on startup,
+	// their files get loaded in batches afterwards.
+	struct queue_loader;
+	std::unique_ptr<queue_loader> m_queue_loader;
+	bool LoadQueueBatch(int count); // Returns true if there are files left to load
+	void ContinueLoadingQueue();
+
 	void OnEngineEvent(CFileZillaEngine* engine);
 
 	void OnAskPassword();
@@ -416,9 +416,9 @@ bool CRemoteListView::IsItemValid(unsigned int item) const
 	return true;
 }
 
-void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
+std::vector<unsigned int> CRemoteListView::AddNewEntries(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
 {
-	size_t const to_add = pDirectoryListing->size() - m_pDirectoryListing->size();
+	size_t const old_size = m_pDirectoryListing->size();
 	m_pDirectoryListing = pDirectoryListing;
 	UpdateSortComparisonObject();
 
@@ -430,15 +430,9 @@ void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryLis
 	CGenericFileData last = m_fileData.back();
 	m_fileData.pop_back();
 
-	bool const has_selections = GetSelectedItemCount() != 0;
-
-	std::vector<int> added_indexes;
-	if (has_selections) {
-		added_indexes.reserve(to_add);
-	}
-
-	auto& compare = GetSortComparisonObject();
-	for (size_t i = pDirectoryListing->size() - to_add; i < pDirectoryListing->size(); ++i) {
+	std::vector<unsigned int> visible;
+	visible.reserve(pDirectoryListing->size() - old_size);
+	for (size_t i = old_size; i < pDirectoryListing->size(); ++i) {
 		CDirentry const& entry = (*pDirectoryListing)[i];
 		CGenericFileData data;
 		if (entry.is_dir()) {
@@ -464,6 +458,38 @@ void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryLis
 			}
 		}
 
+		visible.push_back(static_cast<unsigned int>(i));
+	}
+
+	m_fileData.push_back(last);
+
+	return visible;
+}
+
+void CRemoteListView::FinishAddedEntries()
+{
+	SetItemCount(m_indexMapping.size());
+
+	if (m_pFilelistStatusBar) {
+		m_pFilelistStatusBar->SetHidden(m_pDirectoryListing->size() + 1 - m_indexMapping.size());
+	}
+
+	wxASSERT(m_indexMapping.size() <= m_pDirectoryListing->size() + 1);
+}
+
+void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
+{
+	std::vector<unsigned int> const visible = AddNewEntries(pDirectoryListing);
+
+	bool const has_selections = GetSelectedItemCount() != 0;
+
+	std::vector<int> added_indexes;
+	if (has_selections) {
+		added_indexes.reserve(visible.size());
+	}
+
+	auto& compare = GetSortComparisonObject();
+	for (unsigned int const i : visible) {
 		// Find correct position in index mapping
 		std::vector<unsigned int>::iterator start = m_indexMapping.begin();
 		if (m_hasParent) {
@@ -484,16 +510,37 @@ void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryLis
 		}
 	}
 
-	m_fileData.push_back(last);
-
-	SetItemCount(m_indexMapping.size());
+	FinishAddedEntries();
 	UpdateSelections_ItemsAdded(added_indexes);
+}
 
-	if (m_pFilelistStatusBar) {
-		m_pFilelistStatusBar->SetHidden(m_pDirectoryListing->size() + 1 - m_indexMapping.size());
+bool CRemoteListView::UpdateDirectoryListing_Appended(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
+{
+	// Unlike UpdateDirectoryListing_Added, this sorts the new entries once and
+	// merges them in a single pass, as a batch can contain many thousands
+	// of entries.
+	// Selections would need to be moved around, leave that to a full refresh.
+	if (GetSelectedItemCount()) {
+		return false;
 	}
 
-	wxASSERT(m_indexMapping.size() <= pDirectoryListing->size() + 1);
+	std::vector<unsigned int> const visible = AddNewEntries(pDirectoryListing);
+
+	size_t const old_mapping_size = m_indexMapping.size();
+	m_indexMapping.insert(m_indexMapping.end(), visible.cbegin(), visible.cend());
+
+	auto start = m_indexMapping.begin();
+	if (m_hasParent) {
+		++start;
+	}
+	auto const middle = m_indexMapping.begin() + old_mapping_size;
+	auto& compare = GetSortComparisonObject();
+	std::sort(middle, m_indexMapping.end(), SortPredicate(compare));
+	std::inplace_merge(start, middle, m_indexMapping.end(), SortPredicate(compare));
+
+	FinishAddedEntries();
+
+	return true;
 }
 
 void CRemoteListView::UpdateDirectoryListing_Removed(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
@@ -696,6 +743,17 @@ void CRemoteListView::SetDirectoryListing(std::shared_ptr<CDirectoryListing> con
 	else if (m_pDirectoryListing->path != pDirectoryListing->path) {
 		reset = true;
 	}
+	else if (m_pDirectoryListing->partial() && pDirectoryListing->partial() && !IsComparing() &&
+		m_pDirectoryListing->m_firstListTime == pDirectoryListing->m_firstListTime &&
+		m_pDirectoryListing->size() <= pDirectoryListing->size())
+	{
+		// Next batch of a listing still being received, only the
+		// entries at the end are new.
+		if (UpdateDirectoryListing_Appended(pDirectoryListing)) {
+			RefreshListOnly();
+			return;
+		}
+	}
 	else if (m_pDirectoryListing->m_firstListTime == pDirectoryListing->m_firstListTime && !IsComparing()
 		&& m_pDirectoryListing->size() > 200)
 	{
@@ -766,6 +824,7 @@ void CRemoteListView::SetDirectoryListing(std::shared_ptr<CDirectoryListing> con
 		m_indexMapping.push_back(m_pDirectoryListing->size());
 
 		std::wstring const path = m_pDirectoryListing->path.GetPath();
+		std::vector<bool> const filtered = filter.GetFilterMatcher(false).filtered(*m_pDirectoryListing, path);
 
 		for (unsigned int i = 0; i < m_pDirectoryListing->size(); ++i) {
 			const CDirentry& entry = (*m_pDirectoryListing)[i];
@@ -780,7 +839,7 @@ void CRemoteListView::SetDirectoryListing(std::shared_ptr<CDirectoryListing> con
 			}
 			m_fileData.emplace_back(std::move(data));
 
-			if (filter.FilenameFiltered(entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time)) {
+			if (filtered[i]) {
 				++hidden;
 				continue;
 			}
@@ -1874,13 +1933,14 @@ void CRemoteListView::ApplyCurrentFilter()
 	int hidden = 0;
 
 	std::wstring const path = m_pDirectoryListing->path.GetPath();
+	std::vector<bool> const filtered = filter.GetFilterMatcher(false).filtered(*m_pDirectoryListing, path);
 
 	m_indexMapping.clear();
 	size_t const count = m_pDirectoryListing->size();
 	m_indexMapping.push_back(count);
 	for (size_t i = 0; i < count; ++i) {
 		const CDirentry& entry = (*m_pDirectoryListing)[i];
-		if (filter.FilenameFiltered(entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time)) {
+		if (filtered[i]) {
 			++hidden;
 			continue;
 		}
@@ -73,6 +73,14 @@ protected:
 	bool UpdateDirectoryListing(std::shared_ptr<CDirectoryListing> const& pDirectoryListing);
 	void UpdateDirectoryListing_Removed(std::shared_ptr<CDirectoryListing> const& pDirectoryListing);
 	void UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryListing> const& pDirectoryListing);
+	bool UpdateDirectoryListing_Appended(std::shared_ptr<CDirectoryListing> const& pDirectoryListing);
+
+	// Shared by the two above: Switches to the new listing and creates the
+	// file data for the entries at its end. Returns the listing indexes of
+	// the entries not hidden by the filters, the caller has to insert them
+	// into the index mapping and then call FinishAddedEntries.
+	std::vector<unsigned int> AddNewEntries(std::shared_ptr<CDirectoryListing> const& pDirectoryListing);
+	void FinishAddedEntries();
 
 #ifdef __WXDEBUG__
 	void ValidateIndexMapping();
@@ -316,3 +316,14 @@ void CCommandQueue::ProcessDirectoryListing(CDirectoryListingNotification const&
 		CContextManager::Get()->ProcessDirectoryListing(m_state.GetSite().server, pListing, listingIsRecursive ? 0 : &m_state);
 	}
 }
+
+void CCommandQueue::ProcessPartialDirectoryListing(CPartialDirectoryListingNotification const& listingNotification)
+{
+	auto const firstListing = std::find_if(m_CommandList.begin(), m_CommandList.end(), [](CommandInfo const& v) { return v.command->GetId() == Command::list; });
+	if (firstListing == m_CommandList.end() || firstListing->origin == recursiveOperation) {
+		// Recursive operations need complete listings
+		return;
+	}
+
+	m_state.SetRemoteDirPartial(std::make_shared<CDirectoryListing>(listingNotification.GetListing()));
+}
@@ -42,6 +42,7 @@ public:
 	bool EngineLocked() const { return exclusive_lock_; }
 
 	void ProcessDirectoryListing(CDirectoryListingNotification const& listingNotification);
+	void ProcessPartialDirectoryListing(CPartialDirectoryListingNotification const& listingNotification);
 
 protected:
 	void ProcessReply(int nReplyCode, Command commandId);
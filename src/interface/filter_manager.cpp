@@ -503,6 +503,29 @@ bool CFilterManager::FilenameFiltered(std::wstring const& name, std::wstring con
 	return false;
 }
 
+filter_matcher CFilterManager::GetFilterMatcher(bool local) const
+{
+	std::vector<CFilter> filters;
+	AddActiveFilters(filters, local);
+	return filter_matcher(filters);
+}
+
+void CFilterManager::AddActiveFilters(std::vector<CFilter> & filters, bool local) const
+{
+	if (m_filters_disabled) {
+		return;
+	}
+
+	CFilterSet const& set = global_filters_.filter_sets[global_filters_.current_filter_set];
+	auto const& active = local ? set.local : set.remote;
+
+	for (unsigned int i = 0; i < global_filters_.filters.size(); ++i) {
+		if (active[i]) {
+			filters.push_back(global_filters_.filters[i]);
+		}
+	}
+}
+
 void CFilterManager::LoadFilters()
 {
 	if (m_loaded) {
@@ -3,6 +3,7 @@
 
 #include "dialogex.h"
 #include "../commonui/filter.h"
+#include "../commonui/filter_matcher.h"
 
 class CFilterManager : public filter_manager
 {
@@ -13,6 +14,9 @@ public:
 	// Note: Under non-windows, attributes are permissions
 	bool FilenameFiltered(std::wstring const& name, std::wstring const& path, bool dir, int64_t size, bool local, int attributes, fz::datetime const& date) const override;
 	using filter_manager::FilenameFiltered; //also get the other function with same name to scope
+
+	// Same filters as FilenameFiltered, for filtering whole directories
+	virtual filter_matcher GetFilterMatcher(bool local) const;
 	static bool HasActiveFilters(bool ignore_disabled = false);
 
 	bool HasSameLocalAndRemoteFilters() const;
@@ -31,6 +35,8 @@ protected:
 	static void LoadFilters();
 	static void SaveFilters();
 
+	void AddActiveFilters(std::vector<CFilter> & filters, bool local) const;
+
 	static bool m_loaded;
 
 	static filter_data global_filters_;
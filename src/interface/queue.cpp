@@ -10,6 +10,9 @@
 
 #include <wx/filedlg.h>
 
+#include <algorithm>
+#include <limits>
+
 CQueueItem::CQueueItem(CQueueItem* parent)
 	: m_parent(parent)
 {
@@ -44,7 +47,6 @@ void CQueueItem::AddChild(CQueueItem* item)
 	while (parent) {
 		if (parent->GetType() == QueueItemType::Server) {
 			static_cast<CServerItem*>(parent)->m_visibleOffspring += 1 + item->GetChildrenCount(true);
-			static_cast<CServerItem*>(parent)->m_maxCachedIndex = -1;
 		}
 		parent = parent->GetParent();
 	}
@@ -107,16 +109,7 @@ bool CQueueItem::RemoveChild(CQueueItem* pItem, bool destroy, bool forward)
 				delete pItem;
 			}
 
-			if (iter - m_children.begin() - m_removed_at_front <= 10) {
-				++m_removed_at_front;
-				unsigned int end = iter - m_children.begin();
-				for (int i = end; i >= m_removed_at_front; --i) {
-					m_children[i] = m_children[i - 1];
-				}
-			}
-			else {
-				m_children.erase(iter);
-			}
+			EraseChild(iter);
 
 			deleted = true;
 			return;
@@ -129,16 +122,7 @@ bool CQueueItem::RemoveChild(CQueueItem* pItem, bool destroy, bool forward)
 				visibleOffspring -= 1;
 				delete *iter;
 
-				if (iter - m_children.begin() - m_removed_at_front <= 10) {
-					++m_removed_at_front;
-					unsigned int end = iter - m_children.begin();
-					for (int i = end; i >= m_removed_at_front; --i) {
-						m_children[i] = m_children[i - 1];
-					}
-				}
-				else {
-					m_children.erase(iter);
-				}
+				EraseChild(iter);
 			}
 
 			deleted = true;
@@ -174,7 +158,6 @@ bool CQueueItem::RemoveChild(CQueueItem* pItem, bool destroy, bool forward)
 	CQueueItem* parent = GetParent();
 	while (parent) {
 		if (parent->GetType() == QueueItemType::Server) {
-			static_cast<CServerItem*>(parent)->m_maxCachedIndex = -1;
 			static_cast<CServerItem*>(parent)->m_visibleOffspring -= oldVisibleOffspring - visibleOffspring;
 		}
 		parent = parent->GetParent();
@@ -183,6 +166,20 @@ bool CQueueItem::RemoveChild(CQueueItem* pItem, bool destroy, bool forward)
 	return true;
 }
 
+void CQueueItem::EraseChild(std::vector<CQueueItem*>::iterator iter)
+{
+	if (iter - m_children.begin() - m_removed_at_front <= 10) {
+		++m_removed_at_front;
+		unsigned int end = iter - m_children.begin();
+		for (int i = end; i >= m_removed_at_front; --i) {
+			m_children[i] = m_children[i - 1];
+		}
+	}
+	else {
+		m_children.erase(iter);
+	}
+}
+
 CQueueItem* CQueueItem::GetTopLevelItem()
 {
 	if (!m_parent) {
@@ -222,6 +219,10 @@ int CQueueItem::GetItemIndex() const
 		return 0;
 	}
 
+	if (pParent->GetType() == QueueItemType::Server) {
+		return 1 + static_cast<CServerItem const*>(pParent)->GetChildRow(*this);
+	}
+
 	int index = 1;
 	for (std::vector<CQueueItem*>::const_iterator iter = pParent->m_children.begin() + pParent->m_removed_at_front; iter != pParent->m_children.end(); ++iter) {
 		if (*iter == this) {
@@ -234,6 +235,34 @@ int CQueueItem::GetItemIndex() const
 	return index + pParent->GetItemIndex();
 }
 
+CQueuePathTable& CQueuePathTable::Get()
+{
+	static CQueuePathTable table;
+	return table;
+}
+
+CLocalPath const& CQueuePathTable::Intern(CLocalPath const& path)
+{
+	if (path.empty()) {
+		return path;
+	}
+	return *localPaths_.insert(path).first;
+}
+
+CServerPath const& CQueuePathTable::Intern(CServerPath const& path)
+{
+	if (path.empty()) {
+		return path;
+	}
+	return *remotePaths_.insert(path).first;
+}
+
+void CQueuePathTable::Clear()
+{
+	localPaths_.clear();
+	remotePaths_.clear();
+}
+
 CFileItem::CFileItem(CServerItem* parent, transfer_flags const& flags,
 					 std::wstring const& sourceFile, std::wstring const& targetFile,
 					 CLocalPath const& localPath, CServerPath const& remotePath, int64_t size,
@@ -242,8 +271,8 @@ CFileItem::CFileItem(CServerItem* parent, transfer_flags const& flags,
 	, flags_(flags)
 	, m_sourceFile(sourceFile)
 	, extra_data_((targetFile.empty() && extraFlags.empty() && persistentState.empty()) ? fz::sparse_optional<extra_data>() : fz::sparse_optional<extra_data>({ targetFile, extraFlags, persistentState }))
-	, m_localPath(localPath)
-	, m_remotePath(remotePath)
+	, m_localPath(CQueuePathTable::Get().Intern(localPath))
+	, m_remotePath(CQueuePathTable::Get().Intern(remotePath))
 	, m_size(size)
 {
 }
@@ -281,11 +310,17 @@ void CFileItem::SetActive(const bool active)
 		wxASSERT(!GetChildrenCount(false));
 		AddChild(new CStatusItem);
 		flags_ |= queue_flags::active;
+		if (m_parent && m_parent->GetType() == QueueItemType::Server) {
+			static_cast<CServerItem*>(m_parent)->SetExpanded(*this, true);
+		}
 	}
 	else if (!active && IsActive()) {
 		CQueueItem* pItem = GetChild(0, false);
 		RemoveChild(pItem);
 		flags_ -= queue_flags::active;
+		if (m_parent && m_parent->GetType() == QueueItemType::Server) {
+			static_cast<CServerItem*>(m_parent)->SetExpanded(*this, false);
+		}
 	}
 }
 
@@ -316,12 +351,15 @@ void CFileItem::SaveItem(pugi::xml_node& element) const
 	if (extra_data_ && !extra_data_->extraFlags_.empty()) {
 		AddTextElement(file, "ExtraFlags", extra_data_->extraFlags_);
 	}
+	if (extra_data_ && extra_data_->segment_) {
+		AddTextElement(file, "Segment", extra_data_->segment_.to_string());
+	}
 	// Intentionally not exporting persistent state.
 }
 
 bool CFileItem::TryRemoveAll()
 {
-	if (!IsActive()) {
+	if (!IsActive() && !m_pEngineData) {
 		return true;
 	}
 
@@ -335,7 +373,7 @@ void CFileItem::SetTargetFile(std::wstring const& file)
 		if (!extra_data_) {
 			return;
 		}
-		if (extra_data_->extraFlags_.empty() && extra_data_->persistentState_.empty()) {
+		if (extra_data_->extraFlags_.empty() && extra_data_->persistentState_.empty() && !extra_data_->segment_) {
 			extra_data_.clear();
 		}
 		else {
@@ -358,7 +396,7 @@ void CFileItem::set_persistent_state(std::string && state)
 		if (!extra_data_) {
 			return;
 		}
-		if (extra_data_->extraFlags_.empty() && extra_data_->targetFile_.empty()) {
+		if (extra_data_->extraFlags_.empty() && extra_data_->targetFile_.empty() && !extra_data_->segment_) {
 			extra_data_.clear();
 		}
 		else {
@@ -375,6 +413,72 @@ void CFileItem::set_persistent_state(std::string && state)
 	}
 }
 
+std::wstring CFileItem::segment::to_string() const
+{
+	return fz::sprintf(L"%d %d %d %d %d", offset_, length_, fileSize_, done_, othersDone_);
+}
+
+CFileItem::segment CFileItem::segment::from_string(std::wstring_view const& s)
+{
+	auto const tokens = fz::strtok_view(s, L" ");
+	if (tokens.size() != 5) {
+		return {};
+	}
+
+	segment ret;
+	ret.offset_ = fz::to_integral<int64_t>(tokens[0], -1);
+	ret.length_ = fz::to_integral<int64_t>(tokens[1], -1);
+	ret.fileSize_ = fz::to_integral<int64_t>(tokens[2], -1);
+	ret.done_ = fz::to_integral<int64_t>(tokens[3], -1);
+	ret.othersDone_ = fz::to_integral<int64_t>(tokens[4], -1);
+	if (ret.offset_ < 0 || ret.length_ <= 0 || ret.done_ < 0 || ret.done_ > ret.length_ || ret.fileSize_ - ret.length_ < ret.offset_) {
+		return {};
+	}
+	if (ret.othersDone_ < 0 || ret.othersDone_ > ret.fileSize_ - ret.length_) {
+		return {};
+	}
+
+	return ret;
+}
+
+void CFileItem::SetSegment(segment const& s)
+{
+	if (!s) {
+		if (!extra_data_) {
+			return;
+		}
+		if (extra_data_->extraFlags_.empty() && extra_data_->targetFile_.empty() && extra_data_->persistentState_.empty()) {
+			extra_data_.clear();
+		}
+		else {
+			extra_data_->segment_ = segment();
+		}
+	}
+	else {
+		if (!extra_data_) {
+			extra_data_ = std::move(fz::sparse_optional<extra_data>({{}, {}, {}, s}));
+		}
+		else {
+			extra_data_->segment_ = s;
+		}
+	}
+}
+
+void CFileItem::SetSegmentDone(int64_t done)
+{
+	if (extra_data_ && extra_data_->segment_) {
+		extra_data_->segment_.done_ = std::clamp(done, int64_t(0), extra_data_->segment_.length_);
+	}
+}
+
+void CFileItem::AddSegmentOthersDone(int64_t length)
+{
+	if (extra_data_ && extra_data_->segment_) {
+		auto & s = extra_data_->segment_;
+		s.othersDone_ = std::min(s.othersDone_ + length, s.fileSize_ - s.length_);
+	}
+}
+
 void CFileItem::SetStatusMessage(CFileItem::Status status)
 {
 	m_status = status;
@@ -396,7 +500,9 @@ wxString const& CFileItem::GetStatusMessage() const
 		_("Could not write to local file"),
 		_("Could not start transfer"),
 		_("Transferring"),
-		_("Creating directory")
+		_("Creating directory"),
+		_("Checksum mismatch"),
+		_("Checksum not verified")
 	};
 
 	return statusTexts[std::underlying_type_t<Status>(m_status)];
@@ -453,8 +559,12 @@ wxString CServerItem::GetName() const
 
 void CServerItem::AddChild(CQueueItem* pItem)
 {
+	if (m_nextOrder == std::numeric_limits<uint32_t>::max()) {
+		RenumberChildren();
+	}
+	pItem->m_order = m_nextOrder++;
+
 	CQueueItem::AddChild(pItem);
-	m_maxCachedIndex = -1;
 	m_visibleOffspring += 1 + pItem->GetChildrenCount(true);
 	if (pItem->GetType() == QueueItemType::File ||
 		pItem->GetType() == QueueItemType::Folder)
@@ -571,8 +681,8 @@ void CServerItem::Sort(int col, bool reverse)
 
 	std::stable_sort(m_children.begin() + m_removed_at_front, m_children.end(), fn);
 
-	m_lookupCache.clear();
-	m_maxCachedIndex = -1;
+	RenumberChildren();
+	std::sort(m_expanded.begin(), m_expanded.end(), [](CQueueItem const* l, CQueueItem const* r) { return l->m_order < r->m_order; });
 
 	// Rebuild m_fileList
 	for (size_t i = 0; i < static_cast<size_t>(QueuePriority::count); ++i) {
@@ -588,66 +698,84 @@ void CServerItem::Sort(int col, bool reverse)
 
 CQueueItem* CServerItem::GetChild(unsigned int item, bool recursive)
 {
-	std::vector<CQueueItem*>::iterator iter;
+	unsigned int const count = m_children.size() - m_removed_at_front;
 	if (!recursive) {
-		if (item + m_removed_at_front >= m_children.size()) {
+		if (item >= count) {
 			return 0;
 		}
-		iter = m_children.begin();
-		iter += item + m_removed_at_front;
-		return *iter;
+		return m_children[m_removed_at_front + item];
 	}
 
-	if ((int)item <= m_maxCachedIndex) {
-		// Index is cached
-		iter = m_children.begin() + m_removed_at_front;
-		iter += m_lookupCache[item].child;
-		item -= m_lookupCache[item].index;
-		if (!item) {
-			return *iter;
+	// Rows taken by the offspring of the expanded children above the item
+	unsigned int extra{};
+	for (auto * expanded : m_expanded) {
+		unsigned int const row = (FindChild(*expanded) - m_children.cbegin()) - m_removed_at_front + extra;
+		if (item < row) {
+			break;
 		}
-		else {
-			return (*iter)->GetChild(item - 1);
+
+		unsigned int const rows = expanded->GetChildrenCount(true);
+		if (item == row) {
+			return expanded;
+		}
+		else if (item <= row + rows) {
+			return expanded->GetChild(item - row - 1);
 		}
+		extra += rows;
 	}
 
-	int index;
-	int child;
-	iter = m_children.begin() + m_removed_at_front;
-	if (m_maxCachedIndex == -1) {
-		child = 0;
-		index = 0;
-	}
-	else {
-		// Start with loop with the last cached item index
-		iter += m_lookupCache[m_maxCachedIndex].child + 1;
-		item -= m_maxCachedIndex + 1;
-		index = m_maxCachedIndex + 1;
-		child = m_lookupCache[m_maxCachedIndex].child + 1;
+	item -= extra;
+	if (item >= count) {
+		return 0;
 	}
+	return m_children[m_removed_at_front + item];
+}
 
-	for (; iter != m_children.end(); ++iter, ++child) {
-		if (!item) {
-			return *iter;
-		}
+int CServerItem::GetChildRow(CQueueItem const& child) const
+{
+	auto const begin = m_children.cbegin() + m_removed_at_front;
+	auto const cmp = [](CQueueItem const* item, uint32_t order) { return item->m_order < order; };
+	int row = std::lower_bound(begin, m_children.cend(), child.m_order, cmp) - begin;
 
-		unsigned int count = (*iter)->GetChildrenCount(true);
-		if (item > count) {
-			if (m_maxCachedIndex == -1 && m_lookupCache.size() < (unsigned int)m_visibleOffspring)
-				m_lookupCache.resize(m_visibleOffspring);
-			for (unsigned int k = index; k <= index + count; ++k) {
-				m_lookupCache[k].child = child;
-				m_lookupCache[k].index = index;
-			}
-			m_maxCachedIndex = index + count;
-			item -= count + 1;
-			index += count + 1;
-			continue;
+	for (auto const* expanded : m_expanded) {
+		if (expanded->m_order >= child.m_order) {
+			break;
 		}
+		row += expanded->GetChildrenCount(true);
+	}
 
-		return (*iter)->GetChild(item - 1);
+	return row;
+}
+
+std::vector<CQueueItem*>::const_iterator CServerItem::FindChild(CQueueItem const& child) const
+{
+	auto const cmp = [](CQueueItem const* item, uint32_t order) { return item->m_order < order; };
+	auto const it = std::lower_bound(m_children.cbegin() + m_removed_at_front, m_children.cend(), child.m_order, cmp);
+	if (it != m_children.cend() && *it == &child) {
+		return it;
+	}
+	return m_children.cend();
+}
+
+void CServerItem::RenumberChildren()
+{
+	m_nextOrder = 0;
+	for (auto it = m_children.begin() + m_removed_at_front; it != m_children.end(); ++it) {
+		(*it)->m_order = m_nextOrder++;
+	}
+}
+
+void CServerItem::SetExpanded(CQueueItem & child, bool expanded)
+{
+	auto const cmp = [](CQueueItem const* item, uint32_t order) { return item->m_order < order; };
+	auto const it = std::lower_bound(m_expanded.begin(), m_expanded.end(), child.m_order, cmp);
+	bool const found = it != m_expanded.end() && *it == &child;
+	if (expanded && !found) {
+		m_expanded.insert(it, &child);
+	}
+	else if (!expanded && found) {
+		m_expanded.erase(it);
 	}
-	return 0;
 }
 
 namespace {
@@ -656,7 +784,7 @@ CFileItem* DoGetIdleChild(std::deque<CFileItem*> const* fileList, TransferDirect
 	int i = 0;
 	for (i = static_cast<int>(QueuePriority::count) - 1; i >= 0; --i) {
 		for (auto const& item : fileList[i]) {
-			if (item->IsActive()) {
+			if (item->IsActive() || item->m_pEngineData) {
 				continue;
 			}
 
@@ -693,20 +821,32 @@ bool CServerItem::RemoveChild(CQueueItem* pItem, bool destroy, bool forward)
 		return false;
 	}
 
+	if (pItem->GetParent() != this) {
+		return CQueueItem::RemoveChild(pItem, destroy, forward);
+	}
+
+	auto const it = FindChild(*pItem);
+	if (it == m_children.cend()) {
+		wxFAIL_MSG(_T("Child item not found"));
+		return false;
+	}
+
 	if (pItem->GetType() == QueueItemType::File || pItem->GetType() == QueueItemType::Folder) {
 		CFileItem* pFileItem = static_cast<CFileItem*>(pItem);
 		RemoveFileItemFromList(pFileItem, forward);
 	}
 
-	bool removed = CQueueItem::RemoveChild(pItem, destroy, forward);
-	if (removed) {
-		m_maxCachedIndex = -1;
+	SetExpanded(*pItem, false);
+	m_visibleOffspring -= 1 + pItem->GetChildrenCount(true);
+	EraseChild(m_children.begin() + (it - m_children.cbegin()));
+	if (destroy) {
+		delete pItem;
 	}
 
 	wxASSERT(m_visibleOffspring >= static_cast<int>(m_children.size()) - m_removed_at_front);
 	wxASSERT(((m_children.size() - m_removed_at_front) != 0) == (m_visibleOffspring != 0));
 
-	return removed;
+	return true;
 }
 
 void CServerItem::QueueImmediateFiles()
@@ -812,8 +952,6 @@ bool CServerItem::TryRemoveAll()
 	std::swap(m_children, keepChildren);
 	m_removed_at_front = 0;
 
-	m_maxCachedIndex = -1;
-
 	wxASSERT(oldVisibleOffspring >= m_visibleOffspring);
 	wxASSERT(m_visibleOffspring >= static_cast<int>(m_children.size()));
 	(void)oldVisibleOffspring;
@@ -827,8 +965,9 @@ void CServerItem::DetachChildren()
 
 	m_children.clear();
 	m_visibleOffspring = 0;
-	m_maxCachedIndex = -1;
 	m_removed_at_front = 0;
+	m_expanded.clear();
+	m_nextOrder = 0;
 
 	for (int i = 0; i < 2; ++i) {
 		for (int j = 0; j < static_cast<int>(QueuePriority::count); ++j) {
@@ -1023,6 +1162,9 @@ wxString CQueueViewBase::OnGetItemText(CQueueItem* pItem, ColumnId column) const
 			case colSize:
 				{
 					auto const& size = pFileItem->GetSize();
+					if (auto const* segment = pFileItem->GetSegment()) {
+						return wxString::Format(_("%s, segment at %s"), CSizeFormat::Format(size), CSizeFormat::Format(segment->offset_));
+					}
 					if (size >= 0) {
 						return CSizeFormat::Format(size);
 					}
@@ -1591,7 +1733,7 @@ void CQueueViewBase::OnKeyDown(wxKeyEvent& event)
 	}
 }
 
-void CQueueViewBase::WriteToFile(pugi::xml_node element) const
+void CQueueViewBase::WriteToFile(pugi::xml_node element)
 {
 	auto queue = element.child("Queue");
 	if (!queue) {
@@ -7,6 +7,8 @@
 
 #include <libfilezilla/optional.hpp>
 
+#include <set>
+
 enum class QueuePriority : unsigned char {
 	lowest,
 	low,
@@ -60,9 +62,16 @@ public:
 
 	int GetRemovedAtFront() const { return m_removed_at_front; }
 
+	// Row id in the queue database, 0 if not stored there
+	int64_t GetStorageId() const { return m_storageId; }
+	void SetStorageId(int64_t id) { m_storageId = id; }
+
 protected:
 	CQueueItem(CQueueItem* parent = 0);
 
+	// Removes the child from m_children without deleting it
+	void EraseChild(std::vector<CQueueItem*>::iterator iter);
+
 	CQueueItem* m_parent;
 
 	friend class CServerItem;
@@ -76,6 +85,12 @@ private:
 	// Increased instead of calling slow m_children.erase(0),
 	// resetted on insert.
 	int m_removed_at_front{};
+
+	// Children of server items are in ascending order of this key,
+	// allowing to look them up using binary search.
+	uint32_t m_order{};
+
+	int64_t m_storageId{};
 };
 
 class CFileItem;
@@ -120,10 +135,20 @@ public:
 
 	void Sort(int col, bool reverse);
 
+	// Index of the list row of a child, relative to the first child
+	int GetChildRow(CQueueItem const& child) const;
+
+	// Keeps track of children having children themselves, the status
+	// lines of active items.
+	void SetExpanded(CQueueItem & child, bool expanded);
+
 protected:
 	void AddFileItemToList(CFileItem* pItem);
 	void RemoveFileItemFromList(CFileItem* pItem, bool forward);
 
+	std::vector<CQueueItem*>::const_iterator FindChild(CQueueItem const& child) const;
+	void RenumberChildren();
+
 	Site site_;
 
 	// array of item lists, sorted by priority. Used by scheduler to find
@@ -134,14 +159,12 @@ protected:
 	friend class CQueueItem;
 
 	int m_visibleOffspring{}; // Visible offspring over all sublevels
-	int m_maxCachedIndex{-1};
 
-	struct t_cacheItem
-	{
-		int index;
-		int child;
-	};
-	std::vector<t_cacheItem> m_lookupCache;
+	// Only the few children that span more than a single row are tracked,
+	// sorted by m_order. Together with the order of the children this maps
+	// between rows and children without a per-row lookup table.
+	std::vector<CQueueItem*> m_expanded;
+	uint32_t m_nextOrder{};
 };
 
 struct t_EngineData;
@@ -155,6 +178,25 @@ namespace queue_flags
 	auto constexpr mask = static_cast<transfer_flags>(0x0f);
 }
 
+// Interned directories of queued files. Files in the same directory share
+// a single copy of its path, no matter how they got queued.
+class CQueuePathTable final
+{
+public:
+	static CQueuePathTable& Get();
+
+	CLocalPath const& Intern(CLocalPath const& path);
+	CServerPath const& Intern(CServerPath const& path);
+
+	// Items keep their paths, only items created afterwards no longer share
+	// them with the existing ones.
+	void Clear();
+
+private:
+	std::set<CLocalPath> localPaths_;
+	std::set<CServerPath> remotePaths_;
+};
+
 class CFileItem : public CQueueItem
 {
 public:
@@ -169,10 +211,30 @@ public:
 	void SetPriorityRaw(QueuePriority priority);
 	QueuePriority GetPriority() const;
 
+	// Byte range of the remote file transferred by a segmented download,
+	// see CQueueView::SplitDownload
+	struct segment {
+		int64_t offset_{};
+		int64_t length_{};
+		int64_t fileSize_{};
+		int64_t done_{};
+
+		// Combined length of the other segments of the same file that have
+		// already been transferred successfully
+		int64_t othersDone_{};
+
+		explicit operator bool() const { return length_ > 0; }
+
+		// Textual form used by the queue storage and the XML export
+		std::wstring to_string() const;
+		static segment from_string(std::wstring_view const& s);
+	};
+
 	struct extra_data {
 		std::wstring targetFile_;
 		std::wstring extraFlags_;
 		std::string persistentState_;
+		segment segment_;
 	};
 
 	std::wstring const& GetLocalFile() const { return !Download() ? GetSourceFile() : (extra_data_ && !extra_data_->targetFile_.empty() ? extra_data_->targetFile_ : m_sourceFile); }
@@ -224,6 +286,11 @@ public:
 
 	void set_persistent_state(std::string && state);
 
+	segment const* GetSegment() const { return (extra_data_ && extra_data_->segment_) ? &extra_data_->segment_ : nullptr; }
+	void SetSegment(segment const& s);
+	void SetSegmentDone(int64_t done);
+	void AddSegmentOthersDone(int64_t length);
+
 	enum class Status : unsigned char {
 		none,
 		incorrect_password,
@@ -238,7 +305,9 @@ public:
 		local_file_unwriteable,
 		could_not_start,
 		transferring,
-		creating_dir
+		creating_dir,
+		checksum_mismatch,
+		checksum_unverified
 	};
 
 	wxString const& GetStatusMessage() const;
@@ -255,6 +324,9 @@ protected:
 
 public:
 	unsigned char m_errorCount{};
+
+	// Engine transferring the item. Also set for inactive items while their
+	// transfer is queued in an engine, see CQueueView::QueueFollowingTransfers.
 	t_EngineData* m_pEngineData{};
 
 	inline bool made_progress() const { return flags_ & queue_flags::made_progess; }
@@ -323,6 +395,9 @@ public:
 	// Gets item for given server or creates new if it doesn't exist
 	CServerItem* CreateServerItem(Site const& site);
 
+	// Gets item for given server
+	CServerItem* GetServerItem(Site const& site);
+
 	virtual void InsertItem(CServerItem* pServerItem, CQueueItem* pItem);
 	virtual bool RemoveItem(CQueueItem* pItem, bool destroy, bool updateItemCount = true, bool updateSelections = true, bool forward = true);
 
@@ -334,16 +409,13 @@ public:
 
 	int GetFileCount() const { return m_fileCount; }
 
-	void WriteToFile(pugi::xml_node element) const;
+	virtual void WriteToFile(pugi::xml_node element);
 
 protected:
 
 	void CreateColumns(std::vector<ColumnId> const& extraColumns = std::vector<ColumnId>());
 	void AddQueueColumn(ColumnId id);
 
-	// Gets item for given server
-	CServerItem* GetServerItem(Site const& site);
-
 	// Gets item with given index
 	CQueueItem* GetQueueItem(unsigned int item) const;
 
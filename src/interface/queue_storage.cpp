@@ -96,7 +96,9 @@ namespace file_table_column_names
 		flags,
 		default_exists_action,
 		extra_flags,
-		persistent_state
+		persistent_state,
+		segment,
+		state
 	};
 }
 
@@ -113,7 +115,9 @@ _column file_table_columns[] = {
 	{ "flags", Column_type::integer, 0 },
 	{ "default_exists_action", Column_type::integer, 0 },
 	{ "extra_flags", Column_type::text, 0 },
-	{ "persistent_state", Column_type::blob, 0 }
+	{ "persistent_state", Column_type::blob, 0 },
+	{ "segment", Column_type::text, 0 },
+	{ "state", Column_type::integer, 0 }
 };
 
 namespace path_table_column_names
@@ -144,10 +148,15 @@ public:
 
 	sqlite3_stmt* PrepareStatement(std::string const& query);
 	sqlite3_stmt* PrepareInsertStatement(std::string const& name, _column const*, unsigned int count);
+	sqlite3_stmt* PrepareUpdateStatement(std::string const& name, _column const*, unsigned int count);
 
 	bool SaveServer(CServerItem const& item);
-	bool SaveFile(CFileItem const& item);
-	bool SaveDirectory(CFolderItem const& item);
+	int64_t SaveServerRow(CServerItem const& item);
+	bool SaveFile(sqlite3_stmt* statement, CFileItem const& item);
+	bool SaveDirectory(sqlite3_stmt* statement, CFolderItem const& item);
+	bool SaveItem(sqlite3_stmt* statement, CQueueItem const& item);
+
+	bool Execute(sqlite3_stmt* statement);
 
 	int64_t SaveLocalPath(CLocalPath const& path);
 	int64_t SaveRemotePath(CServerPath const& path);
@@ -173,13 +182,17 @@ public:
 	int GetColumnInt(sqlite3_stmt* statement, int index, int def = 0);
 
 	int64_t ParseServerFromRow(Site & site);
-	int64_t ParseFileFromRow(CFileItem** pItem);
+	int64_t ParseFileFromRow(sqlite3_stmt* statement, CFileItem** pItem);
 
 	bool MigrateSchema();
 
 	bool BeginTransaction();
 	bool EndTransaction(bool roolback);
 
+	// Starts the transaction collecting incremental changes if needed
+	bool Journal();
+	bool Commit();
+
 	void Close();
 
 	sqlite3* db_{};
@@ -189,8 +202,16 @@ public:
 	sqlite3_stmt* insertLocalPathQuery_{};
 	sqlite3_stmt* insertRemotePathQuery_{};
 
+	sqlite3_stmt* updateFileQuery_{};
+	sqlite3_stmt* deleteFileQuery_{};
+	sqlite3_stmt* deleteServerQuery_{};
+	sqlite3_stmt* deleteServerFilesQuery_{};
+	sqlite3_stmt* moveServerFilesQuery_{};
+
 	sqlite3_stmt* selectServersQuery_{};
 	sqlite3_stmt* selectFilesQuery_{};
+	sqlite3_stmt* selectFilesPageQuery_{};
+	sqlite3_stmt* selectLastFileQuery_{};
 	sqlite3_stmt* selectLocalPathQuery_{};
 	sqlite3_stmt* selectRemotePathQuery_{};
 
@@ -203,6 +224,10 @@ public:
 	std::map<int64_t, CLocalPath> reverseLocalPaths_;
 	std::map<int64_t, CServerPath> reverseRemotePaths_;
 
+	// Whether the transaction holding uncommitted incremental changes is open
+	bool journal_{};
+	bool incremental_{};
+
 	COptionsBase & options_;
 };
 
@@ -222,6 +247,9 @@ void CQueueStorage::Impl::ReadLocalPaths()
 			CLocalPath localPath;
 			if (id > 0 && !localPathRaw.empty() && localPath.SetPath(localPathRaw)) {
 				reverseLocalPaths_[id] = localPath;
+				if (incremental_) {
+					localPaths_[localPath.GetPath()] = id;
+				}
 			}
 		}
 	}
@@ -246,6 +274,9 @@ void CQueueStorage::Impl::ReadRemotePaths()
 			CServerPath remotePath;
 			if (id > 0 && !remotePathRaw.empty() && remotePath.SetSafePath(remotePathRaw)) {
 				reverseRemotePaths_[id] = remotePath;
+				if (incremental_) {
+					remotePaths_[remotePath.GetSafePath()] = id;
+				}
 			}
 		}
 	}
@@ -306,7 +337,7 @@ bool CQueueStorage::Impl::MigrateSchema()
 	bool ret = sqlite3_exec(db_, "PRAGMA user_version", int_callback, &version, 0) == SQLITE_OK;
 
 	if (ret) {
-		if (version > 8) {
+		if (version > 9) {
 			ret = false;
 		}
 		else if (version > 0) {
@@ -348,9 +379,16 @@ bool CQueueStorage::Impl::MigrateSchema()
 			if (ret && version < 8) {
 				ret = sqlite3_exec(db_, "ALTER TABLE files ADD COLUMN persistent_state BLOB DEFAULT NULL", 0, 0, 0) == SQLITE_OK;
 			}
+			// Before version 7, the table got recreated with all current columns above
+			if (ret && version >= 7 && version < 9) {
+				ret = sqlite3_exec(db_, "ALTER TABLE files ADD COLUMN segment TEXT DEFAULT NULL", 0, 0, 0) == SQLITE_OK;
+			}
+			if (ret && version >= 7 && version < 10) {
+				ret = sqlite3_exec(db_, "ALTER TABLE files ADD COLUMN state INTEGER DEFAULT NULL", 0, 0, 0) == SQLITE_OK;
+			}
 		}
-		if (ret && version != 8) {
-			ret = sqlite3_exec(db_, "PRAGMA user_version = 8", 0, 0, 0) == SQLITE_OK;
+		if (ret && version != 10) {
+			ret = sqlite3_exec(db_, "PRAGMA user_version = 10", 0, 0, 0) == SQLITE_OK;
 		}
 	}
 
@@ -532,6 +570,27 @@ sqlite3_stmt* CQueueStorage::Impl::PrepareInsertStatement(std::string const& nam
 	return PrepareStatement(query);
 }
 
+sqlite3_stmt* CQueueStorage::Impl::PrepareUpdateStatement(std::string const& name, _column const* columns, unsigned int count)
+{
+	if (!db_) {
+		return 0;
+	}
+
+	// Parameters are numbered like in the insert statement, with the id last.
+	std::string query = "UPDATE " + name + " SET ";
+	for (unsigned int i = 1; i < count; ++i) {
+		if (i > 1) {
+			query += ", ";
+		}
+		query += columns[i].name;
+		query += "=:";
+		query += columns[i].name;
+	}
+	query += " WHERE id=:id";
+
+	return PrepareStatement(query);
+}
+
 
 sqlite3_stmt* CQueueStorage::Impl::PrepareStatement(std::string const& query)
 {
@@ -564,6 +623,15 @@ bool CQueueStorage::Impl::PrepareStatements()
 		return false;
 	}
 
+	updateFileQuery_ = PrepareUpdateStatement("files", file_table_columns, sizeof(file_table_columns) / sizeof(_column));
+	deleteFileQuery_ = PrepareStatement("DELETE FROM files WHERE id=:id");
+	deleteServerQuery_ = PrepareStatement("DELETE FROM servers WHERE id=:id");
+	deleteServerFilesQuery_ = PrepareStatement("DELETE FROM files WHERE server=:server");
+	moveServerFilesQuery_ = PrepareStatement("UPDATE files SET server=:server WHERE server=:from");
+	if (!updateFileQuery_ || !deleteFileQuery_ || !deleteServerQuery_ || !deleteServerFilesQuery_ || !moveServerFilesQuery_) {
+		return false;
+	}
+
 	{
 		std::string query = "SELECT ";
 		for (unsigned int i = 0; i < (sizeof(server_table_columns) / sizeof(_column)); ++i) {
@@ -589,13 +657,19 @@ bool CQueueStorage::Impl::PrepareStatements()
 			query += file_table_columns[i].name;
 		}
 
-		query += " FROM files WHERE server=:server ORDER BY id ASC";
+		if (!(selectFilesQuery_ = PrepareStatement(query + " FROM files WHERE server=:server ORDER BY id ASC"))) {
+			return false;
+		}
 
-		if (!(selectFilesQuery_ = PrepareStatement(query))) {
+		if (!(selectFilesPageQuery_ = PrepareStatement(query + " FROM files WHERE server=:server AND id>:after AND id<=:last ORDER BY id ASC LIMIT :count"))) {
 			return false;
 		}
 	}
 
+	if (!(selectLastFileQuery_ = PrepareStatement("SELECT MAX(id) FROM files"))) {
+		return false;
+	}
+
 	{
 		std::string query = "SELECT id, path FROM local_paths";
 		if (!(selectLocalPathQuery_ = PrepareStatement(query))) {
@@ -659,7 +733,7 @@ bool CQueueStorage::Impl::BindBlob(sqlite3_stmt* statement, int index, std::stri
 }
 
 
-bool CQueueStorage::Impl::SaveServer(CServerItem const& item)
+int64_t CQueueStorage::Impl::SaveServerRow(CServerItem const& item)
 {
 	bool kiosk_mode = options_.get_int(OPTION_DEFAULT_KIOSKMODE) != 0;
 
@@ -794,6 +868,9 @@ bool CQueueStorage::Impl::SaveServer(CServerItem const& item)
 		}
 		Bind(insertServerQuery_, server_table_column_names::parameters, qs.to_string(false));
 	}
+	else {
+		BindNull(insertServerQuery_, server_table_column_names::parameters);
+	}
 
 	auto const& site_path = site.SitePath();
 	if (site_path.empty()) {
@@ -803,66 +880,99 @@ bool CQueueStorage::Impl::SaveServer(CServerItem const& item)
 		Bind(insertServerQuery_, server_table_column_names::site_path, site_path);
 	}
 
+	if (!Execute(insertServerQuery_)) {
+		return -1;
+	}
+
+	return sqlite3_last_insert_rowid(db_);
+}
+
+
+bool CQueueStorage::Impl::SaveServer(CServerItem const& item)
+{
+	int64_t const serverId = SaveServerRow(item);
+	if (serverId <= 0) {
+		return false;
+	}
+
+	bool ret = true;
+	Bind(insertFileQuery_, file_table_column_names::server, serverId);
+
+	const std::vector<CQueueItem*>& children = item.GetChildren();
+	for (std::vector<CQueueItem*>::const_iterator it = children.begin() + item.GetRemovedAtFront(); it != children.end(); ++it) {
+		ret &= SaveItem(insertFileQuery_, **it);
+	}
+	return ret;
+}
+
+
+bool CQueueStorage::Impl::SaveItem(sqlite3_stmt* statement, CQueueItem const& item)
+{
+	if (item.GetType() == QueueItemType::File) {
+		return SaveFile(statement, static_cast<CFileItem const&>(item));
+	}
+	else if (item.GetType() == QueueItemType::Folder) {
+		return SaveDirectory(statement, static_cast<CFolderItem const&>(item));
+	}
+	return true;
+}
+
+
+bool CQueueStorage::Impl::Execute(sqlite3_stmt* statement)
+{
 	int res;
 	do {
-		res = sqlite3_step(insertServerQuery_);
+		res = sqlite3_step(statement);
 	} while (res == SQLITE_BUSY);
 
-	sqlite3_reset(insertServerQuery_);
+	sqlite3_reset(statement);
 
-	bool ret = res == SQLITE_DONE;
-	if (ret) {
-		sqlite3_int64 serverId = sqlite3_last_insert_rowid(db_);
-		Bind(insertFileQuery_, file_table_column_names::server, static_cast<int64_t>(serverId));
-
-		const std::vector<CQueueItem*>& children = item.GetChildren();
-		for (std::vector<CQueueItem*>::const_iterator it = children.begin() + item.GetRemovedAtFront(); it != children.end(); ++it) {
-			CQueueItem & childItem = **it;
-			if (childItem.GetType() == QueueItemType::File) {
-				ret &= SaveFile(static_cast<CFileItem&>(childItem));
-			}
-			else if (childItem.GetType() == QueueItemType::Folder) {
-				ret &= SaveDirectory(static_cast<CFolderItem&>(childItem));
-			}
-		}
-	}
-	return ret;
+	return res == SQLITE_DONE;
 }
 
 
-bool CQueueStorage::Impl::SaveFile(CFileItem const& file)
+bool CQueueStorage::Impl::SaveFile(sqlite3_stmt* statement, CFileItem const& file)
 {
 	if (file.m_edit != CEditHandler::none) {
 		return true;
 	}
 
-	Bind(insertFileQuery_, file_table_column_names::source_file, file.GetSourceFile());
+	Bind(statement, file_table_column_names::source_file, file.GetSourceFile());
 	auto const& extra_data = file.GetExtraData();
 	if (extra_data) {
 		if (!extra_data->targetFile_.empty()) {
-			Bind(insertFileQuery_, file_table_column_names::target_file, extra_data->targetFile_);
+			Bind(statement, file_table_column_names::target_file, extra_data->targetFile_);
 		}
 		else {
-			BindNull(insertFileQuery_, file_table_column_names::target_file);
+			BindNull(statement, file_table_column_names::target_file);
 		}
 
 		if (!extra_data->extraFlags_.empty()) {
-			Bind(insertFileQuery_, file_table_column_names::extra_flags, extra_data->extraFlags_);
+			Bind(statement, file_table_column_names::extra_flags, extra_data->extraFlags_);
 		}
 		else {
-			BindNull(insertFileQuery_, file_table_column_names::extra_flags);
+			BindNull(statement, file_table_column_names::extra_flags);
 		}
 
 		if (!extra_data->persistentState_.empty()) {
-			Bind(insertFileQuery_, file_table_column_names::persistent_state, extra_data->persistentState_);
+			Bind(statement, file_table_column_names::persistent_state, extra_data->persistentState_);
+		}
+		else {
+			BindNull(statement, file_table_column_names::persistent_state);
+		}
+
+		if (extra_data->segment_) {
+			Bind(statement, file_table_column_names::segment, extra_data->segment_.to_string());
 		}
 		else {
-			BindNull(insertFileQuery_, file_table_column_names::persistent_state);
+			BindNull(statement, file_table_column_names::segment);
 		}
 	}
 	else {
-		BindNull(insertFileQuery_, file_table_column_names::target_file);
-		BindNull(insertFileQuery_, file_table_column_names::extra_flags);
+		BindNull(statement, file_table_column_names::target_file);
+		BindNull(statement, file_table_column_names::extra_flags);
+		BindNull(statement, file_table_column_names::persistent_state);
+		BindNull(statement, file_table_column_names::segment);
 	}
 
 	int64_t localPathId = SaveLocalPath(file.GetLocalPath());
@@ -871,51 +981,63 @@ bool CQueueStorage::Impl::SaveFile(CFileItem const& file)
 		return false;
 	}
 
-	Bind(insertFileQuery_, file_table_column_names::local_path, localPathId);
-	Bind(insertFileQuery_, file_table_column_names::remote_path, remotePathId);
+	Bind(statement, file_table_column_names::local_path, localPathId);
+	Bind(statement, file_table_column_names::remote_path, remotePathId);
 
 	if (file.GetSize() != -1) {
-		Bind(insertFileQuery_, file_table_column_names::size, file.GetSize());
+		Bind(statement, file_table_column_names::size, file.GetSize());
 	}
 	else {
-		BindNull(insertFileQuery_, file_table_column_names::size);
+		BindNull(statement, file_table_column_names::size);
 	}
 	if (file.m_errorCount) {
-		Bind(insertFileQuery_, file_table_column_names::error_count, file.m_errorCount);
+		Bind(statement, file_table_column_names::error_count, file.m_errorCount);
 	}
 	else {
-		BindNull(insertFileQuery_, file_table_column_names::error_count);
+		BindNull(statement, file_table_column_names::error_count);
 	}
-	Bind(insertFileQuery_, file_table_column_names::priority, static_cast<int>(file.GetPriority()));
-	Bind(insertFileQuery_, file_table_column_names::flags, static_cast<int64_t>(file.flags() - queue_flags::mask));
+	Bind(statement, file_table_column_names::priority, static_cast<int>(file.GetPriority()));
+	Bind(statement, file_table_column_names::flags, static_cast<int64_t>(file.flags() - queue_flags::mask));
 
-	if (file.m_defaultFileExistsAction != CFileExistsNotification::unknown) {
-		Bind(insertFileQuery_, file_table_column_names::default_exists_action, file.m_defaultFileExistsAction);
+	// Whether the file was being transferred and whether that transfer
+	// made any progress
+	transfer_flags state{};
+	if (file.IsActive()) {
+		state |= queue_flags::active;
+	}
+	if (file.made_progress()) {
+		state |= queue_flags::made_progess;
+	}
+	if (state != transfer_flags::none) {
+		Bind(statement, file_table_column_names::state, static_cast<int64_t>(state));
 	}
 	else {
-		BindNull(insertFileQuery_, file_table_column_names::default_exists_action);
+		BindNull(statement, file_table_column_names::state);
 	}
 
-	int res;
-	do {
-		res = sqlite3_step(insertFileQuery_);
-	} while (res == SQLITE_BUSY);
-
-	sqlite3_reset(insertFileQuery_);
+	if (file.m_defaultFileExistsAction != CFileExistsNotification::unknown) {
+		Bind(statement, file_table_column_names::default_exists_action, file.m_defaultFileExistsAction);
+	}
+	else {
+		BindNull(statement, file_table_column_names::default_exists_action);
+	}
 
-	return res == SQLITE_DONE;
+	return Execute(statement);
 }
 
 
-bool CQueueStorage::Impl::SaveDirectory(CFolderItem const& directory)
+bool CQueueStorage::Impl::SaveDirectory(sqlite3_stmt* statement, CFolderItem const& directory)
 {
 	if (directory.Download()) {
-		BindNull(insertFileQuery_, file_table_column_names::source_file);
+		BindNull(statement, file_table_column_names::source_file);
 	}
 	else {
-		Bind(insertFileQuery_, file_table_column_names::source_file, directory.GetSourceFile());
+		Bind(statement, file_table_column_names::source_file, directory.GetSourceFile());
 	}
-	BindNull(insertFileQuery_, file_table_column_names::target_file);
+	BindNull(statement, file_table_column_names::target_file);
+	BindNull(statement, file_table_column_names::extra_flags);
+	BindNull(statement, file_table_column_names::persistent_state);
+	BindNull(statement, file_table_column_names::segment);
 
 	int64_t localPathId = directory.Download() ? SaveLocalPath(directory.GetLocalPath()) : -1;
 	int64_t remotePathId = directory.Download() ? -1 : SaveRemotePath(directory.GetRemotePath());
@@ -923,29 +1045,23 @@ bool CQueueStorage::Impl::SaveDirectory(CFolderItem const& directory)
 		return false;
 	}
 
-	Bind(insertFileQuery_, file_table_column_names::local_path, localPathId);
-	Bind(insertFileQuery_, file_table_column_names::remote_path, remotePathId);
+	Bind(statement, file_table_column_names::local_path, localPathId);
+	Bind(statement, file_table_column_names::remote_path, remotePathId);
 
-	BindNull(insertFileQuery_, file_table_column_names::size);
+	BindNull(statement, file_table_column_names::size);
 	if (directory.m_errorCount) {
-		Bind(insertFileQuery_, file_table_column_names::error_count, directory.m_errorCount);
+		Bind(statement, file_table_column_names::error_count, directory.m_errorCount);
 	}
 	else {
-		BindNull(insertFileQuery_, file_table_column_names::error_count);
+		BindNull(statement, file_table_column_names::error_count);
 	}
-	Bind(insertFileQuery_, file_table_column_names::priority, static_cast<int>(directory.GetPriority()));
-	Bind(insertFileQuery_, file_table_column_names::flags, static_cast<int>(directory.flags() - queue_flags::mask));
+	Bind(statement, file_table_column_names::priority, static_cast<int>(directory.GetPriority()));
+	Bind(statement, file_table_column_names::flags, static_cast<int>(directory.flags() - queue_flags::mask));
 
-	BindNull(insertFileQuery_, file_table_column_names::default_exists_action);
+	BindNull(statement, file_table_column_names::default_exists_action);
+	BindNull(statement, file_table_column_names::state);
 
-	int res;
-	do {
-		res = sqlite3_step(insertFileQuery_);
-	} while (res == SQLITE_BUSY);
-
-	sqlite3_reset(insertFileQuery_);
-
-	return res == SQLITE_DONE;
+	return Execute(statement);
 }
 
 
@@ -1144,18 +1260,18 @@ int64_t CQueueStorage::Impl::ParseServerFromRow(Site & site)
 }
 
 
-int64_t CQueueStorage::Impl::ParseFileFromRow(CFileItem** pItem)
+int64_t CQueueStorage::Impl::ParseFileFromRow(sqlite3_stmt* statement, CFileItem** pItem)
 {
-	std::wstring sourceFile = GetColumnText(selectFilesQuery_, file_table_column_names::source_file);
-	std::wstring targetFile = GetColumnText(selectFilesQuery_, file_table_column_names::target_file);
+	std::wstring sourceFile = GetColumnText(statement, file_table_column_names::source_file);
+	std::wstring targetFile = GetColumnText(statement, file_table_column_names::target_file);
 
-	int64_t localPathId = GetColumnInt64(selectFilesQuery_, file_table_column_names::local_path, false);
-	int64_t remotePathId = GetColumnInt64(selectFilesQuery_, file_table_column_names::remote_path, false);
+	int64_t localPathId = GetColumnInt64(statement, file_table_column_names::local_path, false);
+	int64_t remotePathId = GetColumnInt64(statement, file_table_column_names::remote_path, false);
 
 	CLocalPath const localPath(GetLocalPath(localPathId));
 	CServerPath const remotePath(GetRemotePath(remotePathId));
 
-	auto flags = static_cast<transfer_flags>(GetColumnInt(selectFilesQuery_, file_table_column_names::flags));
+	auto flags = static_cast<transfer_flags>(GetColumnInt(statement, file_table_column_names::flags));
 	bool const download = flags & transfer_flags::download;
 
 	if (localPathId == -1 || remotePathId == -1) {
@@ -1174,14 +1290,21 @@ int64_t CQueueStorage::Impl::ParseFileFromRow(CFileItem** pItem)
 		}
 	}
 	else {
-		int64_t size = GetColumnInt64(selectFilesQuery_, file_table_column_names::size);
-		unsigned char errorCount = static_cast<unsigned char>(GetColumnInt(selectFilesQuery_, file_table_column_names::error_count));
-		int priority = GetColumnInt(selectFilesQuery_, file_table_column_names::priority, static_cast<int>(QueuePriority::normal));
+		int64_t size = GetColumnInt64(statement, file_table_column_names::size);
+		unsigned char errorCount = static_cast<unsigned char>(GetColumnInt(statement, file_table_column_names::error_count));
+		int priority = GetColumnInt(statement, file_table_column_names::priority, static_cast<int>(QueuePriority::normal));
 
-		std::wstring extraFlags = GetColumnText(selectFilesQuery_, file_table_column_names::extra_flags);
-		std::string persistentState = GetColumnTextUtf8(selectFilesQuery_, file_table_column_names::persistent_state);
+		std::wstring extraFlags = GetColumnText(statement, file_table_column_names::extra_flags);
+		std::string persistentState = GetColumnTextUtf8(statement, file_table_column_names::persistent_state);
+
+		std::wstring const segmentText = GetColumnText(statement, file_table_column_names::segment);
+		auto const segment = CFileItem::segment::from_string(segmentText);
+		if (!segmentText.empty() && !segment) {
+			return INVALID_DATA;
+		}
 
-		int overwrite_action = GetColumnInt(selectFilesQuery_, file_table_column_names::default_exists_action, CFileExistsNotification::unknown);
+		int overwrite_action = GetColumnInt(statement, file_table_column_names::default_exists_action, CFileExistsNotification::unknown);
+		auto const state = static_cast<transfer_flags>(GetColumnInt64(statement, file_table_column_names::state));
 
 		if (sourceFile.empty() || localPath.empty() ||
 			remotePath.empty() ||
@@ -1195,13 +1318,20 @@ int64_t CQueueStorage::Impl::ParseFileFromRow(CFileItem** pItem)
 		*pItem = fileItem;
 		fileItem->SetPriorityRaw(QueuePriority(priority));
 		fileItem->m_errorCount = errorCount;
+		fileItem->SetSegment(segment);
 
 		if (overwrite_action > 0 && overwrite_action < CFileExistsNotification::ACTION_COUNT) {
 			fileItem->m_defaultFileExistsAction = (CFileExistsNotification::OverwriteAction)overwrite_action;
 		}
+
+		// The program got terminated while the file was being transferred
+		if (state & queue_flags::active) {
+			fileItem->set_made_progress(state & queue_flags::made_progess);
+			fileItem->SetStatusMessage(CFileItem::Status::interrupted);
+		}
 	}
 
-	return GetColumnInt64(selectFilesQuery_, file_table_column_names::id);
+	return GetColumnInt64(statement, file_table_column_names::id);
 }
 
 bool CQueueStorage::Impl::BeginTransaction()
@@ -1219,6 +1349,39 @@ bool CQueueStorage::Impl::EndTransaction(bool rollback)
 	}
 }
 
+bool CQueueStorage::Impl::Journal()
+{
+	if (!db_ || !incremental_) {
+		return false;
+	}
+
+	if (!journal_) {
+		journal_ = BeginTransaction();
+	}
+	return journal_;
+}
+
+bool CQueueStorage::Impl::Commit()
+{
+	if (!journal_) {
+		return true;
+	}
+
+	journal_ = false;
+	if (EndTransaction(false)) {
+		return true;
+	}
+
+	// Changes are kept in the journal of the transaction, do not lose them
+	// if it cannot be committed right now, e.g. due to a lock held by
+	// another instance saving its queue.
+	if (sqlite3_get_autocommit(db_)) {
+		return false;
+	}
+	journal_ = true;
+	return false;
+}
+
 
 void CQueueStorage::Impl::Close()
 {
@@ -1226,16 +1389,30 @@ void CQueueStorage::Impl::Close()
 	sqlite3_finalize(insertFileQuery_);
 	sqlite3_finalize(insertLocalPathQuery_);
 	sqlite3_finalize(insertRemotePathQuery_);
+	sqlite3_finalize(updateFileQuery_);
+	sqlite3_finalize(deleteFileQuery_);
+	sqlite3_finalize(deleteServerQuery_);
+	sqlite3_finalize(deleteServerFilesQuery_);
+	sqlite3_finalize(moveServerFilesQuery_);
 	sqlite3_finalize(selectServersQuery_);
 	sqlite3_finalize(selectFilesQuery_);
+	sqlite3_finalize(selectFilesPageQuery_);
+	sqlite3_finalize(selectLastFileQuery_);
 	sqlite3_finalize(selectLocalPathQuery_);
 	sqlite3_finalize(selectRemotePathQuery_);
 	insertServerQuery_ = 0;
 	insertFileQuery_ = 0;
 	insertLocalPathQuery_ = 0;
 	insertRemotePathQuery_ = 0;
+	updateFileQuery_ = 0;
+	deleteFileQuery_ = 0;
+	deleteServerQuery_ = 0;
+	deleteServerFilesQuery_ = 0;
+	moveServerFilesQuery_ = 0;
 	selectServersQuery_ = 0;
 	selectFilesQuery_ = 0;
+	selectFilesPageQuery_ = 0;
+	selectLastFileQuery_ = 0;
 	selectLocalPathQuery_ = 0;
 	selectRemotePathQuery_ = 0;
 	sqlite3_close(db_);
@@ -1259,6 +1436,7 @@ CQueueStorage::CQueueStorage(COptionsBase& options)
 
 CQueueStorage::~CQueueStorage()
 {
+	d_->Commit();
 	d_->Close();
 	delete d_;
 }
@@ -1348,7 +1526,7 @@ int64_t CQueueStorage::GetFile(CFileItem** pItem, int64_t server)
 			while (res == SQLITE_BUSY);
 
 			if (res == SQLITE_ROW) {
-				ret = d_->ParseFileFromRow(pItem);
+				ret = d_->ParseFileFromRow(d_->selectFilesQuery_, pItem);
 				if (ret > 0) {
 					break;
 				}
@@ -1372,6 +1550,73 @@ int64_t CQueueStorage::GetFile(CFileItem** pItem, int64_t server)
 	return ret;
 }
 
+int64_t CQueueStorage::GetLastFileId()
+{
+	if (!d_->selectLastFileQuery_) {
+		return -1;
+	}
+
+	int res;
+	do {
+		res = sqlite3_step(d_->selectLastFileQuery_);
+	}
+	while (res == SQLITE_BUSY);
+
+	int64_t ret = -1;
+	if (res == SQLITE_ROW) {
+		ret = d_->GetColumnInt64(d_->selectLastFileQuery_, 0);
+	}
+	sqlite3_reset(d_->selectLastFileQuery_);
+
+	return ret;
+}
+
+int CQueueStorage::GetFiles(std::vector<CFileItem*> & files, int64_t server, int64_t & after, int64_t last, int count)
+{
+	sqlite3_stmt* const statement = d_->selectFilesPageQuery_;
+	if (!statement) {
+		return -1;
+	}
+
+	sqlite3_reset(statement);
+	if (!d_->Bind(statement, 1, server) || !d_->Bind(statement, 2, after) || !d_->Bind(statement, 3, last) || !d_->Bind(statement, 4, count)) {
+		return -1;
+	}
+
+	int rows{};
+	for (;;) {
+		int res;
+		do {
+			res = sqlite3_step(statement);
+		}
+		while (res == SQLITE_BUSY);
+
+		if (res == SQLITE_ROW) {
+			++rows;
+			after = d_->GetColumnInt64(statement, file_table_column_names::id);
+
+			CFileItem* item{};
+			if (d_->ParseFileFromRow(statement, &item) > 0 && item) {
+				item->SetStorageId(after);
+				files.push_back(item);
+			}
+			else {
+				delete item;
+			}
+		}
+		else {
+			// Not kept active, other statements run between the batches
+			sqlite3_reset(statement);
+			if (res != SQLITE_DONE) {
+				return -1;
+			}
+			break;
+		}
+	}
+
+	return rows;
+}
+
 bool CQueueStorage::Clear()
 {
 	if (!d_->db_) {
@@ -1418,3 +1663,135 @@ bool CQueueStorage::Vacuum()
 {
 	return sqlite3_exec(d_->db_, "VACUUM", 0, 0, 0) == SQLITE_OK;
 }
+
+bool CQueueStorage::EnableIncremental()
+{
+	if (!d_->db_ || !d_->updateFileQuery_) {
+		return false;
+	}
+
+	// With a write-ahead log, committing a batch of changes only appends
+	// to the log instead of rewriting the pages in the database file.
+	if (sqlite3_exec(d_->db_, "PRAGMA journal_mode=WAL", 0, 0, 0) != SQLITE_OK) {
+		return false;
+	}
+	sqlite3_exec(d_->db_, "PRAGMA synchronous=NORMAL", 0, 0, 0);
+
+	d_->ClearCaches();
+	d_->incremental_ = true;
+
+	return true;
+}
+
+bool CQueueStorage::RemoveOrphans()
+{
+	if (!d_->db_) {
+		return false;
+	}
+
+	bool ret = sqlite3_exec(d_->db_, "DELETE FROM files WHERE server NOT IN (SELECT id FROM servers)", 0, 0, 0) == SQLITE_OK;
+	ret &= sqlite3_exec(d_->db_, "DELETE FROM servers WHERE id NOT IN (SELECT server FROM files)", 0, 0, 0) == SQLITE_OK;
+	ret &= sqlite3_exec(d_->db_, "DELETE FROM local_paths WHERE id NOT IN (SELECT local_path FROM files WHERE local_path IS NOT NULL)", 0, 0, 0) == SQLITE_OK;
+	ret &= sqlite3_exec(d_->db_, "DELETE FROM remote_paths WHERE id NOT IN (SELECT remote_path FROM files WHERE remote_path IS NOT NULL)", 0, 0, 0) == SQLITE_OK;
+
+	return ret;
+}
+
+bool CQueueStorage::AddServer(CServerItem & item)
+{
+	if (!d_->Journal()) {
+		return false;
+	}
+
+	int64_t const id = d_->SaveServerRow(item);
+	if (id <= 0) {
+		return false;
+	}
+
+	item.SetStorageId(id);
+	return true;
+}
+
+bool CQueueStorage::AddItem(CQueueItem & item)
+{
+	if (item.GetType() != QueueItemType::File && item.GetType() != QueueItemType::Folder) {
+		return true;
+	}
+	if (static_cast<CFileItem const&>(item).m_edit != CEditHandler::none) {
+		// Not persisted, see SaveFile
+		return true;
+	}
+
+	int64_t const server = item.GetTopLevelItem()->GetStorageId();
+	if (server <= 0 || !d_->Journal()) {
+		return false;
+	}
+
+	d_->Bind(d_->insertFileQuery_, file_table_column_names::server, server);
+	if (!d_->SaveItem(d_->insertFileQuery_, item)) {
+		return false;
+	}
+
+	item.SetStorageId(sqlite3_last_insert_rowid(d_->db_));
+	return true;
+}
+
+bool CQueueStorage::UpdateItem(CQueueItem const& item)
+{
+	if (item.GetStorageId() <= 0) {
+		// Not stored, e.g. files opened for editing
+		return true;
+	}
+
+	int64_t const server = item.GetTopLevelItem()->GetStorageId();
+	if (server <= 0 || !d_->Journal()) {
+		return false;
+	}
+
+	d_->Bind(d_->updateFileQuery_, file_table_column_names::server, server);
+	d_->Bind(d_->updateFileQuery_, static_cast<int>(sizeof(file_table_columns) / sizeof(_column)), item.GetStorageId());
+	return d_->SaveItem(d_->updateFileQuery_, item);
+}
+
+bool CQueueStorage::RemoveItem(int64_t id)
+{
+	if (!d_->Journal()) {
+		return false;
+	}
+
+	d_->Bind(d_->deleteFileQuery_, 1, id);
+	return d_->Execute(d_->deleteFileQuery_);
+}
+
+bool CQueueStorage::RemoveServer(int64_t id)
+{
+	if (!d_->Journal()) {
+		return false;
+	}
+
+	d_->Bind(d_->deleteServerFilesQuery_, 1, id);
+	d_->Bind(d_->deleteServerQuery_, 1, id);
+	return d_->Execute(d_->deleteServerFilesQuery_) && d_->Execute(d_->deleteServerQuery_);
+}
+
+bool CQueueStorage::MergeServer(int64_t from, int64_t to)
+{
+	if (!d_->Journal()) {
+		return false;
+	}
+
+	d_->Bind(d_->moveServerFilesQuery_, 1, to);
+	d_->Bind(d_->moveServerFilesQuery_, 2, from);
+	d_->Bind(d_->deleteServerQuery_, 1, from);
+	return d_->Execute(d_->moveServerFilesQuery_) && d_->Execute(d_->deleteServerQuery_);
+}
+
+bool CQueueStorage::Commit()
+{
+	return d_->Commit();
+}
+
+bool CQueueStorage::HasUncommittedChanges() const
+{
+	return d_->journal_;
+}
@@ -7,6 +7,7 @@
 
 class CFileItem;
 class COptionsBase;
+class CQueueItem;
 class CServerItem;
 class Site;
 
@@ -40,6 +41,43 @@ public:
 
 	int64_t GetFile(CFileItem** pItem, int64_t server);
 
+	// For loading the files in batches.
+	// Returns the highest file id, 0 if there are no files, < 0 on failure.
+	int64_t GetLastFileId();
+
+	// Reads up to count rows of the server's files with ids greater than
+	// after and at most last, setting the storage ids of the files read.
+	// Updates after to the id of the last row read. Invalid rows are
+	// skipped, returns the number of rows read or -1 on failure.
+	int GetFiles(std::vector<CFileItem*> & files, int64_t server, int64_t & after, int64_t last, int count);
+
+	// Incremental saving, used by the instance owning the stored queue
+	// instead of SaveQueue. Call EnableIncremental before loading.
+	//
+	// Changes get written right away, but within a transaction that is only
+	// committed by Commit. This batches any number of changes into a single
+	// write to the disk.
+	bool EnableIncremental();
+
+	// Removes files of missing servers, servers without files and unused
+	// paths. Call within the loading transaction.
+	bool RemoveOrphans();
+
+	// Assign the storage ids of the items
+	bool AddServer(CServerItem & item);
+	bool AddItem(CQueueItem & item);
+
+	bool UpdateItem(CQueueItem const& item);
+
+	bool RemoveItem(int64_t id);
+	bool RemoveServer(int64_t id); // Including its files
+
+	// Moves the files of a server to another server, then removes it
+	bool MergeServer(int64_t from, int64_t to);
+
+	bool Commit();
+	bool HasUncommittedChanges() const;
+
 	std::wstring GetDatabaseFilename();
 
 private:
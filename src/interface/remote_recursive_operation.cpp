@@ -1,19 +1,27 @@
 #include "filezilla.h"
 #include "remote_recursive_operation.h"
+#include "asyncrequestqueue.h"
 #include "commandqueue.h"
 #include "chmoddialog.h"
 #include "filter_manager.h"
+#include "loginmanager.h"
+#include "Mainfrm.h"
 #include "Options.h"
 #include "queue.h"
+#include "StatusView.h"
 
 #include "../commonui/misc.h"
 
+#include <libfilezilla/glue/wxinvoker.hpp>
 #include <libfilezilla/local_filesys.hpp>
 #include <libfilezilla/recursive_remove.hpp>
 
-CRemoteRecursiveOperation::CRemoteRecursiveOperation(CState &state)
+#include <algorithm>
+
+CRemoteRecursiveOperation::CRemoteRecursiveOperation(CState &state, CMainFrame& mainFrame)
 : CStateEventHandler(state)
 , m_state(state)
+, m_mainFrame(mainFrame)
 {
 	state.RegisterHandler(this, STATECHANGE_REMOTE_DIR_OTHER);
 	state.RegisterHandler(this, STATECHANGE_REMOTE_LINKNOTDIR);
@@ -21,6 +29,9 @@ CRemoteRecursiveOperation::CRemoteRecursiveOperation(CState &state)
 
 CRemoteRecursiveOperation::~CRemoteRecursiveOperation()
 {
+	while (!listers_.empty()) {
+		RemoveLister(listers_.back().engine_.get());
+	}
 }
 
 void CRemoteRecursiveOperation::OnStateChange(t_statechange_notifications notification, std::wstring const&, const void* data)
@@ -64,9 +75,193 @@ void CRemoteRecursiveOperation::do_start_recursive_operation(OperationMode mode,
 	m_state.NotifyHandlers(STATECHANGE_REMOTE_IDLE);
 	m_state.NotifyHandlers(STATECHANGE_REMOTE_RECURSION_STATUS);
 
+	CreateListers();
+
 	remote_recursive_operation::do_start_recursive_operation(mode, filters);
 }
 
+void CRemoteRecursiveOperation::CreateListers()
+{
+	Site site = m_state.GetSite();
+	if (!site) {
+		return;
+	}
+
+	int count = COptions::Get()->get_int(OPTION_PARALLEL_LISTINGS);
+	if (site.server.MaximumMultipleConnections() > 0) {
+		// The primary connection and the queue's transfers to the same
+		// server count against the limit as well
+		int used = 1;
+		if (m_pQueue) {
+			used += m_pQueue->GetActiveEngineCount(site.server);
+		}
+		count = std::min(count, site.server.MaximumMultipleConnections() - used);
+	}
+	if (count <= 0) {
+		return;
+	}
+
+	// Don't pester the user with additional logins
+	if (site.credentials.logonType_ == LogonType::interactive || !CLoginManager::Get().GetPassword(site, true)) {
+		return;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		lister l;
+		l.engine_ = std::make_unique<CFileZillaEngine>(m_mainFrame.GetEngineContext(), fz::make_invoker(*this, [this](CFileZillaEngine* engine) { OnListerEvent(engine); }));
+		int const res = l.engine_->Execute(CConnectCommand(site.server, site.Handle(), site.credentials, false));
+		if (res == FZ_REPLY_OK) {
+			l.connected_ = true;
+		}
+		else if (res != FZ_REPLY_WOULDBLOCK) {
+			continue;
+		}
+		listers_.push_back(std::move(l));
+	}
+}
+
+void CRemoteRecursiveOperation::RemoveLister(CFileZillaEngine const* engine)
+{
+	auto it = std::find_if(listers_.begin(), listers_.end(), [engine](lister const& l) { return l.engine_.get() == engine; });
+	if (it == listers_.end()) {
+		return;
+	}
+
+	auto * asyncRequestQueue = m_mainFrame.GetAsyncRequestQueue();
+	if (asyncRequestQueue) {
+		asyncRequestQueue->ClearPending(it->engine_.get());
+	}
+	unsigned int const id = it->id_;
+	listers_.erase(it);
+
+	if (id) {
+		ParallelListingFinished(id, FZ_REPLY_DISCONNECTED | FZ_REPLY_ERROR, nullptr);
+	}
+}
+
+void CRemoteRecursiveOperation::process_parallel_listing(unsigned int id, std::unique_ptr<CListCommand>&& command)
+{
+	// Prefer connections that are ready already
+	auto it = std::find_if(listers_.begin(), listers_.end(), [](lister const& l) { return !l.id_ && l.connected_; });
+	if (it == listers_.end()) {
+		it = std::find_if(listers_.begin(), listers_.end(), [](lister const& l) { return !l.id_; });
+	}
+	if (it == listers_.end()) {
+		ParallelListingFinished(id, FZ_REPLY_INTERNALERROR, nullptr);
+		return;
+	}
+
+	it->id_ = id;
+	it->listing_.reset();
+	if (it->connected_) {
+		ExecuteListing(*it, *command);
+	}
+	else {
+		it->command_ = std::move(command);
+	}
+}
+
+void CRemoteRecursiveOperation::ExecuteListing(lister & l, CListCommand const& command)
+{
+	int const res = l.engine_->Execute(command);
+	if (res != FZ_REPLY_WOULDBLOCK) {
+		// Engine did not accept the command, e.g. after losing the connection
+		unsigned int const id = l.id_;
+		l.id_ = 0;
+		RemoveLister(l.engine_.get());
+		ParallelListingFinished(id, res == FZ_REPLY_OK ? FZ_REPLY_ERROR : res, nullptr);
+	}
+}
+
+void CRemoteRecursiveOperation::OnListerEvent(CFileZillaEngine* engine)
+{
+	while (true) {
+		// Anything called from here might have removed the lister
+		auto it = std::find_if(listers_.begin(), listers_.end(), [engine](lister const& l) { return l.engine_.get() == engine; });
+		if (it == listers_.end()) {
+			return;
+		}
+		lister & l = *it;
+
+		std::unique_ptr<CNotification> notification = l.engine_->GetNextNotification();
+		if (!notification) {
+			return;
+		}
+
+		switch (notification->GetID())
+		{
+		case nId_logmsg:
+			if (m_mainFrame.GetStatusView()) {
+				m_mainFrame.GetStatusView()->AddToLog(std::move(static_cast<CLogmsgNotification&>(*notification)));
+			}
+			break;
+		case nId_operation:
+			{
+				int const reply = static_cast<COperationNotification&>(*notification).replyCode_;
+				if (!l.connected_) {
+					if (reply != FZ_REPLY_OK) {
+						RemoveLister(engine);
+						break;
+					}
+					l.connected_ = true;
+					if (l.command_) {
+						auto command = std::move(l.command_);
+						ExecuteListing(l, *command);
+					}
+				}
+				else if (l.id_) {
+					unsigned int const id = l.id_;
+					auto listing = std::move(l.listing_);
+					l.id_ = 0;
+					if ((reply & FZ_REPLY_DISCONNECTED) == FZ_REPLY_DISCONNECTED) {
+						// Don't bother reconnecting, the primary connection retries the directory
+						RemoveLister(engine);
+					}
+					ParallelListingFinished(id, reply, listing);
+				}
+			}
+			break;
+		case nId_listing:
+			{
+				auto const& listingNotification = static_cast<CDirectoryListingNotification const&>(*notification);
+				if (l.id_ && listingNotification.Primary() && !listingNotification.Failed() && !listingNotification.GetPath().empty()) {
+					auto listing = std::make_shared<CDirectoryListing>();
+					if (l.engine_->CacheLookup(listingNotification.GetPath(), *listing) == FZ_REPLY_OK) {
+						l.listing_ = listing;
+						CContextManager::Get()->ProcessDirectoryListing(m_state.GetSite().server, listing, 0);
+					}
+				}
+			}
+			break;
+		case nId_asyncrequest:
+			{
+				auto * asyncRequestQueue = m_mainFrame.GetAsyncRequestQueue();
+				if (asyncRequestQueue) {
+					asyncRequestQueue->AddRequest(l.engine_.get(), unique_static_cast<CAsyncRequestNotification>(std::move(notification)));
+				}
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void CRemoteRecursiveOperation::handle_parallel_listing(int reply, std::shared_ptr<CDirectoryListing> const& listing)
+{
+	if (reply == FZ_REPLY_OK) {
+		// Goes through OnStateChange just like listings of the primary connection, so that
+		// everyone else interested in them, e.g. the search dialog, gets to see it.
+		m_state.NotifyHandlers(STATECHANGE_REMOTE_DIR_OTHER, std::wstring(), &listing);
+	}
+	else if ((reply & FZ_REPLY_LINKNOTDIR) == FZ_REPLY_LINKNOTDIR) {
+		LinkIsNotDir(m_state.GetSite());
+	}
+	else {
+		ListingFailed(reply);
+	}
+}
+
 
 void CRemoteRecursiveOperation::process_command(std::unique_ptr<CCommand> pCommand)
 {
@@ -124,6 +319,9 @@ void CRemoteRecursiveOperation::StopRecursiveOperation()
 {
 	bool notify = m_operationMode != recursive_none;
 	remote_recursive_operation::StopRecursiveOperation();
+	while (!listers_.empty()) {
+		RemoveLister(listers_.back().engine_.get());
+	}
 	if (notify) {
 		m_state.NotifyHandlers(STATECHANGE_REMOTE_IDLE);
 		m_state.NotifyHandlers(STATECHANGE_REMOTE_RECURSION_STATUS);
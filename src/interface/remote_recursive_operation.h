@@ -4,13 +4,15 @@
 #include "state.h"
 #include "../commonui/remote_recursive_operation.h"
 
+#include <vector>
+
 class CQueueView;
 class CActionAfterBlocker;
 
-class CRemoteRecursiveOperation final : public remote_recursive_operation, public CStateEventHandler
+class CRemoteRecursiveOperation final : public wxEvtHandler, public remote_recursive_operation, public CStateEventHandler
 {
 public:
-	CRemoteRecursiveOperation(CState& state);
+	CRemoteRecursiveOperation(CState& state, CMainFrame& mainFrame);
 	virtual ~CRemoteRecursiveOperation();
 
 	void StartRecursiveOperation(OperationMode mode, ActiveFilters const& filters, bool immediate = true);
@@ -20,6 +22,9 @@ public:
 
 	void SetQueue(CQueueView* pQueue) { m_pQueue = pQueue; }
 
+	// Number of additional connections used for listing directories
+	size_t GetListerCount() const { return listers_.size(); }
+
 protected:
 	void do_start_recursive_operation(OperationMode mode, ActiveFilters const& filters) override;
 	void process_command(std::unique_ptr<CCommand>) override;
@@ -33,9 +38,37 @@ protected:
 
 	void OnStateChange(t_statechange_notifications notification, std::wstring const&, const void* data) override;
 
+	size_t parallel_listing_connections() const override { return listers_.size(); }
+	void process_parallel_listing(unsigned int id, std::unique_ptr<CListCommand>&& command) override;
+	void handle_parallel_listing(int reply, std::shared_ptr<CDirectoryListing> const& listing) override;
+
+	// Connects the additional engines used to list directories ahead
+	// of the primary connection, see OPTION_PARALLEL_LISTINGS.
+	void CreateListers();
+	void OnListerEvent(CFileZillaEngine* engine);
+	void RemoveLister(CFileZillaEngine const* engine);
+
+	struct lister;
+	void ExecuteListing(lister & l, CListCommand const& command);
+
+	struct lister final
+	{
+		std::unique_ptr<CFileZillaEngine> engine_;
+
+		// Listing waiting for the connection to be established
+		std::unique_ptr<CListCommand> command_;
+		std::shared_ptr<CDirectoryListing> listing_;
+
+		// Of the directory being listed, 0 if idle
+		unsigned int id_{};
+		bool connected_{};
+	};
+	std::vector<lister> listers_;
+
 	bool m_immediate{true};
 	bool added_to_queue_{};
 	CState& m_state;
+	CMainFrame& m_mainFrame;
 	CQueueView* m_pQueue{};
 	std::shared_ptr<CActionAfterBlocker> m_actionAfterBlocker;
 
@@ -6,6 +6,7 @@
 #include "../filezillaapp.h"
 #include "../fzputtygen_interface.h"
 #include "../inputdialog.h"
+#include "../textctrlex.h"
 #if USE_MAC_SANDBOX
 #include "../osx_sandbox_userdirs.h"
 #endif
@@ -23,6 +24,9 @@ struct COptionsPageConnectionSFTP::impl
 	wxButton* remove_{};
 
 	wxCheckBox* compression_{};
+
+	wxTextCtrlEx* windowMin_{};
+	wxTextCtrlEx* windowMax_{};
 };
 
 COptionsPageConnectionSFTP::COptionsPageConnectionSFTP()
@@ -76,6 +80,20 @@ bool COptionsPageConnectionSFTP::CreateControls(wxWindow* parent)
 
 		impl_->compression_ = new wxCheckBox(box, nullID, _("&Enable compression"));
 		inner->Add(impl_->compression_);
+
+		auto rows = lay.createFlex(3);
+		inner->Add(rows);
+		rows->Add(new wxStaticText(box, nullID, _("M&inimum transfer window:")), lay.valign);
+		impl_->windowMin_ = new wxTextCtrlEx(box, nullID, wxString(), wxDefaultPosition, wxSize(lay.dlgUnits(30), -1));
+		impl_->windowMin_->SetMaxLength(7);
+		rows->Add(impl_->windowMin_, lay.valign);
+		rows->Add(new wxStaticText(box, nullID, _("KiB")), lay.valign);
+		rows->Add(new wxStaticText(box, nullID, _("Ma&ximum transfer window:")), lay.valign);
+		impl_->windowMax_ = new wxTextCtrlEx(box, nullID, wxString(), wxDefaultPosition, wxSize(lay.dlgUnits(30), -1));
+		impl_->windowMax_->SetMaxLength(7);
+		rows->Add(impl_->windowMax_, lay.valign);
+		rows->Add(new wxStaticText(box, nullID, _("KiB")), lay.valign);
+		inner->Add(new wxStaticText(box, nullID, _("The amount of data requested ahead of time adapts to the speed and latency of the connection within these limits.")));
 	}
 	return true;
 }
@@ -102,6 +120,8 @@ bool COptionsPageConnectionSFTP::LoadPage()
 	SetCtrlState();
 
 	impl_->compression_->SetValue(m_pOptions->get_int(OPTION_SFTP_COMPRESSION) != 0);
+	impl_->windowMin_->ChangeValue(fz::to_wstring(m_pOptions->get_int(OPTION_SFTP_WINDOW_MIN)));
+	impl_->windowMax_->ChangeValue(fz::to_wstring(m_pOptions->get_int(OPTION_SFTP_WINDOW_MAX)));
 
 	return !failure;
 }
@@ -121,6 +141,22 @@ bool COptionsPageConnectionSFTP::SavePage()
 	}
 
 	m_pOptions->set(OPTION_SFTP_COMPRESSION, impl_->compression_->GetValue() ? 1 : 0);
+	m_pOptions->set(OPTION_SFTP_WINDOW_MIN, impl_->windowMin_->GetValue().ToStdWstring());
+	m_pOptions->set(OPTION_SFTP_WINDOW_MAX, impl_->windowMax_->GetValue().ToStdWstring());
+
+	return true;
+}
+
+bool COptionsPageConnectionSFTP::Validate()
+{
+	auto const min = fz::to_integral<int>(impl_->windowMin_->GetValue().ToStdWstring(), -1);
+	if (min < 32 || min > 1024 * 1024) {
+		return DisplayError(impl_->windowMin_, _("The minimum transfer window has to be between 32 and 1048576 KiB."));
+	}
+	auto const max = fz::to_integral<int>(impl_->windowMax_->GetValue().ToStdWstring(), -1);
+	if (max < min || max > 1024 * 1024) {
+		return DisplayError(impl_->windowMax_, _("The maximum transfer window has to be between the minimum transfer window and 1048576 KiB."));
+	}
 
 	return true;
 }
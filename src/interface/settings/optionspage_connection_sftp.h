@@ -13,6 +13,7 @@ public:
 	virtual bool CreateControls(wxWindow* parent) override;
 	virtual bool LoadPage() override;
 	virtual bool SavePage() override;
+	virtual bool Validate() override;
 
 protected:
 	struct impl;
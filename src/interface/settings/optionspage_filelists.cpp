@@ -16,6 +16,8 @@ struct COptionsPageFilelists::impl final
 
 	wxChoice* doubleClickFileAction_{};
 	wxChoice* doubleClickDirAction_{};
+
+	wxCheckBox* persistentCache_{};
 };
 
 COptionsPageFilelists::COptionsPageFilelists()
@@ -91,6 +93,13 @@ bool COptionsPageFilelists::CreateControls(wxWindow* parent)
 		inner->Add(impl_->doubleClickDirAction_, lay.valign);
 	}
 
+	{
+		auto [box, inner] = lay.createStatBox(main, _("Directory cache"), 1);
+		impl_->persistentCache_ = new wxCheckBox(box, nullID, _("&Keep directory listings across sessions"));
+		inner->Add(impl_->persistentCache_);
+		inner->Add(new wxStaticText(box, nullID, _("Changing this setting requires restart of FileZilla.")), 0, wxLEFT, lay.indent);
+	}
+
 	return true;
 }
 
@@ -104,6 +113,8 @@ bool COptionsPageFilelists::LoadPage()
 	impl_->doubleClickFileAction_->Select(m_pOptions->get_int(OPTION_DOUBLECLICK_ACTION_FILE));
 	impl_->doubleClickDirAction_->Select(m_pOptions->get_int(OPTION_DOUBLECLICK_ACTION_DIRECTORY));
 
+	impl_->persistentCache_->SetValue(m_pOptions->get_bool(OPTION_CACHE_PERSISTENT));
+
 	return true;
 }
 
@@ -117,6 +128,8 @@ bool COptionsPageFilelists::SavePage()
 	m_pOptions->set(OPTION_DOUBLECLICK_ACTION_FILE, impl_->doubleClickFileAction_->GetSelection());
 	m_pOptions->set(OPTION_DOUBLECLICK_ACTION_DIRECTORY, impl_->doubleClickDirAction_->GetSelection());
 
+	m_pOptions->set(OPTION_CACHE_PERSISTENT, impl_->persistentCache_->GetValue());
+
 	return true;
 }
 
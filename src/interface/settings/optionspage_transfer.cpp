@@ -14,6 +14,7 @@ struct COptionsPageTransfer::impl final
 	wxSpinCtrlEx* transfers_{};
 	wxSpinCtrlEx* downloads_{};
 	wxSpinCtrlEx* uploads_{};
+	wxSpinCtrlEx* listings_{};
 
 	wxChoice* burst_tolerance_{};
 
@@ -25,6 +26,9 @@ struct COptionsPageTransfer::impl final
 	wxTextCtrlEx* replace_{};
 
 	wxCheckBox* preallocate_{};
+
+	wxSpinCtrlEx* segments_{};
+	wxTextCtrlEx* segment_minsize_{};
 };
 
 COptionsPageTransfer::COptionsPageTransfer()
@@ -65,6 +69,12 @@ bool COptionsPageTransfer::CreateControls(wxWindow* parent)
 		impl_->uploads_->SetMaxLength(2);
 		inner->Add(impl_->uploads_, lay.valign);
 		inner->Add(new wxStaticText(box, nullID, _("(0 for no limit)")), lay.valign);
+		inner->Add(new wxStaticText(box, nullID, _("Additional connections for re&cursive listings:")), lay.valign);
+		impl_->listings_ = new wxSpinCtrlEx(box, nullID, wxString(), wxDefaultPosition, wxSize(lay.dlgUnits(26), -1));
+		impl_->listings_->SetRange(0, 10);
+		impl_->listings_->SetMaxLength(2);
+		inner->Add(impl_->listings_, lay.valign);
+		inner->Add(new wxStaticText(box, nullID, _("(0 to disable)")), lay.valign);
 	}
 
 	{
@@ -132,6 +142,24 @@ bool COptionsPageTransfer::CreateControls(wxWindow* parent)
 		inner->Add(impl_->preallocate_);
 	}
 
+	{
+		auto [box, inner] = lay.createStatBox(main, _("Segmented downloads"), 1);
+		inner->Add(new wxStaticText(box, nullID, _("Large files can be downloaded in several segments at once, each using its own connection. Only new files are split, the number of segments is limited by the number of simultaneous transfers.")));
+		auto innermost = lay.createFlex(3);
+		inner->Add(innermost);
+		innermost->Add(new wxStaticText(box, nullID, _("Maximum &segments per file:")), lay.valign);
+		impl_->segments_ = new wxSpinCtrlEx(box, nullID, wxString(), wxDefaultPosition, wxSize(lay.dlgUnits(26), -1));
+		impl_->segments_->SetRange(0, 10);
+		impl_->segments_->SetMaxLength(2);
+		innermost->Add(impl_->segments_, lay.valign);
+		innermost->Add(new wxStaticText(box, nullID, _("(0 to disable)")), lay.valign);
+		innermost->Add(new wxStaticText(box, nullID, _("M&inimum segment size:")), lay.valign);
+		impl_->segment_minsize_ = new wxTextCtrlEx(box, nullID, wxString(), wxDefaultPosition, wxSize(lay.dlgUnits(40), -1));
+		impl_->segment_minsize_->SetMaxLength(7);
+		innermost->Add(impl_->segment_minsize_, lay.valign);
+		innermost->Add(new wxStaticText(box, nullID, wxString::Format(_("(in %s)"), CSizeFormat::GetUnitWithBase(CSizeFormat::mega, 1024))), lay.valign);
+	}
+
 	GetSizer()->Fit(this);
 
 	return true;
@@ -151,6 +179,7 @@ bool COptionsPageTransfer::LoadPage()
 	impl_->transfers_->SetValue(m_pOptions->get_int(OPTION_NUMTRANSFERS));
 	impl_->downloads_->SetValue(m_pOptions->get_int(OPTION_CONCURRENTDOWNLOADLIMIT));
 	impl_->uploads_->SetValue(m_pOptions->get_int(OPTION_CONCURRENTUPLOADLIMIT));
+	impl_->listings_->SetValue(m_pOptions->get_int(OPTION_PARALLEL_LISTINGS));
 
 	impl_->burst_tolerance_->SetSelection(m_pOptions->get_int(OPTION_SPEEDLIMIT_BURSTTOLERANCE));
 	impl_->burst_tolerance_->Enable(enable_speedlimits);
@@ -160,6 +189,9 @@ bool COptionsPageTransfer::LoadPage()
 
 	impl_->preallocate_->SetValue(m_pOptions->get_bool(OPTION_PREALLOCATE_SPACE));
 
+	impl_->segments_->SetValue(m_pOptions->get_int(OPTION_SEGMENTED_DOWNLOADS));
+	impl_->segment_minsize_->ChangeValue(m_pOptions->get_string(OPTION_SEGMENTED_DOWNLOAD_MINSIZE));
+
 	return true;
 }
 
@@ -170,6 +202,7 @@ bool COptionsPageTransfer::SavePage()
 	m_pOptions->set(OPTION_NUMTRANSFERS, impl_->transfers_->GetValue());
 	m_pOptions->set(OPTION_CONCURRENTDOWNLOADLIMIT,	impl_->downloads_->GetValue());
 	m_pOptions->set(OPTION_CONCURRENTUPLOADLIMIT, impl_->uploads_->GetValue());
+	m_pOptions->set(OPTION_PARALLEL_LISTINGS, impl_->listings_->GetValue());
 
 	m_pOptions->set(OPTION_SPEEDLIMIT_INBOUND, impl_->dllimit_->GetValue().ToStdWstring());
 	m_pOptions->set(OPTION_SPEEDLIMIT_OUTBOUND, impl_->ullimit_->GetValue().ToStdWstring());
@@ -177,6 +210,8 @@ bool COptionsPageTransfer::SavePage()
 	m_pOptions->set(OPTION_INVALID_CHAR_REPLACE, impl_->replace_->GetValue().ToStdWstring());
 	m_pOptions->set(OPTION_INVALID_CHAR_REPLACE_ENABLE, impl_->enable_replace_->GetValue());
 	m_pOptions->set(OPTION_PREALLOCATE_SPACE, impl_->preallocate_->GetValue());
+	m_pOptions->set(OPTION_SEGMENTED_DOWNLOADS, impl_->segments_->GetValue());
+	m_pOptions->set(OPTION_SEGMENTED_DOWNLOAD_MINSIZE, impl_->segment_minsize_->GetValue().ToStdWstring());
 
 	return true;
 }
@@ -195,6 +230,10 @@ bool COptionsPageTransfer::Validate()
 		return DisplayError(impl_->uploads_, _("Please enter a number between 0 and 10 for the number of concurrent uploads."));
 	}
 
+	if (impl_->listings_->GetValue() < 0 || impl_->listings_->GetValue() > 10) {
+		return DisplayError(impl_->listings_, _("Please enter a number between 0 and 10 for the number of additional listing connections."));
+	}
+
 	if (fz::to_integral<int>(impl_->dllimit_->GetValue().ToStdWstring(), -1) < 0) {
 		const wxString unit = CSizeFormat::GetUnitWithBase(CSizeFormat::kilo, 1024);
 		return DisplayError(impl_->dllimit_, wxString::Format(_("Please enter a download speed limit greater or equal to 0 %s/s."), unit));
@@ -205,6 +244,16 @@ bool COptionsPageTransfer::Validate()
 		return DisplayError(impl_->ullimit_, wxString::Format(_("Please enter an upload speed limit greater or equal to 0 %s/s."), unit));
 	}
 
+	if (impl_->segments_->GetValue() < 0 || impl_->segments_->GetValue() > 10) {
+		return DisplayError(impl_->segments_, _("Please enter a number between 0 and 10 for the number of segments per file."));
+	}
+
+	int const minsize = fz::to_integral<int>(impl_->segment_minsize_->GetValue().ToStdWstring(), -1);
+	if (minsize < 1 || minsize > 1024 * 1024) {
+		wxString const unit = CSizeFormat::GetUnitWithBase(CSizeFormat::mega, 1024);
+		return DisplayError(impl_->segment_minsize_, wxString::Format(_("Please enter a minimum segment size between 1 and 1048576 %s."), unit));
+	}
+
 	std::wstring replace = impl_->replace_->GetValue().ToStdWstring();
 #ifdef __WXMSW__
 	if (replace == _T("\\") ||
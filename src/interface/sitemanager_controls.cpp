@@ -1171,6 +1171,9 @@ TransferSettingsSiteControls::TransferSettingsSiteControls(wxWindow & parent, Di
 	row->Add(spin, lay.valign);
 
 	limit->Bind(wxEVT_CHECKBOX, [spin](wxCommandEvent const& ev){ spin->Enable(ev.IsChecked()); });
+
+	sizer.Add(new wxCheckBox(&parent, XRCID("ID_MODE_Z"), _("Use data &compression (MODE Z) if supported by the server")));
+	sizer.Add(new wxCheckBox(&parent, XRCID("ID_PIPELINING"), _("Send multiple commands &without waiting for replies when deleting files")));
 }
 
 void TransferSettingsSiteControls::SetSite(Site const& site)
@@ -1179,10 +1182,14 @@ void TransferSettingsSiteControls::SetSite(Site const& site)
 	xrc_call(parent_, "ID_TRANSFERMODE_ACTIVE", &wxWindow::Enable, !predefined_);
 	xrc_call(parent_, "ID_TRANSFERMODE_PASSIVE", &wxWindow::Enable, !predefined_);
 	xrc_call(parent_, "ID_LIMITMULTIPLE", &wxWindow::Enable, !predefined_);
+	xrc_call(parent_, "ID_MODE_Z", &wxWindow::Enable, !predefined_);
+	xrc_call(parent_, "ID_PIPELINING", &wxWindow::Enable, !predefined_);
 
 	if (!site) {
 		xrc_call(parent_, "ID_TRANSFERMODE_DEFAULT", &wxRadioButton::SetValue, true);
 		xrc_call(parent_, "ID_LIMITMULTIPLE", &wxCheckBox::SetValue, false);
+		xrc_call(parent_, "ID_MODE_Z", &wxCheckBox::SetValue, false);
+		xrc_call(parent_, "ID_PIPELINING", &wxCheckBox::SetValue, false);
 		xrc_call(parent_, "ID_MAXMULTIPLE", &wxSpinCtrl::Enable, false);
 		xrc_call<wxSpinCtrl, int>(parent_, "ID_MAXMULTIPLE", &wxSpinCtrl::SetValue, 1);
 	}
@@ -1211,6 +1218,8 @@ void TransferSettingsSiteControls::SetSite(Site const& site)
 			xrc_call<wxSpinCtrl, int>(parent_, "ID_MAXMULTIPLE", &wxSpinCtrl::SetValue, 1);
 		}
 
+		xrc_call(parent_, "ID_MODE_Z", &wxCheckBox::SetValue, site.server.GetExtraParameter("mode_z") == L"1");
+		xrc_call(parent_, "ID_PIPELINING", &wxCheckBox::SetValue, site.server.GetExtraParameter("pipelining") == L"1");
 	}
 }
 
@@ -1238,6 +1247,24 @@ bool TransferSettingsSiteControls::UpdateSite(Site & site, bool)
 		site.server.MaximumMultipleConnections(0);
 	}
 
+	if (CServer::ProtocolHasFeature(site.server.GetProtocol(), ProtocolFeature::DataCompression) &&
+		xrc_call(parent_, "ID_MODE_Z", &wxCheckBox::GetValue))
+	{
+		site.server.SetExtraParameter("mode_z", L"1");
+	}
+	else {
+		site.server.ClearExtraParameter("mode_z");
+	}
+
+	if (CServer::ProtocolHasFeature(site.server.GetProtocol(), ProtocolFeature::CommandPipelining) &&
+		xrc_call(parent_, "ID_PIPELINING", &wxCheckBox::GetValue))
+	{
+		site.server.SetExtraParameter("pipelining", L"1");
+	}
+	else {
+		site.server.ClearExtraParameter("pipelining");
+	}
+
 	return true;
 }
 
@@ -1249,6 +1276,8 @@ void TransferSettingsSiteControls::SetControlVisibility(ServerProtocol protocol,
 	xrc_call(parent_, "ID_TRANSFERMODE_PASSIVE", &wxWindow::Show, hasTransferMode);
 	auto* transferModeLabel = XRCCTRL(parent_, "ID_TRANSFERMODE_LABEL", wxStaticText);
 	transferModeLabel->Show(hasTransferMode);
+	xrc_call(parent_, "ID_MODE_Z", &wxWindow::Show, CServer::ProtocolHasFeature(protocol, ProtocolFeature::DataCompression));
+	xrc_call(parent_, "ID_PIPELINING", &wxWindow::Show, CServer::ProtocolHasFeature(protocol, ProtocolFeature::CommandPipelining));
 	transferModeLabel->GetContainingSizer()->CalcMin();
 	transferModeLabel->GetContainingSizer()->Layout();
 }
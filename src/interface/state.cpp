@@ -36,6 +36,18 @@ bool CStateFilterManager::FilenameFiltered(std::wstring const& name, std::wstrin
 	return CFilterManager::FilenameFiltered(name, path, dir, size, local, attributes, date);
 }
 
+filter_matcher CStateFilterManager::GetFilterMatcher(bool local) const
+{
+	std::vector<CFilter> filters;
+	CFilter const& filter = local ? m_localFilter : m_remoteFilter;
+	if (filter) {
+		filters.push_back(filter);
+	}
+	AddActiveFilters(filters, local);
+
+	return filter_matcher(filters);
+}
+
 CContextManager CContextManager::m_the_context_manager;
 
 CContextManager::CContextManager()
@@ -229,7 +241,7 @@ CState::CState(CMainFrame &mainFrame)
 	m_pComparisonManager = new CComparisonManager(*this, m_mainFrame.GetOptions());
 
 	m_pLocalRecursiveOperation = new CLocalRecursiveOperation(*this);
-	m_pRemoteRecursiveOperation = new CRemoteRecursiveOperation(*this);
+	m_pRemoteRecursiveOperation = new CRemoteRecursiveOperation(*this, m_mainFrame);
 
 	m_localDir.SetPath(std::wstring(1, CLocalPath::path_separator));
 }
@@ -371,6 +383,9 @@ bool CState::SetRemoteDir(std::shared_ptr<CDirectoryListing> const& pDirectoryLi
 	{
 		m_previouslyVisitedRemoteSubdir = m_pDirectoryListing->path.GetLastSegment();
 	}
+	else if (m_pDirectoryListing && m_pDirectoryListing->partial() && m_pDirectoryListing->path == pDirectoryListing->path) {
+		// Already handled when the first partial listing arrived
+	}
 	else {
 		m_previouslyVisitedRemoteSubdir.clear();
 	}
@@ -386,7 +401,7 @@ bool CState::SetRemoteDir(std::shared_ptr<CDirectoryListing> const& pDirectoryLi
 	}
 
 	if (m_pDirectoryListing && m_pDirectoryListing->path == pDirectoryListing->path &&
-		pDirectoryListing->failed())
+		pDirectoryListing->failed() && !m_pDirectoryListing->partial())
 	{
 		// We still got an old listing, no need to display the new one
 		return true;
@@ -443,6 +458,36 @@ bool CState::SetRemoteDir(std::shared_ptr<CDirectoryListing> const& pDirectoryLi
 	return true;
 }
 
+void CState::SetRemoteDirPartial(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
+{
+	if (!pDirectoryListing) {
+		return;
+	}
+
+	// Comparison and synchronized browsing get set up once the complete listing has arrived.
+	if (m_changeDirFlags.compare || m_changeDirFlags.syncbrowse) {
+		return;
+	}
+
+	if (m_pDirectoryListing && m_pDirectoryListing->path == pDirectoryListing->path) {
+		if (!m_pDirectoryListing->partial() || m_pDirectoryListing->m_firstListTime != pDirectoryListing->m_firstListTime) {
+			// Refreshing the current directory, keep displaying the old listing until the new one is complete
+			return;
+		}
+	}
+	else if (m_pDirectoryListing && pDirectoryListing->path == m_pDirectoryListing->path.GetParent()) {
+		m_previouslyVisitedRemoteSubdir = m_pDirectoryListing->path.GetLastSegment();
+	}
+	else {
+		m_previouslyVisitedRemoteSubdir.clear();
+	}
+
+	m_pDirectoryListing = pDirectoryListing;
+
+	bool primary = true;
+	NotifyHandlers(STATECHANGE_REMOTE_DIR, std::wstring(), &primary);
+}
+
 std::shared_ptr<CDirectoryListing> CState::GetRemoteDir() const
 {
 	return m_pDirectoryListing;
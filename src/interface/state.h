@@ -66,6 +66,7 @@ class CStateFilterManager final : public CFilterManager
 {
 public:
 	virtual bool FilenameFiltered(std::wstring const& name, std::wstring const& path, bool dir, int64_t size, bool local, int attributes, fz::datetime const& date) const override;
+	virtual filter_matcher GetFilterMatcher(bool local) const override;
 
 	CFilter const& GetLocalFilter() const { return m_localFilter; }
 	void SetLocalFilter(CFilter const& filter) { m_localFilter = filter; }
@@ -146,6 +147,7 @@ public:
 
 	bool ChangeRemoteDir(CServerPath const& path, std::wstring const& subdir = std::wstring(), int flags = 0, bool ignore_busy = false, bool compare = false);
 	bool SetRemoteDir(std::shared_ptr<CDirectoryListing> const& pDirectoryListing, bool primary);
+	void SetRemoteDirPartial(std::shared_ptr<CDirectoryListing> const& pDirectoryListing);
 	std::shared_ptr<CDirectoryListing> GetRemoteDir() const;
 	const CServerPath GetRemotePath() const;
 
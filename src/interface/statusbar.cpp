@@ -750,6 +750,14 @@ void CStatusBar::UpdateActivityTooltip()
 	wxString tooltipText;
 	tooltipText.Printf(_("Network activity:") + L"\n    " + _("Download: %s/s") + L"\n    " + _("Upload: %s/s"), dlSpeed, upSpeed);
 
+	uint64_t const saved = activity_logger_.saved();
+	if (saved) {
+		std::wstring const savedSize = CSizeFormat::Format(saved, true, format,
+														   options_.get_int(OPTION_SIZE_USETHOUSANDSEP) != 0,
+														   options_.get_int(OPTION_SIZE_DECIMALPLACES));
+		tooltipText += L"\n    " + wxString::Format(_("Saved by compression: %s"), savedSize);
+	}
+
 	activityLeds_[0]->SetToolTip(tooltipText);
 	activityLeds_[1]->SetToolTip(tooltipText);
 }
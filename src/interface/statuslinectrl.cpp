@@ -181,6 +181,13 @@ void CStatusLineCtrl::OnPaint(wxPaintEvent&)
 			bytes_and_rate.Printf(_("%s (? B/s)"), bytestr);
 		}
 
+		if (status_.window > 0) {
+			// Amount of data requested ahead of time, adapts to the connection
+			const wxString windowstr = CSizeFormat::Format(status_.window, true, CSizeFormat::iec,
+														   options_.get_int(OPTION_SIZE_USETHOUSANDSEP) != 0, 0);
+			bytes_and_rate += wxString::Format(_(", window %s"), windowstr);
+		}
+
 		if (m_last_bytes_and_rate != bytes_and_rate) {
 			refresh |= 8;
 			m_last_bytes_and_rate = bytes_and_rate;
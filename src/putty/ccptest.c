@@ -0,0 +1,304 @@
+/*
+ * Known-answer tests for ChaCha20 and Poly1305 with the test vectors of
+ * RFC 8439, run against each implementation the CPU supports.
+ *
+ * RFC 8439 uses a 32-bit block counter and a 96-bit nonce, while the SSH
+ * variant uses a 64-bit counter and a 64-bit nonce. Both only differ in
+ * how words 12 to 15 of the state get filled, so the tests set up the
+ * state directly. This needs the internals of sshccp.c, which is why it
+ * gets included here rather than linked.
+ *
+ * The buffers are long enough for the SIMD implementations to process
+ * several groups of blocks, the parts beyond the test vectors need to
+ * match the unaccelerated implementation.
+ */
+
+#include <stdio.h>
+
+#include "sshccp.c"
+
+void out_of_memory(void)
+{
+    fprintf(stderr, "out of memory\n");
+    abort();
+}
+
+/* Section 2.4.2 */
+static const char sunscreen[] =
+    "Ladies and Gentlemen of the class of '99: If I could offer y"
+    "ou only one tip for the future, sunscreen would be it.";
+
+static const unsigned char sunscreen_nonce[12] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const unsigned char sunscreen_cipher[114] = {
+    0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28,
+    0xdd, 0x0d, 0x69, 0x81, 0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2,
+    0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b, 0xf9, 0x1b, 0x65, 0xc5,
+    0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+    0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35,
+    0x9f, 0x08, 0x61, 0xd8, 0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61,
+    0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e, 0x52, 0xbc, 0x51, 0x4d,
+    0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+    0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed,
+    0xf2, 0x78, 0x5e, 0x42, 0x87, 0x4d,
+};
+
+/* Appendix A.1, test vectors #1 and #2: consecutive blocks of the
+ * key stream for the all-zero key and nonce */
+static const unsigned char zero_keystream[128] = {
+    0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5,
+    0x53, 0x86, 0xbd, 0x28, 0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a,
+    0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7, 0xda, 0x41, 0x59, 0x7c,
+    0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+    0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69,
+    0xb2, 0xee, 0x65, 0x86, 0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a,
+    0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d, 0xcb, 0x0f, 0x29, 0xa0,
+    0x48, 0xe3, 0x65, 0x69, 0x12, 0xc6, 0x53, 0x3e, 0x32, 0xee, 0x7a, 0xed,
+    0x29, 0xb7, 0x21, 0x76, 0x9c, 0xe6, 0x4e, 0x43, 0xd5, 0x71, 0x33, 0xb0,
+    0x74, 0xd8, 0x39, 0xd5, 0x31, 0xed, 0x1f, 0x28, 0x51, 0x0a, 0xfb, 0x45,
+    0xac, 0xe1, 0x0a, 0x1f, 0x4b, 0x79, 0x4d, 0x6f,
+};
+
+/* Appendix A.2, test vector #2, and A.3, test vectors #2 and #3 */
+static const char ietf[] =
+    "Any submission to the IETF intended by the Contributor for p"
+    "ublication as all or part of an IETF Internet-Draft or RFC a"
+    "nd any statement made within the context of an IETF activity"
+    " is considered an \"IETF Contribution\". Such statements inclu"
+    "de oral statements in IETF sessions, as well as written and "
+    "electronic communications made at any time or place, which a"
+    "re addressed to";
+
+static const unsigned char ietf_cipher[375] = {
+    0xa3, 0xfb, 0xf0, 0x7d, 0xf3, 0xfa, 0x2f, 0xde, 0x4f, 0x37, 0x6c, 0xa2,
+    0x3e, 0x82, 0x73, 0x70, 0x41, 0x60, 0x5d, 0x9f, 0x4f, 0x4f, 0x57, 0xbd,
+    0x8c, 0xff, 0x2c, 0x1d, 0x4b, 0x79, 0x55, 0xec, 0x2a, 0x97, 0x94, 0x8b,
+    0xd3, 0x72, 0x29, 0x15, 0xc8, 0xf3, 0xd3, 0x37, 0xf7, 0xd3, 0x70, 0x05,
+    0x0e, 0x9e, 0x96, 0xd6, 0x47, 0xb7, 0xc3, 0x9f, 0x56, 0xe0, 0x31, 0xca,
+    0x5e, 0xb6, 0x25, 0x0d, 0x40, 0x42, 0xe0, 0x27, 0x85, 0xec, 0xec, 0xfa,
+    0x4b, 0x4b, 0xb5, 0xe8, 0xea, 0xd0, 0x44, 0x0e, 0x20, 0xb6, 0xe8, 0xdb,
+    0x09, 0xd8, 0x81, 0xa7, 0xc6, 0x13, 0x2f, 0x42, 0x0e, 0x52, 0x79, 0x50,
+    0x42, 0xbd, 0xfa, 0x77, 0x73, 0xd8, 0xa9, 0x05, 0x14, 0x47, 0xb3, 0x29,
+    0x1c, 0xe1, 0x41, 0x1c, 0x68, 0x04, 0x65, 0x55, 0x2a, 0xa6, 0xc4, 0x05,
+    0xb7, 0x76, 0x4d, 0x5e, 0x87, 0xbe, 0xa8, 0x5a, 0xd0, 0x0f, 0x84, 0x49,
+    0xed, 0x8f, 0x72, 0xd0, 0xd6, 0x62, 0xab, 0x05, 0x26, 0x91, 0xca, 0x66,
+    0x42, 0x4b, 0xc8, 0x6d, 0x2d, 0xf8, 0x0e, 0xa4, 0x1f, 0x43, 0xab, 0xf9,
+    0x37, 0xd3, 0x25, 0x9d, 0xc4, 0xb2, 0xd0, 0xdf, 0xb4, 0x8a, 0x6c, 0x91,
+    0x39, 0xdd, 0xd7, 0xf7, 0x69, 0x66, 0xe9, 0x28, 0xe6, 0x35, 0x55, 0x3b,
+    0xa7, 0x6c, 0x5c, 0x87, 0x9d, 0x7b, 0x35, 0xd4, 0x9e, 0xb2, 0xe6, 0x2b,
+    0x08, 0x71, 0xcd, 0xac, 0x63, 0x89, 0x39, 0xe2, 0x5e, 0x8a, 0x1e, 0x0e,
+    0xf9, 0xd5, 0x28, 0x0f, 0xa8, 0xca, 0x32, 0x8b, 0x35, 0x1c, 0x3c, 0x76,
+    0x59, 0x89, 0xcb, 0xcf, 0x3d, 0xaa, 0x8b, 0x6c, 0xcc, 0x3a, 0xaf, 0x9f,
+    0x39, 0x79, 0xc9, 0x2b, 0x37, 0x20, 0xfc, 0x88, 0xdc, 0x95, 0xed, 0x84,
+    0xa1, 0xbe, 0x05, 0x9c, 0x64, 0x99, 0xb9, 0xfd, 0xa2, 0x36, 0xe7, 0xe8,
+    0x18, 0xb0, 0x4b, 0x0b, 0xc3, 0x9c, 0x1e, 0x87, 0x6b, 0x19, 0x3b, 0xfe,
+    0x55, 0x69, 0x75, 0x3f, 0x88, 0x12, 0x8c, 0xc0, 0x8a, 0xaa, 0x9b, 0x63,
+    0xd1, 0xa1, 0x6f, 0x80, 0xef, 0x25, 0x54, 0xd7, 0x18, 0x9c, 0x41, 0x1f,
+    0x58, 0x69, 0xca, 0x52, 0xc5, 0xb8, 0x3f, 0xa3, 0x6f, 0xf2, 0x16, 0xb9,
+    0xc1, 0xd3, 0x00, 0x62, 0xbe, 0xbc, 0xfd, 0x2d, 0xc5, 0xbc, 0xe0, 0x91,
+    0x19, 0x34, 0xfd, 0xa7, 0x9a, 0x86, 0xf6, 0xe6, 0x98, 0xce, 0xd7, 0x59,
+    0xc3, 0xff, 0x9b, 0x64, 0x77, 0x33, 0x8f, 0x3d, 0xa4, 0xf9, 0xcd, 0x85,
+    0x14, 0xea, 0x99, 0x82, 0xcc, 0xaf, 0xb3, 0x41, 0xb2, 0x38, 0x4d, 0xd9,
+    0x02, 0xf3, 0xd1, 0xab, 0x7a, 0xc6, 0x1d, 0xd2, 0x9c, 0x6f, 0x21, 0xba,
+    0x5b, 0x86, 0x2f, 0x37, 0x30, 0xe3, 0x7c, 0xfd, 0xc4, 0xfd, 0x80, 0x6c,
+    0x22, 0xf2, 0x21,
+};
+
+
+/* Poly1305 keys of section 2.5.2 and appendix A.3 */
+static const unsigned char poly_key_252[32] = {
+    0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe,
+    0x42, 0xd5, 0x06, 0xa8, 0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd,
+    0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b,
+};
+static const char poly_msg_252[] = "Cryptographic Forum Research Group";
+static const unsigned char poly_tag_252[16] = {
+    0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf,
+    0x0c, 0x01, 0x27, 0xa9,
+};
+
+static const unsigned char poly_key_a32[32] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x36, 0xe5, 0xf6, 0xb5, 0xc5, 0xe0, 0x60, 0x70,
+    0xf0, 0xef, 0xca, 0x96, 0x22, 0x7a, 0x86, 0x3e,
+};
+static const unsigned char poly_tag_a32[16] = {
+    0x36, 0xe5, 0xf6, 0xb5, 0xc5, 0xe0, 0x60, 0x70, 0xf0, 0xef, 0xca, 0x96,
+    0x22, 0x7a, 0x86, 0x3e,
+};
+
+static const unsigned char poly_key_a33[32] = {
+    0x36, 0xe5, 0xf6, 0xb5, 0xc5, 0xe0, 0x60, 0x70, 0xf0, 0xef, 0xca, 0x96,
+    0x22, 0x7a, 0x86, 0x3e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+static const unsigned char poly_tag_a33[16] = {
+    0xf3, 0x47, 0x7e, 0x7c, 0xd9, 0x54, 0x17, 0xaf, 0x89, 0xa6, 0xb8, 0x79,
+    0x4c, 0x31, 0x0c, 0xf0,
+};
+
+struct impl {
+    const char *name;
+    const struct ccp_simd *simd;
+};
+
+static int failures = 0;
+
+static void fail(const struct impl *impl, const char *test)
+{
+    printf("%s: %s failed\n", impl->name, test);
+    ++failures;
+}
+
+#define BUFLEN 1024
+
+static void chacha20_setup(struct chacha20 *ctx, const struct impl *impl,
+                           const unsigned char *key,
+                           const unsigned char *nonce, uint32_t counter)
+{
+    chacha20_key(ctx, key);
+    ctx->state[12] = counter;
+    ctx->state[13] = GET_32BIT_LSB_FIRST(nonce);
+    ctx->state[14] = GET_32BIT_LSB_FIRST(nonce + 4);
+    ctx->state[15] = GET_32BIT_LSB_FIRST(nonce + 8);
+    ctx->simd = impl->simd;
+}
+
+/*
+ * Encrypts the plain text padded with zeroes to BUFLEN, once in a single
+ * call and once starting with a partial block. The start needs to match
+ * the expected cipher text, all of it the output of the unaccelerated
+ * implementation.
+ */
+static void test_chacha20(const struct impl *impl, const char *test,
+                          const unsigned char *key,
+                          const unsigned char *nonce, uint32_t counter,
+                          const void *plain, const unsigned char *cipher,
+                          size_t len, unsigned char *reference)
+{
+    unsigned char buf[BUFLEN];
+    struct chacha20 ctx;
+    int split;
+
+    for (split = 0; split < 2; ++split) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, plain, len);
+
+        chacha20_setup(&ctx, impl, key, nonce, counter);
+        if (split) {
+            chacha20_encrypt(&ctx, buf, 5);
+            chacha20_encrypt(&ctx, buf + 5, 64 - 5);
+            chacha20_encrypt(&ctx, buf + 64, BUFLEN - 64);
+        } else {
+            chacha20_encrypt(&ctx, buf, BUFLEN);
+        }
+
+        if (cipher && memcmp(buf, cipher, len))
+            fail(impl, test);
+        else if (!impl->simd)
+            memcpy(reference, buf, BUFLEN);
+        else if (memcmp(buf, reference, BUFLEN))
+            fail(impl, test);
+    }
+    smemclr(&ctx, sizeof(ctx));
+}
+
+/*
+ * Feeds the message in pieces of the given size, with the whole message
+ * at once the SIMD implementations get used for messages of at least
+ * POLY1305_SIMD_MIN bytes.
+ */
+static void test_poly1305(const struct impl *impl, const char *test,
+                          const unsigned char *key, const void *msg,
+                          size_t len, const unsigned char *tag)
+{
+    static const size_t pieces[] = { BUFLEN, 300, 7 };
+    const unsigned char *p = (const unsigned char *)msg;
+    unsigned char mac[16];
+    struct poly1305 ctx;
+    size_t i, pos, n;
+
+    for (i = 0; i < lenof(pieces); ++i) {
+        poly1305_init(&ctx);
+        ctx.simd = impl->simd;
+        poly1305_key(&ctx, make_ptrlen(key, 32));
+        for (pos = 0; pos < len; pos += n) {
+            n = len - pos < pieces[i] ? len - pos : pieces[i];
+            poly1305_feed(&ctx, p + pos, (int)n);
+        }
+        poly1305_finalise(&ctx, mac);
+        if (memcmp(mac, tag, 16))
+            fail(impl, test);
+    }
+    smemclr(&ctx, sizeof(ctx));
+}
+
+static void run(const struct impl *impl)
+{
+    static unsigned char ref_zero[BUFLEN], ref_sunscreen[BUFLEN],
+        ref_ietf[BUFLEN], ref_wrap[BUFLEN];
+    static const unsigned char zeroes[sizeof(zero_keystream)];
+    unsigned char key[32], nonce[12] = { 0 };
+    size_t i;
+
+    memset(key, 0, sizeof(key));
+    test_chacha20(impl, "ChaCha20 A.1 #1 and #2", key, nonce, 0,
+                  zeroes, zero_keystream, sizeof(zero_keystream), ref_zero);
+
+    for (i = 0; i < sizeof(key); ++i)
+        key[i] = (unsigned char)i;
+    test_chacha20(impl, "ChaCha20 2.4.2", key, sunscreen_nonce, 1,
+                  sunscreen, sunscreen_cipher, sizeof(sunscreen) - 1,
+                  ref_sunscreen);
+
+    memset(key, 0, sizeof(key));
+    key[31] = 1;
+    nonce[11] = 2;
+    test_chacha20(impl, "ChaCha20 A.2 #2", key, nonce, 1,
+                  ietf, ietf_cipher, sizeof(ietf) - 1, ref_ietf);
+
+    /* The SSH variant carries the block counter into word 13 */
+    test_chacha20(impl, "ChaCha20 counter carry", key, nonce, 0xfffffffd,
+                  "", NULL, 0, ref_wrap);
+
+    test_poly1305(impl, "Poly1305 2.5.2", poly_key_252, poly_msg_252,
+                  sizeof(poly_msg_252) - 1, poly_tag_252);
+    test_poly1305(impl, "Poly1305 A.3 #2", poly_key_a32, ietf,
+                  sizeof(ietf) - 1, poly_tag_a32);
+    test_poly1305(impl, "Poly1305 A.3 #3", poly_key_a33, ietf,
+                  sizeof(ietf) - 1, poly_tag_a33);
+}
+
+int main(void)
+{
+    struct impl impls[3];
+    size_t n = 0, i;
+
+    impls[n].name = "unaccelerated";
+    impls[n++].simd = NULL;
+#if HW_CCP == HW_CCP_X86
+    if (ccp_hw_level_cached() >= 1) {
+        impls[n].name = "SSE2";
+        impls[n++].simd = &ccp_simd_sse2;
+    } else {
+        printf("SSE2: not supported\n");
+    }
+    if (ccp_hw_level_cached() >= 2) {
+        impls[n].name = "AVX2";
+        impls[n++].simd = &ccp_simd_avx2;
+    } else {
+        printf("AVX2: not supported\n");
+    }
+#endif
+
+    for (i = 0; i < n; ++i) {
+        int before = failures;
+        run(&impls[i]);
+        if (failures == before)
+            printf("%s: ok\n", impls[i].name);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -1,4 +1,4 @@
-#define FZSFTP_PROTOCOL_VERSION 11
+#define FZSFTP_PROTOCOL_VERSION 15
 
 typedef enum
 {
@@ -33,6 +33,8 @@ typedef enum
     sftp_io_open,
     sftp_io_nextbuf,
     sftp_io_finalize,
+    sftpTransferWindow, /* amount of data in outstanding read or write requests */
+    sftpFileResult, /* index of a file in a multi-file command, followed by 1 on success or 0 on failure */
 } sftpEventTypes;
 
 extern bool pending_reply;
@@ -18,12 +18,76 @@ char *input_buf = 0;
 int input_buflen = 0, input_bufsize = 0;
 #endif
 
-char* priority_read()
+/*
+ * The engine hands buffers to us ahead of time, several buffers can be in
+ * flight at once. These arrive as lines of the form "-@<id> <offset> <size>"
+ * and may interleave with the replies we wait for in priority_read, so they
+ * are queued until the file transfer asks for its next buffer.
+ *
+ * The id gets incremented on every opened file, lines for previous files
+ * still in the pipe are discarded.
+ */
+struct buffer_line {
+    char* line;
+    struct buffer_line* next;
+};
+
+static unsigned int io_transfer_id = 0;
+static struct buffer_line* buffer_lines_head = 0;
+static struct buffer_line* buffer_lines_tail = 0;
+
+static void clear_buffer_lines()
+{
+    while (buffer_lines_head) {
+        struct buffer_line* next = buffer_lines_head->next;
+        sfree(buffer_lines_head->line);
+        sfree(buffer_lines_head);
+        buffer_lines_head = next;
+    }
+    buffer_lines_tail = 0;
+}
+
+// Returns the data following the id if the line is a buffer line of the current transfer
+static char* match_buffer_line(char* line)
+{
+    char* p;
+    if (line[0] != '-' || line[1] != '@') {
+        return 0;
+    }
+    p = line + 2;
+    if (next_int(&p) != io_transfer_id) {
+        return 0;
+    }
+    return p;
+}
+
+static void queue_buffer_line(char* line)
+{
+    struct buffer_line* entry;
+    if (!match_buffer_line(line)) {
+        sfree(line);
+        return;
+    }
+
+    entry = snew(struct buffer_line);
+    entry->line = line;
+    entry->next = 0;
+    if (buffer_lines_tail) {
+        buffer_lines_tail->next = entry;
+    }
+    else {
+        buffer_lines_head = entry;
+    }
+    buffer_lines_tail = entry;
+}
+
+static char* read_raw_line()
 {
 #ifdef _WINDOWS
-    char* ret = 0;
     HANDLE hin;
     DWORD savemode, newmode;
+    char* line;
+    size_t len = 0, size = 256;
 
     hin = GetStdHandle(STD_INPUT_HANDLE);
 
@@ -32,60 +96,114 @@ char* priority_read()
     newmode &= ~ENABLE_ECHO_INPUT;
     SetConsoleMode(hin, newmode);
 
-    char buffer[256];
-
-    while (!ret) {
+    // Read byte by byte, the engine may have sent several lines at once
+    line = snewn(size, char);
+    while (1) {
         DWORD read;
         BOOL r;
 
-        r = ReadFile(hin, buffer, 255, &read, 0);
+        if (len + 1 >= size) {
+            size *= 2;
+            line = sresize(line, size, char);
+        }
+        r = ReadFile(hin, line + len, 1, &read, 0);
         if (!r || read == 0) {
                 fzprintf(sftpError, "ReadFile failed in priority_read");
                 cleanup_exit(1);
         }
-        while (read && (buffer[read - 1] == '\r' || buffer[read - 1] == '\n')) {
-            --read;
+        if (line[len] == '\n') {
+            break;
         }
-        buffer[read] = 0;
+        ++len;
+    }
+    while (len && line[len - 1] == '\r') {
+        --len;
+    }
+    line[len] = 0;
 
-        if (buffer[0] != '-') {
+    SetConsoleMode(hin, savemode);
+
+    return line;
+#else
+    int error = 0;
+    char* line = read_input_line(1, &error);
+    if (line == NULL || error) {
+        fzprintf(sftpError, "read_input_line failed in priority_read");
+        cleanup_exit(1);
+    }
+    return line;
+#endif
+}
+
+char* priority_read()
+{
+    char* ret = 0;
+    while (!ret) {
+        char* line = read_raw_line();
+
+        if (line[0] != '-') {
             if (input_pushback != 0) {
+                sfree(line);
                 fzprintf(sftpError, "input_pushback not null!");
                 cleanup_exit(1);
             }
             else {
-                input_pushback = dupstr(buffer);
+                input_pushback = line;
             }
         }
+        else if (line[1] == '@') {
+            queue_buffer_line(line);
+        }
         else {
-            ret = dupstr(buffer);
+            ret = line;
         }
     }
+    return ret;
+}
 
-    SetConsoleMode(hin, savemode);
-#else
-    char* ret = 0;
-    while (!ret) {
-        int error = 0;
-        char* line = read_input_line(1, &error);
-        if (line == NULL || error) {
-            fzprintf(sftpError, "read_input_line failed in priority_read");
-            cleanup_exit(1);
-        }
+void begin_io_transfer()
+{
+    clear_buffer_lines();
+    ++io_transfer_id;
+}
+
+char* read_buffer_line()
+{
+    struct buffer_line* entry;
+    char* line;
+    char* ret;
 
+    while (!buffer_lines_head) {
+        line = read_raw_line();
         if (line[0] != '-') {
             if (input_pushback != 0) {
                 sfree(line);
                 fzprintf(sftpError, "input_pushback not null!");
                 cleanup_exit(1);
             }
-            else {
-                input_pushback = line;
-            }
+            input_pushback = line;
+        }
+        else if (line[1] == '@') {
+            queue_buffer_line(line);
         }
-        ret = line;
+        else {
+            sfree(line);
+            fzprintf(sftpError, "Unexpected reply while waiting for next buffer");
+            cleanup_exit(1);
+        }
+    }
+
+    entry = buffer_lines_head;
+    buffer_lines_head = entry->next;
+    if (!buffer_lines_head) {
+        buffer_lines_tail = 0;
     }
-#endif //_WINDOWS
+
+    line = entry->line;
+    sfree(entry);
+
+    ret = dupstr(match_buffer_line(line));
+    sfree(line);
     return ret;
 }
 
@@ -152,6 +270,10 @@ int ProcessQuotaCmd(const char* line)
     if (line[0] != '-')
         return 0;
 
+    /* Buffer of a file transfer that has already ended */
+    if (line[1] == '@')
+        return 0;
+
     if (line[1] == '0')
         direction = 0;
     else if (line[1] == '1')
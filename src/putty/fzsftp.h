@@ -3,6 +3,10 @@
 
 char* priority_read();
 
+/* Call before requesting a file to be opened, returns buffer lines of that file in order */
+void begin_io_transfer(void);
+char* read_buffer_line(void);
+
 int ProcessQuotaCmd(const char* line);
 int RequestQuota(int i, int bytes);
 void UpdateQuota(int i, int bytes);
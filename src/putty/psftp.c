@@ -269,6 +269,176 @@ char *canonify(const char *name, bool parent_only)
     }
 }
 
+/* ----------------------------------------------------------------------
+ * Apply an action to many files at once, keeping a number of requests
+ * in flight instead of waiting for each reply before sending the next
+ * request.
+ */
+#define SFTP_BATCH_WINDOW 32
+
+struct sftp_batch_item {
+    char *name;                        /* canonified */
+    int index;                         /* position in the command */
+    int state;                         /* number of requests completed */
+    struct fxp_attrs attrs;
+    unsigned oldperms;
+};
+
+struct sftp_batch_action {
+    bool parent_only;                  /* as in canonify */
+
+    /* Sends the next request for the item. */
+    struct sftp_request *(*send)(void *ctx, struct sftp_batch_item *item);
+
+    /*
+     * Handles the reply to the request. Returns 1 on success, 0 on
+     * failure, or -1 if the item needs another request.
+     */
+    int (*reply)(void *ctx, struct sftp_batch_item *item,
+                 struct sftp_packet *pktin, struct sftp_request *req);
+};
+
+/*
+ * Canonifies a name of a batch. The files of a batch usually share the
+ * same directory, so only the directory gets canonified, once for all
+ * consecutive names in it. As the requests used by the batches follow
+ * symbolic links on the server, that is the same as canonifying the
+ * full name.
+ */
+struct sftp_canon_cache {
+    char *dir;
+    char *canondir;                    /* without trailing slash */
+};
+
+static char *canonify_cached(struct sftp_canon_cache *cache,
+                             const char *name, bool parent_only)
+{
+    char *fullname, *base, *ret;
+
+    if (name[0] == '/') {
+        fullname = dupstr(name);
+    } else {
+        fullname = dupcat(pwd, pwd[strlen(pwd) - 1] == '/' ? "" : "/",
+                          name);
+    }
+
+    base = strrchr(fullname, '/');
+    if (base == fullname || !base[1] ||
+        !strcmp(base, "/.") || !strcmp(base, "/..")) {
+        sfree(fullname);
+        return canonify(name, parent_only);
+    }
+    *base++ = 0;
+
+    if (!cache->dir || strcmp(cache->dir, fullname)) {
+        char *canondir = canonify(fullname, false);
+        size_t len;
+        if (!canondir) {
+            sfree(fullname);
+            return NULL;
+        }
+        len = strlen(canondir);
+        if (len && canondir[len - 1] == '/')
+            canondir[len - 1] = 0;
+
+        sfree(cache->dir);
+        sfree(cache->canondir);
+        cache->dir = dupstr(fullname);
+        cache->canondir = canondir;
+    }
+
+    ret = dupcat(cache->canondir, "/", base);
+    sfree(fullname);
+    return ret;
+}
+
+static void sftp_batch_send(const struct sftp_batch_action *action,
+                            void *ctx, struct sftp_batch_item *item)
+{
+    struct sftp_request *req = action->send(ctx, item);
+    sftp_register(req);
+    fxp_set_userdata(req, item);
+}
+
+/*
+ * Runs the action on all names. The result for each file is reported
+ * by its index as sftpFileResult. Returns 1 if the action succeeded
+ * for all files.
+ */
+static int sftp_batch(const struct sftp_batch_action *action, void *ctx,
+                      char **names, int count)
+{
+    struct sftp_batch_item *items;
+    struct sftp_canon_cache cache = { NULL, NULL };
+    struct sftp_packet *pktin;
+    struct sftp_request *req;
+    struct sftp_batch_item *item;
+    int i, next, inflight = 0, failed = 0, result;
+
+    /*
+     * Canonifying needs its own round trips, these have to be done
+     * before any other request is outstanding.
+     */
+    items = snewn(count, struct sftp_batch_item);
+    for (i = 0; i < count; ++i) {
+        items[i].index = i;
+        items[i].state = 0;
+        items[i].name = canonify_cached(&cache, names[i], action->parent_only);
+        if (!items[i].name) {
+            fzprintf(sftpError, "%s: canonify: %s", names[i], fxp_error());
+            fzprintf(sftpFileResult, "%d 0", i);
+        }
+    }
+    sfree(cache.dir);
+    sfree(cache.canondir);
+
+    next = 0;
+    while (next < count || inflight) {
+        while (next < count && inflight < SFTP_BATCH_WINDOW) {
+            item = &items[next++];
+            if (!item->name) {
+                ++failed;
+                continue;
+            }
+            sftp_batch_send(action, ctx, item);
+            ++inflight;
+        }
+        if (!inflight)
+            break;
+
+        pktin = sftp_recv();
+        if (pktin == NULL) {
+            seat_connection_fatal(
+                psftp_seat, "did not receive SFTP response packet from server");
+        }
+        req = sftp_find_request(pktin);
+        item = req ? (struct sftp_batch_item *)fxp_get_userdata(req) : NULL;
+        if (!item) {
+            seat_connection_fatal(
+                psftp_seat,
+                "unable to understand SFTP response packet from server: %s",
+                fxp_error());
+        }
+
+        result = action->reply(ctx, item, pktin, req);
+        if (result < 0) {
+            ++item->state;
+            sftp_batch_send(action, ctx, item);
+            continue;
+        }
+
+        --inflight;
+        if (!result)
+            ++failed;
+        fzprintf(sftpFileResult, "%d %d", item->index, result);
+        sfree(item->name);
+        item->name = NULL;
+    }
+
+    sfree(items);
+    return failed ? 0 : 1;
+}
+
 static void not_connected(void)
 {
     fzprintf(sftpError, "psftp: not connected to a host; use \"open host.name\"");
@@ -277,7 +447,7 @@ static void not_connected(void)
 /* ----------------------------------------------------------------------
  * The meat of the `get' and `put' commands.
  */
-int sftp_get_file(char *fname, char *outfname, bool restart)
+int sftp_get_file(char *fname, char *outfname, bool restart, uint64_t end)
 {
     struct fxp_handle *fh;
     struct sftp_packet *pktin;
@@ -331,7 +501,7 @@ int sftp_get_file(char *fname, char *outfname, bool restart)
      * thus put up a progress bar.
      */
     ret = 1;
-    xfer = xfer_download_init(fh, offset);
+    xfer = xfer_download_init(fh, offset, end);
     while (!xfer_done(xfer)) {
         void *vbuf;
         int retd, len;
@@ -807,10 +977,14 @@ int sftp_cmd_pwd(struct sftp_command *cmd)
  * starts from where a previous aborted transfer left off; `mget'
  * differs in that it interprets all its arguments as files to
 * transfer (never as a different local name for a remote file).
+ *
+ * An optional third argument gives the offset at which to stop
+ * reading, so that only a range of the file gets downloaded.
  */
 int sftp_general_get(struct sftp_command *cmd, int restart)
 {
     char *fname, *origfname, *outfname;
+    uint64_t end = UINT64_MAX;
     int ret;
 
     if (!backend) {
@@ -818,7 +992,7 @@ int sftp_general_get(struct sftp_command *cmd, int restart)
         return 0;
     }
 
-    if (cmd->nwords != 3) {
+    if (cmd->nwords != 3 && cmd->nwords != 4) {
         fzprintf(sftpError, "%s: expects a filename", cmd->words[0]);
         return 0;
     }
@@ -826,6 +1000,14 @@ int sftp_general_get(struct sftp_command *cmd, int restart)
     ret = 1;
     origfname = cmd->words[1];
     outfname = cmd->words[2];
+    if (cmd->nwords == 4) {
+        char *endp;
+        end = strtoull(cmd->words[3], &endp, 10);
+        if (*endp || endp == cmd->words[3]) {
+            fzprintf(sftpError, "%s: invalid end offset", cmd->words[0]);
+            return 0;
+        }
+    }
 
     fname = canonify(origfname, false);
     if (!fname) {
@@ -833,7 +1015,7 @@ int sftp_general_get(struct sftp_command *cmd, int restart)
         return 0;
     }
 
-    ret = sftp_get_file(fname, outfname, restart);
+    ret = sftp_get_file(fname, outfname, restart, end);
     sfree(fname);
     return ret;
 }
@@ -982,26 +1164,29 @@ int sftp_cmd_rmdir(struct sftp_command *cmd)
     return ret;
 }
 
-static int sftp_action_rm(char *fname)
+static struct sftp_request *sftp_rm_send(void *ctx,
+                                         struct sftp_batch_item *item)
 {
-    struct sftp_packet *pktin;
-    struct sftp_request *req;
-    int result;
-
-    req = fxp_remove_send(fname);
-    pktin = sftp_wait_for_reply(req);
-    result = fxp_remove_recv(pktin, req);
+    return fxp_remove_send(item->name);
+}
 
-    if (!result) {
-        fzprintf(sftpError, "rm %s: %s", fname, fxp_error());
+static int sftp_rm_reply(void *ctx, struct sftp_batch_item *item,
+                         struct sftp_packet *pktin, struct sftp_request *req)
+{
+    if (!fxp_remove_recv(pktin, req)) {
+        fzprintf(sftpError, "rm %s: %s", item->name, fxp_error());
         return 0;
     }
 
-    fzprintf(sftpReply, "rm %s: OK", fname);
-
     return 1;
 }
 
+static const struct sftp_batch_action sftp_action_rm = {
+    .parent_only = true,
+    .send = sftp_rm_send,
+    .reply = sftp_rm_reply,
+};
+
 int sftp_cmd_rm(struct sftp_command *cmd)
 {
     if (!backend) {
@@ -1010,19 +1195,11 @@ int sftp_cmd_rm(struct sftp_command *cmd)
     }
 
     if (cmd->nwords < 2) {
-        fzprintf(sftpError, "rm: expects a filename");
+        fzprintf(sftpError, "rm: expects one or more filenames");
         return 0;
     }
 
-    char * cname = canonify(cmd->words[1], true);
-    if (!cname) {
-        fzprintf(sftpError, "%s: canonify: %s", cmd->words[1], fxp_error());
-        return 0;
-    }
-
-    int ret = sftp_action_rm(cname);
-    sfree(cname);
-    return ret;
+    return sftp_batch(&sftp_action_rm, NULL, cmd->words + 1, cmd->nwords - 1);
 }
 
 static int sftp_action_mv(char* source, char* target)
@@ -1089,48 +1266,57 @@ struct sftp_context_chmod {
     unsigned attrs_clr, attrs_xor;
 };
 
-static int sftp_action_chmod(void *vctx, char *fname)
+static struct sftp_request *sftp_chmod_send(void *vctx,
+                                            struct sftp_batch_item *item)
+{
+    if (!item->state)
+        return fxp_stat_send(item->name);
+    return fxp_setstat_send(item->name, item->attrs);
+}
+
+static int sftp_chmod_reply(void *vctx, struct sftp_batch_item *item,
+                            struct sftp_packet *pktin, struct sftp_request *req)
 {
-    struct fxp_attrs attrs;
-    struct sftp_packet *pktin;
-    struct sftp_request *req;
-    int result;
-    unsigned oldperms, newperms;
     struct sftp_context_chmod *ctx = (struct sftp_context_chmod *)vctx;
+    struct fxp_attrs *attrs = &item->attrs;
+    bool result;
+
+    if (!item->state) {
+        result = fxp_stat_recv(pktin, req, attrs);
+        if (!result || !(attrs->flags & SSH_FILEXFER_ATTR_PERMISSIONS)) {
+            fzprintf(sftpError, "get attrs for %s: %s", item->name,
+                   result ? "file permissions not provided" : fxp_error());
+            return 0;
+        }
 
-    req = fxp_stat_send(fname);
-    pktin = sftp_wait_for_reply(req);
-    result = fxp_stat_recv(pktin, req, &attrs);
+        attrs->flags = SSH_FILEXFER_ATTR_PERMISSIONS;   /* perms _only_ */
+        item->oldperms = attrs->permissions & 07777;
+        attrs->permissions &= ~ctx->attrs_clr;
+        attrs->permissions ^= ctx->attrs_xor;
 
-    if (!result || !(attrs.flags & SSH_FILEXFER_ATTR_PERMISSIONS)) {
-        fzprintf(sftpError, "get attrs for %s: %s", fname,
-               result ? "file permissions not provided" : fxp_error());
-        return 0;
+        if (item->oldperms == (attrs->permissions & 07777))
+            return 1;                   /* no need to do anything! */
+        return -1;
     }
 
-    attrs.flags = SSH_FILEXFER_ATTR_PERMISSIONS;   /* perms _only_ */
-    oldperms = attrs.permissions & 07777;
-    attrs.permissions &= ~ctx->attrs_clr;
-    attrs.permissions ^= ctx->attrs_xor;
-    newperms = attrs.permissions & 07777;
-
-    if (oldperms == newperms)
-        return 1;                       /* no need to do anything! */
-
-    req = fxp_setstat_send(fname, attrs);
-    pktin = sftp_wait_for_reply(req);
     result = fxp_setstat_recv(pktin, req);
-
     if (!result) {
-        fzprintf(sftpError, "set attrs for %s: %s", fname, fxp_error());
+        fzprintf(sftpError, "set attrs for %s: %s", item->name, fxp_error());
         return 0;
     }
 
-    fzprintf(sftpStatus, "%s: %04o -> %04o", fname, oldperms, newperms);
+    fzprintf(sftpStatus, "%s: %04o -> %04o", item->name, item->oldperms,
+             attrs->permissions & 07777);
 
     return 1;
 }
 
+static const struct sftp_batch_action sftp_action_chmod = {
+    .parent_only = false,
+    .send = sftp_chmod_send,
+    .reply = sftp_chmod_reply,
+};
+
 int sftp_cmd_chmod(struct sftp_command *cmd)
 {
     char *mode;
@@ -1141,8 +1327,8 @@ int sftp_cmd_chmod(struct sftp_command *cmd)
         return 0;
     }
 
-    if (cmd->nwords != 3) {
-        fzprintf(sftpError, "chmod: expects a mode specifier and a filename");
+    if (cmd->nwords < 3) {
+        fzprintf(sftpError, "chmod: expects a mode specifier and one or more filenames");
         return 0;
     }
 
@@ -1251,16 +1437,7 @@ int sftp_cmd_chmod(struct sftp_command *cmd)
         }
     }
 
-
-    char * cname = canonify(cmd->words[2], false);
-    if (!cname) {
-        fzprintf(sftpError, "%s: canonify: %s", cmd->words[2], fxp_error());
-        return 0;
-    }
-
-    sftp_action_chmod(ctx, cname);
-    sfree(cname);
-    return 0;
+    return sftp_batch(&sftp_action_chmod, ctx, cmd->words + 2, cmd->nwords - 2);
 }
 
 static int sftp_cmd_chmtime(struct sftp_command *cmd)
@@ -1568,9 +1745,11 @@ struct sftp_command *sftp_getcmd()
         sgrowarrayn(cmd->words, cmd->wordssize, cmd->nwords, 0);
         cmd->words[0] = dupstr("!");
         cmd->words[1] = dupstr(p+1);
-    } else if (*p == '#') {
+    } else if (*p == '#' || (p[0] == '-' && p[1] == '@')) {
         /*
-         * Special case: comment. Entire line is ignored.
+         * Special case: comment. Entire line is ignored. Same for
+         * buffers the engine handed out for a file transfer that has
+         * already ended.
          */
         cmd->nwords = cmd->wordssize = 0;
     } else {
@@ -2208,6 +2387,10 @@ int psftp_main(int argc, char *argv[])
         } else if (strcmp(argv[i], "-V") == 0 ||
                    strcmp(argv[i], "--version") == 0) {
             version();
+        } else if (strcmp(argv[i], "-transferwindow") == 0 && i + 2 < argc) {
+            /* FZ: Limits of the transfer window in KiB */
+            xfer_set_window_limits(atoi(argv[i+1]) * 1024, atoi(argv[i+2]) * 1024);
+            i += 2;
         } else if (strcmp(argv[i], "--") == 0) {
             i++;
             break;
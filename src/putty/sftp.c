@@ -8,13 +8,11 @@
 #include <assert.h>
 #include <limits.h>
 
+#include "putty.h"
 #include "misc.h"
 #include "tree234.h"
 #include "sftp.h"
 
-#include "fzprintf.h"
-#include "fzsftp.h"
-
 static const char *fxp_error_message;
 static int fxp_errtype;
 
@@ -903,19 +901,43 @@ struct req {
     char *buffer;
     int len, retlen, complete;
     uint64_t offset;
+    unsigned long sent;
     struct req *next, *prev;
 };
 
 struct fxp_xfer {
     uint64_t offset, furthestdata, filesize;
+    uint64_t end;                      /* downloads stop reading here */
     int req_totalsize, req_maxsize;
     bool eof, err;
     struct fxp_handle *fh;
     struct req *head, *tail;
     _fztimer send_timer;
     int sent_interval;
+
+    /* Measurements for adapting req_maxsize, see xfer_adapt_window */
+    unsigned long window_start, min_rtt;
+    uint64_t window_bytes;
+    bool window_full;
 };
 
+/*
+ * Limits of the amount of data in outstanding requests, set through
+ * the -transferwindow command line option.
+ */
+static int xfer_window_min = 1048576;
+static int xfer_window_max = 1048576*32;
+
+void xfer_set_window_limits(int min, int max)
+{
+    if (min < 32768)
+        min = 32768;
+    if (max < min)
+        max = min;
+    xfer_window_min = min;
+    xfer_window_max = max;
+}
+
 static struct fxp_xfer *xfer_init(struct fxp_handle *fh, uint64_t offset)
 {
     struct fxp_xfer *xfer = snew(struct fxp_xfer);
@@ -925,15 +947,86 @@ static struct fxp_xfer *xfer_init(struct fxp_handle *fh, uint64_t offset)
     xfer->head = xfer->tail = NULL;
     xfer->req_totalsize = 0;
     xfer->req_maxsize = 1048576*4;
+    if (xfer->req_maxsize < xfer_window_min)
+        xfer->req_maxsize = xfer_window_min;
+    if (xfer->req_maxsize > xfer_window_max)
+        xfer->req_maxsize = xfer_window_max;
     xfer->err = false;
     xfer->filesize = UINT64_MAX;
+    xfer->end = UINT64_MAX;
     xfer->furthestdata = 0;
     fz_timer_init(&xfer->send_timer);
     xfer->sent_interval = 0;
 
+    xfer->window_start = GETTICKCOUNT();
+    xfer->min_rtt = 0;
+    xfer->window_bytes = 0;
+    xfer->window_full = false;
+    fzprintf(sftpTransferWindow, "%d", xfer->req_maxsize);
+
     return xfer;
 }
 
+/*
+ * Adapts the amount of data in outstanding requests to the path.
+ *
+ * Every few round trips, the throughput over the last interval times
+ * the lowest observed request latency gives the bandwidth-delay
+ * product. If the window has been exhausted and the data in flight
+ * was close to the bandwidth-delay product, the window limits the
+ * throughput and gets doubled. Otherwise the window is brought down
+ * towards twice the bandwidth-delay product, but at most halved per
+ * interval so that short hiccups do not collapse it.
+ */
+static void xfer_adapt_window(struct fxp_xfer *xfer, struct req *rr, int len)
+{
+    unsigned long now = GETTICKCOUNT();
+    unsigned long rtt = now - rr->sent;
+    unsigned long elapsed;
+    uint64_t bdp;
+    int window;
+
+    if (!rtt)
+        rtt = 1;
+    if (!xfer->min_rtt || rtt < xfer->min_rtt)
+        xfer->min_rtt = rtt;
+
+    if (len > 0)
+        xfer->window_bytes += len;
+
+    elapsed = now - xfer->window_start;
+    if (elapsed < 100 || elapsed < 4 * xfer->min_rtt)
+        return;
+
+    bdp = xfer->window_bytes * xfer->min_rtt / elapsed;
+
+    window = xfer->req_maxsize;
+    if (xfer->window_full && bdp * 5 >= (uint64_t)window * 4) {
+        if (window <= xfer_window_max / 2)
+            window *= 2;
+        else
+            window = xfer_window_max;
+    }
+    else if (bdp * 2 < (uint64_t)window) {
+        window /= 2;
+        if ((uint64_t)window < bdp * 2)
+            window = (int)(bdp * 2);
+    }
+    if (window < xfer_window_min)
+        window = xfer_window_min;
+    if (window > xfer_window_max)
+        window = xfer_window_max;
+
+    if (window != xfer->req_maxsize) {
+        xfer->req_maxsize = window;
+        fzprintf(sftpTransferWindow, "%d", window);
+    }
+
+    xfer->window_start = now;
+    xfer->window_bytes = 0;
+    xfer->window_full = false;
+}
+
 bool xfer_done(struct fxp_xfer *xfer)
 {
     /*
@@ -945,6 +1038,9 @@ bool xfer_done(struct fxp_xfer *xfer)
 
 void xfer_download_queue(struct fxp_xfer *xfer)
 {
+    if (xfer->req_totalsize >= xfer->req_maxsize)
+        xfer->window_full = true;
+
     while (xfer->req_totalsize < xfer->req_maxsize &&
            !xfer->eof && !xfer->err) {
         /*
@@ -953,6 +1049,15 @@ void xfer_download_queue(struct fxp_xfer *xfer)
         struct req *rr;
         struct sftp_request *req;
 
+        if (xfer->offset >= xfer->end) {
+            /*
+             * Everything up to the requested end has been asked
+             * for, treat it like the end of the file.
+             */
+            xfer->eof = true;
+            break;
+        }
+
         rr = snew(struct req);
         rr->offset = xfer->offset;
         rr->complete = 0;
@@ -967,7 +1072,10 @@ void xfer_download_queue(struct fxp_xfer *xfer)
         rr->next = NULL;
 
         rr->len = 32768;
+        if (xfer->end - xfer->offset < (uint64_t)rr->len)
+            rr->len = (int)(xfer->end - xfer->offset);
         rr->buffer = snewn(rr->len, char);
+        rr->sent = GETTICKCOUNT();
         sftp_register(req = fxp_read_send(xfer->fh, rr->offset, rr->len));
         fxp_set_userdata(req, rr);
 
@@ -980,10 +1088,12 @@ void xfer_download_queue(struct fxp_xfer *xfer)
     }
 }
 
-struct fxp_xfer *xfer_download_init(struct fxp_handle *fh, uint64_t offset)
+struct fxp_xfer *xfer_download_init(struct fxp_handle *fh, uint64_t offset,
+                                    uint64_t end)
 {
     struct fxp_xfer *xfer = xfer_init(fh, offset);
 
+    xfer->end = end;
     xfer->eof = false;
     xfer_download_queue(xfer);
 
@@ -1011,6 +1121,7 @@ int xfer_download_gotpkt(struct fxp_xfer *xfer, struct sftp_packet *pktin)
 #ifdef DEBUG_DOWNLOAD
     printf("read request %p has returned [%d]\n", rr, rr->retlen);
 #endif
+    xfer_adapt_window(xfer, rr, rr->retlen);
 
     if ((rr->retlen < 0 && fxp_error_type()==SSH_FX_EOF) || rr->retlen == 0) {
         xfer->eof = true;
@@ -1136,6 +1247,10 @@ struct fxp_xfer *xfer_upload_init(struct fxp_handle *fh, uint64_t offset)
 
 bool xfer_upload_ready(struct fxp_xfer *xfer)
 {
+    if (xfer->req_totalsize >= xfer->req_maxsize) {
+        xfer->window_full = true;
+        return false;
+    }
     return sftp_sendbuffer() == 0;
 }
 
@@ -1159,6 +1274,7 @@ void xfer_upload_data(struct fxp_xfer *xfer, char *buffer, int len)
 
     rr->len = len;
     rr->buffer = NULL;
+    rr->sent = GETTICKCOUNT();
     sftp_register(req = fxp_write_send(xfer->fh, buffer, rr->offset, len));
     fxp_set_userdata(req, rr);
 
@@ -1193,6 +1309,7 @@ int xfer_upload_gotpkt(struct fxp_xfer *xfer, struct sftp_packet *pktin)
 #ifdef DEBUG_UPLOAD
     printf("write request %p has returned [%d]\n", rr, ret ? 1 : 0);
 #endif
+    xfer_adapt_window(xfer, rr, ret ? rr->len : 0);
 
     /*
      * Remove this one from the queue.
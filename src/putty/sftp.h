@@ -298,7 +298,14 @@ struct sftp_packet *sftp_recv(void);
 
 struct fxp_xfer;
 
-struct fxp_xfer *xfer_download_init(struct fxp_handle *fh, uint64_t offset);
+/*
+ * The amount of data in outstanding requests adapts to throughput and
+ * latency, within these limits in bytes.
+ */
+void xfer_set_window_limits(int min, int max);
+
+struct fxp_xfer *xfer_download_init(struct fxp_handle *fh, uint64_t offset,
+                                    uint64_t end);
 void xfer_download_queue(struct fxp_xfer *xfer);
 int xfer_download_gotpkt(struct fxp_xfer *xfer, struct sftp_packet *pktin);
 bool xfer_download_data(struct fxp_xfer *xfer, void **buf, int *len);
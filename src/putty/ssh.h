@@ -975,6 +975,9 @@ extern const ssh_cipheralg ssh_blowfish_ssh2;
 extern const ssh_cipheralg ssh_arcfour256_ssh2;
 extern const ssh_cipheralg ssh_arcfour128_ssh2;
 extern const ssh_cipheralg ssh2_chacha20_poly1305;
+extern const ssh_cipheralg ssh2_chacha20_poly1305_sw;
+extern const ssh_cipheralg ssh2_chacha20_poly1305_sse2;
+extern const ssh_cipheralg ssh2_chacha20_poly1305_avx2;
 extern const ssh2_ciphers ssh2_3des;
 extern const ssh2_ciphers ssh2_des;
 extern const ssh2_ciphers ssh2_aes;
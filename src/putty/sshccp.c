@@ -36,6 +36,58 @@
 #define INLINE
 #endif
 
+/*
+ * Decide whether we can compile the SIMD implementations of ChaCha20
+ * and Poly1305 at all. Whether the CPU supports them is checked at run
+ * time, as with hardware AES.
+ */
+#define HW_CCP_NONE 0
+#define HW_CCP_X86 1
+
+#ifdef _FORCE_CCP_X86
+#   define HW_CCP HW_CCP_X86
+#elif defined(__clang__)
+#   if __has_attribute(target) && __has_include(<immintrin.h>) &&       \
+    (defined(__x86_64__) || defined(__i386))
+#       define HW_CCP HW_CCP_X86
+#   endif
+#elif defined(__GNUC__)
+#    if (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    (defined(__x86_64__) || defined(__i386))
+#       define HW_CCP HW_CCP_X86
+#    endif
+#elif defined (_MSC_VER)
+#   if (defined(_M_X64) || defined(_M_IX86)) && _MSC_VER >= 1800
+#      define HW_CCP HW_CCP_X86
+#   endif
+#endif
+
+#if defined _FORCE_SOFTWARE_CCP || !defined HW_CCP
+#   undef HW_CCP
+#   define HW_CCP HW_CCP_NONE
+#endif
+
+/*
+ * Bulk operations of a SIMD implementation, processing several blocks
+ * in parallel. They only get called for non-zero multiples of their
+ * block count.
+ */
+struct poly1305;
+struct ccp_simd {
+    /* XORs the key stream of nblocks 64 byte blocks into blk and
+     * advances the block counter in the state */
+    size_t chacha20_blocks;
+    void (*chacha20_xor)(uint32_t *state, unsigned char *blk, size_t nblocks);
+
+    /* Prepares the key for poly1305_feed from r */
+    void (*poly1305_key)(struct poly1305 *ctx);
+
+    /* Feeds nblocks whole 16 byte chunks into the MAC */
+    size_t poly1305_blocks;
+    void (*poly1305_feed)(struct poly1305 *ctx, const unsigned char *blk,
+                          size_t nblocks);
+};
+
 /* ChaCha20 implementation, only supporting 256-bit keys */
 
 /* State for each ChaCha20 instance */
@@ -50,6 +102,8 @@ struct chacha20 {
     unsigned char current[64];
     /* The index of the above currently used to allow a true streaming cipher */
     int currentIndex;
+    /* Computes whole blocks in parallel if set */
+    const struct ccp_simd *simd;
 };
 
 static INLINE void chacha20_round(struct chacha20 *ctx)
@@ -158,6 +212,17 @@ static void chacha20_iv(struct chacha20 *ctx, const unsigned char *iv)
 static void chacha20_encrypt(struct chacha20 *ctx, unsigned char *blk, int len)
 {
     while (len) {
+        /* Hand whole groups of blocks to the SIMD implementation */
+        if (ctx->currentIndex >= 64 && ctx->simd &&
+            (size_t)len >= 64 * ctx->simd->chacha20_blocks) {
+            size_t nblocks = len / 64;
+            nblocks -= nblocks % ctx->simd->chacha20_blocks;
+            ctx->simd->chacha20_xor(ctx->state, blk, nblocks);
+            blk += 64 * nblocks;
+            len -= (int)(64 * nblocks);
+            continue;
+        }
+
         /* If we don't have any state left, then cycle to the next */
         if (ctx->currentIndex >= 64) {
             chacha20_round(ctx);
@@ -763,6 +828,12 @@ struct poly1305 {
     /* Buffer in case we get less that a multiple of 16 bytes */
     unsigned char buffer[16];
     int bufferIndex;
+
+    /* Feeds whole chunks in parallel if set, using r to r^4 split into
+     * 26-bit limbs. These only get computed once there is enough data. */
+    const struct ccp_simd *simd;
+    bool rpow_ready;
+    uint32_t rpow[4][5];
 };
 
 static void poly1305_init(struct poly1305 *ctx)
@@ -790,6 +861,7 @@ static void poly1305_key(struct poly1305 *ctx, ptrlen key)
     key_copy[8] &= 0xfc;
     key_copy[12] &= 0xfc;
     bigval_import_le(&ctx->r, key_copy, 16);
+    ctx->rpow_ready = false;
     smemclr(key_copy, sizeof(key_copy));
 
     /* Use second 128 bits as the nonce */
@@ -808,6 +880,8 @@ static void poly1305_feed_chunk(struct poly1305 *ctx,
     bigval_mul_mod_p(&ctx->h, &c, &ctx->r);
 }
 
+#define POLY1305_SIMD_MIN 256
+
 static void poly1305_feed(struct poly1305 *ctx,
                           const unsigned char *buf, int len)
 {
@@ -824,7 +898,20 @@ static void poly1305_feed(struct poly1305 *ctx,
         }
     }
 
-    /* Process 16 byte whole chunks */
+    /* Process 16 byte whole chunks, as many as possible in parallel. For
+     * short packets, converting from and to the limbs costs more than it
+     * saves. */
+    if (ctx->simd && len >= POLY1305_SIMD_MIN) {
+        size_t nblocks = len / 16;
+        nblocks -= nblocks % ctx->simd->poly1305_blocks;
+        if (!ctx->rpow_ready) {
+            ctx->simd->poly1305_key(ctx);
+            ctx->rpow_ready = true;
+        }
+        ctx->simd->poly1305_feed(ctx, buf, nblocks);
+        buf += 16 * nblocks;
+        len -= (int)(16 * nblocks);
+    }
     while (len >= 16) {
         poly1305_feed_chunk(ctx, buf, 16);
         len -= 16;
@@ -853,6 +940,574 @@ static void poly1305_finalise(struct poly1305 *ctx, unsigned char *mac)
     bigval_export_le(&tmp, mac, 16);
 }
 
+/* ----------------------------------------------------------------------
+ * SIMD implementations using SSE2 and AVX2.
+ *
+ * ChaCha20 computes 4 (SSE2) or 8 (AVX2) consecutive blocks at once,
+ * each vector holding the same state word of all blocks.
+ *
+ * Poly1305 runs 2 (SSE2) or 4 (AVX2) interleaved accumulators with the
+ * value in five 26-bit limbs, each 64-bit lane holding the limb of one
+ * accumulator. With N accumulators, accumulator i takes the chunks
+ * i, i+N, i+2N, ... and gets multiplied by r^N after each of them.
+ * Multiplying accumulator i by r^(N-i) at the end and adding them all
+ * up gives the same result as feeding the chunks one by one.
+ */
+
+#if HW_CCP == HW_CCP_X86
+
+#if defined(__clang__) || defined(__GNUC__)
+#    define FUNC_ISA_SSE2 __attribute__ ((target("sse2")))
+#    define FUNC_ISA_AVX2 __attribute__ ((target("avx2")))
+#else
+#    define FUNC_ISA_SSE2
+#    define FUNC_ISA_AVX2
+#endif
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(__clang__) || defined(__GNUC__)
+#include <cpuid.h>
+#define GET_CPU_ID_0(out)                               \
+    __cpuid(0, (out)[0], (out)[1], (out)[2], (out)[3])
+#define GET_CPU_ID_1(out)                               \
+    __cpuid(1, (out)[0], (out)[1], (out)[2], (out)[3])
+#define GET_CPU_ID_7(out)                                       \
+    __cpuid_count(7, 0, (out)[0], (out)[1], (out)[2], (out)[3])
+#else
+#include <intrin.h>
+#define GET_CPU_ID_0(out) __cpuid(out, 0)
+#define GET_CPU_ID_1(out) __cpuid(out, 1)
+#define GET_CPU_ID_7(out) __cpuidex(out, 7, 0)
+#endif
+
+static unsigned int ccp_xgetbv(void)
+{
+#if defined(__clang__) || defined(__GNUC__)
+    unsigned int eax, edx;
+    __asm__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#else
+    return (unsigned int)_xgetbv(0);
+#endif
+}
+
+static bool ccp_sse2_available(void)
+{
+    unsigned int CPUInfo[4];
+    GET_CPU_ID_1(CPUInfo);
+    return CPUInfo[3] & (1 << 26); /* Check SSE2 */
+}
+
+static bool ccp_avx2_available(void)
+{
+    unsigned int CPUInfo[4];
+    GET_CPU_ID_0(CPUInfo);
+    if (CPUInfo[0] < 7)
+        return false;
+
+    /* The OS needs to save the YMM registers */
+    GET_CPU_ID_1(CPUInfo);
+    if (!(CPUInfo[2] & (1 << 27)) || !(CPUInfo[2] & (1 << 28)))
+        return false; /* No OSXSAVE or AVX */
+    if ((ccp_xgetbv() & 6) != 6)
+        return false;
+
+    GET_CPU_ID_7(CPUInfo);
+    return CPUInfo[1] & (1 << 5); /* Check AVX2 */
+}
+
+/* Counter values of the next blocks, with the carry into the high word */
+static void chacha20_counters(const uint32_t *state, size_t n,
+                              uint32_t *lo, uint32_t *hi)
+{
+    uint64_t counter = state[12] | ((uint64_t)state[13] << 32);
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        lo[i] = (uint32_t)(counter + i);
+        hi[i] = (uint32_t)((counter + i) >> 32);
+    }
+}
+
+static void chacha20_advance(uint32_t *state, size_t n)
+{
+    uint64_t counter = state[12] | ((uint64_t)state[13] << 32);
+    counter += n;
+    state[12] = (uint32_t)counter;
+    state[13] = (uint32_t)(counter >> 32);
+}
+
+#define CCP_QUARTER(x, a, b, c, d, add, xor, rot16, rot12, rot8, rot7)  \
+    x[a] = add(x[a], x[b]); x[d] = xor(x[d], x[a]); x[d] = rot16(x[d]); \
+    x[c] = add(x[c], x[d]); x[b] = xor(x[b], x[c]); x[b] = rot12(x[b]); \
+    x[a] = add(x[a], x[b]); x[d] = xor(x[d], x[a]); x[d] = rot8(x[d]);  \
+    x[c] = add(x[c], x[d]); x[b] = xor(x[b], x[c]); x[b] = rot7(x[b])
+
+#define CCP_DOUBLE_ROUND(x, add, xor, rot16, rot12, rot8, rot7)         \
+    CCP_QUARTER(x, 0, 4, 8, 12, add, xor, rot16, rot12, rot8, rot7);    \
+    CCP_QUARTER(x, 1, 5, 9, 13, add, xor, rot16, rot12, rot8, rot7);    \
+    CCP_QUARTER(x, 2, 6, 10, 14, add, xor, rot16, rot12, rot8, rot7);   \
+    CCP_QUARTER(x, 3, 7, 11, 15, add, xor, rot16, rot12, rot8, rot7);   \
+    CCP_QUARTER(x, 0, 5, 10, 15, add, xor, rot16, rot12, rot8, rot7);   \
+    CCP_QUARTER(x, 1, 6, 11, 12, add, xor, rot16, rot12, rot8, rot7);   \
+    CCP_QUARTER(x, 2, 7, 8, 13, add, xor, rot16, rot12, rot8, rot7);    \
+    CCP_QUARTER(x, 3, 4, 9, 14, add, xor, rot16, rot12, rot8, rot7)
+
+#define SSE2_ROTL(v, n)                                                 \
+    _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define SSE2_ROTL16(v)                                                  \
+    _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1)
+#define SSE2_ROTL12(v) SSE2_ROTL(v, 12)
+#define SSE2_ROTL8(v) SSE2_ROTL(v, 8)
+#define SSE2_ROTL7(v) SSE2_ROTL(v, 7)
+
+static FUNC_ISA_SSE2 void chacha20_xor_sse2(
+    uint32_t *state, unsigned char *blk, size_t nblocks)
+{
+    __m128i x[16], in[16];
+    uint32_t lo[4], hi[4];
+    int i, j;
+
+    for (; nblocks; nblocks -= 4, blk += 256) {
+        chacha20_counters(state, 4, lo, hi);
+        for (i = 0; i < 16; ++i)
+            in[i] = _mm_set1_epi32(state[i]);
+        in[12] = _mm_set_epi32(lo[3], lo[2], lo[1], lo[0]);
+        in[13] = _mm_set_epi32(hi[3], hi[2], hi[1], hi[0]);
+        for (i = 0; i < 16; ++i)
+            x[i] = in[i];
+
+        for (i = 0; i < 20; i += 2) {
+            CCP_DOUBLE_ROUND(x, _mm_add_epi32, _mm_xor_si128, SSE2_ROTL16,
+                             SSE2_ROTL12, SSE2_ROTL8, SSE2_ROTL7);
+        }
+
+        for (i = 0; i < 16; ++i)
+            x[i] = _mm_add_epi32(x[i], in[i]);
+
+        /* Transpose each group of four words into the four blocks */
+        for (i = 0; i < 16; i += 4) {
+            __m128i t0 = _mm_unpacklo_epi32(x[i], x[i + 1]);
+            __m128i t1 = _mm_unpacklo_epi32(x[i + 2], x[i + 3]);
+            __m128i t2 = _mm_unpackhi_epi32(x[i], x[i + 1]);
+            __m128i t3 = _mm_unpackhi_epi32(x[i + 2], x[i + 3]);
+            __m128i out[4];
+            out[0] = _mm_unpacklo_epi64(t0, t1);
+            out[1] = _mm_unpackhi_epi64(t0, t1);
+            out[2] = _mm_unpacklo_epi64(t2, t3);
+            out[3] = _mm_unpackhi_epi64(t2, t3);
+            for (j = 0; j < 4; ++j) {
+                __m128i *p = (__m128i *)(blk + 64 * j + 4 * i);
+                _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), out[j]));
+            }
+        }
+
+        chacha20_advance(state, 4);
+    }
+
+    smemclr(x, sizeof(x));
+}
+
+#define AVX2_ROTL(v, n)                                                 \
+    _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+#define AVX2_ROTL16(v) _mm256_shuffle_epi8(v, rot16)
+#define AVX2_ROTL12(v) AVX2_ROTL(v, 12)
+#define AVX2_ROTL8(v) _mm256_shuffle_epi8(v, rot8)
+#define AVX2_ROTL7(v) AVX2_ROTL(v, 7)
+
+static FUNC_ISA_AVX2 void chacha20_xor_avx2(
+    uint32_t *state, unsigned char *blk, size_t nblocks)
+{
+    const __m256i rot16 = _mm256_setr_epi8(
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8 = _mm256_setr_epi8(
+        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    __m256i x[16], in[16];
+    uint32_t lo[8], hi[8];
+    int i, j;
+
+    for (; nblocks; nblocks -= 8, blk += 512) {
+        chacha20_counters(state, 8, lo, hi);
+        for (i = 0; i < 16; ++i)
+            in[i] = _mm256_set1_epi32(state[i]);
+        in[12] = _mm256_setr_epi32(lo[0], lo[1], lo[2], lo[3],
+                                   lo[4], lo[5], lo[6], lo[7]);
+        in[13] = _mm256_setr_epi32(hi[0], hi[1], hi[2], hi[3],
+                                   hi[4], hi[5], hi[6], hi[7]);
+        for (i = 0; i < 16; ++i)
+            x[i] = in[i];
+
+        for (i = 0; i < 20; i += 2) {
+            CCP_DOUBLE_ROUND(x, _mm256_add_epi32, _mm256_xor_si256,
+                             AVX2_ROTL16, AVX2_ROTL12, AVX2_ROTL8,
+                             AVX2_ROTL7);
+        }
+
+        for (i = 0; i < 16; ++i)
+            x[i] = _mm256_add_epi32(x[i], in[i]);
+
+        /* Transposing within the 128-bit lanes leaves blocks j and j+4
+         * of each group of four words in one vector */
+        __m256i out[4][4];
+        for (i = 0; i < 4; ++i) {
+            __m256i t0 = _mm256_unpacklo_epi32(x[4 * i], x[4 * i + 1]);
+            __m256i t1 = _mm256_unpacklo_epi32(x[4 * i + 2], x[4 * i + 3]);
+            __m256i t2 = _mm256_unpackhi_epi32(x[4 * i], x[4 * i + 1]);
+            __m256i t3 = _mm256_unpackhi_epi32(x[4 * i + 2], x[4 * i + 3]);
+            out[i][0] = _mm256_unpacklo_epi64(t0, t1);
+            out[i][1] = _mm256_unpackhi_epi64(t0, t1);
+            out[i][2] = _mm256_unpacklo_epi64(t2, t3);
+            out[i][3] = _mm256_unpackhi_epi64(t2, t3);
+        }
+        for (j = 0; j < 4; ++j) {
+            __m256i b[4];
+            b[0] = _mm256_permute2x128_si256(out[0][j], out[1][j], 0x20);
+            b[1] = _mm256_permute2x128_si256(out[2][j], out[3][j], 0x20);
+            b[2] = _mm256_permute2x128_si256(out[0][j], out[1][j], 0x31);
+            b[3] = _mm256_permute2x128_si256(out[2][j], out[3][j], 0x31);
+            for (i = 0; i < 4; ++i) {
+                /* Blocks j and j+4 */
+                __m256i *p = (__m256i *)(blk + 64 * j + 256 * (i / 2) +
+                                         32 * (i % 2));
+                _mm256_storeu_si256(
+                    p, _mm256_xor_si256(_mm256_loadu_si256(p), b[i]));
+            }
+        }
+        smemclr(out, sizeof(out));
+
+        chacha20_advance(state, 8);
+    }
+
+    smemclr(x, sizeof(x));
+}
+
+#define LIMB_MASK 0x3ffffff
+
+/* Splits a little-endian value of up to 136 bits into limbs, partially
+ * reducing it modulo 2^130-5 */
+static void poly1305_limbs_import(uint32_t *l, const unsigned char *data,
+                                  int top)
+{
+    uint64_t lo = GET_64BIT_LSB_FIRST(data);
+    uint64_t hi = GET_64BIT_LSB_FIRST(data + 8);
+    l[0] = lo & LIMB_MASK;
+    l[1] = (lo >> 26) & LIMB_MASK;
+    l[2] = ((lo >> 52) | (hi << 12)) & LIMB_MASK;
+    l[3] = (hi >> 14) & LIMB_MASK;
+    l[4] = ((hi >> 40) | ((uint64_t)(top & 3) << 24)) & LIMB_MASK;
+    l[0] += 5 * (uint32_t)(top >> 2);
+}
+
+/* Inverse of the above, for values below 2^136 */
+static void poly1305_limbs_export(const uint64_t *l, unsigned char *data)
+{
+    uint64_t acc = 0;
+    int bits = 0, i, n = 0;
+    for (i = 0; i < 5; ++i) {
+        acc += l[i] << bits;
+        for (bits += 26; bits >= 8; bits -= 8) {
+            data[n++] = (unsigned char)acc;
+            acc >>= 8;
+        }
+    }
+    while (n < 17) {
+        data[n++] = (unsigned char)acc;
+        acc >>= 8;
+    }
+}
+
+/* Propagates the carries, leaving limbs of at most 26 bits with the
+ * value only partially reduced */
+static void poly1305_limbs_carry(uint64_t *l)
+{
+    uint64_t c;
+    int i, pass;
+    for (pass = 0; pass < 2; ++pass) {
+        for (i = 0; i < 4; ++i) {
+            c = l[i] >> 26;
+            l[i] &= LIMB_MASK;
+            l[i + 1] += c;
+        }
+        c = l[4] >> 26;
+        l[4] &= LIMB_MASK;
+        l[0] += 5 * c;
+    }
+}
+
+static void poly1305_limbs_mul(uint32_t *r, const uint32_t *a,
+                               const uint32_t *b)
+{
+    uint64_t s1 = 5 * (uint64_t)b[1], s2 = 5 * (uint64_t)b[2];
+    uint64_t s3 = 5 * (uint64_t)b[3], s4 = 5 * (uint64_t)b[4];
+    uint64_t d[5];
+    int i;
+
+    d[0] = (uint64_t)a[0] * b[0] + a[1] * s4 + a[2] * s3 + a[3] * s2 +
+        a[4] * s1;
+    d[1] = (uint64_t)a[0] * b[1] + (uint64_t)a[1] * b[0] + a[2] * s4 +
+        a[3] * s3 + a[4] * s2;
+    d[2] = (uint64_t)a[0] * b[2] + (uint64_t)a[1] * b[1] +
+        (uint64_t)a[2] * b[0] + a[3] * s4 + a[4] * s3;
+    d[3] = (uint64_t)a[0] * b[3] + (uint64_t)a[1] * b[2] +
+        (uint64_t)a[2] * b[1] + (uint64_t)a[3] * b[0] + a[4] * s4;
+    d[4] = (uint64_t)a[0] * b[4] + (uint64_t)a[1] * b[3] +
+        (uint64_t)a[2] * b[2] + (uint64_t)a[3] * b[1] +
+        (uint64_t)a[4] * b[0];
+    poly1305_limbs_carry(d);
+    for (i = 0; i < 5; ++i)
+        r[i] = (uint32_t)d[i];
+}
+
+/* Powers r^1 to r^4 of the key for the interleaved accumulators */
+static void poly1305_limbs_key(struct poly1305 *ctx)
+{
+    unsigned char r[16];
+    int i;
+    bigval_export_le(&ctx->r, r, 16);
+    poly1305_limbs_import(ctx->rpow[0], r, 0);
+    for (i = 1; i < 4; ++i)
+        poly1305_limbs_mul(ctx->rpow[i], ctx->rpow[i - 1], ctx->rpow[0]);
+    smemclr(r, sizeof(r));
+}
+
+static void poly1305_limbs_get(struct poly1305 *ctx, uint32_t *h)
+{
+    unsigned char data[17];
+    bigval_export_le(&ctx->h, data, 17);
+    poly1305_limbs_import(h, data, data[16]);
+    smemclr(data, sizeof(data));
+}
+
+static void poly1305_limbs_set(struct poly1305 *ctx, uint64_t *h)
+{
+    unsigned char data[17];
+    poly1305_limbs_carry(h);
+    poly1305_limbs_export(h, data);
+    bigval_import_le(&ctx->h, data, 17);
+    smemclr(data, sizeof(data));
+}
+
+/* Limbs of a 16 byte chunk including the bit above it */
+static void poly1305_limbs_chunk(uint32_t *m, const unsigned char *chunk)
+{
+    unsigned char data[17];
+    memcpy(data, chunk, 16);
+    data[16] = 1;
+    poly1305_limbs_import(m, data, 1);
+}
+
+static FUNC_ISA_SSE2 void poly1305_mul_sse2(
+    __m128i *h, const __m128i *r, const __m128i *s)
+{
+    const __m128i mask = _mm_set_epi32(0, LIMB_MASK, 0, LIMB_MASK);
+    __m128i d[5], c;
+
+#define MUL(a, b) _mm_mul_epu32(a, b)
+#define ADD(a, b) _mm_add_epi64(a, b)
+    d[0] = ADD(ADD(ADD(ADD(MUL(h[0], r[0]), MUL(h[1], s[4])),
+                       MUL(h[2], s[3])), MUL(h[3], s[2])), MUL(h[4], s[1]));
+    d[1] = ADD(ADD(ADD(ADD(MUL(h[0], r[1]), MUL(h[1], r[0])),
+                       MUL(h[2], s[4])), MUL(h[3], s[3])), MUL(h[4], s[2]));
+    d[2] = ADD(ADD(ADD(ADD(MUL(h[0], r[2]), MUL(h[1], r[1])),
+                       MUL(h[2], r[0])), MUL(h[3], s[4])), MUL(h[4], s[3]));
+    d[3] = ADD(ADD(ADD(ADD(MUL(h[0], r[3]), MUL(h[1], r[2])),
+                       MUL(h[2], r[1])), MUL(h[3], r[0])), MUL(h[4], s[4]));
+    d[4] = ADD(ADD(ADD(ADD(MUL(h[0], r[4]), MUL(h[1], r[3])),
+                       MUL(h[2], r[2])), MUL(h[3], r[1])), MUL(h[4], r[0]));
+
+    d[1] = ADD(d[1], _mm_srli_epi64(d[0], 26));
+    d[2] = ADD(d[2], _mm_srli_epi64(d[1], 26));
+    d[3] = ADD(d[3], _mm_srli_epi64(d[2], 26));
+    d[4] = ADD(d[4], _mm_srli_epi64(d[3], 26));
+    c = _mm_srli_epi64(d[4], 26);
+    d[0] = ADD(_mm_and_si128(d[0], mask), ADD(c, _mm_slli_epi64(c, 2)));
+    h[1] = ADD(_mm_and_si128(d[1], mask), _mm_srli_epi64(d[0], 26));
+    h[0] = _mm_and_si128(d[0], mask);
+    h[2] = _mm_and_si128(d[2], mask);
+    h[3] = _mm_and_si128(d[3], mask);
+    h[4] = _mm_and_si128(d[4], mask);
+#undef MUL
+#undef ADD
+}
+
+static FUNC_ISA_SSE2 void poly1305_powers_sse2(
+    __m128i *r, __m128i *s, const uint32_t *lane0, const uint32_t *lane1)
+{
+    int i;
+    for (i = 0; i < 5; ++i) {
+        r[i] = _mm_set_epi32(0, lane1[i], 0, lane0[i]);
+        s[i] = _mm_add_epi32(r[i], _mm_slli_epi32(r[i], 2));
+    }
+}
+
+static FUNC_ISA_SSE2 void poly1305_feed_sse2(
+    struct poly1305 *ctx, const unsigned char *blk, size_t nblocks)
+{
+    __m128i h[5], r[5], s[5];
+    uint32_t acc[5], m[2][5];
+    uint64_t lanes[2], out[5];
+    int i;
+
+    /* The accumulated value goes into the first lane */
+    poly1305_limbs_get(ctx, acc);
+    poly1305_limbs_chunk(m[0], blk);
+    poly1305_limbs_chunk(m[1], blk + 16);
+    for (i = 0; i < 5; ++i)
+        h[i] = _mm_set_epi32(0, m[1][i], 0, m[0][i] + acc[i]);
+
+    poly1305_powers_sse2(r, s, ctx->rpow[1], ctx->rpow[1]);
+    for (blk += 32, nblocks -= 2; nblocks; blk += 32, nblocks -= 2) {
+        poly1305_mul_sse2(h, r, s);
+        poly1305_limbs_chunk(m[0], blk);
+        poly1305_limbs_chunk(m[1], blk + 16);
+        for (i = 0; i < 5; ++i)
+            h[i] = _mm_add_epi64(h[i], _mm_set_epi32(0, m[1][i], 0, m[0][i]));
+    }
+
+    poly1305_powers_sse2(r, s, ctx->rpow[1], ctx->rpow[0]);
+    poly1305_mul_sse2(h, r, s);
+
+    for (i = 0; i < 5; ++i) {
+        _mm_storeu_si128((__m128i *)lanes, h[i]);
+        out[i] = lanes[0] + lanes[1];
+    }
+    poly1305_limbs_set(ctx, out);
+
+    smemclr(h, sizeof(h));
+    smemclr(acc, sizeof(acc));
+    smemclr(m, sizeof(m));
+    smemclr(lanes, sizeof(lanes));
+    smemclr(out, sizeof(out));
+}
+
+static FUNC_ISA_AVX2 void poly1305_mul_avx2(
+    __m256i *h, const __m256i *r, const __m256i *s)
+{
+    const __m256i mask = _mm256_set_epi32(0, LIMB_MASK, 0, LIMB_MASK,
+                                          0, LIMB_MASK, 0, LIMB_MASK);
+    __m256i d[5], c;
+
+#define MUL(a, b) _mm256_mul_epu32(a, b)
+#define ADD(a, b) _mm256_add_epi64(a, b)
+    d[0] = ADD(ADD(ADD(ADD(MUL(h[0], r[0]), MUL(h[1], s[4])),
+                       MUL(h[2], s[3])), MUL(h[3], s[2])), MUL(h[4], s[1]));
+    d[1] = ADD(ADD(ADD(ADD(MUL(h[0], r[1]), MUL(h[1], r[0])),
+                       MUL(h[2], s[4])), MUL(h[3], s[3])), MUL(h[4], s[2]));
+    d[2] = ADD(ADD(ADD(ADD(MUL(h[0], r[2]), MUL(h[1], r[1])),
+                       MUL(h[2], r[0])), MUL(h[3], s[4])), MUL(h[4], s[3]));
+    d[3] = ADD(ADD(ADD(ADD(MUL(h[0], r[3]), MUL(h[1], r[2])),
+                       MUL(h[2], r[1])), MUL(h[3], r[0])), MUL(h[4], s[4]));
+    d[4] = ADD(ADD(ADD(ADD(MUL(h[0], r[4]), MUL(h[1], r[3])),
+                       MUL(h[2], r[2])), MUL(h[3], r[1])), MUL(h[4], r[0]));
+
+    d[1] = ADD(d[1], _mm256_srli_epi64(d[0], 26));
+    d[2] = ADD(d[2], _mm256_srli_epi64(d[1], 26));
+    d[3] = ADD(d[3], _mm256_srli_epi64(d[2], 26));
+    d[4] = ADD(d[4], _mm256_srli_epi64(d[3], 26));
+    c = _mm256_srli_epi64(d[4], 26);
+    d[0] = ADD(_mm256_and_si256(d[0], mask), ADD(c, _mm256_slli_epi64(c, 2)));
+    h[1] = ADD(_mm256_and_si256(d[1], mask), _mm256_srli_epi64(d[0], 26));
+    h[0] = _mm256_and_si256(d[0], mask);
+    h[2] = _mm256_and_si256(d[2], mask);
+    h[3] = _mm256_and_si256(d[3], mask);
+    h[4] = _mm256_and_si256(d[4], mask);
+#undef MUL
+#undef ADD
+}
+
+static FUNC_ISA_AVX2 void poly1305_powers_avx2(
+    __m256i *r, __m256i *s, const uint32_t *lane0, const uint32_t *lane1,
+    const uint32_t *lane2, const uint32_t *lane3)
+{
+    int i;
+    for (i = 0; i < 5; ++i) {
+        r[i] = _mm256_set_epi32(0, lane3[i], 0, lane2[i],
+                                0, lane1[i], 0, lane0[i]);
+        s[i] = _mm256_add_epi32(r[i], _mm256_slli_epi32(r[i], 2));
+    }
+}
+
+static FUNC_ISA_AVX2 __m256i poly1305_chunks_avx2(uint32_t (*m)[5], int limb)
+{
+    return _mm256_set_epi32(0, m[3][limb], 0, m[2][limb],
+                            0, m[1][limb], 0, m[0][limb]);
+}
+
+static FUNC_ISA_AVX2 void poly1305_feed_avx2(
+    struct poly1305 *ctx, const unsigned char *blk, size_t nblocks)
+{
+    __m256i h[5], r[5], s[5];
+    uint32_t acc[5], m[4][5];
+    uint64_t lanes[4], out[5];
+    int i, j;
+
+    /* The accumulated value goes into the first lane */
+    poly1305_limbs_get(ctx, acc);
+    for (j = 0; j < 4; ++j)
+        poly1305_limbs_chunk(m[j], blk + 16 * j);
+    for (i = 0; i < 5; ++i)
+        m[0][i] += acc[i];
+    for (i = 0; i < 5; ++i)
+        h[i] = poly1305_chunks_avx2(m, i);
+
+    poly1305_powers_avx2(r, s, ctx->rpow[3], ctx->rpow[3],
+                         ctx->rpow[3], ctx->rpow[3]);
+    for (blk += 64, nblocks -= 4; nblocks; blk += 64, nblocks -= 4) {
+        poly1305_mul_avx2(h, r, s);
+        for (j = 0; j < 4; ++j)
+            poly1305_limbs_chunk(m[j], blk + 16 * j);
+        for (i = 0; i < 5; ++i)
+            h[i] = _mm256_add_epi64(h[i], poly1305_chunks_avx2(m, i));
+    }
+
+    poly1305_powers_avx2(r, s, ctx->rpow[3], ctx->rpow[2],
+                         ctx->rpow[1], ctx->rpow[0]);
+    poly1305_mul_avx2(h, r, s);
+
+    for (i = 0; i < 5; ++i) {
+        _mm256_storeu_si256((__m256i *)lanes, h[i]);
+        out[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    poly1305_limbs_set(ctx, out);
+
+    smemclr(h, sizeof(h));
+    smemclr(acc, sizeof(acc));
+    smemclr(m, sizeof(m));
+    smemclr(lanes, sizeof(lanes));
+    smemclr(out, sizeof(out));
+}
+
+static const struct ccp_simd ccp_simd_sse2 = {
+    .chacha20_blocks = 4,
+    .chacha20_xor = chacha20_xor_sse2,
+    .poly1305_blocks = 2,
+    .poly1305_key = poly1305_limbs_key,
+    .poly1305_feed = poly1305_feed_sse2,
+};
+
+static const struct ccp_simd ccp_simd_avx2 = {
+    .chacha20_blocks = 8,
+    .chacha20_xor = chacha20_xor_avx2,
+    .poly1305_blocks = 4,
+    .poly1305_key = poly1305_limbs_key,
+    .poly1305_feed = poly1305_feed_avx2,
+};
+
+static int ccp_hw_level_cached(void)
+{
+    static bool initialised = false;
+    static int level;
+    if (!initialised) {
+        level = ccp_avx2_available() ? 2 : ccp_sse2_available() ? 1 : 0;
+        initialised = true;
+    }
+    return level;
+}
+
+#endif /* HW_CCP == HW_CCP_X86 */
 /* SSH-2 wrapper */
 
 struct ccp_context {
@@ -957,15 +1612,73 @@ const ssh2_macalg ssh2_poly1305 = {
     .keylen = 0,
 };
 
-static ssh_cipher *ccp_new(const ssh_cipheralg *alg)
+static ssh_cipher *ccp_new_simd(const ssh_cipheralg *alg,
+                                const struct ccp_simd *simd)
 {
     struct ccp_context *ctx = snew(struct ccp_context);
     BinarySink_INIT(ctx, poly_BinarySink_write);
     poly1305_init(&ctx->mac);
+    /* The length is too short to gain anything from SIMD */
+    ctx->a_cipher.simd = NULL;
+    ctx->b_cipher.simd = simd;
+    ctx->mac.simd = simd;
     ctx->ciph.vt = alg;
     return &ctx->ciph;
 }
 
+static ssh_cipher *ccp_sw_new(const ssh_cipheralg *alg)
+{
+    return ccp_new_simd(alg, NULL);
+}
+
+#if HW_CCP == HW_CCP_X86
+
+static ssh_cipher *ccp_sse2_new(const ssh_cipheralg *alg)
+{
+    if (ccp_hw_level_cached() < 1)
+        return NULL;
+    return ccp_new_simd(alg, &ccp_simd_sse2);
+}
+
+static ssh_cipher *ccp_avx2_new(const ssh_cipheralg *alg)
+{
+    if (ccp_hw_level_cached() < 2)
+        return NULL;
+    return ccp_new_simd(alg, &ccp_simd_avx2);
+}
+
+#else
+
+/* Stub versions so that the vtables below still exist */
+
+static ssh_cipher *ccp_sse2_new(const ssh_cipheralg *alg)
+{
+    return NULL;
+}
+
+static ssh_cipher *ccp_avx2_new(const ssh_cipheralg *alg)
+{
+    return NULL;
+}
+
+#endif
+
+struct ccp_extra {
+    const ssh_cipheralg *sw, *sse2, *avx2;
+};
+
+/* Picks the fastest implementation the CPU supports */
+static ssh_cipher *ccp_select(const ssh_cipheralg *alg)
+{
+    const struct ccp_extra *extra = (const struct ccp_extra *)alg->extra;
+    ssh_cipher *cipher = ssh_cipher_new(extra->avx2);
+    if (!cipher)
+        cipher = ssh_cipher_new(extra->sse2);
+    if (!cipher)
+        cipher = ssh_cipher_new(extra->sw);
+    return cipher;
+}
+
 static void ccp_free(ssh_cipher *cipher)
 {
     struct ccp_context *ctx = container_of(cipher, struct ccp_context, ciph);
@@ -1037,22 +1750,45 @@ static void ccp_decrypt_length(ssh_cipher *cipher, void *blk, int len,
     chacha20_decrypt(&ctx->a_cipher, blk, len);
 }
 
+#define CCP_VTABLE(suffix, name)                                        \
+    const ssh_cipheralg ssh2_chacha20_poly1305_##suffix = {             \
+        .new = ccp_##suffix##_new,                                      \
+        .free = ccp_free,                                               \
+        .setiv = ccp_iv,                                                \
+        .setkey = ccp_key,                                              \
+        .encrypt = ccp_encrypt,                                         \
+        .decrypt = ccp_decrypt,                                         \
+        .encrypt_length = ccp_encrypt_length,                           \
+        .decrypt_length = ccp_decrypt_length,                           \
+        .ssh2_id = "chacha20-poly1305@openssh.com",                     \
+        .blksize = 1,                                                   \
+        .real_keybits = 512,                                            \
+        .padded_keybytes = 64,                                          \
+        .flags = SSH_CIPHER_SEPARATE_LENGTH,                            \
+        .text_name = "ChaCha20 (" name ")",                             \
+        .required_mac = &ssh2_poly1305,                                 \
+    }
+
+CCP_VTABLE(sw, "unaccelerated");
+CCP_VTABLE(sse2, "SSE2 accelerated");
+CCP_VTABLE(avx2, "AVX2 accelerated");
+
+static const struct ccp_extra ccp_extra = {
+    &ssh2_chacha20_poly1305_sw,
+    &ssh2_chacha20_poly1305_sse2,
+    &ssh2_chacha20_poly1305_avx2,
+};
+
 const ssh_cipheralg ssh2_chacha20_poly1305 = {
-    .new = ccp_new,
-    .free = ccp_free,
-    .setiv = ccp_iv,
-    .setkey = ccp_key,
-    .encrypt = ccp_encrypt,
-    .decrypt = ccp_decrypt,
-    .encrypt_length = ccp_encrypt_length,
-    .decrypt_length = ccp_decrypt_length,
+    .new = ccp_select,
     .ssh2_id = "chacha20-poly1305@openssh.com",
     .blksize = 1,
     .real_keybits = 512,
     .padded_keybytes = 64,
     .flags = SSH_CIPHER_SEPARATE_LENGTH,
-    .text_name = "ChaCha20",
+    .text_name = "ChaCha20 (dummy selector vtable)",
     .required_mac = &ssh2_poly1305,
+    .extra = &ccp_extra,
 };
 
 static const ssh_cipheralg *const ccp_list[] = {
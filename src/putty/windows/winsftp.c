@@ -124,6 +124,7 @@ RFile *open_existing_file(const char *name, uint64_t offset,
                           long *perms)
 {
 #if 1
+    begin_io_transfer();
     fzprintf(sftp_io_open, "%"PRIu64, offset);
     char * s = priority_read();
 
@@ -196,20 +197,22 @@ int read_from_file(RFile *f, void *buffer, int length)
 {
 #if 1
     if (f->state == ok && !f->remaining_) {
-        fznotify1(sftp_io_nextbuf, 0);
-        char const* s = priority_read();
-        if (s[1] == '-') {
+        if (f->buffer_) {
+            /* Done with the previous buffer, the engine may refill it */
+            fznotify1(sftp_io_nextbuf, 0);
+        }
+        char * s = read_buffer_line();
+        if (s[0] == '-') {
+            sfree(s);
             f->state = error;
             return -1;
         }
-        else if (s[1] == 0) {
+        char * p = s;
+        f->buffer_ = f->memory_ + next_int(&p);
+        f->remaining_ = (int)next_int(&p);
+        if (!f->remaining_) {
             f->state = eof;
         }
-        else {
-            char const* p = s + 1;
-            f->buffer_ = f->memory_ + next_int(&p);
-            f->remaining_ = (int)next_int(&p);
-        }
         sfree(s);
     }
     if (f->state == eof) {
@@ -264,6 +267,7 @@ struct WFile {
 WFile *open_new_file(const char *name, long perms)
 {
 #if 1
+    begin_io_transfer();
     fznotify1(sftp_io_open, 0);
     char * s = priority_read();
 
@@ -318,6 +322,7 @@ WFile *open_new_file(const char *name, long perms)
 WFile *open_existing_wfile(const char *name, uint64_t *size)
 {
 #if 1
+    begin_io_transfer();
     fzprintf(sftp_io_open, "%"PRIu64, (uint64_t)-1);
     char * s = priority_read();
 
@@ -382,21 +387,20 @@ int write_to_file(WFile *f, void *buffer, int length)
 {
 #if 1
     if (f->state == ok && !f->remaining_) {
-        fznotify1(sftp_io_nextbuf, f->size_ - f->remaining_);
-        char const* s = priority_read();
-        if (s[1] == '-') {
+        if (f->buffer_) {
+            /* Previous buffer is full, hand it back to the engine */
+            fznotify1(sftp_io_nextbuf, f->size_ - f->remaining_);
+        }
+        char * s = read_buffer_line();
+        if (s[0] == '-') {
+            sfree(s);
             f->state = error;
             return -1;
         }
-        else if (s[1] == 0) {
-            f->state = eof;
-        }
-        else {
-            char const* p = s + 1;
-            f->buffer_ = f->memory_ + next_int(&p);
-            f->remaining_ = (int)next_int(&p);
-            f->size_ = f->remaining_;
-        }
+        char * p = s;
+        f->buffer_ = f->memory_ + next_int(&p);
+        f->remaining_ = (int)next_int(&p);
+        f->size_ = f->remaining_;
         sfree(s);
     }
     if (f->state == eof) {
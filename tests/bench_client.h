@@ -0,0 +1,102 @@
+#ifndef FILEZILLA_TESTS_BENCH_CLIENT_HEADER
+#define FILEZILLA_TESTS_BENCH_CLIENT_HEADER
+
+#include "../src/include/libfilezilla_engine.h"
+#include "../src/include/engine_context.h"
+
+#include <iostream>
+
+// Minimal engine client for the benchmarks. Trusts every server and
+// overwrites existing files.
+
+class bench_options final : public COptionsBase
+{
+public:
+	virtual void notify_changed() override {}
+};
+
+class bench_encoding_converter final : public CustomEncodingConverterBase
+{
+public:
+	virtual std::wstring toLocal(std::wstring const&, char const* buffer, size_t len) const override
+	{
+		return fz::to_wstring(std::string_view(buffer, len));
+	}
+
+	virtual std::string toServer(std::wstring const&, wchar_t const* buffer, size_t len) const override
+	{
+		return fz::to_string(std::wstring_view(buffer, len));
+	}
+};
+
+class bench_client final
+{
+public:
+	explicit bench_client(CFileZillaEngineContext & context)
+		: engine_(context, [this](CFileZillaEngine*) { on_notification(); })
+	{}
+
+	// Runs the command to completion and returns its reply code
+	int run(CCommand const& command)
+	{
+		int res = engine_.Execute(command);
+		if (res != FZ_REPLY_WOULDBLOCK) {
+			return res;
+		}
+
+		while (true) {
+			{
+				fz::scoped_lock l(mutex_);
+				while (!pending_) {
+					cond_.wait(l);
+				}
+				pending_ = false;
+			}
+
+			while (auto notification = engine_.GetNextNotification()) {
+				if (notification->GetID() == nId_operation) {
+					return static_cast<COperationNotification&>(*notification).replyCode_;
+				}
+				else if (notification->GetID() == nId_logmsg) {
+					auto const& msg = static_cast<CLogmsgNotification&>(*notification);
+					if (msg.msgType == logmsg::error) {
+						std::wcerr << msg.msg << std::endl;
+					}
+				}
+				else if (notification->GetID() == nId_asyncrequest) {
+					std::unique_ptr<CAsyncRequestNotification> request(static_cast<CAsyncRequestNotification*>(notification.release()));
+					auto const id = request->GetRequestID();
+					if (id == reqId_hostkey || id == reqId_hostkeyChanged) {
+						static_cast<CHostKeyNotification&>(*request).m_trust = true;
+					}
+					else if (id == reqId_certificate) {
+						static_cast<CCertificateNotification&>(*request).trusted_ = true;
+					}
+					else if (id == reqId_insecure_connection) {
+						static_cast<CInsecureConnectionNotification&>(*request).allow_ = true;
+					}
+					else if (id == reqId_fileexists) {
+						static_cast<CFileExistsNotification&>(*request).overwriteAction = CFileExistsNotification::overwrite;
+					}
+					engine_.SetAsyncRequestReply(std::move(request));
+				}
+			}
+		}
+	}
+
+private:
+	void on_notification()
+	{
+		fz::scoped_lock l(mutex_);
+		pending_ = true;
+		cond_.signal(l);
+	}
+
+	fz::mutex mutex_;
+	fz::condition cond_;
+	bool pending_{};
+
+	CFileZillaEngine engine_;
+};
+
+#endif
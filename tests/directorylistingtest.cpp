@@ -0,0 +1,140 @@
+#include "../src/include/libfilezilla_engine.h"
+#include "../src/engine/directorylistingparser.h"
+
+#include <libfilezilla/format.hpp>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+
+/*
+ * This testsuite covers the comparison of directory listings used to detect
+ * LIST -a and STAT support, as well as feeding listings sent in multi-line
+ * replies on the control connection to the parser.
+ */
+
+class CDirectoryListingTest final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CDirectoryListingTest);
+	CPPUNIT_TEST(testInclusion);
+	CPPUNIT_TEST(testReplyLines);
+	CPPUNIT_TEST(testPrefixedReplyLines);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {}
+	void tearDown() {}
+
+	void testInclusion();
+	void testReplyLines();
+	void testPrefixedReplyLines();
+
+protected:
+	void AssertSameAsList(std::wstring const& prefix);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CDirectoryListingTest);
+
+namespace {
+CDirectoryListing make_listing(std::vector<std::wstring> const& names)
+{
+	CDirectoryListing listing;
+	listing.path = CServerPath(L"/");
+	for (auto const& name : names) {
+		CDirentry entry;
+		entry.name = name;
+		entry.size = 0;
+		listing.Append(std::move(entry));
+	}
+	return listing;
+}
+
+char const listingData[] =
+	"drwxr-xr-x   2 user     group        4096 Jan  1  2020 dir\r\n"
+	"-rw-r--r--   1 user     group         123 Jan  1  2020 file.txt\r\n"
+	"-rw-r--r--   1 user     group           0 Feb 29  2020 211-file\r\n"
+	"lrwxrwxrwx   1 user     group           8 Mar  3  2021 link -> file.txt\r\n";
+
+std::wstring const replyLines[] = {
+	L"drwxr-xr-x   2 user     group        4096 Jan  1  2020 dir",
+	L"-rw-r--r--   1 user     group         123 Jan  1  2020 file.txt",
+	L"-rw-r--r--   1 user     group           0 Feb 29  2020 211-file",
+	L"lrwxrwxrwx   1 user     group           8 Mar  3  2021 link -> file.txt"
+};
+}
+
+void CDirectoryListingTest::testInclusion()
+{
+	CDirectoryListing const empty = make_listing({});
+	CDirectoryListing const abc = make_listing({ L"a", L"b", L"c" });
+	CDirectoryListing const cab = make_listing({ L"c", L"a", L"b" });
+	CDirectoryListing const ac = make_listing({ L"a", L"c" });
+	CDirectoryListing const ad = make_listing({ L"a", L"d" });
+	CDirectoryListing const xyz = make_listing({ L"x", L"y", L"z" });
+	CDirectoryListing const dotfiles = make_listing({ L".", L"..", L".hidden", L"a", L"b", L"c" });
+
+	CPPUNIT_ASSERT(CheckInclusion(empty, empty));
+	CPPUNIT_ASSERT(CheckInclusion(abc, empty));
+	CPPUNIT_ASSERT(!CheckInclusion(empty, abc));
+
+	// Order does not matter
+	CPPUNIT_ASSERT(CheckInclusion(abc, cab));
+	CPPUNIT_ASSERT(CheckInclusion(cab, abc));
+
+	CPPUNIT_ASSERT(CheckInclusion(abc, ac));
+	CPPUNIT_ASSERT(!CheckInclusion(ac, abc));
+
+	// Same or smaller size alone must not be enough
+	CPPUNIT_ASSERT(!CheckInclusion(abc, ad));
+	CPPUNIT_ASSERT(!CheckInclusion(abc, xyz));
+	CPPUNIT_ASSERT(!CheckInclusion(xyz, abc));
+
+	// As with LIST -a compared to LIST
+	CPPUNIT_ASSERT(CheckInclusion(dotfiles, abc));
+	CPPUNIT_ASSERT(!CheckInclusion(abc, dotfiles));
+}
+
+void CDirectoryListingTest::AssertSameAsList(std::wstring const& prefix)
+{
+	CServer server;
+	server.SetType(DEFAULT);
+
+	CDirectoryListingParser listParser(nullptr, server);
+	size_t const len = strlen(listingData);
+	char* data = new char[len];
+	memcpy(data, listingData, len);
+	listParser.AddData(data, len);
+	CDirectoryListing const expected = listParser.Parse(CServerPath(L"/"));
+	CPPUNIT_ASSERT_EQUAL(size_t(4), expected.size());
+
+	CDirectoryListingParser statParser(nullptr, server);
+	for (auto const& line : replyLines) {
+		statParser.AddReplyLine(prefix + line, L"211 ");
+	}
+	CDirectoryListing const listing = statParser.Parse(CServerPath(L"/"));
+
+	CPPUNIT_ASSERT_EQUAL(expected.size(), listing.size());
+	for (size_t i = 0; i < expected.size(); ++i) {
+		std::string const msg = fz::sprintf("Prefix: \"%s\"  Expected:\n%s\n  Got:\n%s", fz::to_utf8(prefix), expected[i].dump(), listing[i].dump());
+		CPPUNIT_ASSERT_MESSAGE(msg, expected[i] == listing[i]);
+	}
+	CPPUNIT_ASSERT(CheckInclusion(expected, listing) && CheckInclusion(listing, expected));
+}
+
+void CDirectoryListingTest::testReplyLines()
+{
+	AssertSameAsList(std::wstring());
+
+	// Reply lines of other codes are left as they are
+	CServer server;
+	server.SetType(DEFAULT);
+	CDirectoryListingParser parser(nullptr, server);
+	parser.AddReplyLine(L"213-rw-r--r--   1 user     group         123 Jan  1  2020 file.txt", L"211 ");
+	CDirectoryListing const listing = parser.Parse(CServerPath(L"/"));
+	CPPUNIT_ASSERT(!listing.size() || listing[0].name != L"file.txt");
+}
+
+void CDirectoryListingTest::testPrefixedReplyLines()
+{
+	AssertSameAsList(L"211-");
+}
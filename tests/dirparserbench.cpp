@@ -0,0 +1,77 @@
+#include "../src/include/libfilezilla_engine.h"
+#include "../src/engine/directorylistingparser.h"
+
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/time.hpp>
+
+#include <iostream>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Measures the throughput of the directory listing parser.
+ *
+ * Usage: dirparserbench [lines] [chunksize]
+ *
+ * Generates a Unix-style listing with the given number of lines, feeds it
+ * to the parser in chunks of the given size, as received from a data
+ * connection, and reports the number of lines parsed per second.
+ */
+
+namespace {
+std::string make_listing(size_t lines)
+{
+	std::string ret;
+	ret.reserve(lines * 70);
+	for (size_t i = 0; i < lines; ++i) {
+		ret += fz::sprintf("-rw-r--r--   1 user     group    %10u Jan %2u 12:%02u file_%u.txt\r\n", i * 37, i % 28 + 1, i % 60, i);
+	}
+	return ret;
+}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t lines = 500000;
+	size_t chunksize = 65536;
+	if (argc > 1) {
+		lines = static_cast<size_t>(atol(argv[1]));
+	}
+	if (argc > 2) {
+		chunksize = static_cast<size_t>(atol(argv[2]));
+	}
+	if (!lines || !chunksize) {
+		std::cerr << "Usage: " << argv[0] << " [lines] [chunksize]" << std::endl;
+		return 1;
+	}
+
+	std::string const listing = make_listing(lines);
+
+	CServer server;
+	server.SetType(DEFAULT);
+	CDirectoryListingParser parser(nullptr, server);
+
+	auto const start = fz::monotonic_clock::now();
+	for (size_t pos = 0; pos < listing.size(); pos += chunksize) {
+		size_t const len = std::min(chunksize, listing.size() - pos);
+		char* data = new char[len];
+		memcpy(data, listing.c_str() + pos, len);
+		parser.AddData(data, static_cast<int>(len));
+	}
+	CDirectoryListing result = parser.Parse(CServerPath());
+	auto const elapsed = (fz::monotonic_clock::now() - start).get_milliseconds();
+
+	if (result.size() != lines) {
+		std::cerr << "Parsed " << result.size() << " entries, expected " << lines << std::endl;
+		return 1;
+	}
+
+	std::cout << "Parsed " << lines << " lines in " << elapsed << " ms";
+	if (elapsed > 0) {
+		std::cout << ", " << (static_cast<int64_t>(lines) * 1000 / elapsed) << " lines/s";
+	}
+	std::cout << std::endl;
+
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include <libfilezilla/util.hpp>
 
 #include <cppunit/extensions/HelperMacros.h>
+#include <algorithm>
 #include <list>
 
 #include <string.h>
@@ -31,6 +32,7 @@ class CDirectoryListingParserTest final : public CppUnit::TestFixture
 	}
 	CPPUNIT_TEST(testAll);
 	CPPUNIT_TEST(testSpecial);
+	CPPUNIT_TEST(testChunked);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -40,6 +42,7 @@ public:
 	void testIndividual();
 	void testAll();
 	void testSpecial();
+	void testChunked();
 
 	static std::vector<t_entry> m_entries;
 
@@ -1546,6 +1549,62 @@ void CDirectoryListingParserTest::testSpecial()
 	}
 }
 
+namespace {
+CDirectoryListing ParseChunked(CServer const& server, std::string const& data, size_t chunk)
+{
+	CDirectoryListingParser parser(0, server);
+	for (size_t pos = 0; pos < data.size(); pos += chunk) {
+		size_t const len = std::min(chunk, data.size() - pos);
+		char* p = new char[len];
+		memcpy(p, data.c_str() + pos, len);
+		parser.AddData(p, len);
+	}
+	return parser.Parse(CServerPath());
+}
+}
+
+void CDirectoryListingParserTest::testChunked()
+{
+	CServer server;
+	server.SetType(DEFAULT);
+
+	// Lines may be split at any position, including between CR and LF.
+	// Use bare LF on every third line to also cover mixed line endings.
+	std::string data;
+	size_t count{};
+	for (auto const& entry : m_entries) {
+		if (entry.serverType != DEFAULT) {
+			continue;
+		}
+		if (count++ % 3 == 2) {
+			data += entry.data.substr(0, entry.data.size() - 2) + "\n";
+		}
+		else {
+			data += entry.data;
+		}
+	}
+
+	CDirectoryListing const reference = ParseChunked(server, data, data.size());
+	CPPUNIT_ASSERT(reference.size() > 0);
+
+	for (size_t chunk : { 1, 2, 3, 7, 13, 64, 1021 }) {
+		CDirectoryListing const listing = ParseChunked(server, data, chunk);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(fz::sprintf("Chunk size %u", chunk), reference.size(), listing.size());
+		for (size_t i = 0; i < listing.size(); ++i) {
+			std::string const msg = fz::sprintf("Chunk size %u  Expected:\n%s\n  Got:\n%s", chunk, reference[i].dump(), listing[i].dump());
+			CPPUNIT_ASSERT_MESSAGE(msg, listing[i] == reference[i]);
+		}
+	}
+
+	// A final line without line ending must not get lost, no matter how it is split
+	std::string const last = "-rw-r--r--   1 root     other        531 Apr  8  1994 unterminated";
+	for (size_t chunk : { 1, 5, last.size() }) {
+		CDirectoryListing const listing = ParseChunked(server, data + last, chunk);
+		CPPUNIT_ASSERT_EQUAL(reference.size() + 1, listing.size());
+		CPPUNIT_ASSERT(listing[listing.size() - 1].name == L"unterminated");
+	}
+}
+
 void CDirectoryListingParserTest::setUp()
 {
 }
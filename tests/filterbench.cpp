@@ -0,0 +1,141 @@
+#include "../src/include/libfilezilla_engine.h"
+#include "../src/engine/directorylistingparser.h"
+#include "../src/commonui/filter_matcher.h"
+
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/time.hpp>
+
+#include <iostream>
+#include <tuple>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Compares evaluating the filters entry by entry through
+ * filter_manager::FilenameFiltered with evaluating whole listings through
+ * filter_matcher.
+ *
+ * Usage: filterbench [entries] [rounds]
+ *
+ * Generates a Unix-style listing with the given number of entries and
+ * filters it repeatedly using a mix of string, regular expression, size
+ * and path conditions. Both ways need to filter the same entries.
+ */
+
+namespace {
+CDirectoryListing make_listing(size_t lines)
+{
+	std::string listing;
+	listing.reserve(lines * 70);
+	char const* const extensions[] = { "txt", "TMP", "bak", "jpg", "cache" };
+	for (size_t i = 0; i < lines; ++i) {
+		if (i % 10) {
+			listing += fz::sprintf("-rw-r--r--   1 user     group    %10u Jan %2u 12:%02u file_%u.%s\r\n", i * 37, i % 28 + 1, i % 60, i, extensions[i % 5]);
+		}
+		else {
+			listing += fz::sprintf("drwxr-xr-x   1 user     group          4096 Jan %2u 12:%02u dir_%u\r\n", i % 28 + 1, i % 60, i);
+		}
+	}
+
+	CServer server;
+	server.SetType(DEFAULT);
+	CDirectoryListingParser parser(nullptr, server);
+	char* data = new char[listing.size()];
+	memcpy(data, listing.c_str(), listing.size());
+	parser.AddData(data, static_cast<int>(listing.size()));
+	return parser.Parse(CServerPath(L"/home/user"));
+}
+
+void add_filter(std::vector<CFilter>& filters, CFilter::t_matchType matchType, bool matchCase, std::vector<std::tuple<t_filterType, std::wstring, int>> const& conditions)
+{
+	CFilter filter;
+	filter.matchType = matchType;
+	filter.matchCase = matchCase;
+	for (auto const& [type, value, op] : conditions) {
+		CFilterCondition condition;
+		if (condition.set(type, value, op, matchCase)) {
+			filter.filters.push_back(condition);
+		}
+	}
+	filters.push_back(filter);
+}
+
+std::vector<CFilter> make_filters()
+{
+	std::vector<CFilter> filters;
+	add_filter(filters, CFilter::any, true, { { filter_name, L".bak", 3 }, { filter_name, L"~", 3 } });
+	add_filter(filters, CFilter::all, true, { { filter_name, L"\\.jpg$", 4 }, { filter_size, L"100000", 0 } });
+	add_filter(filters, CFilter::all, true, { { filter_name, L"file_12[0-9]+\\.txt", 4 } });
+	add_filter(filters, CFilter::all, false, { { filter_name, L"\\.tmp$", 4 } });
+	add_filter(filters, CFilter::all, false, { { filter_name, L"CACHE", 0 }, { filter_path, L"/home", 2 } });
+	add_filter(filters, CFilter::none, true, { { filter_name, L"^(file|dir)_", 4 } });
+	return filters;
+}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t entries = 100000;
+	size_t rounds = 10;
+	if (argc > 1) {
+		entries = static_cast<size_t>(atol(argv[1]));
+	}
+	if (argc > 2) {
+		rounds = static_cast<size_t>(atol(argv[2]));
+	}
+	if (!entries || !rounds) {
+		std::cerr << "Usage: " << argv[0] << " [entries] [rounds]" << std::endl;
+		return 1;
+	}
+
+	CDirectoryListing const listing = make_listing(entries);
+	if (listing.size() != entries) {
+		std::cerr << "Parsed " << listing.size() << " entries, expected " << entries << std::endl;
+		return 1;
+	}
+	std::wstring const path = listing.path.GetPath();
+
+	std::vector<CFilter> const filters = make_filters();
+
+	std::vector<bool> expected(entries);
+	auto start = fz::monotonic_clock::now();
+	for (size_t round = 0; round < rounds; ++round) {
+		for (size_t i = 0; i < entries; ++i) {
+			CDirentry const& entry = listing[i];
+			expected[i] = filter_manager::FilenameFiltered(filters, entry.name, path, entry.is_dir(), entry.size, 0, entry.time);
+		}
+	}
+	auto const single = (fz::monotonic_clock::now() - start).get_milliseconds();
+
+	std::vector<bool> filtered;
+	start = fz::monotonic_clock::now();
+	for (size_t round = 0; round < rounds; ++round) {
+		filter_matcher const matcher(filters);
+		filtered = matcher.filtered(listing, path);
+	}
+	auto const batch = (fz::monotonic_clock::now() - start).get_milliseconds();
+
+	if (filtered != expected) {
+		for (size_t i = 0; i < entries; ++i) {
+			if (filtered[i] != expected[i]) {
+				std::wcerr << L"Results differ for " << listing[i].name << std::endl;
+				break;
+			}
+		}
+		return 1;
+	}
+
+	size_t count{};
+	for (bool f : filtered) {
+		if (f) {
+			++count;
+		}
+	}
+
+	std::cout << "Filtered " << count << " of " << entries << " entries " << rounds << " times" << std::endl;
+	std::cout << "Per entry: " << single << " ms" << std::endl;
+	std::cout << "Per listing: " << batch << " ms" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+#include "../src/include/libfilezilla_engine.h"
+#include "../src/commonui/filter_matcher.h"
+
+#include <libfilezilla/format.hpp>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <tuple>
+
+/*
+ * This testsuite asserts that filter_matcher filters exactly the same
+ * entries as filter_manager::FilenameFilteredByFilter, in particular for
+ * regular expressions it analyzes for literal text.
+ */
+
+class CFilterMatcherTest final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CFilterMatcherTest);
+	CPPUNIT_TEST(testStrings);
+	CPPUNIT_TEST(testRegex);
+	CPPUNIT_TEST(testCombined);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown() {}
+
+	void testStrings();
+	void testRegex();
+	void testCombined();
+
+protected:
+	void AssertSame(CFilter const& filter);
+
+	CDirectoryListing listing_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CFilterMatcherTest);
+
+namespace {
+CFilter make_filter(CFilter::t_matchType matchType, bool matchCase, std::vector<std::tuple<t_filterType, std::wstring, int>> const& conditions)
+{
+	CFilter filter;
+	filter.matchType = matchType;
+	filter.matchCase = matchCase;
+	for (auto const& [type, value, op] : conditions) {
+		CFilterCondition condition;
+		if (condition.set(type, value, op, matchCase)) {
+			filter.filters.push_back(condition);
+		}
+	}
+	return filter;
+}
+
+std::string describe(CFilter const& filter)
+{
+	std::wstring ret = fz::sprintf(L"match type %d, match case %d, files %d, dirs %d:", static_cast<int>(filter.matchType), static_cast<int>(filter.matchCase), static_cast<int>(filter.filterFiles), static_cast<int>(filter.filterDirs));
+	for (auto const& condition : filter.filters) {
+		ret += fz::sprintf(L" [%d %d \"%s\"]", static_cast<int>(condition.type), condition.condition, condition.strValue);
+	}
+	return fz::to_utf8(ret);
+}
+
+std::wstring const names[] = {
+	L"file.txt", L"File.TXT", L"file.txt.bak", L"file_123.txt", L"file_12a.txt",
+	L"dir_1", L"DIR_2", L"a", L"ab", L"a.b", L"aXb", L"abc", L"ABC", L"b",
+	L"[x]", L"x", L"x+y", L"xxy", L"back\\slash", L"dollar$", L"^caret", L"caret",
+	L"photo.JPG", L"photo.jpeg", L"photo.jpg", L"archive.tar.gz", L"README",
+	L"readme.md", L".hidden", L"x.y.z", L"123", L"tab\tname", L"space name",
+	L"\u00dcml\u00e4ut.TXT", L"\u00fcml\u00e4ut.txt", L"foo.bak~", L"(paren)", L"a|b",
+	L"question?", L"star*", L"dot.", L"..."
+};
+
+std::wstring const strings[] = {
+	L"txt", L"TXT", L"file", L"File", L".", L"a", L"A", L"x+y", L"$", L"^", L"[x]",
+	L"\u00dc", L"\u00fcml\u00e4ut.txt", L"readme", L"~", L"a|b"
+};
+
+std::wstring const expressions[] = {
+	// Plain text and escapes
+	L"txt", L"TXT", L"\\.txt", L"\\[x\\]", L"x\\+y", L"\\\\", L"\\$", L"\\^", L"\\.\\.\\.",
+	L"\\(paren\\)", L"a\\|b", L"question\\?", L"star\\*", L"\\t",
+	// Anchors
+	L"^file", L"txt$", L"^a$", L"^a.b$", L"\\$$", L"^\\^", L"^$", L"\\bname", L"^\\.",
+	// Alternation
+	L"a|b", L"^(file|dir)_", L"(tar|gz)$", L"txt|TXT|jpg", L"^(a|ab|abc)$", L"x(|y)",
+	// Classes and quantifiers
+	L"[0-9]+", L"[[:upper:]]", L"[^.]+$", L"^[^.]+$", L"file_12[0-9]+\\.txt", L"jpe?g",
+	L"x*y", L"x{2}", L"[.]", L"[\\]]", L"\\d", L"\\w+\\.\\w+", L"\\s", L".", L"a.*b",
+	L"(?:file)\\.", L"photo\\.(?=jpg)", L"\u00fc", L"README|readme"
+};
+
+CFilter::t_matchType const matchTypes[] = { CFilter::all, CFilter::any, CFilter::none, CFilter::not_all };
+}
+
+void CFilterMatcherTest::setUp()
+{
+	listing_ = CDirectoryListing();
+	listing_.path = CServerPath(L"/home/user");
+	int i{};
+	for (auto const& name : names) {
+		CDirentry entry;
+		entry.name = name;
+		entry.size = 100 * i;
+		if (!(i % 5)) {
+			entry.flags = CDirentry::flag_dir;
+			entry.size = -1;
+		}
+		listing_.Append(std::move(entry));
+		++i;
+	}
+}
+
+void CFilterMatcherTest::AssertSame(CFilter const& filter)
+{
+	std::wstring const path = listing_.path.GetPath();
+
+	std::vector<bool> expected(listing_.size());
+	for (size_t i = 0; i < listing_.size(); ++i) {
+		CDirentry const& entry = listing_[i];
+		expected[i] = filter_manager::FilenameFilteredByFilter(filter, entry.name, path, entry.is_dir(), entry.size, 0, entry.time);
+	}
+
+	filter_matcher const matcher(std::vector<CFilter>{filter});
+	std::vector<bool> const filtered = matcher.filtered(listing_, path);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE(describe(filter), expected.size(), filtered.size());
+	for (size_t i = 0; i < listing_.size(); ++i) {
+		CDirentry const& entry = listing_[i];
+		std::string const msg = describe(filter) + " on " + fz::to_utf8(entry.name);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(msg, static_cast<bool>(expected[i]), static_cast<bool>(filtered[i]));
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(msg, static_cast<bool>(expected[i]), matcher.filtered(entry.name, path, entry.is_dir(), entry.size, 0, entry.time));
+	}
+}
+
+void CFilterMatcherTest::testStrings()
+{
+	for (bool matchCase : { true, false }) {
+		for (auto const& value : strings) {
+			for (int op : { 0, 1, 2, 3, 5 }) {
+				AssertSame(make_filter(CFilter::all, matchCase, { { filter_name, value, op } }));
+			}
+		}
+	}
+}
+
+void CFilterMatcherTest::testRegex()
+{
+	for (bool matchCase : { true, false }) {
+		for (auto const& expression : expressions) {
+			CFilter const filter = make_filter(CFilter::all, matchCase, { { filter_name, expression, 4 } });
+			CPPUNIT_ASSERT_MESSAGE(describe(filter), !filter.filters.empty());
+			AssertSame(filter);
+		}
+	}
+}
+
+void CFilterMatcherTest::testCombined()
+{
+	for (auto matchType : matchTypes) {
+		for (bool matchCase : { true, false }) {
+			for (int dirs = 0; dirs < 4; ++dirs) {
+				CFilter filter = make_filter(matchType, matchCase, {
+					{ filter_name, L"^(file|dir)_", 4 },
+					{ filter_name, L"txt", 3 },
+					{ filter_path, L"/home", 2 }
+				});
+				filter.filterFiles = dirs & 1;
+				filter.filterDirs = dirs & 2;
+				AssertSame(filter);
+
+				filter = make_filter(matchType, matchCase, {
+					{ filter_name, L"\\.(jpe?g|TXT)$", 4 },
+					{ filter_size, L"1000", 0 },
+					{ filter_path, L"^/home/[a-z]+$", 4 }
+				});
+				filter.filterFiles = dirs & 1;
+				filter.filterDirs = dirs & 2;
+				AssertSame(filter);
+			}
+		}
+	}
+}
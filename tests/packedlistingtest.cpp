@@ -0,0 +1,173 @@
+#include "../src/include/libfilezilla_engine.h"
+#include "../src/engine/packed_listing.h"
+
+#include <libfilezilla/format.hpp>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <functional>
+
+#include <string.h>
+
+/*
+ * This testsuite asserts that directory listings survive being packed for
+ * the directory cache unchanged, and that blobs read back from the
+ * persistent cache are validated before use.
+ */
+
+class CPackedListingTest final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CPackedListingTest);
+	CPPUNIT_TEST(testRoundTrip);
+	CPPUNIT_TEST(testSerialize);
+	CPPUNIT_TEST(testTruncated);
+	CPPUNIT_TEST(testCorrupt);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown() {}
+
+	void testRoundTrip();
+	void testSerialize();
+	void testTruncated();
+	void testCorrupt();
+
+protected:
+	void AssertEqual(CDirectoryListing const& a, CDirectoryListing const& b);
+
+	CDirectoryListing listing_;
+	std::string blob_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CPackedListingTest);
+
+typedef fz::shared_value<std::wstring> R;
+
+void CPackedListingTest::setUp()
+{
+	std::vector<fz::shared_value<CDirentry>> entries;
+	auto add = [&entries](CDirentry && entry) {
+		entries.emplace_back(std::move(entry));
+	};
+
+	R const perms(L"-rw-r--r--");
+	R const owner(L"user group");
+
+	add({ L"file.txt", 1234, perms, owner, {}, fz::datetime(fz::datetime::utc, 2020, 2, 29, 13, 37, 42), 0 });
+	add({ L"dir", -1, R(L"drwxr-xr-x"), owner, {}, fz::datetime(fz::datetime::utc, 1999, 12, 31), CDirentry::flag_dir });
+	add({ L"link", 7, R(L"lrwxrwxrwx"), R(L"root wheel"), fz::sparse_optional<std::wstring>(L"../target dir"), fz::datetime(fz::datetime::utc, 2021, 7, 1, 8, 15), CDirentry::flag_dir | CDirentry::flag_link });
+	add({ L"ms", 0, perms, owner, {}, fz::datetime(fz::datetime::utc, 2022, 1, 2, 3, 4, 5, 678), CDirentry::flag_unsure });
+	add({ L"no time", 5000000000ll, perms, R(), {}, fz::datetime(), 0 });
+	add({ L"\u00e4\u00f6\u00fc \u65e5\u672c", 1, R(), R(), {}, fz::datetime(fz::datetime::utc, 2010, 5, 6, 7), 0 });
+
+	listing_ = CDirectoryListing();
+	listing_.Assign(std::move(entries));
+
+	CPackedDirectoryListing packed;
+	CPPUNIT_ASSERT(packed.Pack(listing_));
+	blob_.clear();
+	packed.Serialize(blob_);
+}
+
+void CPackedListingTest::AssertEqual(CDirectoryListing const& a, CDirectoryListing const& b)
+{
+	CPPUNIT_ASSERT_EQUAL(a.size(), b.size());
+	for (size_t i = 0; i < a.size(); ++i) {
+		std::string const msg = fz::sprintf("Expected:\n%s\n  Got:\n%s", a[i].dump(), b[i].dump());
+		CPPUNIT_ASSERT_MESSAGE(msg, a[i] == b[i]);
+
+		// operator== ignores these if there is no date
+		CPPUNIT_ASSERT(a[i].time.empty() == b[i].time.empty());
+		CPPUNIT_ASSERT(!a[i].target == !b[i].target);
+		CPPUNIT_ASSERT(!a[i].target || *a[i].target == *b[i].target);
+	}
+}
+
+void CPackedListingTest::testRoundTrip()
+{
+	CPackedDirectoryListing packed;
+	CPPUNIT_ASSERT(packed.Pack(listing_));
+	CPPUNIT_ASSERT_EQUAL(listing_.size(), packed.size());
+
+	CDirectoryListing unpacked;
+	unpacked.m_flags = CDirectoryListing::unsure_file_added;
+	packed.Unpack(unpacked);
+	AssertEqual(listing_, unpacked);
+
+	// Listing flags are left alone
+	CPPUNIT_ASSERT(unpacked.m_flags & CDirectoryListing::unsure_file_added);
+}
+
+void CPackedListingTest::testSerialize()
+{
+	CPackedDirectoryListing packed;
+	CPPUNIT_ASSERT(packed.Deserialize(reinterpret_cast<unsigned char const*>(blob_.data()), blob_.size()));
+
+	CDirectoryListing unpacked;
+	packed.Unpack(unpacked);
+	AssertEqual(listing_, unpacked);
+
+	std::string blob;
+	packed.Serialize(blob);
+	CPPUNIT_ASSERT(blob == blob_);
+}
+
+void CPackedListingTest::testTruncated()
+{
+	CPackedDirectoryListing packed;
+	for (size_t len = 0; len < blob_.size(); ++len) {
+		CPPUNIT_ASSERT_MESSAGE(fz::sprintf("Length %u", len), !packed.Deserialize(reinterpret_cast<unsigned char const*>(blob_.data()), len));
+	}
+
+	std::string const longer = blob_ + '\0';
+	CPPUNIT_ASSERT(!packed.Deserialize(reinterpret_cast<unsigned char const*>(longer.data()), longer.size()));
+}
+
+namespace {
+void put_u32(std::string & blob, size_t offset, uint32_t v)
+{
+	memcpy(&blob[offset], &v, sizeof(v));
+}
+
+uint32_t get_u32(std::string const& blob, size_t offset)
+{
+	uint32_t v;
+	memcpy(&v, &blob[offset], sizeof(v));
+	return v;
+}
+}
+
+void CPackedListingTest::testCorrupt()
+{
+	// The entries are stored at the end of the blob as fixed-size records
+	// starting with size and time, followed by the name offset and length,
+	// the target offset and length and the table indexes.
+	size_t const entry_size = get_u32(blob_, 4);
+	size_t const first_entry = blob_.size() - listing_.size() * entry_size;
+	size_t const name_offset = first_entry + 16;
+	size_t const name_length = name_offset + 4;
+	size_t const target_offset = name_offset + 8;
+	size_t const permissions = name_offset + 16;
+	size_t const owner_group = name_offset + 20;
+	size_t const accuracy = name_offset + 26;
+
+	auto check = [this](std::function<void(std::string&)> const& corrupt, char const* what) {
+		std::string blob = blob_;
+		corrupt(blob);
+		CPackedDirectoryListing packed;
+		CPPUNIT_ASSERT_MESSAGE(what, !packed.Deserialize(reinterpret_cast<unsigned char const*>(blob.data()), blob.size()));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), packed.size());
+	};
+
+	check([](std::string & blob) { put_u32(blob, 0, get_u32(blob, 0) + 1); }, "version");
+	check([](std::string & blob) { put_u32(blob, 4, get_u32(blob, 4) + 8); }, "entry size");
+	check([](std::string & blob) { put_u32(blob, 8, 0x7fffffff); }, "table size");
+	check([&](std::string & blob) { put_u32(blob, name_offset, 0xfffffff0); }, "name offset");
+	check([&](std::string & blob) { put_u32(blob, name_length, 0x10000000); }, "name length");
+	check([&](std::string & blob) { put_u32(blob, target_offset, 0x10000000); }, "target offset");
+	check([&](std::string & blob) { put_u32(blob, permissions, 1000); }, "permissions index");
+	check([&](std::string & blob) { put_u32(blob, owner_group, 1000); }, "owner/group index");
+	check([&](std::string & blob) { blob[accuracy] = 42; }, "time accuracy");
+	check([&](std::string & blob) { put_u32(blob, first_entry - 4, static_cast<uint32_t>(listing_.size() + 1)); }, "entry count");
+}
@@ -0,0 +1,117 @@
+#include "bench_client.h"
+
+#include "../src/include/engine_options.h"
+
+#include <libfilezilla/local_filesys.hpp>
+#include <libfilezilla/time.hpp>
+
+#include <iostream>
+
+#include <stdlib.h>
+
+/*
+ * Measures SFTP transfer throughput between the engine and fzsftp.
+ *
+ * Usage: sftpbench <fzsftp> <port> <user> <password|key:keyfile> <remote file> <local file> [iterations]
+ *
+ * Connects to an SFTP server on the loopback interface, downloads the remote
+ * file to the local file and uploads it back next to the remote file, the
+ * given number of times each. Reports the average throughput per direction.
+ *
+ * Any OpenSSH-compatible server works, e.g. an unprivileged sshd:
+ *
+ *   ssh-keygen -q -N '' -t ed25519 -f hostkey
+ *   /usr/sbin/sshd -D -p 2222 -h $PWD/hostkey -o AuthorizedKeysFile=$PWD/keys.pub
+ *
+ * On loopback, latency between the engine and fzsftp dominates over the
+ * network, which makes it suitable to compare buffer handling changes.
+ */
+
+int main(int argc, char* argv[])
+{
+	if (argc < 7) {
+		std::cerr << "Usage: " << argv[0] << " <fzsftp> <port> <user> <password|key:keyfile> <remote file> <local file> [iterations]" << std::endl;
+		return 1;
+	}
+
+	int iterations = 3;
+	if (argc > 7) {
+		iterations = atoi(argv[7]);
+	}
+	unsigned int const port = static_cast<unsigned int>(atoi(argv[2]));
+	if (iterations <= 0 || !port) {
+		std::cerr << "Invalid port or number of iterations" << std::endl;
+		return 1;
+	}
+
+	bench_options options;
+	options.set(OPTION_FZSFTP_EXECUTABLE, fz::to_wstring(std::string(argv[1])));
+
+	bench_encoding_converter converter;
+	CFileZillaEngineContext context(options, converter);
+	bench_client client(context);
+
+	CServer server(SFTP, DEFAULT, L"127.0.0.1", port);
+	server.SetUser(fz::to_wstring(std::string(argv[3])));
+
+	Credentials credentials;
+	std::string const auth = argv[4];
+	if (auth.substr(0, 4) == "key:") {
+		credentials.logonType_ = LogonType::key;
+		credentials.keyFile_ = fz::to_wstring(auth.substr(4));
+	}
+	else {
+		credentials.logonType_ = LogonType::normal;
+		credentials.SetPass(fz::to_wstring(auth));
+	}
+
+	std::wstring const remote = fz::to_wstring(std::string(argv[5]));
+	auto const pos = remote.rfind('/');
+	if (pos == std::wstring::npos) {
+		std::cerr << "Remote file needs to be an absolute path" << std::endl;
+		return 1;
+	}
+	CServerPath const remotePath(pos ? remote.substr(0, pos) : L"/");
+	std::wstring const remoteFile = remote.substr(pos + 1);
+	std::wstring const local = fz::to_wstring(std::string(argv[6]));
+
+	if (client.run(CConnectCommand(server, ServerHandle(), credentials)) != FZ_REPLY_OK) {
+		std::cerr << "Could not connect" << std::endl;
+		return 1;
+	}
+
+	auto const measure = [&](bool download) {
+		int64_t size{};
+		fz::duration total;
+		for (int i = 0; i < iterations; ++i) {
+			auto const start = fz::monotonic_clock::now();
+			int res;
+			if (download) {
+				res = client.run(CFileTransferCommand(fz::file_writer_factory(local, context.GetThreadPool()), remotePath, remoteFile, transfer_flags::download));
+			}
+			else {
+				res = client.run(CFileTransferCommand(fz::file_reader_factory(local, context.GetThreadPool()), remotePath, remoteFile + L".sftpbench", transfer_flags::none));
+			}
+			if (res != FZ_REPLY_OK) {
+				std::cerr << (download ? "Download" : "Upload") << " failed" << std::endl;
+				return false;
+			}
+			total += fz::monotonic_clock::now() - start;
+			size += fz::local_filesys::get_size(fz::to_native(local));
+		}
+
+		double const seconds = static_cast<double>(total.get_milliseconds()) / 1000;
+		std::cout << (download ? "Download: " : "Upload:   ") << size << " bytes in " << seconds << " s";
+		if (seconds > 0) {
+			std::cout << ", " << (size / seconds / 1024 / 1024) << " MiB/s";
+		}
+		std::cout << std::endl;
+		return true;
+	};
+
+	if (!measure(true) || !measure(false)) {
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "bench_client.h"
+
+#include "../src/include/engine_options.h"
+
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/local_filesys.hpp>
+#include <libfilezilla/time.hpp>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+
+/*
+ * Measures how the aggregate throughput of concurrent FTP downloads scales
+ * with the number of transfers and engine event loops.
+ *
+ * Usage: transferbench <ftp|ftpes> <port> <user> <password> <remote file> <local dir> <transfers> [event loops]
+ *
+ * Connects the given number of engines to an FTP server on the loopback
+ * interface, then lets all of them download the remote file at the same
+ * time, each into its own file in the local directory. Files from earlier
+ * runs get overwritten. The number of event loops defaults to 0, one per
+ * CPU core. Running it with 1 event loop gives the baseline of all engines
+ * sharing a single thread.
+ *
+ * With FTP over TLS, the encryption makes the event loop threads the
+ * bottleneck, use a file of a few hundred MiB and a fast local server.
+ */
+
+int main(int argc, char* argv[])
+{
+	if (argc < 8) {
+		std::cerr << "Usage: " << argv[0] << " <ftp|ftpes> <port> <user> <password> <remote file> <local dir> <transfers> [event loops]" << std::endl;
+		return 1;
+	}
+
+	std::string const protocol = argv[1];
+	if (protocol != "ftp" && protocol != "ftpes") {
+		std::cerr << "Protocol needs to be ftp or ftpes" << std::endl;
+		return 1;
+	}
+	unsigned int const port = static_cast<unsigned int>(atoi(argv[2]));
+	int const transfers = atoi(argv[7]);
+	int loops = 0;
+	if (argc > 8) {
+		loops = atoi(argv[8]);
+	}
+	if (!port || transfers <= 0 || loops < 0) {
+		std::cerr << "Invalid port, number of transfers or event loops" << std::endl;
+		return 1;
+	}
+
+	bench_options options;
+	options.set(OPTION_EVENT_LOOPS, loops);
+
+	bench_encoding_converter converter;
+	CFileZillaEngineContext context(options, converter);
+
+	CServer server(protocol == "ftp" ? INSECURE_FTP : FTPES, DEFAULT, L"127.0.0.1", port);
+	server.SetUser(fz::to_wstring(std::string(argv[3])));
+
+	Credentials credentials;
+	credentials.logonType_ = LogonType::normal;
+	credentials.SetPass(fz::to_wstring(std::string(argv[4])));
+
+	std::wstring const remote = fz::to_wstring(std::string(argv[5]));
+	auto const pos = remote.rfind('/');
+	if (pos == std::wstring::npos) {
+		std::cerr << "Remote file needs to be an absolute path" << std::endl;
+		return 1;
+	}
+	CServerPath const remotePath(pos ? remote.substr(0, pos) : L"/");
+	std::wstring const remoteFile = remote.substr(pos + 1);
+	std::wstring const localDir = fz::to_wstring(std::string(argv[6]));
+
+	std::vector<std::unique_ptr<bench_client>> clients;
+	for (int i = 0; i < transfers; ++i) {
+		clients.emplace_back(std::make_unique<bench_client>(context));
+		if (clients.back()->run(CConnectCommand(server, ServerHandle(), credentials)) != FZ_REPLY_OK) {
+			std::cerr << "Could not connect" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<int> results(transfers, FZ_REPLY_ERROR);
+	auto const start = fz::monotonic_clock::now();
+	{
+		std::vector<std::thread> threads;
+		for (int i = 0; i < transfers; ++i) {
+			threads.emplace_back([&, i]() {
+				std::wstring const local = localDir + fz::sprintf(L"/transferbench.%d", i);
+				results[i] = clients[i]->run(CFileTransferCommand(fz::file_writer_factory(local, context.GetThreadPool()), remotePath, remoteFile, transfer_flags::download));
+			});
+		}
+		for (auto & thread : threads) {
+			thread.join();
+		}
+	}
+	fz::duration const total = fz::monotonic_clock::now() - start;
+
+	int64_t size{};
+	for (int i = 0; i < transfers; ++i) {
+		std::wstring const local = localDir + fz::sprintf(L"/transferbench.%d", i);
+		if (results[i] != FZ_REPLY_OK) {
+			std::cerr << "Download " << i << " failed" << std::endl;
+			return 1;
+		}
+		size += fz::local_filesys::get_size(fz::to_native(local));
+	}
+
+	double const seconds = static_cast<double>(total.get_milliseconds()) / 1000;
+	std::cout << transfers << " transfers on " << context.GetEventLoopCount() << " event loops: " << size << " bytes in " << seconds << " s";
+	if (seconds > 0) {
+		std::cout << ", " << (size / seconds / 1024 / 1024) << " MiB/s";
+	}
+	std::cout << std::endl;
+
+	return 0;
+}